@@ -0,0 +1,88 @@
+#!/bin/bash
+
+set -e
+
+# Compares the parser of two revisions on the examples, e.g.
+#   ./profile.sh HEAD~5 HEAD
+# Each revision is built in its own worktree that shares extern with this one.
+# Prints per file the prediction calls, time in prediction and LL fallbacks
+# summed over all decisions (see --profile-parser), then the parse wall time.
+# Revisions without --profile-parser only get the wall time. Afterwards the
+# --dot output of both revisions is compared for every example, a grammar
+# change that keeps the ASTs has no differences.
+
+BEFORE=${1:-HEAD~1}
+AFTER=${2:-HEAD}
+RUNS=${RUNS:-5}
+
+ROOT=$(dirname $(readlink -f $0))
+WORK=$(mktemp -d)
+cleanup() {
+    git -C "$ROOT" worktree remove --force "$WORK/before" || true
+    git -C "$ROOT" worktree remove --force "$WORK/after" || true
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+build() {
+    git -C "$ROOT" worktree add --detach "$WORK/$1" "$2" > /dev/null
+    rm -rf "$WORK/$1/extern/antlr4" "$WORK/$1/extern/jlibc"
+    ln -s "$ROOT/extern/antlr4" "$WORK/$1/extern/antlr4"
+    ln -s "$ROOT/extern/jlibc" "$WORK/$1/extern/jlibc"
+    ln -s "$ROOT/extern/antlr.jar" "$WORK/$1/extern/antlr.jar"
+    cmake -S "$WORK/$1" -B "$WORK/$1/build" -DCMAKE_BUILD_TYPE=Release > /dev/null
+    cmake --build "$WORK/$1/build" -j 16 --target ccomp > /dev/null
+}
+
+# calls, ms in prediction and LL fallbacks of one run
+decisions() {
+    "$1" "$2" --profile-parser 2>&1 >/dev/null |
+        awk '$1 ~ /^[0-9]+$/ && NF == 8 { n++; calls += $3; ms += $4; ll += $6 }
+             END { if (n) printf "%10d %10.3f %8d", calls, ms, ll
+                   else printf "%10s %10s %8s", "-", "-", "-" }'
+}
+
+# Best of RUNS wall times in ms
+wall() {
+    local best=""
+    for _ in $(seq "$RUNS"); do
+        local start=$(date +%s%N)
+        "$1" "$2" > /dev/null 2>&1
+        local ms=$((($(date +%s%N) - start) / 1000000))
+        if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then
+            best=$ms
+        fi
+    done
+    echo "$best"
+}
+
+build before "$BEFORE"
+build after "$AFTER"
+
+# ccomp writes foo.pre.c into the working directory
+cd "$WORK"
+printf "%-16s %-7s %10s %10s %8s %8s\n" "file" "rev" "calls" "pred ms" \
+    "LL fall" "wall ms"
+for file in "$ROOT"/examples/*.c; do
+    for rev in before after; do
+        exe="$WORK/$rev/build/ccomp"
+        printf "%-16s %-7s %s %8s\n" "$(basename $file)" "$rev" \
+            "$(decisions "$exe" "$file")" "$(wall "$exe" "$file")"
+    done
+done
+
+# Same AST, as far as the dot graph shows it
+differences=0
+for file in "$ROOT"/examples/*.c; do
+    name=$(basename "$file" .c)
+    for rev in before after; do
+        "$WORK/$rev/build/ccomp" "$file" --dot "$WORK/$name.$rev.dot" \
+            > /dev/null 2>&1 || true
+    done
+    if diff -u "$WORK/$name.before.dot" "$WORK/$name.after.dot"; then
+        echo "$name.c: same AST"
+    else
+        differences=$((differences + 1))
+    fi
+done
+echo "$differences examples with a different AST"
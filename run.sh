@@ -2,19 +2,7 @@
 
 set -e
 
-# Check if antlr is there
-./extern/get_antlr.sh
-
-# Generate Antlr Cpp files
-mkdir -p src/antlr
-if [[ src/C.g4 -nt src/antlr/CParser.h ]]; then
-    echo "Generating Antlr Cpp files"
-    cd src
-    java -jar ../extern/antlr.jar -Dlanguage=Cpp -o antlr/ -no-listener -no-visitor -lib antlr C.g4
-    cd ..
-else
-    echo "Antlr Cpp files are up to date"
-fi
+# The Antlr Cpp files are generated by cmake
 
 # Check Formatting
 clang-format src/*.cpp src/*.hpp -i
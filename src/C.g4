@@ -1,31 +1,198 @@
 grammar C;
 
+// TYPEDEF_NAME is emitted instead of IDENTIFIER for names declared with
+// typedef, LAZY_BODY by the LazyBodyFilter for a skipped function body
+tokens { TYPEDEF_NAME, LAZY_BODY }
+
 @parser::header {
 #include "ast.hpp"
 #include "memory"
 #include "common.hpp"
+#include "parser.hpp"
+#include "tokens.hpp"
+#include "typedefs.hpp"
 using namespace CCOMP::AST;
 
+#include <functional>
 #include <sstream>
+#include <string_view>
+
+}
+
+@parser::members {
+// Every string literal of the program, handed over to the Program node
+std::shared_ptr<StringPool> strings = std::make_shared<StringPool>();
+
+// Shared with the token factory, which uses it to emit TYPEDEF_NAME tokens
+std::shared_ptr<CCOMP::Parser::TypedefTable> typedefs;
+
+// Byte range of every globalDeclaration, in the order they were parsed. Offsets
+// are relative to the parsed text.
+std::vector<CCOMP::Parser::DeclarationSpan> declaration_spans;
+
+// Offset of the parsed text in the source buffer
+uint32_t base_offset = 0;
+
+// Initializer lists of only number literals are stored packed
+bool pack_literals = true;
+
+// Creates the FunctionDefinition body for a LAZY_BODY token
+std::function<std::unique_ptr<LazyBody>(antlr4::Token *)> make_lazy_body;
+
+// All tokens are created by the ArenaTokenFactory of CCOMP::Parser::parse
+static std::string_view text(antlr4::Token *token) {
+    return static_cast<CCOMP::Parser::ArenaToken *>(token)->view();
+}
+
+SourceLocation loc(antlr4::Token *token) const {
+    return SourceLocation(base_offset + static_cast<CCOMP::Parser::ArenaToken *>(token)->get_offset());
+}
+
+// Tokens already buffered for lookahead were classified with the old
+// typedef table
+void retype_lookahead() {
+    for (size_t i = _input->index(); i < _input->size(); i++) {
+        auto *token = static_cast<CCOMP::Parser::ArenaToken *>(_input->get(i));
+        size_t type = token->getType();
+        if (type != IDENTIFIER && type != TYPEDEF_NAME) {
+            continue;
+        }
+        token->setType(typedefs->is_typedef(token->view()) ? TYPEDEF_NAME : IDENTIFIER);
+    }
+}
+
+// Gives a declarator the type written in front of it, see the declarator rule
+static std::unique_ptr<Identifier> complete_declarator(std::unique_ptr<Identifier> id, FunctionType *pending, std::unique_ptr<Type> type) {
+    if (pending != nullptr) {
+        pending->return_type = std::move(type);
+    } else {
+        id->add_type(std::move(type));
+    }
+    return id;
+}
+
+static std::unique_ptr<FunctionType> make_function_type(SourceLocation location, std::vector<std::unique_ptr<Identifier>> &parameters, bool varargs) {
+    auto fn = std::make_unique<FunctionType>(location, nullptr);
+    fn->varargs = varargs;
+    for (auto &parameter : parameters) {
+        fn->add_parameter(std::move(parameter));
+    }
+    return fn;
+}
+
+// Decodes an integer token, an invalid digit is reported like a syntax error
+IntegerLiteral decode_integer(antlr4::Token *token) {
+    std::string diagnostic;
+    IntegerLiteral literal = CCOMP::AST::decode_integer(text(token), diagnostic);
+    if (!diagnostic.empty()) {
+        notifyErrorListeners(token, diagnostic, nullptr);
+    }
+    return literal;
+}
+
+// Reads the elements of the first arrayInitializerList alternative from the
+// tokens between the braces. Once an element does not fit the packed ones
+// before it, the list continues with nodes.
+void add_literals(ArrayInitializationList &list, antlr4::Token *lbrace, antlr4::Token *rbrace) {
+    PackedLiterals packed;
+    bool packing = true;
+    bool minus = false;
+    for (size_t i = lbrace->getTokenIndex() + 1; i < rbrace->getTokenIndex(); i++) {
+        antlr4::Token *token = _input->get(i);
+        if (token->getType() == COMMA) {
+            continue;
+        }
+        if (token->getType() == MINUS) {
+            minus = true;
+            continue;
+        }
+
+        std::string_view t = text(token);
+        bool is_float = token->getType() == NUMBER && is_float_literal(t);
+        IntegerLiteral integer;
+        FloatLiteral floating{};
+        if (is_float) {
+            floating = decode_float(t);
+        } else {
+            integer = decode_integer(token);
+        }
+
+        if (packing) {
+            uint32_t offset = loc(token).get_offset() - loc(lbrace).get_offset();
+            if (is_float ? packed.add(floating, minus, offset) : packed.add(integer, minus, offset)) {
+                minus = false;
+                continue;
+            }
+            // add_value gives the elements packed so far nodes as well
+            list.set_packed(std::make_shared<const PackedLiterals>(std::move(packed)));
+            packing = false;
+        }
 
+        std::unique_ptr<AST> value;
+        if (is_float) {
+            value = std::make_unique<Constant>(loc(token), floating);
+        } else {
+            value = std::make_unique<Constant>(loc(token), integer);
+        }
+        if (minus) {
+            value = std::make_unique<UnaryExpression>(loc(token), std::move(value), UnaryExpression::Operator::MINUS);
+        }
+        list.add_value(std::move(value));
+        minus = false;
+    }
+
+    if (packing) {
+        packed.shrink_to_fit();
+        list.set_packed(std::make_shared<const PackedLiterals>(std::move(packed)));
+    }
+}
+
+// Dimensions are ArrayDimensionContexts, which are not declared here yet
+template <typename Dimensions>
+static void add_array_dimensions(Type &type, Dimensions &dimensions) {
+    if (dimensions.empty()) {
+        return;
+    }
+    type.set_array_dimensions(dimensions.size());
+    for (size_t i = 0; i < dimensions.size(); i++) {
+        if (dimensions[i]->size) {
+            type.set_array_dimension(i, std::move(dimensions[i]->size));
+        }
+    }
+}
 }
 
 // Parser
 program returns [ std::unique_ptr<Program> ast ]
     : (decls += globalDeclaration)* EOF
     {
-        $ast = std::make_unique<Program>(0, 0);
+        $ast = std::make_unique<Program>(SourceLocation(base_offset));
+        $ast->strings = strings;
         for (int i = 0; i < $decls.size(); i++) {
-            $ast->add_declaration(std::move($decls[i]->ast));
+            auto *stop = static_cast<CCOMP::Parser::ArenaToken *>($decls[i]->stop);
+            auto &span = declaration_spans[i];
+            if (stop != nullptr && stop->getTokenIndex() >= $decls[i]->start->getTokenIndex()) {
+                span.end = stop->get_offset() + stop->view().size();
+            } else {
+                span.end = span.begin;
+            }
+            span.in_program = $decls[i]->ast != nullptr;
+
+            if ($decls[i]->ast) {
+                $ast->add_declaration(std::move($decls[i]->ast));
+            }
         }
     }
     ;
 
 block returns [ std::unique_ptr<Block> ast ]
-    : LBRACE (s+=statement)* RBRACE
+    : LBRACE { typedefs->push_scope(); } (s+=statement)* RBRACE
     {
+        typedefs->pop_scope();
+        retype_lookahead();
+
         Token *symbol = $ctx->LBRACE()->getSymbol();
-        $ast = std::make_unique<Block>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<Block>(loc(symbol));
         for (int i = 0; i < $s.size(); i++) {
             $ast->add_statement(std::move($s[i]->ast));
         }
@@ -35,16 +202,14 @@ block returns [ std::unique_ptr<Block> ast ]
 statement returns [ std::unique_ptr<AST> ast ]
     : variableDeclaration SEMICOLON
         {
+            typedefs->declare_ordinary($variableDeclaration.ast->name->name);
+            retype_lookahead();
             $ast = std::move($variableDeclaration.ast);
         }
     | returnStatement SEMICOLON
         {
             $ast = std::move($returnStatement.ast);
         }
-    | fn=functionCall SEMICOLON
-    {
-        $ast = std::move($fn.ast);
-    }
     | b=block
     {
         $ast = std::move($b.ast);
@@ -80,19 +245,18 @@ ifStatement returns [ std::unique_ptr<If> ast ]
     {
         Token *symbol = $ctx->IF()->getSymbol();
         if ($b2.ctx != nullptr) {
-            $ast = std::make_unique<If>(symbol->getLine(), symbol->getCharPositionInLine(), std::move($cond.ast), std::move($b.ast), std::move($b2.ast));
+            $ast = std::make_unique<If>(loc(symbol), std::move($cond.ast), std::move($b.ast), std::move($b2.ast));
         } else {
-            $ast = std::make_unique<If>(symbol->getLine(), symbol->getCharPositionInLine(), std::move($cond.ast), std::move($b.ast));
+            $ast = std::make_unique<If>(loc(symbol), std::move($cond.ast), std::move($b.ast));
         }
     }
     ;
 
-
 forStatement returns [ std::unique_ptr<For> ast ]
     : FOR LPAREN (init=expression)? SEMICOLON (cond=expression)? SEMICOLON (inc=expression)? RPAREN s=statement
     {
         Token *symbol = $ctx->FOR()->getSymbol();
-        auto f = std::make_unique<For>(symbol->getLine(), symbol->getCharPositionInLine(), std::move($s.ast));
+        auto f = std::make_unique<For>(loc(symbol), std::move($s.ast));
         if ($init.ctx != nullptr) { f->set_init(std::move($init.ast)); }
         if ($cond.ctx != nullptr) { f->set_condition(std::move($cond.ast)); }
         if ($inc.ctx != nullptr) { f->set_increment(std::move($inc.ast)); }
@@ -104,16 +268,15 @@ whileStatement returns [ std::unique_ptr<While> ast ]
     : WHILE LPAREN cond=expression RPAREN s=statement
     {
         Token *symbol = $ctx->WHILE()->getSymbol();
-        $ast = std::make_unique<While>(symbol->getLine(), symbol->getCharPositionInLine(), std::move($cond.ast), std::move($s.ast));
+        $ast = std::make_unique<While>(loc(symbol), std::move($cond.ast), std::move($s.ast));
     }
     ;
 
-
 doWhileStatement returns [ std::unique_ptr<DoWhile> ast ]
     : DO s=statement WHILE LPAREN cond=expression RPAREN
     {
         Token *symbol = $ctx->WHILE()->getSymbol();
-        $ast = std::make_unique<DoWhile>(symbol->getLine(), symbol->getCharPositionInLine(), std::move($cond.ast), std::move($s.ast));
+        $ast = std::make_unique<DoWhile>(loc(symbol), std::move($cond.ast), std::move($s.ast));
     }
     ;
 
@@ -121,7 +284,7 @@ switchStatement returns [ std::unique_ptr<Switch> ast ]
     : SWITCH LPAREN e=expression RPAREN LBRACE (s+=switchBlock)* RBRACE
     {
         Token *symbol = $ctx->SWITCH()->getSymbol();
-        $ast = std::make_unique<Switch>(symbol->getLine(), symbol->getCharPositionInLine(), std::move($e.ast));
+        $ast = std::make_unique<Switch>(loc(symbol), std::move($e.ast));
         for (int i = 0; i < $s.size(); i++) {
             $ast->add_switch_block(std::move($s[i]->ast));
         }
@@ -132,7 +295,7 @@ switchBlock returns [ std::unique_ptr<SwitchBlock> ast ]
     : (CASE e=expression | DEFAULT) COLON (s+=statement)* (BREAK SEMICOLON)?
     {
         Token *symbol = $ctx->COLON()->getSymbol();
-        $ast = std::make_unique<SwitchBlock>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<SwitchBlock>(loc(symbol));
         for (int i = 0; i < $s.size(); i++) {
             $ast->add_statement(std::move($s[i]->ast));
         }
@@ -154,119 +317,113 @@ returnStatement returns [ std::unique_ptr<Return> ast ]
         std::unique_ptr<AST> e = nullptr;
         if ($exp.ctx != nullptr) { e = std::move($exp.ast); }
         Token *symbol = $ctx->RETURN()->getSymbol();
-        $ast = std::make_unique<Return>(symbol->getLine(), symbol->getCharPositionInLine(), std::move(e));
+        $ast = std::make_unique<Return>(loc(symbol), std::move(e));
     }
     ;
 
-globalDeclarationHelperSemi returns [ std::unique_ptr<Declaration> ast ]
-    : a=attribute g=globalDeclarationHelperSemi
-    {
-        $ast = std::move($g.ast);
-        $ast->add_attribute($a.ast);
-    }
-    | gl=globalDeclarationHelperSemi at=attribute
-    {
-        $ast = std::move($gl.ast);
-        $ast->add_attribute($at.ast);
-    }
-    | ass=assembly glo=globalDeclarationHelperSemi
-    {
-        $ast = std::move($glo.ast);
-        $ast->add_assembly(std::move($ass.ast));
-    }
-    | glob=globalDeclarationHelperSemi as=assembly
-    {
-        $ast = std::move($glob.ast);
-        $ast->add_assembly(std::move($as.ast));
-    }
-    |  decl=functionDeclaration
-    {
-       $ast = std::move($decl.ast);
-    }
-    | var=globalVariableDeclaration
-    {
-        $ast = std::move($var.ast);
-    }
-    | sdc=structDeclaration
-    {
-        $ast = std::move($sdc.ast);
-    }
-    | sdc=structDeclaration
-    {
-        $ast = std::move($sdc.ast);
-    }
-    | sdf=structDefinition
-    {
-        $ast = std::move($sdf.ast);
-    }
-    | ud=unionDeclaration
-    {
-        $ast = std::move($ud.ast);
-    }
-    | udf=unionDefinition
-    {
-        $ast = std::move($udf.ast);
+// Attributes and assembly in front of a declaration are added after the ones
+// behind it, innermost first
+globalDeclaration returns [ std::unique_ptr<AST> ast ]
+    @init {
+        auto *first = static_cast<CCOMP::Parser::ArenaToken *>(_input->LT(1));
+        declaration_spans.push_back({first->get_offset(), first->get_offset(), typedefs->position(), false});
     }
-    | en=enumDeclaration
+    : (pre+=declarationExtension)* body=globalDeclarationBody
     {
-        $ast = std::move($en.ast);
-    }
-    | enu=enumDefinition
-    {
-        $ast = std::move($enu.ast);
-    }
-    | td=typedef
-    {
-       $ast = std::move($td.ast);
+        $ast = std::move($body.ast);
+        auto *decl = declaration_data($ast.get());
+        for (int i = (int)$pre.size() - 1; decl && i >= 0; i--) {
+            decl->add_attribute($pre[i]->attributes);
+            if ($pre[i]->assembly) { decl->add_assembly(std::move($pre[i]->assembly)); }
+        }
     }
     ;
 
-
-globalDeclarationHelperNoSemi returns [ std::unique_ptr<Declaration> ast ]
-    : a=attribute g=globalDeclarationHelperNoSemi
-    {
-        $ast = std::move($g.ast);
-        $ast->add_attribute($a.ast);
-    }
-    | gl=globalDeclarationHelperNoSemi at=attribute
-    {
-        $ast = std::move($gl.ast);
-        $ast->add_attribute($at.ast);
-    }
-    | ass=assembly glo=globalDeclarationHelperNoSemi
-    {
-        $ast = std::move($glo.ast);
-        $ast->add_assembly(std::move($ass.ast));
-    }
-    | glob=globalDeclarationHelperNoSemi as=assembly
+// Visibility, attributes and type are shared by all kinds of global
+// declarations. Only the tokens behind the declarator decide between function
+// definition, function declaration and variable, so prediction never has to
+// look past the type.
+globalDeclarationBody returns [ std::unique_ptr<AST> ast ]
+    : td=typedef (post+=declarationExtension)* SEMICOLON
     {
-        $ast = std::move($glob.ast);
-        $ast->add_assembly(std::move($as.ast));
+        for (int i = 0; i < $post.size(); i++) {
+            $td.ast->add_attribute($post[i]->attributes);
+            if ($post[i]->assembly) { $td.ast->add_assembly(std::move($post[i]->assembly)); }
+        }
+        $ast = std::move($td.ast);
     }
-    | fn=functionDefinition
+    | (vis=visibility (a+=attribute)*)? t=type
+        ( (post+=declarationExtension)* SEMICOLON
+        {
+            // A struct, union or enum on its own
+            if (declaration_data($t.ast.get()) == nullptr) {
+                notifyErrorListeners("Declaration does not declare anything");
+            } else {
+                $ast = std::move($t.ast);
+            }
+        }
+        | d=declarator (dims+=arrayDimension)* (EQUAL init=expression)? (post+=declarationExtension)*
+            ( (body=block | lazy=LAZY_BODY)
+            {
+                if ($d.pending == nullptr || !$dims.empty() || $init.ctx != nullptr) {
+                    notifyErrorListeners("Function body without a function declarator");
+                } else {
+                    auto id = complete_declarator(std::move($d.ast), $d.pending, std::move($t.ast));
+                    if ($body.ctx != nullptr) {
+                        $ast = std::make_unique<FunctionDefinition>(id->location, std::move(id), std::move($body.ast));
+                    } else {
+                        $ast = std::make_unique<FunctionDefinition>(id->location, std::move(id), make_lazy_body($lazy));
+                    }
+                }
+            }
+            | SEMICOLON
+            {
+                auto id = complete_declarator(std::move($d.ast), $d.pending, std::move($t.ast));
+                if ($d.pending != nullptr && $dims.empty() && $init.ctx == nullptr) {
+                    $ast = std::make_unique<FunctionDeclaration>(id->location, std::move(id));
+                } else {
+                    std::unique_ptr<AST> value = nullptr;
+                    if ($init.ctx != nullptr) { value = std::move($init.ast); }
+                    auto var = std::make_unique<VariableDeclaration>(id->location, std::move(id), std::move(value));
+                    var->global = true;
+                    add_array_dimensions(*var->mutable_type(), $dims);
+                    $ast = std::move(var);
+                }
+            }
+            )
+        )
     {
-        $ast = std::move($fn.ast);
+        if (auto *decl = declaration_data($ast.get())) {
+            if ($vis.ctx != nullptr) { decl->is_public = $vis.is_public; }
+            for (int i = 0; i < $a.size(); i++) {
+                decl->add_attribute($a[i]->ast);
+            }
+            for (int i = 0; i < $post.size(); i++) {
+                decl->add_attribute($post[i]->attributes);
+                if ($post[i]->assembly) { decl->add_assembly(std::move($post[i]->assembly)); }
+            }
+        }
     }
     ;
 
-globalDeclaration returns [ std::unique_ptr<Declaration> ast ]
-    : g=globalDeclarationHelperSemi SEMICOLON
+declarationExtension returns [ Attributes attributes, std::unique_ptr<Assembly> assembly ]
+    : a=attribute
     {
-        $ast = std::move($g.ast);
+        $attributes = std::move($a.ast);
     }
-    | gl=globalDeclarationHelperNoSemi
+    | s=assembly
     {
-       $ast = std::move($gl.ast);
+        $assembly = std::move($s.ast);
     }
     ;
 
-attribute returns [ std::vector<std::unique_ptr<Attribute>> ast ]
+attribute returns [ Attributes ast ]
     : ATTRIBUTE LPAREN LPAREN s=attributeContent RPAREN RPAREN
     {
         Token *symbol = $ctx->ATTRIBUTE()->getSymbol();
-        std::vector<std::unique_ptr<Attribute>> erg;
+        Attributes erg;
         for (auto s: $s.v) {
-            erg.push_back(std::move(std::make_unique<Attribute>(symbol->getLine(), symbol->getCharPositionInLine(), s)));
+            erg.push_back(std::make_unique<Attribute>(loc(symbol), s));
         }
         $ast = std::move(erg);
     }
@@ -276,7 +433,7 @@ assembly returns [ std::unique_ptr<Assembly> ast ]
     : ASSEMBLY LPAREN s=assemblyContent RPAREN
     {
         Token *symbol = $ctx->ASSEMBLY()->getSymbol();
-        $ast = std::make_unique<Assembly>(symbol->getLine(), symbol->getCharPositionInLine(), $s.s);
+        $ast = std::make_unique<Assembly>(loc(symbol), $s.s);
     }
     ;
 
@@ -285,7 +442,7 @@ assemblyContent returns [ std::vector<std::string> s ]
     {
         $s.reserve($c.size());
         for (int i = 0; i < $c.size(); i++) {
-            $s.push_back($c[i]->s);
+            $s.emplace_back($c[i]->s);
         }
     }
     ;
@@ -297,7 +454,7 @@ attributeContent returns [ std::vector<std::string> v ]
     }
     | c=constant
     {
-        $v = { $c.ast->value };
+        $v = { $c.ast->to_string() };
     }
     | a1=attributeContent COMMA a2=attributeContent
     {
@@ -321,90 +478,95 @@ attributeContent returns [ std::vector<std::string> v ]
     }
     ;
 
-fnTypeWithoutReturn returns [ std::unique_ptr<Identifier> ast ]
-    : (l+=LPAREN STAR? (id=identifier)? RPAREN | STAR? (id=identifier)?) l+=LPAREN (args+=parameterDeclaration (COMMA args+=parameterDeclaration)*)? (COMMA var=VA_ARGS)? RPAREN
-         {
-             Token *symbol = $ctx->l[0];
-             if ($id.ctx != nullptr) {
-                $ast = std::move($id.ast);
-              } else {
-                $ast = std::make_unique<Identifier>(symbol->getLine(), symbol->getCharPositionInLine(), "");
-              }
-
-             auto fn = std::make_unique<FunctionType>($ast->get_line(), $ast->get_column(), nullptr);
-             if ($var != nullptr) { fn->varargs = true; }
-
-             for (int i = 0; i < $args.size(); i++) {
-                fn->add_parameter(std::move($args[i]->ast));
-             }
-             if ($ctx->STAR() != nullptr) {
-                fn->pointer_count++;
-             }
-             $ast->add_type(std::move(fn));
-         }
-
-    ;
-
-fnType returns [ std::unique_ptr<Identifier> ast ]
-    : type fnTypeWithoutReturn
+// Name and function part of a declaration, the type in front of it is added
+// by complete_declarator. pending is the function type still missing its
+// return type, nullptr if the identifier itself gets the type.
+declarator returns [ std::unique_ptr<Identifier> ast, FunctionType *pending = nullptr ]
+    : id=anyIdentifier (p=parameterList)?
     {
-             $ast = std::move($fnTypeWithoutReturn.ast);
-             dynamic_cast<FunctionType*>($ast->type())->return_type = std::move($type.ast);
+        $ast = std::move($id.ast);
+        if ($p.ctx != nullptr) {
+            auto fn = make_function_type($ast->location, $p.parameters, $p.varargs);
+            $pending = fn.get();
+            $ast->add_type(std::move(fn));
+        }
     }
-    | type (l+=LPAREN STAR? (id=fnTypeWithoutReturn)? RPAREN | STAR? (id=fnTypeWithoutReturn)?) l+=LPAREN (args+=parameterDeclaration (COMMA args+=parameterDeclaration)*)? (COMMA va=VA_ARGS)? RPAREN
-        {
-            Token *symbol = $ctx->l[0];
-             if ($id.ctx != nullptr) {
-                $ast = std::move($id.ast);
-             } else {
-                $ast = std::make_unique<Identifier>(symbol->getLine(), symbol->getCharPositionInLine(), "");
-             }
-
-             auto fn = std::make_unique<FunctionType>($ast->get_line(), $ast->get_column(), std::move($type.ast));
-             if ($va != nullptr) { fn->varargs = true; }
+    | l=LPAREN (s=STAR)? (inner=declarator)? RPAREN p=parameterList
+    {
+        if ($inner.ctx != nullptr) {
+            $ast = std::move($inner.ast);
+        } else {
+            $ast = std::make_unique<Identifier>(loc($l), "");
+        }
 
-             for (int i = 0; i < $args.size(); i++) {
-                 fn->add_parameter(std::move($args[i]->ast));
-             }
-             if ($ctx->STAR() != nullptr) {
-                fn->pointer_count++;
-             }
+        auto fn = make_function_type($ast->location, $p.parameters, $p.varargs);
+        if ($s != nullptr) {
+            fn->pointer_count++;
+        }
+        $pending = fn.get();
 
-             dynamic_cast<FunctionType*>($ast->type())->return_type = std::move(fn);
+        // The function type of an inner function declarator returns this one
+        if ($inner.ctx != nullptr && $inner.pending != nullptr) {
+            $inner.pending->return_type = std::move(fn);
+        } else {
+            $ast->add_type(std::move(fn));
+        }
     }
-    ;
-
-identifier_with_type returns [ std::unique_ptr<Identifier> ast ]
-    : type identifier
+    | p=parameterList
     {
-        $ast = std::move($identifier.ast);
-        $ast->add_type(std::move($type.ast));
+        Token *symbol = $p.start;
+        $ast = std::make_unique<Identifier>(loc(symbol), "");
+        auto fn = make_function_type($ast->location, $p.parameters, $p.varargs);
+        $pending = fn.get();
+        $ast->add_type(std::move(fn));
     }
-    | type STAR identifier
+    ;
+
+parameterList returns [ std::vector<std::unique_ptr<Identifier>> parameters, bool varargs = false ]
+    : LPAREN (args+=parameterDeclaration (COMMA args+=parameterDeclaration)*)? (COMMA var=VA_ARGS)? RPAREN
     {
-        $ast = std::move($identifier.ast);
-        $type.ast->pointer_count++;
-        $ast->add_type(std::move($type.ast));
+        for (int i = 0; i < $args.size(); i++) {
+            $parameters.push_back(std::move($args[i]->ast));
+        }
+        $varargs = $var != nullptr;
     }
-    | fnType
+    ;
+
+identifier_with_type returns [ std::unique_ptr<Identifier> ast ]
+    : t=type d=declarator
     {
-        $ast = std::move($fnType.ast);
+        $ast = complete_declarator(std::move($d.ast), $d.pending, std::move($t.ast));
     }
     ;
 
 typedef returns [ std::unique_ptr<TypeDef> ast ]
     : TYPEDEF id=identifier_with_type
     {
+        typedefs->declare_typedef($id.ast->name);
+        retype_lookahead();
+
         Token *symbol = $ctx->TYPEDEF()->getSymbol();
-        $ast = std::make_unique<TypeDef>(symbol->getLine(), symbol->getCharPositionInLine(), std::move($id.ast));
+        $ast = std::make_unique<TypeDef>(loc(symbol), std::move($id.ast));
     }
     ;
 
+// Items are assignment expressions, a comma separates them. Lists of only
+// number literals match both alternatives, the predicate lets the first one
+// win without a full context prediction. Its elements get no rule contexts
+// and are packed, see add_literals.
 arrayInitializerList returns [ std::unique_ptr<ArrayInitializationList> ast ]
-    : LBRACE (item+=expression (COMMA item+=expression)*)? RBRACE
+    : {pack_literals}? l=LBRACE
+        MINUS? (NUMBER | HEX_NUMBER | OCT_NUMBER | BIN_NUMBER)
+        (COMMA MINUS? (NUMBER | HEX_NUMBER | OCT_NUMBER | BIN_NUMBER))*
+        r=RBRACE
+    {
+        $ast = std::make_unique<ArrayInitializationList>(loc($l));
+        add_literals(*$ast, $l, $r);
+    }
+    | LBRACE (item+=presedence_14 (COMMA item+=presedence_14)*)? RBRACE
     {
         Token *symbol = $ctx->LBRACE()->getSymbol();
-        $ast = std::make_unique<ArrayInitializationList>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<ArrayInitializationList>(loc(symbol));
 
         for (int i = 0; i < $item.size(); i++) {
             $ast->add_value(std::move($item[i]->ast));
@@ -420,47 +582,49 @@ expression returns [ std::unique_ptr<AST> ast ]
     ;
 
 presedence_15 returns [ std::unique_ptr<AST> ast ]
-    : p1=presedence_14
+    : p+=presedence_14 (COMMA p+=presedence_14)*
     {
-        $ast = std::move($p1.ast);
-    }
-    | p+=presedence_14 (COMMA p+=presedence_14)+
-    {
-        auto l = std::make_unique<ExpressionList>($p[0]->ast->get_line(), $p[0]->ast->get_column());
-        for (int i = 0; i < $p.size(); i++) {
-            l->add_expression(std::move($p[i]->ast));
+        if ($p.size() == 1) {
+            $ast = std::move($p[0]->ast);
+        } else {
+            auto l = std::make_unique<ExpressionList>($p[0]->ast->location);
+            for (int i = 0; i < $p.size(); i++) {
+                l->add_expression(std::move($p[i]->ast));
+            }
+            $ast = std::move(l);
         }
-        $ast = std::move(l);
     }
     ;
 
+// The left side is parsed as a conditional expression and only then checked
+// for an assignment operator. Whether it is assignable is up to the analysis.
 presedence_14 returns [ std::unique_ptr<AST> ast ]
-    : a=presedence_2 EQUAL b=presedence_14
-    {
-        $ast = std::make_unique<Assignment>($a.ast->get_line(), $a.ast->get_column(), std::move($a.ast), std::move($b.ast));
-    }
-    | a1=presedence_2 op=( MINUSEQUAL | PLUSEQUAL )  b1=presedence_13
-    {
-        $ast = std::make_unique<OperationAssignment>($a1.ast->get_line(), $a1.ast->get_column(), std::move($a1.ast), std::move($b1.ast), OperationAssignment::str_to_op($op->getText()));
-    }
-    | p=presedence_13
-    {
-        $ast = std::move($p.ast);
+    : a=presedence_13
+        ( EQUAL b=presedence_14
+        | op=( MINUSEQUAL | PLUSEQUAL ) b1=presedence_13
+        )?
+    {
+        if ($b.ctx != nullptr) {
+            $ast = std::make_unique<Assignment>($a.ast->location, std::move($a.ast), std::move($b.ast));
+        } else if ($b1.ctx != nullptr) {
+            $ast = std::make_unique<OperationAssignment>($a.ast->location, std::move($a.ast), std::move($b1.ast), OperationAssignment::str_to_op(text($op)));
+        } else {
+            $ast = std::move($a.ast);
+        }
     }
     ;
 
 presedence_13 returns [ std::unique_ptr<AST> ast ]
-    : p=presedence_12
+    : cond=presedence_12 (QUESTION exp0=expression COLON exp1=presedence_12)?
     {
-        $ast = std::move($p.ast);
-    }
-    | cond=presedence_12 QUESTION exp0=expression COLON exp1=presedence_12
-    {
-        $ast = std::make_unique<TernaryExpression>($cond.ast->get_line(), $cond.ast->get_column(), std::move($cond.ast), std::move($exp0.ast), std::move($exp1.ast));
+        if ($exp0.ctx != nullptr) {
+            $ast = std::make_unique<TernaryExpression>($cond.ast->location, std::move($cond.ast), std::move($exp0.ast), std::move($exp1.ast));
+        } else {
+            $ast = std::move($cond.ast);
+        }
     }
     ;
 
-
 presedence_12 returns [ std::unique_ptr<AST> ast ]
     : operands+=presedence_11
         ( operators+=OROR operands+=presedence_11)*
@@ -468,10 +632,10 @@ presedence_12 returns [ std::unique_ptr<AST> ast ]
         $ast = std::move($operands[0]->ast);
 
         for (int i = 1; i < $operands.size(); i++) {
-            auto op = BinaryExpression::str_to_op($operators[i - 1]->getText());
+            auto op = BinaryExpression::str_to_op(text($operators[i - 1]));
             auto right = std::move($operands[i]->ast);
 
-            $ast = std::make_unique<BinaryExpression>($ast->get_line(), $ast->get_column(), std::move($ast), std::move(right), op);
+            $ast = std::make_unique<BinaryExpression>($ast->location, std::move($ast), std::move(right), op);
         }
     }
     ;
@@ -483,10 +647,10 @@ presedence_11 returns [ std::unique_ptr<AST> ast ]
         $ast = std::move($operands[0]->ast);
 
         for (int i = 1; i < $operands.size(); i++) {
-            auto op = BinaryExpression::str_to_op($operators[i - 1]->getText());
+            auto op = BinaryExpression::str_to_op(text($operators[i - 1]));
             auto right = std::move($operands[i]->ast);
 
-            $ast = std::make_unique<BinaryExpression>($ast->get_line(), $ast->get_column(), std::move($ast), std::move(right), op);
+            $ast = std::make_unique<BinaryExpression>($ast->location, std::move($ast), std::move(right), op);
         }
     }
     ;
@@ -498,10 +662,10 @@ presedence_10 returns [ std::unique_ptr<AST> ast ]
         $ast = std::move($operands[0]->ast);
 
         for (int i = 1; i < $operands.size(); i++) {
-            auto op = BinaryExpression::str_to_op($operators[i - 1]->getText());
+            auto op = BinaryExpression::str_to_op(text($operators[i - 1]));
             auto right = std::move($operands[i]->ast);
 
-            $ast = std::make_unique<BinaryExpression>($ast->get_line(), $ast->get_column(), std::move($ast), std::move(right), op);
+            $ast = std::make_unique<BinaryExpression>($ast->location, std::move($ast), std::move(right), op);
         }
     }
     ;
@@ -513,10 +677,10 @@ presedence_9 returns [ std::unique_ptr<AST> ast ]
         $ast = std::move($operands[0]->ast);
 
         for (int i = 1; i < $operands.size(); i++) {
-            auto op = BinaryExpression::str_to_op($operators[i - 1]->getText());
+            auto op = BinaryExpression::str_to_op(text($operators[i - 1]));
             auto right = std::move($operands[i]->ast);
 
-            $ast = std::make_unique<BinaryExpression>($ast->get_line(), $ast->get_column(), std::move($ast), std::move(right), op);
+            $ast = std::make_unique<BinaryExpression>($ast->location, std::move($ast), std::move(right), op);
         }
     }
     ;
@@ -528,10 +692,10 @@ presedence_8 returns [ std::unique_ptr<AST> ast ]
         $ast = std::move($operands[0]->ast);
 
         for (int i = 1; i < $operands.size(); i++) {
-            auto op = BinaryExpression::str_to_op($operators[i - 1]->getText());
+            auto op = BinaryExpression::str_to_op(text($operators[i - 1]));
             auto right = std::move($operands[i]->ast);
 
-            $ast = std::make_unique<BinaryExpression>($ast->get_line(), $ast->get_column(), std::move($ast), std::move(right), op);
+            $ast = std::make_unique<BinaryExpression>($ast->location, std::move($ast), std::move(right), op);
         }
     }
     ;
@@ -543,10 +707,10 @@ presedence_7 returns [ std::unique_ptr<AST> ast ]
         $ast = std::move($operands[0]->ast);
 
         for (int i = 1; i < $operands.size(); i++) {
-            auto op = BinaryExpression::str_to_op($operators[i - 1]->getText());
+            auto op = BinaryExpression::str_to_op(text($operators[i - 1]));
             auto right = std::move($operands[i]->ast);
 
-            $ast = std::make_unique<BinaryExpression>($ast->get_line(), $ast->get_column(), std::move($ast), std::move(right), op);
+            $ast = std::make_unique<BinaryExpression>($ast->location, std::move($ast), std::move(right), op);
         }
     }
     ;
@@ -558,10 +722,10 @@ presedence_6 returns [ std::unique_ptr<AST> ast ]
         $ast = std::move($operands[0]->ast);
 
         for (int i = 1; i < $operands.size(); i++) {
-            auto op = BinaryExpression::str_to_op($operators[i - 1]->getText());
+            auto op = BinaryExpression::str_to_op(text($operators[i - 1]));
             auto right = std::move($operands[i]->ast);
 
-            $ast = std::make_unique<BinaryExpression>($ast->get_line(), $ast->get_column(), std::move($ast), std::move(right), op);
+            $ast = std::make_unique<BinaryExpression>($ast->location, std::move($ast), std::move(right), op);
         }
     }
     ;
@@ -573,10 +737,10 @@ presedence_5 returns [ std::unique_ptr<AST> ast ]
         $ast = std::move($operands[0]->ast);
 
         for (int i = 1; i < $operands.size(); i++) {
-            auto op = BinaryExpression::str_to_op($operators[i - 1]->getText());
+            auto op = BinaryExpression::str_to_op(text($operators[i - 1]));
             auto right = std::move($operands[i]->ast);
 
-            $ast = std::make_unique<BinaryExpression>($ast->get_line(), $ast->get_column(), std::move($ast), std::move(right), op);
+            $ast = std::make_unique<BinaryExpression>($ast->location, std::move($ast), std::move(right), op);
         }
     }
     ;
@@ -588,10 +752,10 @@ presedence_4 returns [ std::unique_ptr<AST> ast ]
         $ast = std::move($operands[0]->ast);
 
         for (int i = 1; i < $operands.size(); i++) {
-            auto op = BinaryExpression::str_to_op($operators[i - 1]->getText());
+            auto op = BinaryExpression::str_to_op(text($operators[i - 1]));
             auto right = std::move($operands[i]->ast);
 
-            $ast = std::make_unique<BinaryExpression>($ast->get_line(), $ast->get_column(), std::move($ast), std::move(right), op);
+            $ast = std::make_unique<BinaryExpression>($ast->location, std::move($ast), std::move(right), op);
         }
     }
     ;
@@ -603,10 +767,10 @@ presedence_3 returns [ std::unique_ptr<AST> ast ]
         $ast = std::move($operands[0]->ast);
 
         for (int i = 1; i < $operands.size(); i++) {
-            auto op = BinaryExpression::str_to_op($operators[i - 1]->getText());
+            auto op = BinaryExpression::str_to_op(text($operators[i - 1]));
             auto right = std::move($operands[i]->ast);
 
-            $ast = std::make_unique<BinaryExpression>($ast->get_line(), $ast->get_column(), std::move($ast), std::move(right), op);
+            $ast = std::make_unique<BinaryExpression>($ast->location, std::move($ast), std::move(right), op);
         }
     }
     ;
@@ -616,94 +780,116 @@ presedence_2 returns [ std::unique_ptr<AST> ast ]
     {
         $ast = std::move($p.ast);
     }
-    | op=(SIZEOF | PLUSPLUS | MINUSMINUS | AND | STAR | PLUS | MINUS | TILDE | NOT) p3=presedence_2
-    {
-        $ast = std::make_unique<UnaryExpression>($p3.ast->get_line(), $p3.ast->get_column(), std::move($p3.ast), UnaryExpression::prefix_str_to_op($op->getText()));
-    }
-    | s=SIZEOF LPAREN ty=type RPAREN
+    | op=(PLUSPLUS | MINUSMINUS | AND | STAR | PLUS | MINUS | TILDE | NOT) p3=presedence_2
     {
-        $ast = std::make_unique<UnaryExpression>($ty.ast->get_line(), $ty.ast->get_column(), std::move($ty.ast), UnaryExpression::prefix_str_to_op($s->getText()));
+        $ast = std::make_unique<UnaryExpression>($p3.ast->location, std::move($p3.ast), UnaryExpression::prefix_str_to_op(text($op)));
     }
+    | s=SIZEOF
+        ( LPAREN ty=type RPAREN
+        {
+            $ast = std::make_unique<UnaryExpression>($ty.ast->location, std::move($ty.ast), UnaryExpression::prefix_str_to_op(text($s)));
+        }
+        | p4=presedence_2
+        {
+            $ast = std::make_unique<UnaryExpression>($p4.ast->location, std::move($p4.ast), UnaryExpression::prefix_str_to_op(text($s)));
+        }
+        )
     | LPAREN t=type RPAREN p1=presedence_2
     {
-        $ast = std::make_unique<TypeCast>($p1.ast->get_line(), $p1.ast->get_column(), std::move($t.ast), std::move($p1.ast));
+        $ast = std::make_unique<TypeCast>($p1.ast->location, std::move($t.ast), std::move($p1.ast));
     }
     ;
 
+// Postfix operators as a loop over a primary expression. Consecutive
+// subscripts are collected into one ArrayAccess.
 presedence_1 returns [ std::unique_ptr<AST> ast ]
-    : f=factor
-    {
-        $ast = std::move($f.ast);
-    }
-    | p0=presedence_1 op=(PLUSPLUS | MINUSMINUS)
-    {
-        $ast = std::make_unique<UnaryExpression>($p0.ast->get_line(), $p0.ast->get_column(), std::move($p0.ast), UnaryExpression::postfix_str_to_op($op->getText()));
-    }
-    | fn=functionCall
-    {
-        $ast = std::move($fn.ast);
-    }
-    | p4=presedence_1 (LBRACK exp+=expression RBRACK)+
-    {
-        auto arr = std::make_unique<ArrayAccess>($p4.ast->get_line(), $p4.ast->get_column(), std::move($p4.ast));
-        for (int i = 0; i < $exp.size(); i++) {
-            arr->add_index(std::move($exp[i]->ast));
+    locals [ bool subscript = false ]
+    : f=factor { $ast = std::move($f.ast); }
+        ( op=(PLUSPLUS | MINUSMINUS)
+        {
+            $ast = std::make_unique<UnaryExpression>($ast->location, std::move($ast), UnaryExpression::postfix_str_to_op(text($op)));
+            $subscript = false;
         }
-        $ast = std::move(arr);
-    }
-    | p5=presedence_1 DOT id=identifier
-    {
-        $ast = std::make_unique<StructAccess>($p5.ast->get_line(), $p5.ast->get_column(), std::move($p5.ast), std::move($id.ast), false);
-    }
-    | p6=presedence_1 MINUSGREATER ide=identifier
-    {
-        $ast = std::make_unique<StructAccess>($p6.ast->get_line(), $p6.ast->get_column(), std::move($p6.ast), std::move($ide.ast), true);
-    }
-    | ail=arrayInitializerList
-    {
-        $ast = std::move($ail.ast);
-    }
+        | LBRACK exp=expression RBRACK
+        {
+            if (!$subscript) {
+                $ast = std::make_unique<ArrayAccess>($ast->location, std::move($ast));
+            }
+            static_cast<ArrayAccess *>($ast.get())->add_index(std::move($exp.ast));
+            $subscript = true;
+        }
+        | DOT id=anyIdentifier
+        {
+            $ast = std::make_unique<StructAccess>($ast->location, std::move($ast), std::move($id.ast), false);
+            $subscript = false;
+        }
+        | MINUSGREATER ide=anyIdentifier
+        {
+            $ast = std::make_unique<StructAccess>($ast->location, std::move($ast), std::move($ide.ast), true);
+            $subscript = false;
+        }
+        )*
     ;
 
+// Arguments are assignment expressions, a comma separates them
 factor returns [ std::unique_ptr<AST> ast ]
     : con=constant
     {
         $ast = std::move($con.ast);
     }
-    | id=identifier
+    | id=identifier (call=LPAREN (args+=presedence_14 (COMMA args+=presedence_14)*)? RPAREN)?
     {
-        $ast = std::move($id.ast);
+        if ($call != nullptr) {
+            auto fn = std::make_unique<FunctionCall>($id.ast->location, std::move($id.ast));
+            for (int i = 0; i < $args.size(); i++) {
+                fn->add_argument(std::move($args[i]->ast));
+            }
+            $ast = std::move(fn);
+        } else {
+            $ast = std::move($id.ast);
+        }
     }
     | LPAREN exp=expression RPAREN
     {
         $ast = std::move($exp.ast);
     }
+    | ail=arrayInitializerList
+    {
+        $ast = std::move($ail.ast);
+    }
     ;
 
 constant returns [ std::unique_ptr<Constant> ast ]
     : NUMBER
     {
         Token *symbol = $ctx->NUMBER()->getSymbol();
-        $ast = std::make_unique<Constant>(symbol->getLine(), symbol->getCharPositionInLine(), symbol->getText());
+        std::string_view t = text(symbol);
+        if (is_float_literal(t)) {
+            $ast = std::make_unique<Constant>(loc(symbol), decode_float(t));
+        } else {
+            $ast = std::make_unique<Constant>(loc(symbol), decode_integer(symbol));
+        }
     }
     | HEX_NUMBER
     {
         Token *symbol = $ctx->HEX_NUMBER()->getSymbol();
-        $ast = std::make_unique<Constant>(symbol->getLine(), symbol->getCharPositionInLine(), symbol->getText());
+        $ast = std::make_unique<Constant>(loc(symbol), decode_integer(symbol));
     }
     | OCT_NUMBER
     {
         Token *symbol = $ctx->OCT_NUMBER()->getSymbol();
-        $ast = std::make_unique<Constant>(symbol->getLine(), symbol->getCharPositionInLine(), symbol->getText());
+        $ast = std::make_unique<Constant>(loc(symbol), decode_integer(symbol));
     }
     | BIN_NUMBER
     {
         Token *symbol = $ctx->BIN_NUMBER()->getSymbol();
-        $ast = std::make_unique<Constant>(symbol->getLine(), symbol->getCharPositionInLine(), symbol->getText());
+        $ast = std::make_unique<Constant>(loc(symbol), decode_integer(symbol));
     }
     | string
     {
-        $ast = std::make_unique<Constant>(0, 0, $string.s);
+        Token *symbol = $string.start;
+        uint32_t id = strings->intern(decode_string($string.s));
+        $ast = std::make_unique<Constant>(loc(symbol), id, strings->get(id));
     }
     ;
 
@@ -711,184 +897,136 @@ identifier returns [ std::unique_ptr<Identifier> ast ]
     : IDENTIFIER
     {
         Token *symbol = $ctx->IDENTIFIER()->getSymbol();
-        $ast = std::make_unique<Identifier>(symbol->getLine(), symbol->getCharPositionInLine(), symbol->getText());
+        $ast = std::make_unique<Identifier>(loc(symbol), std::string(text(symbol)));
     }
     ;
 
-visibility returns [ bool is_public ]
-    : EXTERN { $is_public = true; }
-    | STATIC { $is_public = false; }
-    ;
-
-parameterDeclaration returns [ std::unique_ptr<Identifier> ast ]
-    : t=type
+typedefName returns [ std::unique_ptr<Identifier> ast ]
+    : TYPEDEF_NAME
     {
-        $ast = std::make_unique<Identifier>($t.ast->get_line(), $t.ast->get_column(), "");
-        $ast->add_type(std::move($t.ast));
+        Token *symbol = $ctx->TYPEDEF_NAME()->getSymbol();
+        $ast = std::make_unique<Identifier>(loc(symbol), std::string(text(symbol)));
     }
-    | id=identifier_with_type
+    ;
+
+// Tags, members and declared names may reuse the name of a typedef
+anyIdentifier returns [ std::unique_ptr<Identifier> ast ]
+    : id=identifier
     {
         $ast = std::move($id.ast);
     }
-    | p=parameterDeclaration LBRACK (exp=expression)? RBRACK
+    | tn=typedefName
     {
-        $ast = std::move($p.ast);
-
-        if ($exp.ctx != nullptr) {
-            $ast->type()->add_array_dimension(std::move($exp.ast));
-        } else {
-            $ast->type()->add_array_dimension();
-        }
+        $ast = std::move($tn.ast);
     }
     ;
 
-functionDefinition returns [ std::unique_ptr<FunctionDefinition> ast ]
-    : (vis=visibility)? (a+=attribute)* fnType (a+=attribute)* block
-    {
-        $ast = std::make_unique<FunctionDefinition>($fnType.ast->get_line(), $fnType.ast->get_column(), std::move($fnType.ast), std::move($block.ast));
-        if ($vis.ctx != nullptr) { $ast->is_public = $vis.is_public; }
-
-        for (int i = 0; i < $a.size(); i++) {
-            $ast->add_attribute($a[i]->ast);
-        }
-    }
+visibility returns [ bool is_public ]
+    : EXTERN { $is_public = true; }
+    | STATIC { $is_public = false; }
     ;
 
-functionDeclaration returns [ std::unique_ptr<FunctionDeclaration> ast ]
-    : (vis=visibility)? (a+=attribute)* fnType
+parameterDeclaration returns [ std::unique_ptr<Identifier> ast ]
+    : t=type (d=declarator)? (dims+=arrayDimension)*
     {
-        $ast = std::make_unique<FunctionDeclaration>($fnType.ast->get_line(), $fnType.ast->get_column(), std::move($fnType.ast));
-        if ($vis.ctx != nullptr) { $ast->is_public = $vis.is_public; }
+        if ($d.ctx != nullptr) {
+            $ast = complete_declarator(std::move($d.ast), $d.pending, std::move($t.ast));
+        } else {
+            $ast = std::make_unique<Identifier>($t.ast->location, "");
+            $ast->add_type(std::move($t.ast));
+        }
 
-        for (int i = 0; i < $a.size(); i++) {
-            $ast->add_attribute($a[i]->ast);
+        for (int i = 0; i < $dims.size(); i++) {
+            if ($dims[i]->size) {
+                $ast->mutable_type()->add_array_dimension(std::move($dims[i]->size));
+            } else {
+                $ast->mutable_type()->add_array_dimension();
+            }
         }
     }
     ;
 
-functionCall returns [ std::unique_ptr<FunctionCall> ast ]
-    : name=identifier LPAREN (args+=expression (COMMA args+=expression)*)? RPAREN
+arrayDimension returns [ std::unique_ptr<AST> size ]
+    : LBRACK (exp=expression)? RBRACK
     {
-        $ast = std::make_unique<FunctionCall>($name.ast->get_line(), $name.ast->get_column(), std::move($name.ast));
-        for (int i = 0; i < $args.size(); i++) {
-            $ast->add_argument(std::move($args[i]->ast));
+        if ($exp.ctx != nullptr) {
+            $size = std::move($exp.ast);
         }
     }
     ;
 
 variableDeclaration returns [ std::unique_ptr<VariableDeclaration> ast ]
-    : id=identifier_with_type (l+=LBRACK (exp+=expression)? RBRACK)*
+    : id=identifier_with_type (dims+=arrayDimension)* (EQUAL init=expression)?
     {
-        $ast = std::make_unique<VariableDeclaration>($id.ast->get_line(), $id.ast->get_column(), std::move($id.ast), nullptr);
-
-        if ($l.size() > 0) {
-            $ast->type()->set_array_dimensions($l.size());
-                for (int i = 0; i < $exp.size(); i++) {
-                    $ast->type()->set_array_dimension(i, std::move($exp[i]->ast));
-                }
-        }
+        std::unique_ptr<AST> value = nullptr;
+        if ($init.ctx != nullptr) { value = std::move($init.ast); }
+        $ast = std::make_unique<VariableDeclaration>($id.ast->location, std::move($id.ast), std::move(value));
+        add_array_dimensions(*$ast->mutable_type(), $dims);
     }
-    | id=identifier_with_type (lb+=LBRACK (ex+=expression)? RBRACK)* EQUAL expression
-        {
-            $ast = std::make_unique<VariableDeclaration>($id.ast->get_line(), $id.ast->get_column(), std::move($id.ast), std::move($expression.ast));
-
-            if ($lb.size() > 0) {
-                $ast->type()->set_array_dimensions($lb.size());
-                for (int i = 0; i < $ex.size(); i++) {
-                    $ast->type()->set_array_dimension(i, std::move($ex[i]->ast));
-                }
-            }
-        }
     ;
 
-globalVariableDeclaration returns [ std::unique_ptr<VariableDeclaration> ast ]
-    : (vis=visibility)? var=variableDeclaration
+// Qualifiers only set flags on the type, so their position does not matter
+type returns [ std::unique_ptr<Type> ast ]
+    : (q+=(CONST | RESTRICT))* s=typeSpecifier (m+=(STAR | CONST | RESTRICT))*
     {
-        $ast = std::move($var.ast);
-        $ast->global = true;
-        if ($vis.ctx != nullptr) { $ast->is_public = $vis.is_public; }
+        $ast = std::move($s.ast);
+        for (auto *token : $q) {
+            if (token->getType() == CONST) {
+                $ast->is_const = true;
+            } else {
+                $ast->is_restrict = true;
+            }
+        }
+        for (auto *token : $m) {
+            if (token->getType() == STAR) {
+                $ast->pointer_count++;
+            } else if (token->getType() == CONST) {
+                $ast->is_const = true;
+            } else {
+                $ast->is_restrict = true;
+            }
+        }
     }
     ;
 
-type returns [ std::unique_ptr<Type> ast ]
+typeSpecifier returns [ std::unique_ptr<Type> ast ]
     : pt=primitiveType
     {
         $ast = std::move($pt.ast);
     }
-    | id=identifier
-    {
-        $ast = std::make_unique<NamedType>(std::move($id.ast));
-    }
-    | sdc=structDeclaration
-    {
-        $ast = std::move($sdc.ast);
-    }
-    | sdf=structDefinition
+    | tn=typedefName
     {
-        $ast = std::move($sdf.ast);
+        $ast = std::make_unique<NamedType>(std::move($tn.ast));
     }
-    | ud=unionDeclaration
+    | st=structSpecifier
     {
-        $ast = std::move($ud.ast);
+        $ast = std::move($st.ast);
     }
-    | udf=unionDefinition
+    | un=unionSpecifier
     {
-        $ast = std::move($udf.ast);
+        $ast = std::move($un.ast);
     }
-    | en=enumDeclaration
+    | en=enumSpecifier
     {
         $ast = std::move($en.ast);
     }
-    | enu=enumDefinition
-    {
-        $ast = std::move($enu.ast);
-    }
-    | t=type STAR
-    {
-        $ast = std::move($t.ast);
-        $ast->pointer_count++;
-    }
-    | CONST ca=type
-    {
-        $ast = std::move($ca.ast);
-        $ast->is_const = true;
-    }
-    | cb=type CONST
-    {
-        $ast = std::move($cb.ast);
-        $ast->is_const = true;
-    }
-    | RESTRICT ra=type
-    {
-        $ast = std::move($ra.ast);
-        $ast->is_restrict = true;
-    }
-    | rb=type RESTRICT
-    {
-        $ast = std::move($rb.ast);
-        $ast->is_restrict = true;
-    }
     ;
 
-enumDeclaration returns [ std::unique_ptr<EnumType> ast ]
-    : ENUM name=identifier
-    {
-        Token *symbol = $ctx->ENUM()->getSymbol();
-        $ast = std::make_unique<EnumType>(symbol->getLine(), symbol->getCharPositionInLine(), std::move($name.ast), false);
-    }
-    ;
-
-enumDefinition returns [ std::unique_ptr<EnumType> ast ]
-    : ENUM (name=identifier)? LBRACE (var+=enumValue COMMA)* (var+=enumValue)? RBRACE
+// Declaration without and definition with a body
+enumSpecifier returns [ std::unique_ptr<EnumType> ast ]
+    : ENUM (name=anyIdentifier)? (body=LBRACE (var+=enumValue COMMA)* (var+=enumValue)? RBRACE)?
     {
         Token *symbol = $ctx->ENUM()->getSymbol();
+        if ($name.ctx == nullptr && $body == nullptr) {
+            notifyErrorListeners("Enum without name and body");
+        }
         std::unique_ptr<Identifier> name;
         if ($name.ctx != nullptr) {
             name = std::move($name.ast);
         } else {
-            name = std::make_unique<Identifier>(symbol->getLine(), symbol->getCharPositionInLine(), "");
+            name = std::make_unique<Identifier>(loc(symbol), "");
         }
-        $ast = std::make_unique<EnumType>(symbol->getLine(), symbol->getCharPositionInLine(), std::move(name), true);
+        $ast = std::make_unique<EnumType>(loc(symbol), std::move(name), $body != nullptr);
         for (int i = 0; i < $var.size(); i++) {
             $ast->add_value(std::move($var[i]->ast));
         }
@@ -898,7 +1036,7 @@ enumDefinition returns [ std::unique_ptr<EnumType> ast ]
 enumValue returns [ std::unique_ptr<EnumValue> ast ]
     : id=identifier (EQUAL c=expression)?
     {
-        auto e = std::make_unique<EnumValue>($id.ast->get_line(), $id.ast->get_column(), std::move($id.ast));
+        auto e = std::make_unique<EnumValue>($id.ast->location, std::move($id.ast));
         if ($c.ctx != nullptr) {
             e->set_value(std::move($c.ast));
         }
@@ -906,50 +1044,40 @@ enumValue returns [ std::unique_ptr<EnumValue> ast ]
     }
     ;
 
-structDeclaration returns [ std::unique_ptr<StructType> ast ]
-    : STRUCT name=identifier
-    {
-        Token *symbol = $ctx->STRUCT()->getSymbol();
-        $ast = std::make_unique<StructType>(symbol->getLine(), symbol->getCharPositionInLine(), std::move($name.ast), false);
-    }
-    ;
-
-structDefinition returns [ std::unique_ptr<StructType> ast ]
-    : STRUCT (name=identifier)? LBRACE (var+=variableDeclaration SEMICOLON)* RBRACE
+structSpecifier returns [ std::unique_ptr<StructType> ast ]
+    : STRUCT (name=anyIdentifier)? (body=LBRACE (var+=variableDeclaration SEMICOLON)* RBRACE)?
     {
         Token *symbol = $ctx->STRUCT()->getSymbol();
+        if ($name.ctx == nullptr && $body == nullptr) {
+            notifyErrorListeners("Struct without name and body");
+        }
         std::unique_ptr<Identifier> name;
         if ($name.ctx != nullptr) {
             name = std::move($name.ast);
         } else {
-            name = std::make_unique<Identifier>(symbol->getLine(), symbol->getCharPositionInLine(), "");
+            name = std::make_unique<Identifier>(loc(symbol), "");
         }
-        $ast = std::make_unique<StructType>(symbol->getLine(), symbol->getCharPositionInLine(), std::move(name), true);
+        $ast = std::make_unique<StructType>(loc(symbol), std::move(name), $body != nullptr);
         for (int i = 0; i < $var.size(); i++) {
             $ast->add_member(std::move($var[i]->ast));
         }
     }
     ;
 
-unionDeclaration returns [ std::unique_ptr<UnionType> ast ]
-    : UNION name=identifier
-    {
-        Token *symbol = $ctx->UNION()->getSymbol();
-        $ast = std::make_unique<UnionType>(symbol->getLine(), symbol->getCharPositionInLine(), std::move($name.ast), false);
-    }
-    ;
-
-unionDefinition returns [ std::unique_ptr<UnionType> ast ]
-    : UNION (name=identifier)? LBRACE (var+=variableDeclaration SEMICOLON)* RBRACE
+unionSpecifier returns [ std::unique_ptr<UnionType> ast ]
+    : UNION (name=anyIdentifier)? (body=LBRACE (var+=variableDeclaration SEMICOLON)* RBRACE)?
     {
         Token *symbol = $ctx->UNION()->getSymbol();
+        if ($name.ctx == nullptr && $body == nullptr) {
+            notifyErrorListeners("Union without name and body");
+        }
         std::unique_ptr<Identifier> name;
         if ($name.ctx != nullptr) {
             name = std::move($name.ast);
         } else {
-            name = std::make_unique<Identifier>(symbol->getLine(), symbol->getCharPositionInLine(), "");
+            name = std::make_unique<Identifier>(loc(symbol), "");
         }
-        $ast = std::make_unique<UnionType>(symbol->getLine(), symbol->getCharPositionInLine(), std::move(name), true);
+        $ast = std::make_unique<UnionType>(loc(symbol), std::move(name), $body != nullptr);
         for (int i = 0; i < $var.size(); i++) {
             $ast->add_member(std::move($var[i]->ast));
         }
@@ -957,85 +1085,83 @@ unionDefinition returns [ std::unique_ptr<UnionType> ast ]
     ;
 
 primitiveType returns [ std::unique_ptr <PrimitiveType> ast ]
-    : p=primitiveTypeHelper
-    {
-        $ast = std::move($p.ast);
-    }
-    | t=primitiveType h=primitiveTypeHelper
+    : (h+=primitiveTypeHelper)+
     {
-        $ast = std::move($t.ast);
-        $ast->add_keyword($h.ast->keywords[0]);
+        $ast = std::move($h[0]->ast);
+        for (int i = 1; i < $h.size(); i++) {
+            $ast->add_keyword($h[i]->ast->keywords[0]);
+        }
     }
     ;
-    
+
 primitiveTypeHelper returns [ std::unique_ptr <PrimitiveType> ast ]
     : INT
     {
         Token *symbol = $ctx->INT()->getSymbol();
-        $ast = std::make_unique<PrimitiveType>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<PrimitiveType>(loc(symbol));
         $ast->add_keyword(PrimitiveType::KeyWords::INT);
     }
     | VOID
     {
         Token *symbol = $ctx->VOID()->getSymbol();
-        $ast = std::make_unique<PrimitiveType>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<PrimitiveType>(loc(symbol));
         $ast->add_keyword(PrimitiveType::KeyWords::VOID);
     }
     | SIGNED
     {
         Token *symbol = $ctx->SIGNED()->getSymbol();
-        $ast = std::make_unique<PrimitiveType>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<PrimitiveType>(loc(symbol));
         $ast->add_keyword(PrimitiveType::KeyWords::SIGNED);
     }
     | UNSIGNED
     {
         Token *symbol = $ctx->UNSIGNED()->getSymbol();
-        $ast = std::make_unique<PrimitiveType>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<PrimitiveType>(loc(symbol));
         $ast->add_keyword(PrimitiveType::KeyWords::UNSIGNED);
     }
     | CHAR
     {
         Token *symbol = $ctx->CHAR()->getSymbol();
-        $ast = std::make_unique<PrimitiveType>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<PrimitiveType>(loc(symbol));
         $ast->add_keyword(PrimitiveType::KeyWords::CHAR);
     }
     | SHORT
     {
         Token *symbol = $ctx->SHORT()->getSymbol();
-        $ast = std::make_unique<PrimitiveType>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<PrimitiveType>(loc(symbol));
         $ast->add_keyword(PrimitiveType::KeyWords::SHORT);
     }
     | LONG
     {
         Token *symbol = $ctx->LONG()->getSymbol();
-        $ast = std::make_unique<PrimitiveType>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<PrimitiveType>(loc(symbol));
         $ast->add_keyword(PrimitiveType::KeyWords::LONG);
     }
     | FLOAT
     {
         Token *symbol = $ctx->FLOAT()->getSymbol();
-        $ast = std::make_unique<PrimitiveType>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<PrimitiveType>(loc(symbol));
         $ast->add_keyword(PrimitiveType::KeyWords::FLOAT);
     }
     | DOUBLE
     {
         Token *symbol = $ctx->DOUBLE()->getSymbol();
-        $ast = std::make_unique<PrimitiveType>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<PrimitiveType>(loc(symbol));
         $ast->add_keyword(PrimitiveType::KeyWords::DOUBLE);
     }
     | BUILTIN_VA_LIST
     {
         Token *symbol = $ctx->BUILTIN_VA_LIST()->getSymbol();
-        $ast = std::make_unique<PrimitiveType>(symbol->getLine(), symbol->getCharPositionInLine());
+        $ast = std::make_unique<PrimitiveType>(loc(symbol));
         $ast->add_keyword(PrimitiveType::KeyWords::VA_LIST);
     }
     ;
 
-
-string returns [ std::string s ]
+// Raw text between the quotes, escapes are not processed
+string returns [ std::string_view s ]
     : c=STRING
     {
-        std::string erg = $c->getText();
+        std::string_view erg = text($c);
         $s = erg.substr(1, erg.size() - 2);
     }
     ;
@@ -1155,8 +1281,10 @@ SEMICOLON: ';';
 QUESTION: '?';
 COLON: ':';
 
-HEX_NUMBER: '0x' [0-9a-f]+ [ul]*;
-BIN_NUMBER: '0b' [0-1]+ [ul]*;
-OCT_NUMBER: '0' [0-7]+ [ul]*;
-NUMBER: [0-9]+ ('.' [0-9]*)? [ul]*;
+HEX_NUMBER: '0' [xX] [0-9a-fA-F]+ [uUlL]*;
+BIN_NUMBER: '0' [bB] [0-1]+ [uUlL]*;
+OCT_NUMBER: '0' [0-7]+ [uUlL]*;
+// Integers and floating constants, decode_integer rejects a float suffix on
+// an integer
+NUMBER: ([0-9]+ ('.' [0-9]*)? | '.' [0-9]+) ([eE] [+-]? [0-9]+)? [fFlLuU]*;
 IDENTIFIER: [a-zA-Z_]+[a-zA-Z0-9_]*;
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace CCOMP {
+
+// Bump allocator handing out memory from large contiguous blocks. Memory is
+// only released when the arena itself is destroyed, destructors of objects
+// placed in the arena are not run by the arena.
+class Arena {
+   public:
+    explicit Arena(size_t block_size = 64 * 1024) : block_size(block_size) {
+    }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size, size_t align) {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(cur) + align - 1) &
+                      ~(uintptr_t)(align - 1);
+        if (cur == nullptr || p + size > reinterpret_cast<uintptr_t>(end)) {
+            new_block(size + align);
+            p = (reinterpret_cast<uintptr_t>(cur) + align - 1) &
+                ~(uintptr_t)(align - 1);
+        }
+        cur = reinterpret_cast<char *>(p + size);
+        return reinterpret_cast<void *>(p);
+    }
+
+    template <typename T, typename... Args>
+    T *make(Args &&...args) {
+        return new (allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+    }
+
+    // Forget all allocations but keep the first block for reuse.
+    void reset() {
+        if (blocks.empty()) {
+            return;
+        }
+        blocks.resize(1);
+        cur = blocks[0].get();
+        end = cur + block_size;
+    }
+
+   private:
+    void new_block(size_t min_size) {
+        size_t size = min_size > block_size ? min_size : block_size;
+        blocks.push_back(std::make_unique<char[]>(size));
+        cur = blocks.back().get();
+        end = cur + size;
+    }
+
+    size_t block_size;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char *cur = nullptr;
+    char *end = nullptr;
+};
+
+}  // namespace CCOMP
@@ -1,5 +1,6 @@
 #include "args.hpp"
 
+#include <cstdlib>
 #include <cstring>
 
 #include "common.hpp"
@@ -9,6 +10,28 @@ CCOMP::Arguments::Arguments(int argc, char **argv) {
         if (strncmp(argv[i], "-E", 2) == 0) {
             trace("Args: stop after preprocessing");
             stop_after_preprocessing = true;
+        } else if (strncmp(argv[i], "--profile-parser", 16) == 0) {
+            trace("Args: profile parser");
+            profile_parser = true;
+        } else if (strncmp(argv[i], "--lazy-bodies", 13) == 0) {
+            trace("Args: lazy function bodies");
+            lazy_bodies = true;
+        } else if (strncmp(argv[i], "--bench-visitors", 16) == 0) {
+            trace("Args: benchmark visitors");
+            bench_visitors = true;
+        } else if (strncmp(argv[i], "--fold-constants", 16) == 0) {
+            trace("Args: fold constants");
+            fold_constants = true;
+        } else if (strncmp(argv[i], "--shift-multiplications", 23) == 0) {
+            trace("Args: shift multiplications");
+            shift_multiplications = true;
+        } else if (strncmp(argv[i], "--threads", 9) == 0) {
+            if (i + 1 >= argc) {
+                die("No number of threads provided");
+            }
+            trace("Args: %s threads", argv[i + 1]);
+            threads = strtoul(argv[i + 1], nullptr, 10);
+            i++;
         } else if (strncmp(argv[i], "--dot", 5) == 0) {
             if (i + 1 >= argc) {
                 die("No dot file provided");
@@ -16,6 +39,48 @@ CCOMP::Arguments::Arguments(int argc, char **argv) {
             trace("Args: dot file %s", argv[i + 1]);
             dot_path = argv[i + 1];
             i++;
+        } else if (strncmp(argv[i], "--ast", 5) == 0) {
+            if (i + 1 >= argc) {
+                die("No binary AST file provided");
+            }
+            trace("Args: binary AST file %s", argv[i + 1]);
+            ast_path = argv[i + 1];
+            i++;
+        } else if (strncmp(argv[i], "--index", 7) == 0) {
+            if (i + 1 >= argc) {
+                die("No index file provided");
+            }
+            trace("Args: index file %s", argv[i + 1]);
+            index_path = argv[i + 1];
+            i++;
+        } else if (strncmp(argv[i], "--find", 6) == 0) {
+            if (i + 1 >= argc) {
+                die("No name to find provided");
+            }
+            trace("Args: find %s", argv[i + 1]);
+            find.emplace_back(argv[i + 1]);
+            i++;
+        } else if (strncmp(argv[i], "--layout", 8) == 0) {
+            if (i + 1 >= argc) {
+                die("No name to lay out provided");
+            }
+            trace("Args: layout of %s", argv[i + 1]);
+            layouts.emplace_back(argv[i + 1]);
+            i++;
+        } else if (strncmp(argv[i], "--reparse", 9) == 0) {
+            if (i + 1 >= argc) {
+                die("No edited source provided");
+            }
+            trace("Args: reparse after editing to %s", argv[i + 1]);
+            reparse_path = argv[i + 1];
+            i++;
+        } else if (strncmp(argv[i], "--hashes", 8) == 0) {
+            if (i + 1 >= argc) {
+                die("No hash file provided");
+            }
+            trace("Args: hash file %s", argv[i + 1]);
+            hashes_path = argv[i + 1];
+            i++;
         } else {
             trace("Args: source file %s", argv[i]);
             source_path = argv[i];
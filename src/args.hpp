@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <string>
+#include <vector>
 
 namespace CCOMP {
 
@@ -10,8 +12,29 @@ struct Arguments {
    public:
     std::string source_path;
     std::string dot_path;
+    // Binary AST output, see ast_file.hpp
+    std::string ast_path;
+    // Structural hashes of the last compile, see structural_hash.hpp
+    std::string hashes_path;
+    // Symbol index output, see symbol_index.hpp
+    std::string index_path;
+    // Names whose occurrences are printed
+    std::vector<std::string> find;
+    // Tags and declarations whose size and alignment are printed
+    std::vector<std::string> layouts;
+    // The source file after an edit, it is preprocessed and reparsed
+    // incrementally
+    std::string reparse_path;
 
     bool stop_after_preprocessing = false;
+    bool profile_parser = false;
+    bool lazy_bodies = false;
+    bool bench_visitors = false;
+    bool fold_constants = false;
+    // Multiplications by powers of two become shifts, see add_shift_rules
+    bool shift_multiplications = false;
+    // Threads for passes over the functions, 0 is one per core
+    size_t threads = 0;
 };
 
 }  // namespace CCOMP
@@ -2,25 +2,32 @@
 
 #include <stdint.h>
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include "common.hpp"
+#include "literals.hpp"
+#include "small_vector.hpp"
+#include "source_manager.hpp"
 #include "visitors/ASTVisitor.hpp"
 
 /* #define DO_AST_TRACE */
 
 #ifdef DO_AST_TRACE
-#define AST_TRACE(p)                                              \
-    do {                                                          \
-        printf("Visiting %s at %d:%d (", __func__, line, column); \
-        std::cout << p;                                           \
-        printf(")\n");                                            \
+#define AST_TRACE(p)                                                    \
+    do {                                                                \
+        printf("Visiting %s at %u (", __func__, location.get_offset()); \
+        std::cout << p;                                                 \
+        printf(")\n");                                                  \
     } while (0)
 #else
 #define AST_TRACE(p)
@@ -28,157 +35,363 @@
 
 namespace CCOMP::AST {
 
+using CCOMP::SourceLocation;
+using CCOMP::SmallVector;
+using CCOMP::SourceManager;
+
+// Every node class with its Kind. Declarations and types are kept together so
+// Declaration::classof and Type::classof are range checks.
+#define AST_KINDS(X)                                      \
+    X(Program, PROGRAM)                                   \
+    X(Block, BLOCK)                                       \
+    X(SwitchBlock, SWITCH_BLOCK)                          \
+    X(Switch, SWITCH)                                     \
+    X(If, IF)                                             \
+    X(For, FOR)                                           \
+    X(While, WHILE)                                       \
+    X(DoWhile, DO_WHILE)                                  \
+    X(Attribute, ATTRIBUTE)                               \
+    X(Assembly, ASSEMBLY)                                 \
+    X(Constant, CONSTANT)                                 \
+    X(Identifier, IDENTIFIER)                             \
+    X(ArrayInitializationList, ARRAY_INITIALIZATION_LIST) \
+    X(ArrayAccess, ARRAY_ACCESS)                          \
+    X(StructAccess, STRUCT_ACCESS)                        \
+    X(Assignment, ASSIGNMENT)                             \
+    X(OperationAssignment, OPERATION_ASSIGNMENT)          \
+    X(ExpressionList, EXPRESSION_LIST)                    \
+    X(FunctionCall, FUNCTION_CALL)                        \
+    X(UnaryExpression, UNARY_EXPRESSION)                  \
+    X(BinaryExpression, BINARY_EXPRESSION)                \
+    X(TernaryExpression, TERNARY_EXPRESSION)              \
+    X(Return, RETURN)                                     \
+    X(EnumValue, ENUM_VALUE)                              \
+    X(TypeCast, TYPE_CAST)                                \
+    X(TypeDef, TYPE_DEF)                                  \
+    X(VariableDeclaration, VARIABLE_DECLARATION)          \
+    X(FunctionDefinition, FUNCTION_DEFINITION)            \
+    X(FunctionDeclaration, FUNCTION_DECLARATION)          \
+    X(NamedType, NAMED_TYPE)                              \
+    X(FunctionType, FUNCTION_TYPE)                        \
+    X(PrimitiveType, PRIMITIVE_TYPE)                      \
+    X(StructType, STRUCT_TYPE)                            \
+    X(UnionType, UNION_TYPE)                              \
+    X(EnumType, ENUM_TYPE)
+
+enum class Kind : uint8_t {
+#define KIND(type, kind) kind,
+    AST_KINDS(KIND)
+#undef KIND
+};
+
+#define COUNT_KIND(type, kind) +1
+constexpr size_t KIND_COUNT = 0 AST_KINDS(COUNT_KIND);
+#undef COUNT_KIND
+
+template <typename T>
+class CowPtr;
+
 class AST {
    public:
-    AST(uint32_t line, uint32_t column) : line(line), column(column) {
-        AST_TRACE(line << ":" << column);
+    AST(Kind kind, SourceLocation location)
+        : location(location), kind(kind) {
+        AST_TRACE(location.get_offset());
+    }
+    // A copy is not referenced by any CowPtr yet
+    AST(const AST &other) : location(other.location), kind(other.kind) {
     }
     virtual ~AST() = default;
 
-    [[nodiscard]] uint32_t get_line() const {
-        return line;
+    [[nodiscard]] SourceLocation get_location() const {
+        return location;
     }
-    [[nodiscard]] uint32_t get_column() const {
-        return column;
+
+    virtual void *accept(ASTVisitor &visitor, void *args) const = 0;
+    // Copies only this node, the children are shared with it
+    virtual std::unique_ptr<AST> clone() const = 0;
+
+   public:
+    SourceLocation location;
+    const Kind kind;
+
+   private:
+    template <typename T>
+    friend class CowPtr;
+
+    // Number of CowPtrs pointing to the node
+    mutable std::atomic<uint32_t> refs = 0;
+};
+
+// Checked with the kind instead of RTTI, see the classof of every node
+template <typename T>
+[[nodiscard]] inline bool isa(const AST *node) {
+    return T::classof(node);
+}
+
+template <typename T>
+[[nodiscard]] inline T *cast(AST *node) {
+    if (!isa<T>(node)) {
+        die("Invalid cast of AST node at %u", node->location.get_offset());
+    }
+    return static_cast<T *>(node);
+}
+
+template <typename T>
+[[nodiscard]] inline const T *cast(const AST *node) {
+    if (!isa<T>(node)) {
+        die("Invalid cast of AST node at %u", node->location.get_offset());
+    }
+    return static_cast<const T *>(node);
+}
+
+template <typename T>
+[[nodiscard]] inline T *dyn_cast(AST *node) {
+    if (node == nullptr || !isa<T>(node)) {
+        return nullptr;
+    }
+    return static_cast<T *>(node);
+}
+
+template <typename T>
+[[nodiscard]] inline const T *dyn_cast(const AST *node) {
+    if (node == nullptr || !isa<T>(node)) {
+        return nullptr;
+    }
+    return static_cast<const T *>(node);
+}
+
+// cast for an owning pointer, nullptr stays nullptr
+template <typename T>
+[[nodiscard]] inline std::unique_ptr<T> unique_cast(std::unique_ptr<AST> node) {
+    if (node == nullptr) {
+        return nullptr;
     }
+    return std::unique_ptr<T>(cast<T>(node.release()));
+}
 
-    virtual void *accept(ASTVisitor &visitor, void *args) = 0;
-    virtual std::unique_ptr<AST> clone() = 0;
+// Deletes a node no CowPtr refers to anymore. Nodes released while another
+// one is deleted are queued and deleted after it, so tearing down a deep
+// tree needs no stack frame per level.
+inline void delete_node(AST *node) {
+    thread_local std::vector<AST *> queued;
+    thread_local bool deleting = false;
+    if (deleting) {
+        queued.push_back(node);
+        return;
+    }
+
+    deleting = true;
+    delete node;
+    while (!queued.empty()) {
+        AST *next = queued.back();
+        queued.pop_back();
+        delete next;
+    }
+    deleting = false;
+}
 
+// Owning pointer to a child node, which may be shared with other trees after
+// a clone. Reading through it is free and only gives a const node. Changing
+// a node goes through mut(), which copies it first while another tree still
+// refers to it, so no tree sees the changes of another.
+template <typename T>
+class CowPtr {
    public:
-    uint32_t line, column;
+    CowPtr() = default;
+    CowPtr(std::nullptr_t) {
+    }
+    template <typename U>
+    CowPtr(std::unique_ptr<U> node) : node(node.release()) {
+        retain();
+    }
+    CowPtr(const CowPtr &other) : node(other.node) {
+        retain();
+    }
+    // Shares the node of other, which has to be a T
+    template <typename U>
+    explicit CowPtr(const CowPtr<U> &other)
+        : node(static_cast<T *>(static_cast<AST *>(other.node))) {
+        retain();
+    }
+    CowPtr(CowPtr &&other) noexcept : node(other.node) {
+        other.node = nullptr;
+    }
+    ~CowPtr() {
+        release();
+    }
+
+    CowPtr &operator=(CowPtr other) noexcept {
+        std::swap(node, other.node);
+        return *this;
+    }
+
+    const T *get() const {
+        return node;
+    }
+    const T *operator->() const {
+        return node;
+    }
+    const T &operator*() const {
+        return *node;
+    }
+    explicit operator bool() const {
+        return node != nullptr;
+    }
+    bool operator==(std::nullptr_t) const {
+        return node == nullptr;
+    }
+    bool operator!=(std::nullptr_t) const {
+        return node != nullptr;
+    }
+
+    [[nodiscard]] bool shared() const {
+        return node != nullptr && node->refs.load() > 1;
+    }
+
+    // The node for changing it. A shared node is replaced by a copy first,
+    // whose children stay shared until they are changed the same way.
+    T *mut() {
+        if (shared()) {
+            // The copy of a T is a T
+            auto copy = node->clone();
+            *this = std::unique_ptr<T>(static_cast<T *>(copy.release()));
+        }
+        return node;
+    }
+
+   private:
+    template <typename U>
+    friend class CowPtr;
+
+    void retain() {
+        if (node != nullptr) {
+            node->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    void release() {
+        if (node != nullptr &&
+            node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete_node(node);
+        }
+    }
+
+    T *node = nullptr;
 };
 
-#define AST_METHODS()                                        \
-    void *accept(ASTVisitor &visitor, void *args) override { \
-        return visitor.visit(*this, args);                   \
+#define AST_METHODS(KIND_NAME)                                     \
+    static constexpr Kind KIND = Kind::KIND_NAME;                  \
+    static bool classof(const AST *node) {                         \
+        return node->kind == KIND;                                 \
+    }                                                              \
+    void *accept(ASTVisitor &visitor, void *args) const override { \
+        return visitor.visit(*this, args);                         \
     }
 
 class Block : public AST {
    public:
-    Block(uint32_t line, uint32_t column) : AST(line, column), statements() {
-        AST_TRACE(line << ":" << column);
+    Block(SourceLocation location)
+        : AST(KIND, location), statements() {
+        AST_TRACE(location.get_offset());
     }
 
     void add_statement(std::unique_ptr<AST> statement) {
         statements.push_back(std::move(statement));
     }
 
-    AST_METHODS()
+    AST_METHODS(BLOCK)
 
-    std::unique_ptr<AST> clone() override {
-        auto block = std::make_unique<Block>(line, column);
-        for (auto &stmt : statements) {
-            block->add_statement(stmt->clone());
-        }
-        return block;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<Block>(*this);
     }
 
    public:
-    std::vector<std::unique_ptr<AST>> statements;
+    std::vector<CowPtr<AST>> statements;
 };
 
 class SwitchBlock : public AST {
    public:
-    SwitchBlock(uint32_t line, uint32_t column)
-        : AST(line, column), statements() {
-        AST_TRACE(line << ":" << column);
+    SwitchBlock(SourceLocation location)
+        : AST(KIND, location), statements() {
+        AST_TRACE(location.get_offset());
     }
 
     void add_statement(std::unique_ptr<AST> statement) {
         statements.push_back(std::move(statement));
     }
 
-    AST_METHODS()
+    AST_METHODS(SWITCH_BLOCK)
 
-    std::unique_ptr<AST> clone() override {
-        auto block = std::make_unique<SwitchBlock>(line, column);
-        for (auto &stmt : statements) {
-            block->add_statement(stmt->clone());
-        }
-        block->is_default = is_default;
-        if (label) {
-            block->label = label->clone();
-        }
-        return block;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<SwitchBlock>(*this);
     }
 
    public:
-    std::vector<std::unique_ptr<AST>> statements;
+    std::vector<CowPtr<AST>> statements;
     bool is_default = false;
     bool break_after = false;
-    std::unique_ptr<AST> label;
+    CowPtr<AST> label;
 };
 
 class Switch : public AST {
    public:
-    Switch(uint32_t line, uint32_t column, std::unique_ptr<AST> condition)
-        : AST(line, column), condition(std::move(condition)), switch_blocks() {
-        AST_TRACE(line << ":" << column);
+    Switch(SourceLocation location, std::unique_ptr<AST> condition)
+        : AST(KIND, location),
+          condition(std::move(condition)),
+          switch_blocks() {
+        AST_TRACE(location.get_offset());
     }
 
     void add_switch_block(std::unique_ptr<SwitchBlock> block) {
         switch_blocks.push_back(std::move(block));
     }
 
-    AST_METHODS()
+    AST_METHODS(SWITCH)
 
-    std::unique_ptr<AST> clone() override {
-        auto sw = std::make_unique<Switch>(line, column, condition->clone());
-        for (auto &block : switch_blocks) {
-            auto b = block->clone().release();
-            sw->add_switch_block(
-                std::unique_ptr<SwitchBlock>(dynamic_cast<SwitchBlock *>(b)));
-        }
-        return sw;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<Switch>(*this);
     }
 
    public:
-    std::unique_ptr<AST> condition;
-    std::vector<std::unique_ptr<SwitchBlock>> switch_blocks;
+    CowPtr<AST> condition;
+    std::vector<CowPtr<SwitchBlock>> switch_blocks;
 };
 
 class If : public AST {
    public:
-    If(uint32_t line, uint32_t column, std::unique_ptr<AST> condition,
+    If(SourceLocation location, std::unique_ptr<AST> condition,
        std::unique_ptr<AST> then_block)
-        : AST(line, column),
+        : AST(KIND, location),
           condition(std::move(condition)),
           then_block(std::move(then_block)),
           else_block(nullptr) {
-        AST_TRACE(line << ":" << column);
+        AST_TRACE(location.get_offset());
     }
 
-    If(uint32_t line, uint32_t column, std::unique_ptr<AST> condition,
+    If(SourceLocation location, std::unique_ptr<AST> condition,
        std::unique_ptr<AST> then_block, std::unique_ptr<AST> else_block)
-        : AST(line, column),
+        : AST(KIND, location),
           condition(std::move(condition)),
           then_block(std::move(then_block)),
           else_block(std::move(else_block)) {
-        AST_TRACE(line << ":" << column);
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(IF)
 
-    std::unique_ptr<AST> clone() override {
-        auto if_node = std::make_unique<If>(line, column, condition->clone(),
-                                            then_block->clone());
-        if (else_block) {
-            if_node->else_block = else_block->clone();
-        }
-        return if_node;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<If>(*this);
     }
 
    public:
-    std::unique_ptr<AST> condition;
-    std::unique_ptr<AST> then_block, else_block;
+    CowPtr<AST> condition;
+    CowPtr<AST> then_block, else_block;
 };
 
 class For : public AST {
    public:
-    For(uint32_t line, uint32_t column, std::unique_ptr<AST> body)
-        : AST(line, column), body(std::move(body)) {
-        AST_TRACE(line << ":" << column);
+    For(SourceLocation location, std::unique_ptr<AST> body)
+        : AST(KIND, location), body(std::move(body)) {
+        AST_TRACE(location.get_offset());
     }
 
     void set_init(std::unique_ptr<AST> init) {
@@ -193,80 +406,68 @@ class For : public AST {
         this->condition = std::move(condition);
     }
 
-    AST_METHODS()
+    AST_METHODS(FOR)
 
-    std::unique_ptr<AST> clone() override {
-        auto for_node = std::make_unique<For>(line, column, body->clone());
-        if (init) {
-            for_node->init = init->clone();
-        }
-        if (increment) {
-            for_node->increment = increment->clone();
-        }
-        if (condition) {
-            for_node->condition = condition->clone();
-        }
-        return for_node;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<For>(*this);
     }
 
    public:
-    std::unique_ptr<AST> init, increment, condition;
-    std::unique_ptr<AST> body;
+    CowPtr<AST> init, increment, condition;
+    CowPtr<AST> body;
 };
 
 class While : public AST {
    public:
-    While(uint32_t line, uint32_t column, std::unique_ptr<AST> condition,
+    While(SourceLocation location, std::unique_ptr<AST> condition,
           std::unique_ptr<AST> body)
-        : AST(line, column),
+        : AST(KIND, location),
           condition(std::move(condition)),
           body(std::move(body)) {
-        AST_TRACE(line << ":" << column);
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(WHILE)
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<While>(line, column, condition->clone(),
-                                       body->clone());
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<While>(*this);
     }
 
    public:
-    std::unique_ptr<AST> condition, body;
+    CowPtr<AST> condition, body;
 };
 
 class DoWhile : public AST {
    public:
-    DoWhile(uint32_t line, uint32_t column, std::unique_ptr<AST> condition,
+    DoWhile(SourceLocation location, std::unique_ptr<AST> condition,
             std::unique_ptr<AST> body)
-        : AST(line, column),
+        : AST(KIND, location),
           condition(std::move(condition)),
           body(std::move(body)) {
-        AST_TRACE(line << ":" << column);
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(DO_WHILE)
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<DoWhile>(line, column, condition->clone(),
-                                         body->clone());
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<DoWhile>(*this);
     }
 
    public:
-    std::unique_ptr<AST> condition, body;
+    CowPtr<AST> condition, body;
 };
 
 class Attribute : public AST {
    public:
-    Attribute(uint32_t line, uint32_t column, std::string name)
-        : AST(line, column), name(std::move(name)) {
-        AST_TRACE(line << ":" << column << " " << name);
+    Attribute(SourceLocation location, std::string name)
+        : AST(KIND, location), name(std::move(name)) {
+        AST_TRACE(location.get_offset() << " " << name);
     }
 
-    AST_METHODS()
+    AST_METHODS(ATTRIBUTE)
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<Attribute>(line, column, name);
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<Attribute>(*this);
     }
 
    public:
@@ -275,15 +476,15 @@ class Attribute : public AST {
 
 class Assembly : public AST {
    public:
-    Assembly(uint32_t line, uint32_t column, std::vector<std::string> assembly)
-        : AST(line, column), assembly(std::move(assembly)) {
-        AST_TRACE(line << ":" << column);
+    Assembly(SourceLocation location, std::vector<std::string> assembly)
+        : AST(KIND, location), assembly(std::move(assembly)) {
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(ASSEMBLY)
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<Assembly>(line, column, assembly);
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<Assembly>(*this);
     }
 
    public:
@@ -292,25 +493,78 @@ class Assembly : public AST {
 
 class Constant : public AST {
    public:
-    Constant(uint32_t line, uint32_t column, std::string value)
-        : AST(line, column), value(std::move(value)) {
-        AST_TRACE(line << ":" << column << " " << value);
+    enum class LiteralKind {
+        INTEGER,
+        FLOAT,
+        STRING,
+    };
+
+    Constant(SourceLocation location, IntegerLiteral value)
+        : AST(KIND, location),
+          literal_kind(LiteralKind::INTEGER),
+          integer(value) {
+        AST_TRACE(location.get_offset() << " " << value.value);
+    }
+
+    Constant(SourceLocation location, FloatLiteral value)
+        : AST(KIND, location),
+          literal_kind(LiteralKind::FLOAT),
+          floating(value) {
+        AST_TRACE(location.get_offset() << " " << value.value);
     }
 
-    AST_METHODS()
+    // string has to be owned by a StringPool as string_id
+    Constant(SourceLocation location, uint32_t string_id,
+             std::string_view string)
+        : AST(KIND, location),
+          literal_kind(LiteralKind::STRING),
+          string_id(string_id),
+          string(string) {
+        AST_TRACE(location.get_offset() << " " << string);
+    }
+
+    AST_METHODS(CONSTANT)
+
+    [[nodiscard]] std::string to_string() const {
+        switch (literal_kind) {
+            case LiteralKind::INTEGER: {
+                std::string s = std::to_string(integer.value);
+                if (integer.is_unsigned) {
+                    s += 'u';
+                }
+                s.append(integer.long_count, 'l');
+                return s;
+            }
+            case LiteralKind::FLOAT:
+                return float_to_string(floating);
+            case LiteralKind::STRING:
+                return escape_string(string);
+        }
+        return "";
+    }
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<Constant>(line, column, value);
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<Constant>(*this);
     }
 
    public:
-    std::string value;
+    LiteralKind literal_kind;
+    union {
+        IntegerLiteral integer;
+        FloatLiteral floating;
+        uint32_t string_id;
+    };
+    std::string_view string;
 };
 
-class Type : public virtual AST {
+class Type : public AST {
    public:
-    Type(uint32_t line, uint32_t column) : AST(line, column) {
-        AST_TRACE(line << ":" << column);
+    Type(Kind kind, SourceLocation location) : AST(kind, location) {
+        AST_TRACE(location.get_offset());
+    }
+
+    static bool classof(const AST *node) {
+        return node->kind >= Kind::NAMED_TYPE && node->kind <= Kind::ENUM_TYPE;
     }
 
     void set_array_dimensions(int dimensions) {
@@ -319,7 +573,7 @@ class Type : public virtual AST {
     }
 
     void set_array_dimension(int i, std::unique_ptr<AST> dimension) {
-        if (i >= array_sizes.size()) {
+        if (i < 0 || (size_t)i >= array_sizes.size()) {
             die("Invalid array dimension: %d", i);
         }
         array_sizes[i] = std::move(dimension);
@@ -340,68 +594,77 @@ class Type : public virtual AST {
     bool is_const = false;
     bool is_restrict = false;
     int array_dimensions = 0;
-    std::vector<std::unique_ptr<AST>> array_sizes;
+    SmallVector<CowPtr<AST>, 1> array_sizes;
 };
 
 class Identifier : public AST {
    public:
-    Identifier(uint32_t line, uint32_t column, std::string name)
-        : AST(line, column),
+    Identifier(SourceLocation location, std::string name)
+        : AST(KIND, location),
           name(std::move(name)),
           type_owned(nullptr),
           type_ref(nullptr) {
-        AST_TRACE(line << ":" << column << " " << name);
+        AST_TRACE(location.get_offset() << " " << name);
     }
 
-    AST_METHODS()
+    AST_METHODS(IDENTIFIER)
 
     void add_type(std::unique_ptr<Type> p_type) {
         this->type_owned = std::move(p_type);
     }
 
-    void add_type(Type *p_type) {
-        this->type_ref = p_type;
+    // Refers to a type that belongs to another node, walks do not visit it
+    // a second time
+    void share_type(CowPtr<Type> p_type) {
+        this->type_ref = std::move(p_type);
     }
 
-    Type *type() {
-        if (type_ref) {
-            return type_ref;
-        }
-        return type_owned.get();
+    [[nodiscard]] const Type *type() const {
+        return type_ptr().get();
     }
 
-    std::unique_ptr<AST> clone() override {
-        auto id = std::make_unique<Identifier>(line, column, name);
-        if (type_owned) {
-            auto type = type_owned->clone().release();
-            id->add_type(std::unique_ptr<Type>(dynamic_cast<Type *>(type)));
-        } else if (type_ref) {
-            id->add_type(type_ref);
-        }
-        return id;
+    // The type for changing it, see CowPtr::mut. A shared one is copied and
+    // no longer shared afterwards.
+    Type *mutable_type() {
+        return type_ptr().mut();
+    }
+
+    // The pointer to the type for changing or replacing it
+    CowPtr<Type> &type_ptr() {
+        return type_ref ? type_ref : type_owned;
+    }
+    [[nodiscard]] const CowPtr<Type> &type_ptr() const {
+        return type_ref ? type_ref : type_owned;
+    }
+
+    [[nodiscard]] bool owns_type() const {
+        return type_owned != nullptr;
+    }
+
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<Identifier>(*this);
     }
 
    public:
     std::string name;
 
    private:
-    std::unique_ptr<Type> type_owned;
-    Type *type_ref;
+    CowPtr<Type> type_owned;
+    CowPtr<Type> type_ref;
 };
 
 class NamedType : public Type {
    public:
     NamedType(std::unique_ptr<Identifier> name)
-        : Type(name->line, name->column), AST(name->line, name->column) {
-        AST_TRACE(line << ":" << column << " " << name->name);
+        : Type(KIND, name->location) {
+        AST_TRACE(location.get_offset() << " " << name->name);
         this->name = name->name;
     }
 
-    AST_METHODS()
+    AST_METHODS(NAMED_TYPE)
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<NamedType>(
-            std::make_unique<Identifier>(line, column, name));
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<NamedType>(*this);
     }
 
    public:
@@ -410,36 +673,27 @@ class NamedType : public Type {
 
 class FunctionType : public Type {
    public:
-    FunctionType(uint32_t line, uint32_t column,
+    FunctionType(SourceLocation location,
                  std::unique_ptr<Type> return_type)
-        : Type(line, column),
-          AST(line, column),
+        : Type(KIND, location),
           return_type(std::move(return_type)) {
-        AST_TRACE(line << ":" << column);
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(FUNCTION_TYPE)
 
     void add_parameter(std::unique_ptr<Identifier> parameter) {
         parameters.push_back(std::move(parameter));
     }
 
-    std::unique_ptr<AST> clone() override {
-        auto return_type = this->return_type->clone().release();
-        auto fn_type = std::make_unique<FunctionType>(
-            line, column,
-            std::unique_ptr<Type>(dynamic_cast<Type *>(return_type)));
-        for (auto &param : parameters) {
-            fn_type->add_parameter(std::make_unique<Identifier>(
-                param->line, param->column, param->name));
-        }
-        return fn_type;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<FunctionType>(*this);
     }
 
    public:
     bool varargs = false;
-    std::unique_ptr<Type> return_type;
-    std::vector<std::unique_ptr<Identifier>> parameters;
+    CowPtr<Type> return_type;
+    std::vector<CowPtr<Identifier>> parameters;
 };
 
 class PrimitiveType : public Type {
@@ -457,12 +711,12 @@ class PrimitiveType : public Type {
         DOUBLE,
     };
 
-    PrimitiveType(uint32_t line, uint32_t column)
-        : Type(line, column), AST(line, column) {
-        AST_TRACE(line << ":" << column);
+    PrimitiveType(SourceLocation location)
+        : Type(KIND, location) {
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(PRIMITIVE_TYPE)
 
     void add_keyword(KeyWords k) {
         keywords.push_back(k);
@@ -507,202 +761,242 @@ class PrimitiveType : public Type {
         return s.str();
     }
 
-    std::unique_ptr<AST> clone() override {
-        auto prim = std::make_unique<PrimitiveType>(line, column);
-        for (auto k : keywords) {
-            prim->add_keyword(k);
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<PrimitiveType>(*this);
+    }
+
+   public:
+    // "unsigned long long int" is the longest
+    SmallVector<KeyWords, 4> keywords;
+};
+
+// Most declarations have no attributes, the rest only a few
+using Attributes = SmallVector<CowPtr<Attribute>, 2>;
+
+// Name, visibility and extensions of everything declared at file scope. Not
+// an AST itself, so struct, union and enum types can have it without a second
+// AST base.
+class DeclarationData {
+   public:
+    explicit DeclarationData(std::unique_ptr<Identifier> name)
+        : name(std::move(name)) {
+    }
+
+    bool is_public = true;
+
+    void add_attribute(Attributes &attribute) {
+        for (auto &attr : attribute) {
+            attributes.push_back(std::move(attr));
         }
-        return prim;
+    }
+
+    void add_assembly(std::unique_ptr<Assembly> line) {
+        assembly.push_back(std::move(line));
     }
 
    public:
-    std::vector<KeyWords> keywords;
+    CowPtr<Identifier> name;
+    Attributes attributes;
+    SmallVector<CowPtr<Assembly>, 1> assembly;
 };
 
-class Declaration : public virtual AST {
+class Declaration : public AST, public DeclarationData {
    public:
-    Declaration(uint32_t line, uint32_t column,
+    Declaration(Kind kind, SourceLocation location,
                 std::unique_ptr<Identifier> name)
-        : AST(line, column), name(std::move(name)), m_type(nullptr) {
-        AST_TRACE(line << ":" << column << " " << this->name->name);
+        : AST(kind, location),
+          DeclarationData(std::move(name)),
+          m_type(nullptr) {
+        AST_TRACE(location.get_offset() << " " << this->name->name);
     }
 
-    Declaration(uint32_t line, uint32_t column, std::unique_ptr<Type> type)
-        : AST(line, column), name(nullptr), m_type(std::move(type)) {
-        AST_TRACE(line << ":" << column);
+    Declaration(Kind kind, SourceLocation location,
+                std::unique_ptr<Type> type)
+        : AST(kind, location),
+          DeclarationData(nullptr),
+          m_type(std::move(type)) {
+        AST_TRACE(location.get_offset());
     }
 
-    bool is_public = true;
+    static bool classof(const AST *node) {
+        return node->kind >= Kind::TYPE_DEF &&
+               node->kind <= Kind::FUNCTION_DECLARATION;
+    }
 
-    virtual bool owns_type() {
+    [[nodiscard]] bool owns_type() const {
         return m_type != nullptr;
     }
 
-    virtual Type *type() {
+    [[nodiscard]] const Type *type() const {
         if (m_type) {
             return m_type.get();
         }
         return name->type();
     }
 
-    void add_attribute(std::vector<std::unique_ptr<Attribute>> &attribute) {
-        for (auto &attr : attribute) {
-            attributes.push_back(std::move(attr));
+    // The type for changing it, see CowPtr::mut
+    Type *mutable_type() {
+        if (m_type) {
+            return m_type.mut();
         }
-    }
-
-    void add_assembly(std::unique_ptr<Assembly> line) {
-        assembly.push_back(std::move(line));
+        return name.mut()->mutable_type();
     }
 
    public:
-    std::unique_ptr<Identifier> name;
-    std::unique_ptr<Type> m_type;
-    std::vector<std::unique_ptr<Attribute>> attributes;
-    std::vector<std::unique_ptr<Assembly>> assembly;
+    CowPtr<Type> m_type;
 };
 
 class TypeDef : public Declaration {
    public:
-    TypeDef(uint32_t line, uint32_t column, std::unique_ptr<Identifier> id)
-        : Declaration(line, column, std::move(id)), AST(line, column) {
-        AST_TRACE(line << ":" << column << " " << this->name->name);
+    TypeDef(SourceLocation location, std::unique_ptr<Identifier> id)
+        : Declaration(KIND, location, std::move(id)) {
+        AST_TRACE(location.get_offset() << " " << this->name->name);
     }
 
-    AST_METHODS();
+    AST_METHODS(TYPE_DEF)
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<TypeDef>(
-            line, column,
-            std::make_unique<Identifier>(name->line, name->column, name->name));
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<TypeDef>(*this);
     }
 };
 
 class VariableDeclaration : public Declaration {
    public:
-    VariableDeclaration(uint32_t line, uint32_t column,
+    VariableDeclaration(SourceLocation location,
                         std::unique_ptr<Identifier> name,
                         std::unique_ptr<AST> value)
-        : Declaration(line, column, std::move(name)),
-          AST(line, column),
+        : Declaration(KIND, location, std::move(name)),
           value(std::move(value)) {
-        AST_TRACE(line << ":" << column << " " << this->name->name);
+        AST_TRACE(location.get_offset() << " " << this->name->name);
     }
 
-    AST_METHODS()
+    AST_METHODS(VARIABLE_DECLARATION)
 
-    std::unique_ptr<AST> clone() override {
-        auto var = std::make_unique<VariableDeclaration>(
-            line, column,
-            std::make_unique<Identifier>(name->line, name->column, name->name),
-            nullptr);
-        if (value) {
-            var->value = value->clone();
-        }
-        return var;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<VariableDeclaration>(*this);
     }
 
    public:
-    std::unique_ptr<AST> value;
+    CowPtr<AST> value;
     bool global = false;
 };
 
 class ArrayInitializationList : public AST {
    public:
-    ArrayInitializationList(uint32_t line, uint32_t column)
-        : AST(line, column), values() {
-        AST_TRACE(line << ":" << column);
+    ArrayInitializationList(SourceLocation location)
+        : AST(KIND, location), m_values() {
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(ARRAY_INITIALIZATION_LIST)
 
     void add_value(std::unique_ptr<AST> value) {
-        values.push_back(std::move(value));
+        mutable_values().push_back(std::move(value));
     }
 
-    std::unique_ptr<AST> clone() override {
-        auto list = std::make_unique<ArrayInitializationList>(line, column);
-        for (auto &val : values) {
-            list->add_value(val->clone());
-        }
-        return list;
+    // Replaces the elements by a list of number literals
+    void set_packed(std::shared_ptr<const PackedLiterals> packed) {
+        m_values.clear();
+        m_packed = std::move(packed);
     }
 
-   public:
-    std::vector<std::unique_ptr<AST>> values;
+    // The elements with nodes, none while the list is packed
+    [[nodiscard]] const std::vector<CowPtr<AST>> &values() const {
+        return m_values;
+    }
+
+    // The elements for changing them. Packed elements get nodes first, with
+    // the locations they were parsed at.
+    std::vector<CowPtr<AST>> &mutable_values() {
+        unpack();
+        return m_values;
+    }
+
+    // The elements if they did not get nodes yet
+    [[nodiscard]] const std::shared_ptr<const PackedLiterals> &packed()
+        const {
+        return m_packed;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return m_packed ? m_packed->size() : m_values.size();
+    }
+
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<ArrayInitializationList>(*this);
+    }
+
+   private:
+    void unpack();
+
+    std::vector<CowPtr<AST>> m_values;
+    // Never changed, so clones share it
+    std::shared_ptr<const PackedLiterals> m_packed;
 };
 
 class ArrayAccess : public AST {
    public:
-    ArrayAccess(uint32_t line, uint32_t column, std::unique_ptr<AST> array)
-        : AST(line, column), array(std::move(array)) {
-        AST_TRACE(line << ":" << column);
+    ArrayAccess(SourceLocation location, std::unique_ptr<AST> array)
+        : AST(KIND, location), array(std::move(array)) {
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(ARRAY_ACCESS)
 
     void add_index(std::unique_ptr<AST> index) {
         indices.push_back(std::move(index));
     }
 
-    std::unique_ptr<AST> clone() override {
-        auto access =
-            std::make_unique<ArrayAccess>(line, column, array->clone());
-        for (auto &idx : indices) {
-            access->add_index(idx->clone());
-        }
-        return access;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<ArrayAccess>(*this);
     }
 
    public:
-    std::unique_ptr<AST> array;
-    std::vector<std::unique_ptr<AST>> indices;
+    CowPtr<AST> array;
+    SmallVector<CowPtr<AST>, 1> indices;
 };
 
 class StructAccess : public AST {
    public:
-    StructAccess(uint32_t line, uint32_t column, std::unique_ptr<AST> struc,
+    StructAccess(SourceLocation location, std::unique_ptr<AST> struc,
                  std::unique_ptr<Identifier> member, bool through_pointer)
-        : AST(line, column),
+        : AST(KIND, location),
+          through_pointer(through_pointer),
           struc(std::move(struc)),
-          member(std::move(member)),
-          through_pointer(through_pointer) {
-        AST_TRACE(line << ":" << column);
+          member(std::move(member)) {
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(STRUCT_ACCESS)
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<StructAccess>(
-            line, column, struc->clone(),
-            std::make_unique<Identifier>(member->line, member->column,
-                                         member->name),
-            through_pointer);
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<StructAccess>(*this);
     }
 
    public:
     bool through_pointer;
-    std::unique_ptr<AST> struc;
-    std::unique_ptr<Identifier> member;
+    CowPtr<AST> struc;
+    CowPtr<Identifier> member;
 };
 
 class Assignment : public AST {
    public:
-    Assignment(uint32_t line, uint32_t column, std::unique_ptr<AST> left,
+    Assignment(SourceLocation location, std::unique_ptr<AST> left,
                std::unique_ptr<AST> right)
-        : AST(line, column), left(std::move(left)), right(std::move(right)) {
-        AST_TRACE(line << ":" << column);
+        : AST(KIND, location),
+          left(std::move(left)),
+          right(std::move(right)) {
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(ASSIGNMENT)
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<Assignment>(line, column, left->clone(),
-                                            right->clone());
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<Assignment>(*this);
     }
 
    public:
-    std::unique_ptr<AST> left, right;
+    CowPtr<AST> left, right;
 };
 
 class OperationAssignment : public AST {
@@ -721,17 +1015,17 @@ class OperationAssignment : public AST {
         SHIFT_RIGHT,
     };
 
-    OperationAssignment(uint32_t line, uint32_t column,
+    OperationAssignment(SourceLocation location,
                         std::unique_ptr<AST> left, std::unique_ptr<AST> right,
                         Operator op)
-        : AST(line, column),
+        : AST(KIND, location),
           left(std::move(left)),
           right(std::move(right)),
           op(op) {
-        AST_TRACE(line << ":" << column << " " << op_to_str());
+        AST_TRACE(location.get_offset() << " " << op_to_str());
     }
 
-    AST_METHODS()
+    AST_METHODS(OPERATION_ASSIGNMENT)
 
     std::string op_to_str() const {
         switch (op) {
@@ -761,7 +1055,7 @@ class OperationAssignment : public AST {
         }
     }
 
-    static OperationAssignment::Operator str_to_op(const std::string &s) {
+    static OperationAssignment::Operator str_to_op(std::string_view s) {
         if (s == "+=") {
             return Operator::PLUS;
         } else if (s == "-=") {
@@ -783,63 +1077,52 @@ class OperationAssignment : public AST {
         } else if (s == ">>=") {
             return Operator::SHIFT_RIGHT;
         }
-        die("Invalid operator: %s", s.c_str());
+        die("Invalid operator: %s", std::string(s).c_str());
         return Operator::NONE;
     }
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<OperationAssignment>(
-            line, column, left->clone(), right->clone(), op);
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<OperationAssignment>(*this);
     }
 
    public:
-    std::unique_ptr<AST> left, right;
+    CowPtr<AST> left, right;
     Operator op;
 };
 
 class ExpressionList : public AST {
    public:
-    ExpressionList(uint32_t line, uint32_t column)
-        : AST(line, column), expressions() {
-        AST_TRACE(line << ":" << column);
+    ExpressionList(SourceLocation location)
+        : AST(KIND, location), expressions() {
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(EXPRESSION_LIST)
 
     void add_expression(std::unique_ptr<AST> expression) {
         expressions.push_back(std::move(expression));
     }
 
-    std::unique_ptr<AST> clone() override {
-        auto list = std::make_unique<ExpressionList>(line, column);
-        for (auto &expr : expressions) {
-            list->add_expression(expr->clone());
-        }
-        return list;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<ExpressionList>(*this);
     }
 
    public:
-    std::vector<std::unique_ptr<AST>> expressions;
+    std::vector<CowPtr<AST>> expressions;
 };
 
 class FunctionCall : public AST {
    public:
-    FunctionCall(uint32_t line, uint32_t column,
+    FunctionCall(SourceLocation location,
                  std::unique_ptr<Identifier> name)
-        : AST(line, column), name(std::move(name)), arguments() {
-        AST_TRACE(line << ":" << column << " " << this->name->name);
+        : AST(KIND, location), name(std::move(name)), arguments() {
+        AST_TRACE(location.get_offset() << " " << this->name->name);
     }
 
-    AST_METHODS()
+    AST_METHODS(FUNCTION_CALL)
 
-    std::unique_ptr<AST> clone() override {
-        auto call = std::make_unique<FunctionCall>(
-            line, column,
-            std::make_unique<Identifier>(name->line, name->column, name->name));
-        for (auto &arg : arguments) {
-            call->add_argument(arg->clone());
-        }
-        return call;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<FunctionCall>(*this);
     }
 
     void add_argument(std::unique_ptr<AST> argument) {
@@ -847,76 +1130,159 @@ class FunctionCall : public AST {
     }
 
    public:
-    std::unique_ptr<Identifier> name;
-    std::vector<std::unique_ptr<AST>> arguments;
+    CowPtr<Identifier> name;
+    SmallVector<CowPtr<AST>, 4> arguments;
+};
+
+// Function body the parser only skipped over, see Parser::Options::lazy_bodies.
+// The copies of a function share it, so it is parsed once for all of them.
+class LazyBody {
+   public:
+    explicit LazyBody(SourceLocation location) : location(location) {
+    }
+    virtual ~LazyBody() = default;
+
+    // Parses the body on the first call, several threads may call it
+    const CowPtr<Block> &body() {
+        std::call_once(once, [this]() {
+            m_body = parse();
+            parsed.store(true, std::memory_order_release);
+        });
+        return m_body;
+    }
+
+    [[nodiscard]] bool is_parsed() const {
+        return parsed.load(std::memory_order_acquire);
+    }
+
+    // The same body not parsed yet, with its locations moved by delta bytes
+    [[nodiscard]] virtual std::unique_ptr<LazyBody> moved(
+        int64_t delta) const = 0;
+
+    // Position of the '{'
+    [[nodiscard]] SourceLocation get_location() const {
+        return location;
+    }
+
+   protected:
+    virtual CowPtr<Block> parse() = 0;
+
+    const SourceLocation location;
+
+   private:
+    std::once_flag once;
+    std::atomic<bool> parsed = false;
+    CowPtr<Block> m_body;
 };
 
 class FunctionDefinition : public Declaration {
    public:
-    FunctionDefinition(uint32_t line, uint32_t column,
+    FunctionDefinition(SourceLocation location,
                        std::unique_ptr<Identifier> fn,
                        std::unique_ptr<Block> body)
-        : Declaration(line, column, std::move(fn)),
-          AST(line, column),
-          body(std::move(body)) {
-        AST_TRACE(line << ":" << column << " " << this->name->name);
+        : Declaration(KIND, location, std::move(fn)),
+          m_body(std::move(body)) {
+        AST_TRACE(location.get_offset() << " " << this->name->name);
+    }
+
+    FunctionDefinition(SourceLocation location,
+                       std::unique_ptr<Identifier> fn,
+                       std::unique_ptr<LazyBody> lazy_body)
+        : Declaration(KIND, location, std::move(fn)),
+          lazy_body(std::move(lazy_body)) {
+        AST_TRACE(location.get_offset() << " " << this->name->name << " lazy");
     }
 
-    AST_METHODS()
+    AST_METHODS(FUNCTION_DEFINITION)
 
-    std::unique_ptr<AST> clone() override {
-        auto block = body->clone().release();
-        return std::make_unique<FunctionDefinition>(
-            line, column,
-            std::make_unique<Identifier>(name->line, name->column, name->name),
-            std::unique_ptr<Block>(dynamic_cast<Block *>(block)));
+    // A lazy body is parsed on first use
+    const Block *body() const {
+        return body_ptr().get();
+    }
+    [[nodiscard]] const CowPtr<Block> &body_ptr() const {
+        if (lazy_body) {
+            return lazy_body->body();
+        }
+        return m_body;
     }
 
-   public:
-    std::unique_ptr<Block> body;
+    [[nodiscard]] bool body_parsed() const {
+        return lazy_body == nullptr || lazy_body->is_parsed();
+    }
+
+    // The body if it was not parsed yet
+    [[nodiscard]] const LazyBody *lazy() const {
+        return body_parsed() ? nullptr : lazy_body.get();
+    }
+
+    // Replaces the body by one that is created on first use
+    void set_lazy_body(std::unique_ptr<LazyBody> body) {
+        m_body = nullptr;
+        lazy_body = std::move(body);
+    }
+
+    // The body for changing it, see CowPtr::mut
+    Block *mutable_body() {
+        return body_ptr().mut();
+    }
+
+    // The pointer to the body for replacing it
+    CowPtr<Block> &body_ptr() {
+        if (lazy_body) {
+            m_body = lazy_body->body();
+            lazy_body.reset();
+        }
+        return m_body;
+    }
+
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<FunctionDefinition>(*this);
+    }
+
+   private:
+    CowPtr<Block> m_body;
+    std::shared_ptr<LazyBody> lazy_body;
 };
 
 class FunctionDeclaration : public Declaration {
    public:
-    FunctionDeclaration(uint32_t line, uint32_t column,
+    FunctionDeclaration(SourceLocation location,
                         std::unique_ptr<Identifier> fn)
-        : Declaration(line, column, std::move(fn)), AST(line, column) {
-        AST_TRACE(line << ":" << column << " " << this->name->name);
+        : Declaration(KIND, location, std::move(fn)) {
+        AST_TRACE(location.get_offset() << " " << this->name->name);
     }
 
-    AST_METHODS()
+    AST_METHODS(FUNCTION_DECLARATION)
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<FunctionDeclaration>(
-            line, column,
-            std::make_unique<Identifier>(name->line, name->column, name->name));
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<FunctionDeclaration>(*this);
     }
 };
 
 class Program : public AST {
    public:
-    Program(uint32_t line, uint32_t column)
-        : AST(line, column), declarations() {
-        AST_TRACE(line << ":" << column);
+    Program(SourceLocation location)
+        : AST(KIND, location), declarations() {
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(PROGRAM)
 
     void add_declaration(std::unique_ptr<AST> declaration) {
         declarations.push_back(std::move(declaration));
     }
 
-    std::unique_ptr<AST> clone() override {
-        auto program = std::make_unique<Program>(line, column);
-        for (auto &decl : declarations) {
-            program->add_declaration(decl->clone());
-        }
-        return program;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<Program>(*this);
     }
 
    public:
     std::string file_location;
-    std::vector<std::unique_ptr<AST>> declarations;
+    // Has to outlive the declarations, the string constants point into it
+    std::shared_ptr<StringPool> strings;
+    // Maps the locations of the nodes to files and lines
+    std::shared_ptr<const SourceManager> sources;
+    std::vector<CowPtr<AST>> declarations;
 };
 
 class UnaryExpression : public AST {
@@ -936,15 +1302,15 @@ class UnaryExpression : public AST {
         DEC_PREFIX,
     };
 
-    UnaryExpression(uint32_t line, uint32_t column, std::unique_ptr<AST> value,
+    UnaryExpression(SourceLocation location, std::unique_ptr<AST> value,
                     Operator op)
-        : AST(line, column), value(std::move(value)), op(op) {
-        AST_TRACE(line << ":" << column << " " << op_to_str());
+        : AST(KIND, location), value(std::move(value)), op(op) {
+        AST_TRACE(location.get_offset() << " " << op_to_str());
     }
 
-    AST_METHODS()
+    AST_METHODS(UNARY_EXPRESSION)
 
-    std::string op_to_str() {
+    std::string op_to_str() const {
         switch (op) {
             case Operator::DEREFERENCE:
                 return "deref";
@@ -974,17 +1340,17 @@ class UnaryExpression : public AST {
         }
     }
 
-    static inline Operator postfix_str_to_op(const std::string &s) {
+    static inline Operator postfix_str_to_op(std::string_view s) {
         if (s == "++") {
             return Operator::INC_POSTFIX;
         } else if (s == "--") {
             return Operator::DEC_POSTFIX;
         }
-        die("Invalid operator: %s", s.c_str());
+        die("Invalid operator: %s", std::string(s).c_str());
         return Operator::NONE;
     }
 
-    static inline Operator prefix_str_to_op(const std::string &s) {
+    static inline Operator prefix_str_to_op(std::string_view s) {
         if (s == "++") {
             return Operator::INC_PREFIX;
         } else if (s == "--") {
@@ -1006,18 +1372,17 @@ class UnaryExpression : public AST {
             case '~':
                 return Operator::BITWISE_NOT;
             default:
-                die("Invalid operator: %s", s.c_str());
+                die("Invalid operator: %s", std::string(s).c_str());
                 return Operator::NONE;
         }
     }
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<UnaryExpression>(line, column, value->clone(),
-                                                 op);
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<UnaryExpression>(*this);
     }
 
    public:
-    std::unique_ptr<AST> value;
+    CowPtr<AST> value;
     Operator op;
 };
 
@@ -1045,18 +1410,18 @@ class BinaryExpression : public AST {
         SHIFT_RIGHT,
     };
 
-    BinaryExpression(uint32_t line, uint32_t column, std::unique_ptr<AST> left,
+    BinaryExpression(SourceLocation location, std::unique_ptr<AST> left,
                      std::unique_ptr<AST> right, Operator op)
-        : AST(line, column),
+        : AST(KIND, location),
           left(std::move(left)),
           right(std::move(right)),
           op(op) {
-        AST_TRACE(line << ":" << column << " " << op_to_str());
+        AST_TRACE(location.get_offset() << " " << op_to_str());
     }
 
-    AST_METHODS()
+    AST_METHODS(BINARY_EXPRESSION)
 
-    std::string op_to_str() {
+    std::string op_to_str() const {
         switch (op) {
             case Operator::PLUS:
                 return "+";
@@ -1100,7 +1465,7 @@ class BinaryExpression : public AST {
         }
     }
 
-    static inline Operator str_to_op(const std::string &s) {
+    static inline Operator str_to_op(std::string_view s) {
         if (s == "<<") {
             return Operator::SHIFT_LEFT;
         } else if (s == ">>") {
@@ -1140,175 +1505,121 @@ class BinaryExpression : public AST {
             case '^':
                 return Operator::BITWISE_XOR;
             default:
-                die("Invalid operator: %s", s.c_str());
+                die("Invalid operator: %s", std::string(s).c_str());
                 return Operator::NONE;
         }
     }
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<BinaryExpression>(line, column, left->clone(),
-                                                  right->clone(), op);
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<BinaryExpression>(*this);
     }
 
    public:
-    std::unique_ptr<AST> left, right;
+    CowPtr<AST> left, right;
     Operator op;
 };
 
 class TernaryExpression : public AST {
    public:
-    TernaryExpression(uint32_t line, uint32_t column,
+    TernaryExpression(SourceLocation location,
                       std::unique_ptr<AST> condition,
                       std::unique_ptr<AST> then_expr,
                       std::unique_ptr<AST> else_expr)
-        : AST(line, column),
+        : AST(KIND, location),
           condition(std::move(condition)),
           then_expr(std::move(then_expr)),
           else_expr(std::move(else_expr)) {
-        AST_TRACE(line << ":" << column);
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(TERNARY_EXPRESSION)
 
-    std::unique_ptr<AST> clone() override {
-        return std::make_unique<TernaryExpression>(
-            line, column, condition->clone(), then_expr->clone(),
-            else_expr->clone());
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<TernaryExpression>(*this);
     }
 
    public:
-    std::unique_ptr<AST> condition, then_expr, else_expr;
+    CowPtr<AST> condition, then_expr, else_expr;
 };
 
 class Return : public AST {
    public:
-    Return(uint32_t line, uint32_t column, std::unique_ptr<AST> value)
-        : AST(line, column), value(std::move(value)) {
-        AST_TRACE(line << ":" << column);
+    Return(SourceLocation location, std::unique_ptr<AST> value)
+        : AST(KIND, location), value(std::move(value)) {
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(RETURN)
 
-    std::unique_ptr<AST> clone() override {
-        if (value) {
-            return std::make_unique<Return>(line, column, value->clone());
-        }
-        return std::make_unique<Return>(line, column, nullptr);
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<Return>(*this);
     }
 
    public:
-    std::unique_ptr<AST> value;
+    CowPtr<AST> value;
 };
 
-class StructType : public Type, public Declaration {
+class StructType : public Type, public DeclarationData {
    public:
-    StructType(uint32_t line, uint32_t column, std::unique_ptr<Identifier> name,
+    StructType(SourceLocation location, std::unique_ptr<Identifier> name,
                bool definition)
-        : Type(line, column),
-          AST(line, column),
-          Declaration(line, column, std::move(name)),
+        : Type(KIND, location),
+          DeclarationData(std::move(name)),
           definition(definition) {
-        AST_TRACE(line << ":" << column << " " << this->name->name);
+        AST_TRACE(location.get_offset() << " " << this->name->name);
     }
 
     void add_member(std::unique_ptr<VariableDeclaration> member) {
         members.push_back(std::move(member));
     }
 
-    AST_METHODS()
-
-    virtual bool owns_type() override {
-        return false;
-    }
-
-    virtual Type *type() override {
-        return this;
-    }
+    AST_METHODS(STRUCT_TYPE)
 
-    std::unique_ptr<AST> clone() override {
-        auto struc = std::make_unique<StructType>(
-            line, column,
-            std::make_unique<Identifier>(name->line, name->column, name->name),
-            definition);
-        for (auto &member : members) {
-            struc->add_member(std::make_unique<VariableDeclaration>(
-                member->line, member->column,
-                std::make_unique<Identifier>(member->name->line,
-                                             member->name->column,
-                                             member->name->name),
-                nullptr));
-        }
-        return struc;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<StructType>(*this);
     }
 
    public:
     bool definition;
-    std::vector<std::unique_ptr<VariableDeclaration>> members;
+    std::vector<CowPtr<VariableDeclaration>> members;
 };
 
-class UnionType : public Type, public Declaration {
+class UnionType : public Type, public DeclarationData {
    public:
-    UnionType(uint32_t line, uint32_t column, std::unique_ptr<Identifier> name,
+    UnionType(SourceLocation location, std::unique_ptr<Identifier> name,
               bool definition)
-        : Type(line, column),
-          AST(line, column),
-          Declaration(line, column, std::move(name)),
+        : Type(KIND, location),
+          DeclarationData(std::move(name)),
           definition(definition) {
-        AST_TRACE(line << ":" << column << " " << this->name->name);
+        AST_TRACE(location.get_offset() << " " << this->name->name);
     }
 
     void add_member(std::unique_ptr<VariableDeclaration> member) {
         members.push_back(std::move(member));
     }
 
-    AST_METHODS()
-
-    virtual bool owns_type() override {
-        return false;
-    }
-
-    virtual Type *type() override {
-        return this;
-    }
+    AST_METHODS(UNION_TYPE)
 
-    std::unique_ptr<AST> clone() override {
-        auto union_type = std::make_unique<UnionType>(
-            line, column,
-            std::make_unique<Identifier>(name->line, name->column, name->name),
-            definition);
-        for (auto &member : members) {
-            union_type->add_member(std::make_unique<VariableDeclaration>(
-                member->line, member->column,
-                std::make_unique<Identifier>(member->name->line,
-                                             member->name->column,
-                                             member->name->name),
-                nullptr));
-        }
-        return union_type;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<UnionType>(*this);
     }
 
    public:
     bool definition;
-    std::vector<std::unique_ptr<VariableDeclaration>> members;
+    std::vector<CowPtr<VariableDeclaration>> members;
 };
 
 class EnumValue : public AST {
    public:
-    EnumValue(uint32_t line, uint32_t column, std::unique_ptr<Identifier> name)
-        : AST(line, column), name(std::move(name)), value(nullptr) {
-        AST_TRACE(line << ":" << column << " " << this->name->name);
+    EnumValue(SourceLocation location, std::unique_ptr<Identifier> name)
+        : AST(KIND, location), name(std::move(name)), value(nullptr) {
+        AST_TRACE(location.get_offset() << " " << this->name->name);
     }
 
-    AST_METHODS()
+    AST_METHODS(ENUM_VALUE)
 
-    std::unique_ptr<AST> clone() override {
-        auto id =
-            std::make_unique<Identifier>(name->line, name->column, name->name);
-        auto e = std::make_unique<EnumValue>(line, column, std::move(id));
-        if (value) {
-            e->value = value->clone();
-        }
-        return e;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<EnumValue>(*this);
     }
 
     void set_value(std::unique_ptr<AST> value) {
@@ -1316,75 +1627,112 @@ class EnumValue : public AST {
     }
 
    public:
-    std::unique_ptr<Identifier> name;
-    std::unique_ptr<AST> value;
+    CowPtr<Identifier> name;
+    CowPtr<AST> value;
 };
 
-class EnumType : public Type, public Declaration {
+class EnumType : public Type, public DeclarationData {
    public:
-    EnumType(uint32_t line, uint32_t column, std::unique_ptr<Identifier> name,
+    EnumType(SourceLocation location, std::unique_ptr<Identifier> name,
              bool definition)
-        : Type(line, column),
-          AST(line, column),
-          Declaration(line, column, std::move(name)),
+        : Type(KIND, location),
+          DeclarationData(std::move(name)),
           definition(definition) {
-        AST_TRACE(line << ":" << column << " " << this->name->name);
+        AST_TRACE(location.get_offset() << " " << this->name->name);
     }
 
     void add_value(std::unique_ptr<EnumValue> value) {
         values.push_back(std::move(value));
     }
 
-    AST_METHODS()
-
-    virtual bool owns_type() override {
-        return false;
-    }
-
-    virtual Type *type() override {
-        return this;
-    }
+    AST_METHODS(ENUM_TYPE)
 
-    std::unique_ptr<AST> clone() override {
-        auto enum_type = std::make_unique<EnumType>(
-            line, column,
-            std::make_unique<Identifier>(name->line, name->column, name->name),
-            definition);
-        for (auto &value : values) {
-            auto val = value->clone().release();
-            auto val_ptr =
-                std::unique_ptr<EnumValue>(dynamic_cast<EnumValue *>(val));
-            enum_type->add_value(std::move(val_ptr));
-        }
-        return enum_type;
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<EnumType>(*this);
     }
 
    public:
-    std::vector<std::unique_ptr<EnumValue>> values;
+    std::vector<CowPtr<EnumValue>> values;
     bool definition;
 };
 
 class TypeCast : public AST {
    public:
-    TypeCast(uint32_t line, uint32_t column, std::unique_ptr<Type> type,
+    TypeCast(SourceLocation location, std::unique_ptr<Type> type,
              std::unique_ptr<AST> value)
-        : AST(line, column), type(std::move(type)), value(std::move(value)) {
-        AST_TRACE(line << ":" << column);
+        : AST(KIND, location),
+          type(std::move(type)),
+          value(std::move(value)) {
+        AST_TRACE(location.get_offset());
     }
 
-    AST_METHODS()
+    AST_METHODS(TYPE_CAST)
 
-    std::unique_ptr<AST> clone() override {
-        auto type = this->type->clone().release();
-        return std::make_unique<TypeCast>(
-            line, column, std::unique_ptr<Type>(dynamic_cast<Type *>(type)),
-            value->clone());
+    std::unique_ptr<AST> clone() const override {
+        return std::make_unique<TypeCast>(*this);
     }
 
    public:
-    std::unique_ptr<Type> type;
-    std::unique_ptr<AST> value;
+    CowPtr<Type> type;
+    CowPtr<AST> value;
 };
 
+// The declaration part of a declaration or a struct, union or enum type
+inline DeclarationData *declaration_data(AST *node) {
+    if (node == nullptr) {
+        return nullptr;
+    }
+    switch (node->kind) {
+        case Kind::STRUCT_TYPE:
+            return static_cast<StructType *>(node);
+        case Kind::UNION_TYPE:
+            return static_cast<UnionType *>(node);
+        case Kind::ENUM_TYPE:
+            return static_cast<EnumType *>(node);
+        default:
+            return dyn_cast<Declaration>(node);
+    }
+}
+
+inline const DeclarationData *declaration_data(const AST *node) {
+    if (node == nullptr) {
+        return nullptr;
+    }
+    switch (node->kind) {
+        case Kind::STRUCT_TYPE:
+            return static_cast<const StructType *>(node);
+        case Kind::UNION_TYPE:
+            return static_cast<const UnionType *>(node);
+        case Kind::ENUM_TYPE:
+            return static_cast<const EnumType *>(node);
+        default:
+            return dyn_cast<Declaration>(node);
+    }
+}
+
+inline void ArrayInitializationList::unpack() {
+    if (!m_packed) {
+        return;
+    }
+    const PackedLiterals &packed = *m_packed;
+    m_values.reserve(packed.size());
+    SourceLocation at = location;
+    for (size_t i = 0; i < packed.size(); i++) {
+        at = at.moved(packed.gap(i));
+        std::unique_ptr<AST> value;
+        if (packed.storage() == PackedLiterals::Storage::FLOATS) {
+            value = std::make_unique<Constant>(at, packed.floating(i));
+        } else {
+            value = std::make_unique<Constant>(at, packed.integer(i));
+        }
+        if (packed.is_negative(i)) {
+            value = std::make_unique<UnaryExpression>(
+                at, std::move(value), UnaryExpression::Operator::MINUS);
+        }
+        m_values.push_back(std::move(value));
+    }
+    m_packed.reset();
+}
+
 #undef AST_METHODS
 }  // namespace CCOMP::AST
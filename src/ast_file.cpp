@@ -0,0 +1,218 @@
+#include "ast_file.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include "byte_stream.hpp"
+#include "common.hpp"
+#include "flat_ast.hpp"
+#include "visitors/locationShiftVisitor.hpp"
+
+namespace CCOMP::AST {
+
+namespace {
+
+// Body of a function definition in a section of a mapped file
+class MappedBody : public LazyBody {
+   public:
+    // delta moves the locations read from the file
+    MappedBody(SourceLocation location, std::shared_ptr<ASTFile> file,
+               size_t declaration, int64_t delta = 0)
+        : LazyBody(location),
+          file(std::move(file)),
+          declaration(declaration),
+          delta(delta) {
+    }
+
+    [[nodiscard]] std::unique_ptr<LazyBody> moved(
+        int64_t delta) const override {
+        return std::make_unique<MappedBody>(location.moved(delta), file,
+                                            declaration, this->delta + delta);
+    }
+
+   protected:
+    CowPtr<Block> parse() override {
+        CowPtr<Block> body = file->body(declaration);
+        if (delta != 0) {
+            LocationShiftVisitor(delta).shift(body);
+        }
+        return body;
+    }
+
+   private:
+    std::shared_ptr<ASTFile> file;
+    size_t declaration;
+    int64_t delta;
+};
+
+}  // namespace
+
+// The section of node, the body of a function definition is left out of it
+static void add_section(std::string &out, const AST &node,
+                        const std::shared_ptr<StringPool> &strings,
+                        uint64_t &offset, uint64_t &size) {
+    offset = out.size();
+    FlatAST::from_node(node, strings).serialize(out);
+    size = out.size() - offset;
+}
+
+void write_ast_file(const Program &program, const std::string &path) {
+    trace("Writing the binary AST to %s", path.c_str());
+    auto strings = program.strings ? program.strings
+                                   : std::make_shared<StringPool>();
+
+    ASTFile::Header header{};
+    std::memcpy(header.magic, ASTFile::MAGIC, sizeof(header.magic));
+    header.version = ASTFile::VERSION;
+    header.declarations = program.declarations.size();
+    header.location = program.location;
+
+    std::string out(sizeof(header), '\0');
+    ByteWriter writer(out);
+    header.strings_offset = out.size();
+    writer.put_string(program.file_location);
+    strings->serialize(writer);
+    header.sources_offset = out.size();
+    writer.put<bool>(program.sources != nullptr);
+    if (program.sources != nullptr) {
+        program.sources->serialize(writer);
+    }
+
+    // The table is read in place, so it is aligned
+    out.resize((out.size() + 7) / 8 * 8);
+    header.sections_offset = out.size();
+    std::vector<ASTFile::Section> sections(header.declarations);
+    out.resize(out.size() + sizeof(ASTFile::Section) * sections.size());
+
+    for (size_t i = 0; i < sections.size(); i++) {
+        const AST &declaration = *program.declarations[i];
+        auto &section = sections[i];
+        section.kind = declaration.kind;
+        section.location = declaration.location;
+
+        auto *definition = dyn_cast<FunctionDefinition>(&declaration);
+        if (definition == nullptr || definition->body() == nullptr) {
+            add_section(out, declaration, strings, section.offset,
+                        section.size);
+            continue;
+        }
+
+        // A copy without the body shares everything else with the node
+        auto head = definition->clone();
+        cast<FunctionDefinition>(head.get())->set_lazy_body(nullptr);
+        add_section(out, *head, strings, section.offset, section.size);
+        section.body_location = definition->body()->location;
+        add_section(out, *definition->body(), strings, section.body_offset,
+                    section.body_size);
+    }
+
+    std::memcpy(out.data(), &header, sizeof(header));
+    std::memcpy(out.data() + header.sections_offset, sections.data(),
+                sizeof(ASTFile::Section) * sections.size());
+    IO::write_file(path, out);
+}
+
+ASTFile::ASTFile(const std::string &path) : file(path) {
+    std::string_view data = file.data();
+    if (data.size() < sizeof(header)) {
+        die("%s is no binary AST", path.c_str());
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        die("%s is no binary AST", path.c_str());
+    }
+    if (header.version != VERSION) {
+        die("%s has version %u instead of %u", path.c_str(), header.version,
+            VERSION);
+    }
+    if (header.strings_offset > header.sources_offset ||
+        header.sources_offset > header.sections_offset ||
+        header.sections_offset % alignof(Section) != 0) {
+        die("%s is no valid binary AST", path.c_str());
+    }
+
+    uint64_t table = sizeof(Section) * header.declarations;
+    sections = reinterpret_cast<const Section *>(
+        bytes(header.sections_offset, table).data());
+}
+
+std::shared_ptr<ASTFile> ASTFile::open(const std::string &path) {
+    return std::shared_ptr<ASTFile>(new ASTFile(path));
+}
+
+const ASTFile::Section &ASTFile::section(size_t i) const {
+    if (i >= header.declarations) {
+        die("Declaration %zu of %u in binary AST", i, header.declarations);
+    }
+    return sections[i];
+}
+
+std::string_view ASTFile::bytes(uint64_t offset, uint64_t size) const {
+    std::string_view data = file.data();
+    if (offset > data.size() || size > data.size() - offset) {
+        die("Binary AST is truncated");
+    }
+    return data.substr(offset, size);
+}
+
+std::shared_ptr<StringPool> ASTFile::strings() {
+    if (m_strings == nullptr) {
+        ByteReader reader(bytes(header.strings_offset,
+                                header.sources_offset - header.strings_offset));
+        reader.get_string();
+        m_strings = std::make_shared<StringPool>();
+        m_strings->deserialize(reader);
+    }
+    return m_strings;
+}
+
+std::unique_ptr<AST> ASTFile::declaration(size_t i) {
+    const Section &s = section(i);
+    auto flat = FlatAST::deserialize(bytes(s.offset, s.size), strings(),
+                                     shared_from_this());
+    // kind() answers from the table, so it has to agree with the section
+    if (flat.root.kind() != s.kind ||
+        (s.body_size > 0 && s.kind != Kind::FUNCTION_DEFINITION)) {
+        die("Declaration %zu of the binary AST is corrupt", i);
+    }
+    auto node = flat.to_node();
+    if (s.body_size > 0) {
+        cast<FunctionDefinition>(node.get())
+            ->set_lazy_body(std::make_unique<MappedBody>(
+                s.body_location, shared_from_this(), i));
+    }
+    return node;
+}
+
+std::unique_ptr<Block> ASTFile::body(size_t i) {
+    const Section &s = section(i);
+    if (s.body_size == 0) {
+        return nullptr;
+    }
+    trace("Reading the body of declaration %zu from the binary AST", i);
+    auto flat = FlatAST::deserialize(bytes(s.body_offset, s.body_size),
+                                     strings(), shared_from_this());
+    if (flat.root.kind() != Kind::BLOCK) {
+        die("Body of declaration %zu of the binary AST is corrupt", i);
+    }
+    return unique_cast<Block>(flat.to_node());
+}
+
+std::unique_ptr<Program> ASTFile::program() {
+    auto program = std::make_unique<Program>(header.location);
+    ByteReader reader(bytes(header.strings_offset,
+                            header.sources_offset - header.strings_offset));
+    program->file_location = reader.get_string();
+    program->strings = strings();
+    ByteReader sources(bytes(header.sources_offset,
+                             header.sections_offset - header.sources_offset));
+    if (sources.get_flag()) {
+        program->sources = SourceManager::deserialize(sources);
+    }
+    for (size_t i = 0; i < size(); i++) {
+        program->add_declaration(declaration(i));
+    }
+    return program;
+}
+
+}  // namespace CCOMP::AST
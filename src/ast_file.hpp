@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "ast.hpp"
+#include "io.hpp"
+
+namespace CCOMP::AST {
+
+// Binary AST files. Every top level declaration is a section holding a
+// serialized FlatAST, and so is the body of every function definition. The
+// string literals are one table shared by the sections. All offsets are
+// relative to the start of the file. The arrays of the sections are aligned,
+// reading them leaves them in the mapping.
+//
+//     Header | file name, string literals | line table | Section[] | sections
+//
+// Types shared between top level declarations, like the one of int a, b;
+// are copied into each section.
+void write_ast_file(const Program &program, const std::string &path);
+
+// A binary AST file mapped into memory. Opening it only checks the header,
+// declarations are built when they are asked for and the function bodies
+// in them when they are first used.
+class ASTFile : public std::enable_shared_from_this<ASTFile> {
+   public:
+    static constexpr uint32_t VERSION = 4;
+
+    static std::shared_ptr<ASTFile> open(const std::string &path);
+
+    // Number of top level declarations
+    [[nodiscard]] size_t size() const {
+        return header.declarations;
+    }
+    [[nodiscard]] Kind kind(size_t i) const {
+        return section(i).kind;
+    }
+    [[nodiscard]] SourceLocation location(size_t i) const {
+        return section(i).location;
+    }
+
+    std::unique_ptr<AST> declaration(size_t i);
+    // Body of the function definition i, nullptr for other declarations
+    std::unique_ptr<Block> body(size_t i);
+    // Every declaration, with the line table of the source if the written
+    // program had one
+    std::unique_ptr<Program> program();
+
+   private:
+    friend void write_ast_file(const Program &program, const std::string &path);
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t declarations;
+        SourceLocation location;
+        uint32_t reserved;
+        uint64_t strings_offset;
+        uint64_t sources_offset;
+        uint64_t sections_offset;
+    };
+
+    struct Section {
+        uint64_t offset, size;
+        // Zero size for everything but function definitions
+        uint64_t body_offset, body_size;
+        Kind kind;
+        SourceLocation location, body_location;
+    };
+
+    static constexpr char MAGIC[8] = {'C', 'C', 'O', 'M', 'P', 'A', 'S', 'T'};
+
+    explicit ASTFile(const std::string &path);
+
+    [[nodiscard]] const Section &section(size_t i) const;
+    [[nodiscard]] std::string_view bytes(uint64_t offset, uint64_t size) const;
+    // The table is read on first use
+    std::shared_ptr<StringPool> strings();
+
+    IO::MappedFile file;
+    Header header;
+    const Section *sections;
+    std::shared_ptr<StringPool> m_strings;
+};
+
+}  // namespace CCOMP::AST
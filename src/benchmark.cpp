@@ -0,0 +1,105 @@
+#include "benchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+#include "pass_manager.hpp"
+#include "visitors/ASTBaseVisitor.hpp"
+#include "visitors/staticVisitor.hpp"
+
+namespace CCOMP::AST {
+
+namespace {
+
+class DynamicCounter : public ASTBaseVisitor {
+   public:
+#define COUNT(type, kind)                                \
+    void *visit(const type &node, void *args) override { \
+        count++;                                         \
+        return ASTBaseVisitor::visit(node, args);        \
+    }
+    AST_KINDS(COUNT)
+#undef COUNT
+
+   public:
+    size_t count = 0;
+};
+
+// Returns the count instead of keeping it in a member
+class StaticCounter : public StaticVisitor<StaticCounter, size_t> {
+   public:
+    template <typename T>
+    size_t visit(const T &node) {
+        size_t count = 1;
+        for_each_child(node,
+                       [&](const AST &child) { count += dispatch(child); });
+        return count;
+    }
+};
+
+class CountPass : public Analysis<size_t> {
+   public:
+    CountPass() : Analysis("count", PRE) {
+    }
+
+   protected:
+    void pre(const AST &, size_t, size_t &count) override {
+        count++;
+    }
+};
+
+template <typename Walk>
+static void measure(const char *name, int rounds, Walk walk) {
+    auto start = std::chrono::steady_clock::now();
+    size_t nodes = 0;
+    for (int i = 0; i < rounds; i++) {
+        nodes += walk();
+    }
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    fprintf(stderr, "%-8s %12zu %10.3f %12.2f\n", name, nodes / rounds,
+            time.count() * 1e3 / rounds, nodes / time.count() / 1e6);
+}
+
+}  // namespace
+
+void benchmark_visitors(Program &program, int rounds) {
+    // Parses the lazy bodies before measuring
+    StaticCounter().dispatch(program);
+
+    fprintf(stderr, "%-8s %12s %10s %12s\n", "visitor", "nodes", "time ms",
+            "Mnodes/s");
+    measure("virtual", rounds, [&]() {
+        DynamicCounter counter;
+        program.accept(counter, nullptr);
+        return counter.count;
+    });
+    measure("static", rounds,
+            [&]() { return StaticCounter().dispatch(program); });
+}
+
+void benchmark_passes(Program &program, ThreadPool &pool, int rounds) {
+    // Four fused counters, every round with a new manager so nothing is
+    // cached
+    auto count = [&](ThreadPool *threads) {
+        PassManager passes(threads);
+        auto &counter = passes.add<CountPass>();
+        for (int i = 0; i < 3; i++) {
+            passes.add<CountPass>();
+        }
+        passes.run(program);
+        size_t nodes = 0;
+        for (auto &declaration : program.declarations) {
+            nodes += *counter.result(declaration.get());
+        }
+        return nodes;
+    };
+    count(nullptr);
+
+    fprintf(stderr, "%-8s %12s %10s %12s\n", "passes", "nodes", "time ms",
+            "Mnodes/s");
+    measure("serial", rounds, [&]() { return count(nullptr); });
+    measure("parallel", rounds, [&]() { return count(&pool); });
+}
+
+}  // namespace CCOMP::AST
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ast.hpp"
+#include "thread_pool.hpp"
+
+namespace CCOMP::AST {
+
+// Walks the tree rounds times with an ASTBaseVisitor and with a
+// StaticVisitor and prints the throughput of both to stderr
+void benchmark_visitors(Program &program, int rounds = 20);
+
+// Runs four node counting analyses with a PassManager on the calling thread
+// and on pool and prints the throughput of both to stderr
+void benchmark_passes(Program &program, ThreadPool &pool, int rounds = 20);
+
+}  // namespace CCOMP::AST
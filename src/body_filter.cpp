@@ -0,0 +1,91 @@
+#include "body_filter.hpp"
+
+#include "common.hpp"
+
+namespace CCOMP::Parser {
+
+LazyBodyFilter::LazyBodyFilter(antlr4::Lexer &lexer, BodyTokens tokens)
+    : lexer(lexer), tokens(tokens) {
+}
+
+std::unique_ptr<antlr4::Token> LazyBodyFilter::nextToken() {
+    if (pending) {
+        return std::move(pending);
+    }
+
+    auto token = lexer.nextToken();
+    size_t type = token->getType();
+
+    if (type == tokens.lparen) {
+        paren_depth++;
+    } else if (type == tokens.rparen) {
+        paren_depth--;
+    }
+
+    // Struct bodies and initializers
+    if (brace_depth > 0) {
+        if (type == tokens.lbrace) {
+            brace_depth++;
+        } else if (type == tokens.rbrace && --brace_depth == 0) {
+            last = type;
+        }
+        return token;
+    }
+
+    // Attributes and assembly do not count as last token
+    if (extension_depth >= 0) {
+        if (type == tokens.rparen && paren_depth == extension_depth) {
+            extension_depth = -1;
+        }
+        return token;
+    }
+    if (type == tokens.attribute || type == tokens.assembly) {
+        extension_depth = paren_depth;
+        return token;
+    }
+
+    if (type == tokens.lbrace) {
+        if (paren_depth == 0 && !in_initializer && last == tokens.rparen) {
+            return skip_body(std::move(token));
+        }
+        brace_depth++;
+    } else if (paren_depth == 0 && type == tokens.equal) {
+        in_initializer = true;
+    } else if (paren_depth == 0 && type == tokens.semicolon) {
+        in_initializer = false;
+    }
+    last = type;
+    return token;
+}
+
+std::unique_ptr<antlr4::Token> LazyBodyFilter::skip_body(
+    std::unique_ptr<antlr4::Token> lbrace) {
+    size_t stop = lbrace->getStopIndex();
+    int depth = 1;
+    while (depth > 0) {
+        auto token = lexer.nextToken();
+        size_t type = token->getType();
+        if (type == antlr4::Token::EOF) {
+            // The parser reports the missing '}' when the body is parsed
+            pending = std::move(token);
+            break;
+        }
+        if (type == tokens.lbrace) {
+            depth++;
+        } else if (type == tokens.rbrace) {
+            depth--;
+        }
+        stop = token->getStopIndex();
+    }
+
+    trace("Skipped function body at line %zu", lbrace->getLine());
+
+    last = tokens.rbrace;
+    in_initializer = false;
+    return lexer.getTokenFactory()->create(
+        {this, lexer.getInputStream()}, tokens.lazy_body, "",
+        antlr4::Token::DEFAULT_CHANNEL, lbrace->getStartIndex(), stop,
+        lbrace->getLine(), lbrace->getCharPositionInLine());
+}
+
+}  // namespace CCOMP::Parser
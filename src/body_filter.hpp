@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+
+#include "Lexer.h"
+#include "TokenSource.h"
+
+namespace CCOMP::Parser {
+
+// Tokens of the grammar the filter has to know about
+struct BodyTokens {
+    size_t lparen, rparen, lbrace, rbrace, semicolon, equal;
+    size_t attribute, assembly;
+    size_t lazy_body;
+};
+
+// Sits between lexer and token stream and replaces the body of every top
+// level function definition by a single lazy_body token spanning from its
+// '{' to the matching '}'. The parser never sees the tokens inside.
+//
+// A '{' at brace depth zero starts a function body if the last token in
+// front of it, ignoring attributes and assembly, is a ')' and it is not part
+// of an initializer.
+class LazyBodyFilter : public antlr4::TokenSource {
+   public:
+    LazyBodyFilter(antlr4::Lexer &lexer, BodyTokens tokens);
+
+    std::unique_ptr<antlr4::Token> nextToken() override;
+
+    size_t getLine() const override {
+        return lexer.getLine();
+    }
+    size_t getCharPositionInLine() override {
+        return lexer.getCharPositionInLine();
+    }
+    antlr4::CharStream *getInputStream() override {
+        return lexer.getInputStream();
+    }
+    std::string getSourceName() override {
+        return lexer.getSourceName();
+    }
+    antlr4::TokenFactory<antlr4::CommonToken> *getTokenFactory() override {
+        return lexer.getTokenFactory();
+    }
+
+   private:
+    std::unique_ptr<antlr4::Token> skip_body(
+        std::unique_ptr<antlr4::Token> lbrace);
+
+    antlr4::Lexer &lexer;
+    BodyTokens tokens;
+
+    // Token read by skip_body behind an unterminated body
+    std::unique_ptr<antlr4::Token> pending;
+
+    int brace_depth = 0;
+    int paren_depth = 0;
+
+    // Paren depth in front of the attribute or assembly being read, -1 outside
+    int extension_depth = -1;
+
+    bool in_initializer = false;
+    size_t last = 0;
+};
+
+}  // namespace CCOMP::Parser
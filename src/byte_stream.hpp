@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "common.hpp"
+#include "shared_array.hpp"
+
+namespace CCOMP {
+
+// Appends values in their in memory representation to a buffer
+class ByteWriter {
+   public:
+    explicit ByteWriter(std::string &out) : out(out) {
+    }
+
+    template <typename T>
+    void put(const T &value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    // The element size is written as well, so a reader built with another
+    // layout notices it
+    template <typename T>
+    void put_array(const std::vector<T> &array) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        put<uint32_t>(sizeof(T));
+        put<uint32_t>(array.size());
+        if (!array.empty()) {
+            out.append(reinterpret_cast<const char *>(array.data()),
+                       sizeof(T) * array.size());
+        }
+    }
+
+    // Like put_array, with the elements aligned for their type relative to
+    // the start of out, so a reader can use them in place
+    template <typename T>
+    void put_aligned_array(const T *data, size_t size) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        put<uint32_t>(sizeof(T));
+        put<uint32_t>(size);
+        size_t padding =
+            (alignof(T) - (out.size() + 1) % alignof(T)) % alignof(T);
+        put<uint8_t>(padding);
+        out.append(padding, '\0');
+        if (size > 0) {
+            out.append(reinterpret_cast<const char *>(data), sizeof(T) * size);
+        }
+    }
+    template <typename Array>
+    void put_aligned_array(const Array &array) {
+        put_aligned_array(array.data(), array.size());
+    }
+
+    void put_string(std::string_view s) {
+        put<uint32_t>(s.size());
+        out.append(s);
+    }
+
+    [[nodiscard]] size_t position() const {
+        return out.size();
+    }
+
+   private:
+    std::string &out;
+};
+
+// Reads what a ByteWriter wrote. Reading past the end is fatal.
+class ByteReader {
+   public:
+    explicit ByteReader(std::string_view data) : data(data) {
+    }
+
+    // Bools are read with get_flag
+    template <typename T>
+    T get() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        static_assert(!std::is_same_v<T, bool>);
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    // Loading a bool that is neither 0 nor 1 is undefined, so its byte is
+    // read and checked instead
+    bool get_flag() {
+        auto byte = get<uint8_t>();
+        if (byte > 1) {
+            die("Invalid binary data");
+        }
+        return byte == 1;
+    }
+
+    template <typename T>
+    void get_array(std::vector<T> &array) {
+        if (get<uint32_t>() != sizeof(T)) {
+            die("Binary data was written with another layout");
+        }
+        uint32_t count = get<uint32_t>();
+        const char *bytes = take(sizeof(T) * count);
+        array.resize(count);
+        if (count > 0) {
+            std::memcpy(array.data(), bytes, sizeof(T) * count);
+        }
+    }
+
+    // Reads what put_aligned_array wrote. The elements stay in the data if
+    // owner keeps it alive and they are aligned, else they are copied.
+    template <typename T>
+    SharedArray<T> get_aligned_array(const std::shared_ptr<const void> &owner) {
+        if (get<uint32_t>() != sizeof(T)) {
+            die("Binary data was written with another layout");
+        }
+        uint32_t count = get<uint32_t>();
+        take(get<uint8_t>());
+        const char *bytes = take(sizeof(T) * count);
+        if (owner != nullptr &&
+            reinterpret_cast<uintptr_t>(bytes) % alignof(T) == 0) {
+            return {reinterpret_cast<const T *>(bytes), count, owner};
+        }
+        SharedArray<T> array;
+        auto &elements = array.mutate();
+        elements.resize(count);
+        if (count > 0) {
+            std::memcpy(elements.data(), bytes, sizeof(T) * count);
+        }
+        return array;
+    }
+
+    // Points into the data
+    std::string_view get_string() {
+        uint32_t size = get<uint32_t>();
+        return {take(size), size};
+    }
+
+   private:
+    const char *take(size_t size) {
+        if (data.size() - position < size) {
+            die("Binary data is truncated");
+        }
+        const char *bytes = data.data() + position;
+        position += size;
+        return bytes;
+    }
+
+    std::string_view data;
+    size_t position = 0;
+};
+
+}  // namespace CCOMP
@@ -0,0 +1,123 @@
+#include "error_strategy.hpp"
+
+#include <cstdio>
+
+#include "InputMismatchException.h"
+#include "Parser.h"
+#include "common.hpp"
+
+namespace CCOMP::Parser {
+
+PanicErrorStrategy::PanicErrorStrategy(PanicPoints points,
+                                       std::function<void()> on_resync)
+    : points(points), on_resync(std::move(on_resync)) {
+}
+
+void PanicErrorStrategy::recover(antlr4::Parser *recognizer,
+                                 std::exception_ptr e) {
+    auto *ctx = recognizer->getContext();
+    size_t rule = ctx->getRuleIndex();
+
+    if (rule == points.program_rule) {
+        // Nothing left to resynchronize at
+        auto *stream = recognizer->getTokenStream();
+        while (stream->LA(1) != antlr4::Token::EOF) {
+            recognizer->consume();
+        }
+        return;
+    }
+
+    // Every rule catches the exception, rethrowing it unwinds one rule at a
+    // time. reportError is silent while in error recovery mode, so only the
+    // innermost rule reports.
+    if (rule != points.declaration_rule) {
+        std::rethrow_exception(e);
+    }
+
+    skip_declaration(recognizer, ctx->start->getTokenIndex());
+    endErrorCondition(recognizer);
+}
+
+antlr4::Token *PanicErrorStrategy::recoverInline(antlr4::Parser *recognizer) {
+    // No single token insertion or deletion
+    throw antlr4::InputMismatchException(recognizer);
+}
+
+void PanicErrorStrategy::sync(antlr4::Parser *recognizer) {
+    // Below the top level a wrong token makes the prediction fail, which is
+    // handled by recover
+    if (recognizer->getContext()->getRuleIndex() != points.program_rule) {
+        return;
+    }
+
+    auto *stream = recognizer->getTokenStream();
+    while (true) {
+        size_t type = stream->LA(1);
+        if (type == antlr4::Token::EOF ||
+            recognizer->getExpectedTokens().contains(type)) {
+            return;
+        }
+        reportUnwantedToken(recognizer);
+        skip_declaration(recognizer, stream->index());
+        endErrorCondition(recognizer);
+    }
+}
+
+// Skips to the end of the declaration starting at token start: a ';' outside
+// of braces or the '}' closing the outermost brace
+void PanicErrorStrategy::skip_declaration(antlr4::Parser *recognizer,
+                                          size_t start) {
+    auto *stream = recognizer->getTokenStream();
+
+    int depth = 0;
+    for (size_t i = start; i < stream->index(); i++) {
+        size_t type = stream->get(i)->getType();
+        if (type == points.lbrace) {
+            depth++;
+        } else if (type == points.rbrace) {
+            depth--;
+        }
+    }
+
+    trace("Skipping broken declaration at line %zu",
+          stream->LT(1)->getLine());
+
+    while (true) {
+        size_t type = stream->LA(1);
+        if (type == antlr4::Token::EOF) {
+            break;
+        }
+        recognizer->consume();
+
+        if (type == points.semicolon && depth <= 0) {
+            break;
+        }
+        if (type == points.lbrace) {
+            depth++;
+        } else if (type == points.rbrace && --depth <= 0) {
+            break;
+        }
+    }
+
+    if (on_resync) {
+        on_resync();
+    }
+}
+
+PresumedErrorListener::PresumedErrorListener(
+    std::shared_ptr<const CCOMP::SourceManager> sources)
+    : sources(std::move(sources)) {
+}
+
+void PresumedErrorListener::syntaxError(antlr4::Recognizer * /*recognizer*/,
+                                        antlr4::Token * /*offending_symbol*/,
+                                        size_t line, size_t column,
+                                        const std::string &message,
+                                        std::exception_ptr /*e*/) {
+    auto presumed = sources->presumed_line(line);
+    // ANTLR counts columns from 0
+    fprintf(stderr, "%.*s:%u:%zu: error: %s\n", (int)presumed.file.size(),
+            presumed.file.data(), presumed.line, column + 1, message.c_str());
+}
+
+}  // namespace CCOMP::Parser
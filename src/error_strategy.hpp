@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "BaseErrorListener.h"
+#include "DefaultErrorStrategy.h"
+#include "source_manager.hpp"
+
+namespace CCOMP::Parser {
+
+// Rules and tokens of the grammar the strategy has to know about
+struct PanicPoints {
+    size_t program_rule, declaration_rule;
+    size_t semicolon, lbrace, rbrace;
+};
+
+// Panic mode error recovery. Instead of repairing the input token by token
+// like the DefaultErrorStrategy, an error unwinds to the enclosing top level
+// declaration, which is skipped up to its ';' or its closing '}'. Every
+// broken declaration gets one diagnostic and costs time linear in its length.
+class PanicErrorStrategy : public antlr4::DefaultErrorStrategy {
+   public:
+    // on_resync runs after every skipped declaration, e.g. to leave the scopes
+    // entered by the broken one
+    PanicErrorStrategy(PanicPoints points, std::function<void()> on_resync);
+
+    void recover(antlr4::Parser *recognizer, std::exception_ptr e) override;
+
+    antlr4::Token *recoverInline(antlr4::Parser *recognizer) override;
+
+    void sync(antlr4::Parser *recognizer) override;
+
+   private:
+    void skip_declaration(antlr4::Parser *recognizer, size_t start);
+
+    PanicPoints points;
+    std::function<void()> on_resync;
+};
+
+// Prints syntax errors as "file:line:column: error: message", with the line
+// taken from the line markers of the preprocessed source instead of the line
+// in the buffer ANTLR counts
+class PresumedErrorListener : public antlr4::BaseErrorListener {
+   public:
+    explicit PresumedErrorListener(
+        std::shared_ptr<const CCOMP::SourceManager> sources);
+
+    void syntaxError(antlr4::Recognizer *recognizer,
+                     antlr4::Token *offending_symbol, size_t line,
+                     size_t column, const std::string &message,
+                     std::exception_ptr e) override;
+
+   private:
+    std::shared_ptr<const CCOMP::SourceManager> sources;
+};
+
+}  // namespace CCOMP::Parser
@@ -0,0 +1,1395 @@
+#include "flat_ast.hpp"
+
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "byte_stream.hpp"
+#include "common.hpp"
+#include "traversal.hpp"
+#include "visitors/staticVisitor.hpp"
+
+namespace CCOMP::AST {
+
+namespace {
+
+// Results of the finished children of the nodes on the stack of a walk. A
+// node takes the results of its children when it is finished, mostly in the
+// order they were finished in, so finding one is a step of the cursor.
+template <typename Key, typename Result>
+class FinishedChildren {
+   public:
+    // At the PRE event of a node
+    void enter() {
+        starts.push_back(results.size());
+    }
+    // At the POST event of a node, before it takes its children
+    void leave() {
+        begin = next = starts.back();
+        starts.pop_back();
+    }
+
+    // Moves the result of child to out. False if the walk did not visit
+    // child below the node, like a type an identifier borrows.
+    bool take(Key child, Result &out) {
+        size_t size = results.size() - begin;
+        for (size_t i = 0; i < size; i++) {
+            size_t at = begin + (next - begin + i) % size;
+            if (results[at].first == child) {
+                out = std::move(results[at].second);
+                next = at + 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Replaces the results of the children of the node by its own
+    void finish(Key node, Result result) {
+        results.resize(begin);
+        results.emplace_back(node, std::move(result));
+    }
+
+    // After the POST event of the root
+    Result root() {
+        return std::move(results.back().second);
+    }
+
+   private:
+    std::vector<std::pair<Key, Result>> results;
+    // Where the children of each node on the stack begin in results
+    std::vector<size_t> starts;
+    // Children of the node being finished
+    size_t begin = 0, next = 0;
+};
+
+// Appends every node of the tree to the arrays of a FlatAST. Children are
+// converted before their parent, so each list can be appended in one piece.
+// The tree is walked with a Traversal, so deep expressions need no stack
+// frame per level.
+class FlatBuilder : public StaticVisitor<FlatBuilder, NodeId> {
+   public:
+    explicit FlatBuilder(FlatAST &flat) : flat(flat) {
+    }
+
+    // A node the walk did not reach, like a borrowed type that is copied, is
+    // converted by a walk of its own
+    NodeId convert(const AST *node) {
+        if (node == nullptr) {
+            return {};
+        }
+        NodeId id;
+        if (finished != nullptr && finished->take(node, id)) {
+            return id;
+        }
+        return convert_tree(*node);
+    }
+
+    // Any list of CowPtrs
+    template <typename List>
+    Range convert_list(const List &nodes) {
+        std::vector<NodeId> ids;
+        ids.reserve(nodes.size());
+        for (auto &node : nodes) {
+            ids.push_back(convert(node.get()));
+        }
+        return flat.add_list(ids);
+    }
+
+    // A type that belongs to another node is only converted once
+    NodeId convert_type(const Type *type, bool &owned) {
+        auto found = types.find(type);
+        if (!owned && found != types.end()) {
+            return found->second;
+        }
+        owned = true;
+        return convert(type);
+    }
+
+    NodeId visit(const Program &node) {
+        auto n = make<Flat::Program>(node);
+        n.file_location = flat.names.intern(node.file_location);
+        n.declarations = convert_list(node.declarations);
+        return flat.add(n);
+    }
+    NodeId visit(const Block &node) {
+        auto n = make<Flat::Block>(node);
+        n.statements = convert_list(node.statements);
+        return flat.add(n);
+    }
+    NodeId visit(const SwitchBlock &node) {
+        auto n = make<Flat::SwitchBlock>(node);
+        n.statements = convert_list(node.statements);
+        n.label = convert(node.label.get());
+        n.is_default = node.is_default;
+        n.break_after = node.break_after;
+        return flat.add(n);
+    }
+    NodeId visit(const Switch &node) {
+        auto n = make<Flat::Switch>(node);
+        n.condition = convert(node.condition.get());
+        n.switch_blocks = convert_list(node.switch_blocks);
+        return flat.add(n);
+    }
+    NodeId visit(const If &node) {
+        auto n = make<Flat::If>(node);
+        n.condition = convert(node.condition.get());
+        n.then_block = convert(node.then_block.get());
+        n.else_block = convert(node.else_block.get());
+        return flat.add(n);
+    }
+    NodeId visit(const For &node) {
+        auto n = make<Flat::For>(node);
+        n.init = convert(node.init.get());
+        n.increment = convert(node.increment.get());
+        n.condition = convert(node.condition.get());
+        n.body = convert(node.body.get());
+        return flat.add(n);
+    }
+    NodeId visit(const While &node) {
+        auto n = make<Flat::While>(node);
+        n.condition = convert(node.condition.get());
+        n.body = convert(node.body.get());
+        return flat.add(n);
+    }
+    NodeId visit(const DoWhile &node) {
+        auto n = make<Flat::DoWhile>(node);
+        n.condition = convert(node.condition.get());
+        n.body = convert(node.body.get());
+        return flat.add(n);
+    }
+    NodeId visit(const Attribute &node) {
+        auto n = make<Flat::Attribute>(node);
+        n.name = flat.names.intern(node.name);
+        return flat.add(n);
+    }
+    NodeId visit(const Assembly &node) {
+        auto n = make<Flat::Assembly>(node);
+        n.assembly = {(uint32_t)flat.string_ids.size(),
+                      (uint32_t)node.assembly.size()};
+        for (auto &line : node.assembly) {
+            flat.string_ids.push_back(flat.names.intern(line));
+        }
+        return flat.add(n);
+    }
+    NodeId visit(const Constant &node) {
+        auto n = make<Flat::Constant>(node);
+        n.literal_kind = node.literal_kind;
+        switch (node.literal_kind) {
+            case Constant::LiteralKind::INTEGER:
+                n.integer = node.integer;
+                break;
+            case Constant::LiteralKind::FLOAT:
+                n.floating = node.floating;
+                break;
+            case Constant::LiteralKind::STRING:
+                n.string_id = node.string_id;
+                break;
+        }
+        return flat.add(n);
+    }
+    NodeId visit(const Identifier &node) {
+        auto n = make<Flat::Identifier>(node);
+        n.name = flat.names.intern(node.name);
+        n.owns_type = node.owns_type();
+        if (node.type()) {
+            n.type = convert_type(node.type(), n.owns_type);
+        }
+        return flat.add(n);
+    }
+    NodeId visit(const NamedType &node) {
+        auto n = make<Flat::NamedType>(node);
+        type_info(n, node);
+        n.name = flat.names.intern(node.name);
+        return add_type(node, n);
+    }
+    NodeId visit(const FunctionType &node) {
+        auto n = make<Flat::FunctionType>(node);
+        type_info(n, node);
+        n.varargs = node.varargs;
+        n.return_type = convert(node.return_type.get());
+        n.parameters = convert_list(node.parameters);
+        return add_type(node, n);
+    }
+    NodeId visit(const PrimitiveType &node) {
+        auto n = make<Flat::PrimitiveType>(node);
+        type_info(n, node);
+        n.keywords = {(uint32_t)flat.keywords.size(),
+                      (uint32_t)node.keywords.size()};
+        auto &keywords = flat.keywords.mutate();
+        keywords.insert(keywords.end(), node.keywords.begin(),
+                        node.keywords.end());
+        return add_type(node, n);
+    }
+    NodeId visit(const TypeDef &node) {
+        auto n = make<Flat::TypeDef>(node);
+        declaration_info(n, node, node.m_type.get());
+        return flat.add(n);
+    }
+    NodeId visit(const VariableDeclaration &node) {
+        auto n = make<Flat::VariableDeclaration>(node);
+        declaration_info(n, node, node.m_type.get());
+        n.value = convert(node.value.get());
+        n.global = node.global;
+        return flat.add(n);
+    }
+    NodeId visit(const ArrayInitializationList &node) {
+        auto n = make<Flat::ArrayInitializationList>(node);
+        if (node.packed()) {
+            n.packed = flat.packed.size();
+            flat.packed.push_back(node.packed());
+        } else {
+            n.values = convert_list(node.values());
+        }
+        return flat.add(n);
+    }
+    NodeId visit(const ArrayAccess &node) {
+        auto n = make<Flat::ArrayAccess>(node);
+        n.array = convert(node.array.get());
+        n.indices = convert_list(node.indices);
+        return flat.add(n);
+    }
+    NodeId visit(const StructAccess &node) {
+        auto n = make<Flat::StructAccess>(node);
+        n.through_pointer = node.through_pointer;
+        n.struc = convert(node.struc.get());
+        n.member = convert(node.member.get());
+        return flat.add(n);
+    }
+    NodeId visit(const Assignment &node) {
+        auto n = make<Flat::Assignment>(node);
+        n.left = convert(node.left.get());
+        n.right = convert(node.right.get());
+        return flat.add(n);
+    }
+    NodeId visit(const OperationAssignment &node) {
+        auto n = make<Flat::OperationAssignment>(node);
+        n.left = convert(node.left.get());
+        n.right = convert(node.right.get());
+        n.op = node.op;
+        return flat.add(n);
+    }
+    NodeId visit(const ExpressionList &node) {
+        auto n = make<Flat::ExpressionList>(node);
+        n.expressions = convert_list(node.expressions);
+        return flat.add(n);
+    }
+    NodeId visit(const FunctionCall &node) {
+        auto n = make<Flat::FunctionCall>(node);
+        n.name = convert(node.name.get());
+        n.arguments = convert_list(node.arguments);
+        return flat.add(n);
+    }
+    NodeId visit(const FunctionDefinition &node) {
+        auto n = make<Flat::FunctionDefinition>(node);
+        declaration_info(n, node, node.m_type.get());
+        n.body = convert(node.body());
+        return flat.add(n);
+    }
+    NodeId visit(const FunctionDeclaration &node) {
+        auto n = make<Flat::FunctionDeclaration>(node);
+        declaration_info(n, node, node.m_type.get());
+        return flat.add(n);
+    }
+    NodeId visit(const UnaryExpression &node) {
+        auto n = make<Flat::UnaryExpression>(node);
+        n.value = convert(node.value.get());
+        n.op = node.op;
+        return flat.add(n);
+    }
+    NodeId visit(const BinaryExpression &node) {
+        auto n = make<Flat::BinaryExpression>(node);
+        n.left = convert(node.left.get());
+        n.right = convert(node.right.get());
+        n.op = node.op;
+        return flat.add(n);
+    }
+    NodeId visit(const TernaryExpression &node) {
+        auto n = make<Flat::TernaryExpression>(node);
+        n.condition = convert(node.condition.get());
+        n.then_expr = convert(node.then_expr.get());
+        n.else_expr = convert(node.else_expr.get());
+        return flat.add(n);
+    }
+    NodeId visit(const Return &node) {
+        auto n = make<Flat::Return>(node);
+        n.value = convert(node.value.get());
+        return flat.add(n);
+    }
+    NodeId visit(const StructType &node) {
+        auto n = make<Flat::StructType>(node);
+        type_info(n, node);
+        declaration_info(n, node);
+        n.definition = node.definition;
+        n.members = convert_list(node.members);
+        return add_type(node, n);
+    }
+    NodeId visit(const UnionType &node) {
+        auto n = make<Flat::UnionType>(node);
+        type_info(n, node);
+        declaration_info(n, node);
+        n.definition = node.definition;
+        n.members = convert_list(node.members);
+        return add_type(node, n);
+    }
+    NodeId visit(const EnumValue &node) {
+        auto n = make<Flat::EnumValue>(node);
+        n.name = convert(node.name.get());
+        n.value = convert(node.value.get());
+        return flat.add(n);
+    }
+    NodeId visit(const EnumType &node) {
+        auto n = make<Flat::EnumType>(node);
+        type_info(n, node);
+        declaration_info(n, node);
+        n.definition = node.definition;
+        n.values = convert_list(node.values);
+        return add_type(node, n);
+    }
+    NodeId visit(const TypeCast &node) {
+        auto n = make<Flat::TypeCast>(node);
+        n.type = convert(node.type.get());
+        n.value = convert(node.value.get());
+        return flat.add(n);
+    }
+
+   private:
+    // A flat node with every field zeroed but the location
+    template <typename T>
+    static T make(const AST &node) {
+        T n{};
+        n.location = node.location;
+        return n;
+    }
+
+    void type_info(Flat::TypeInfo &info, const Type &type) {
+        info.pointer_count = type.pointer_count;
+        info.is_const = type.is_const;
+        info.is_restrict = type.is_restrict;
+        info.array_sizes = convert_list(type.array_sizes);
+    }
+
+    // Struct, union and enum types have no separate type
+    void declaration_info(Flat::DeclarationInfo &info,
+                          const DeclarationData &declaration,
+                          const Type *type = nullptr) {
+        // The type first, so a name referring to it finds it
+        info.type = convert(type);
+        info.name = convert(declaration.name.get());
+        info.is_public = declaration.is_public;
+        info.attributes = convert_list(declaration.attributes);
+        info.assembly = convert_list(declaration.assembly);
+    }
+
+    template <typename T>
+    NodeId add_type(const Type &type, const T &node) {
+        NodeId id = flat.add(node);
+        types.emplace(&type, id);
+        return id;
+    }
+
+    NodeId convert_tree(const AST &root) {
+        FinishedChildren<const AST *, NodeId> children;
+        auto *outer = std::exchange(finished, &children);
+        Traversal walk(root);
+        Traversal::Event event;
+        while (walk.next(event)) {
+            if (event.order == Traversal::Order::PRE) {
+                children.enter();
+                // convert_type decides whether a borrowed type is copied
+                auto *identifier = dyn_cast<Identifier>(event.node);
+                if (identifier != nullptr && !identifier->owns_type()) {
+                    walk.skip_children();
+                }
+                continue;
+            }
+            children.leave();
+            children.finish(event.node, dispatch(*event.node));
+        }
+        finished = outer;
+        return children.root();
+    }
+
+    FlatAST &flat;
+    std::unordered_map<const Type *, NodeId> types;
+    // Of the innermost walk
+    FinishedChildren<const AST *, NodeId> *finished = nullptr;
+};
+
+// Inverse of FlatBuilder. The nodes are walked with an explicit stack as
+// well, each one is built from its finished children.
+class TreeBuilder {
+   public:
+    explicit TreeBuilder(const FlatAST &flat) : flat(flat) {
+    }
+
+    template <typename T>
+    std::unique_ptr<T> build_as(NodeId id) {
+        return unique_cast<T>(build(id));
+    }
+
+    // A borrowed type is no child in the flat AST, its copy is built by a
+    // walk of its own
+    std::unique_ptr<AST> build(NodeId id) {
+        if (!id) {
+            return nullptr;
+        }
+        std::unique_ptr<AST> node;
+        if (finished != nullptr && finished->take(id, node)) {
+            return node;
+        }
+        return build_tree(id);
+    }
+
+   private:
+    std::unique_ptr<AST> build_tree(NodeId root) {
+        FinishedChildren<NodeId, std::unique_ptr<AST>> children;
+        auto *outer = std::exchange(finished, &children);
+        std::vector<std::pair<NodeId, bool>> pending{{root, false}};
+        std::vector<NodeId> next;
+        while (!pending.empty()) {
+            auto [id, leaving] = pending.back();
+            pending.pop_back();
+            if (leaving) {
+                children.leave();
+                children.finish(id, build_node(id));
+                continue;
+            }
+            children.enter();
+            pending.push_back({id, true});
+            next.clear();
+            flat.children_of(id, next);
+            for (auto child = next.rbegin(); child != next.rend(); child++) {
+                pending.push_back({*child, false});
+            }
+        }
+        finished = outer;
+        return children.root();
+    }
+
+    // Builds one node, its children are finished already
+    std::unique_ptr<AST> build_node(NodeId id) {
+        switch (id.kind()) {
+            case Kind::PROGRAM: {
+                auto &n = flat.get<Flat::Program>(id);
+                auto program = std::make_unique<Program>(n.location);
+                program->file_location = flat.names.get(n.file_location);
+                program->strings = flat.strings;
+                for (auto child : flat.list(n.declarations)) {
+                    program->add_declaration(build(child));
+                }
+                return program;
+            }
+            case Kind::BLOCK: {
+                auto &n = flat.get<Flat::Block>(id);
+                auto block = std::make_unique<Block>(n.location);
+                for (auto child : flat.list(n.statements)) {
+                    block->add_statement(build(child));
+                }
+                return block;
+            }
+            case Kind::SWITCH_BLOCK: {
+                auto &n = flat.get<Flat::SwitchBlock>(id);
+                auto block = std::make_unique<SwitchBlock>(n.location);
+                for (auto child : flat.list(n.statements)) {
+                    block->add_statement(build(child));
+                }
+                block->label = build(n.label);
+                block->is_default = n.is_default;
+                block->break_after = n.break_after;
+                return block;
+            }
+            case Kind::SWITCH: {
+                auto &n = flat.get<Flat::Switch>(id);
+                auto sw =
+                    std::make_unique<Switch>(n.location, build(n.condition));
+                for (auto child : flat.list(n.switch_blocks)) {
+                    sw->add_switch_block(build_as<SwitchBlock>(child));
+                }
+                return sw;
+            }
+            case Kind::IF: {
+                auto &n = flat.get<Flat::If>(id);
+                return std::make_unique<If>(n.location, build(n.condition),
+                                            build(n.then_block),
+                                            build(n.else_block));
+            }
+            case Kind::FOR: {
+                auto &n = flat.get<Flat::For>(id);
+                auto for_node =
+                    std::make_unique<For>(n.location, build(n.body));
+                for_node->set_init(build(n.init));
+                for_node->set_increment(build(n.increment));
+                for_node->set_condition(build(n.condition));
+                return for_node;
+            }
+            case Kind::WHILE: {
+                auto &n = flat.get<Flat::While>(id);
+                return std::make_unique<While>(n.location, build(n.condition),
+                                               build(n.body));
+            }
+            case Kind::DO_WHILE: {
+                auto &n = flat.get<Flat::DoWhile>(id);
+                return std::make_unique<DoWhile>(n.location, build(n.condition),
+                                                 build(n.body));
+            }
+            case Kind::ATTRIBUTE: {
+                auto &n = flat.get<Flat::Attribute>(id);
+                return std::make_unique<Attribute>(
+                    n.location, std::string(flat.names.get(n.name)));
+            }
+            case Kind::ASSEMBLY: {
+                auto &n = flat.get<Flat::Assembly>(id);
+                std::vector<std::string> lines;
+                for (auto line : RangeView(flat.string_ids, n.assembly)) {
+                    lines.emplace_back(flat.names.get(line));
+                }
+                return std::make_unique<Assembly>(n.location,
+                                                  std::move(lines));
+            }
+            case Kind::CONSTANT: {
+                auto &n = flat.get<Flat::Constant>(id);
+                switch (n.literal_kind) {
+                    case Constant::LiteralKind::INTEGER:
+                        return std::make_unique<Constant>(n.location,
+                                                          n.integer);
+                    case Constant::LiteralKind::FLOAT:
+                        return std::make_unique<Constant>(n.location,
+                                                          n.floating);
+                    case Constant::LiteralKind::STRING:
+                        break;
+                }
+                return std::make_unique<Constant>(
+                    n.location, n.string_id, flat.strings->get(n.string_id));
+            }
+            case Kind::IDENTIFIER: {
+                auto &n = flat.get<Flat::Identifier>(id);
+                auto identifier = std::make_unique<Identifier>(
+                    n.location, std::string(flat.names.get(n.name)));
+                if (n.owns_type) {
+                    identifier->add_type(build_as<Type>(n.type));
+                } else if (n.type) {
+                    // A copy of the type of the declaration, the identifier
+                    // keeps it alive on its own
+                    identifier->share_type(build_as<Type>(n.type));
+                }
+                return identifier;
+            }
+            case Kind::NAMED_TYPE: {
+                auto &n = flat.get<Flat::NamedType>(id);
+                auto type = std::make_unique<NamedType>(
+                    std::make_unique<Identifier>(
+                        n.location, std::string(flat.names.get(n.name))));
+                return finish_type(n, std::move(type));
+            }
+            case Kind::FUNCTION_TYPE: {
+                auto &n = flat.get<Flat::FunctionType>(id);
+                auto type = std::make_unique<FunctionType>(
+                    n.location, build_as<Type>(n.return_type));
+                type->varargs = n.varargs;
+                for (auto child : flat.list(n.parameters)) {
+                    type->add_parameter(build_as<Identifier>(child));
+                }
+                return finish_type(n, std::move(type));
+            }
+            case Kind::PRIMITIVE_TYPE: {
+                auto &n = flat.get<Flat::PrimitiveType>(id);
+                auto type = std::make_unique<PrimitiveType>(n.location);
+                for (auto keyword : RangeView(flat.keywords, n.keywords)) {
+                    type->add_keyword(keyword);
+                }
+                return finish_type(n, std::move(type));
+            }
+            case Kind::TYPE_DEF: {
+                auto &n = flat.get<Flat::TypeDef>(id);
+                auto def = std::make_unique<TypeDef>(
+                    n.location, build_as<Identifier>(n.name));
+                return finish_declaration(n, std::move(def));
+            }
+            case Kind::VARIABLE_DECLARATION: {
+                auto &n = flat.get<Flat::VariableDeclaration>(id);
+                auto var = std::make_unique<VariableDeclaration>(
+                    n.location, build_as<Identifier>(n.name), build(n.value));
+                var->global = n.global;
+                return finish_declaration(n, std::move(var));
+            }
+            case Kind::ARRAY_INITIALIZATION_LIST: {
+                auto &n = flat.get<Flat::ArrayInitializationList>(id);
+                auto list =
+                    std::make_unique<ArrayInitializationList>(n.location);
+                if (n.packed != Flat::ArrayInitializationList::NOT_PACKED) {
+                    list->set_packed(flat.packed[n.packed]);
+                }
+                for (auto child : flat.list(n.values)) {
+                    list->add_value(build(child));
+                }
+                return list;
+            }
+            case Kind::ARRAY_ACCESS: {
+                auto &n = flat.get<Flat::ArrayAccess>(id);
+                auto access = std::make_unique<ArrayAccess>(n.location,
+                                                            build(n.array));
+                for (auto child : flat.list(n.indices)) {
+                    access->add_index(build(child));
+                }
+                return access;
+            }
+            case Kind::STRUCT_ACCESS: {
+                auto &n = flat.get<Flat::StructAccess>(id);
+                return std::make_unique<StructAccess>(
+                    n.location, build(n.struc), build_as<Identifier>(n.member),
+                    n.through_pointer);
+            }
+            case Kind::ASSIGNMENT: {
+                auto &n = flat.get<Flat::Assignment>(id);
+                return std::make_unique<Assignment>(n.location, build(n.left),
+                                                    build(n.right));
+            }
+            case Kind::OPERATION_ASSIGNMENT: {
+                auto &n = flat.get<Flat::OperationAssignment>(id);
+                return std::make_unique<OperationAssignment>(
+                    n.location, build(n.left), build(n.right), n.op);
+            }
+            case Kind::EXPRESSION_LIST: {
+                auto &n = flat.get<Flat::ExpressionList>(id);
+                auto list = std::make_unique<ExpressionList>(n.location);
+                for (auto child : flat.list(n.expressions)) {
+                    list->add_expression(build(child));
+                }
+                return list;
+            }
+            case Kind::FUNCTION_CALL: {
+                auto &n = flat.get<Flat::FunctionCall>(id);
+                auto call = std::make_unique<FunctionCall>(
+                    n.location, build_as<Identifier>(n.name));
+                for (auto child : flat.list(n.arguments)) {
+                    call->add_argument(build(child));
+                }
+                return call;
+            }
+            case Kind::FUNCTION_DEFINITION: {
+                auto &n = flat.get<Flat::FunctionDefinition>(id);
+                auto name = build_as<Identifier>(n.name);
+                auto def = std::make_unique<FunctionDefinition>(
+                    n.location, std::move(name), build_as<Block>(n.body));
+                return finish_declaration(n, std::move(def));
+            }
+            case Kind::FUNCTION_DECLARATION: {
+                auto &n = flat.get<Flat::FunctionDeclaration>(id);
+                auto decl = std::make_unique<FunctionDeclaration>(
+                    n.location, build_as<Identifier>(n.name));
+                return finish_declaration(n, std::move(decl));
+            }
+            case Kind::UNARY_EXPRESSION: {
+                auto &n = flat.get<Flat::UnaryExpression>(id);
+                return std::make_unique<UnaryExpression>(n.location,
+                                                         build(n.value), n.op);
+            }
+            case Kind::BINARY_EXPRESSION: {
+                auto &n = flat.get<Flat::BinaryExpression>(id);
+                return std::make_unique<BinaryExpression>(
+                    n.location, build(n.left), build(n.right), n.op);
+            }
+            case Kind::TERNARY_EXPRESSION: {
+                auto &n = flat.get<Flat::TernaryExpression>(id);
+                return std::make_unique<TernaryExpression>(
+                    n.location, build(n.condition), build(n.then_expr),
+                    build(n.else_expr));
+            }
+            case Kind::RETURN: {
+                auto &n = flat.get<Flat::Return>(id);
+                return std::make_unique<Return>(n.location, build(n.value));
+            }
+            case Kind::STRUCT_TYPE: {
+                auto &n = flat.get<Flat::StructType>(id);
+                auto struc = std::make_unique<StructType>(
+                    n.location, build_as<Identifier>(n.name), n.definition);
+                for (auto child : flat.list(n.members)) {
+                    struc->add_member(build_as<VariableDeclaration>(child));
+                }
+                struc = finish_type(n, std::move(struc));
+                return finish_declaration(n, std::move(struc));
+            }
+            case Kind::UNION_TYPE: {
+                auto &n = flat.get<Flat::UnionType>(id);
+                auto union_type = std::make_unique<UnionType>(
+                    n.location, build_as<Identifier>(n.name), n.definition);
+                for (auto child : flat.list(n.members)) {
+                    union_type->add_member(
+                        build_as<VariableDeclaration>(child));
+                }
+                union_type = finish_type(n, std::move(union_type));
+                return finish_declaration(n, std::move(union_type));
+            }
+            case Kind::ENUM_VALUE: {
+                auto &n = flat.get<Flat::EnumValue>(id);
+                auto value = std::make_unique<EnumValue>(
+                    n.location, build_as<Identifier>(n.name));
+                value->set_value(build(n.value));
+                return value;
+            }
+            case Kind::ENUM_TYPE: {
+                auto &n = flat.get<Flat::EnumType>(id);
+                auto enum_type = std::make_unique<EnumType>(
+                    n.location, build_as<Identifier>(n.name), n.definition);
+                for (auto child : flat.list(n.values)) {
+                    enum_type->add_value(build_as<EnumValue>(child));
+                }
+                enum_type = finish_type(n, std::move(enum_type));
+                return finish_declaration(n, std::move(enum_type));
+            }
+            case Kind::TYPE_CAST: {
+                auto &n = flat.get<Flat::TypeCast>(id);
+                return std::make_unique<TypeCast>(
+                    n.location, build_as<Type>(n.type), build(n.value));
+            }
+        }
+        die("Invalid flat AST node kind %d", (int)id.kind());
+        return nullptr;
+    }
+
+    template <typename T>
+    std::unique_ptr<T> finish_type(const Flat::TypeInfo &info,
+                                   std::unique_ptr<T> type) {
+        type->pointer_count = info.pointer_count;
+        type->is_const = info.is_const;
+        type->is_restrict = info.is_restrict;
+        for (auto size : flat.list(info.array_sizes)) {
+            if (size) {
+                type->add_array_dimension(build(size));
+            } else {
+                type->add_array_dimension();
+            }
+        }
+        return type;
+    }
+
+    template <typename T>
+    std::unique_ptr<T> finish_declaration(const Flat::DeclarationInfo &info,
+                                          std::unique_ptr<T> declaration) {
+        if constexpr (std::is_base_of_v<Declaration, T>) {
+            declaration->m_type = build_as<Type>(info.type);
+        }
+        declaration->is_public = info.is_public;
+        for (auto child : flat.list(info.attributes)) {
+            declaration->attributes.push_back(build_as<Attribute>(child));
+        }
+        for (auto child : flat.list(info.assembly)) {
+            declaration->add_assembly(build_as<Assembly>(child));
+        }
+        return declaration;
+    }
+
+    const FlatAST &flat;
+    // Of the innermost walk
+    FinishedChildren<NodeId, std::unique_ptr<AST>> *finished = nullptr;
+};
+
+// Checks a FlatAST read from binary data, so building a tree from it
+// neither reads out of bounds nor loops
+class Validator {
+   public:
+    explicit Validator(const FlatAST &flat) : flat(flat) {
+        size_t total = 0;
+#define OFFSET(type, kind)                  \
+    offsets[(size_t)Kind::kind] = total;    \
+    total += flat.all<Flat::type>().size();
+        AST_KINDS(OFFSET)
+#undef OFFSET
+        states.resize(total);
+
+        for (NodeId child : flat.children) {
+            id(child);
+        }
+        for (uint32_t line : flat.string_ids) {
+            name(line);
+        }
+        for (auto keyword : flat.keywords) {
+            enumerator(keyword, PrimitiveType::KeyWords::DOUBLE);
+        }
+    }
+
+    void check(const Flat::Program &n) {
+        name(n.file_location);
+        list(n.declarations);
+    }
+    void check(const Flat::Block &n) {
+        list(n.statements);
+    }
+    void check(const Flat::SwitchBlock &n) {
+        list(n.statements);
+        id(n.label);
+        flag(n.is_default);
+        flag(n.break_after);
+    }
+    void check(const Flat::Switch &n) {
+        id(n.condition);
+        list(n.switch_blocks);
+    }
+    void check(const Flat::If &n) {
+        id(n.condition);
+        id(n.then_block);
+        id(n.else_block);
+    }
+    void check(const Flat::For &n) {
+        id(n.init);
+        id(n.increment);
+        id(n.condition);
+        id(n.body);
+    }
+    void check(const Flat::While &n) {
+        id(n.condition);
+        id(n.body);
+    }
+    void check(const Flat::DoWhile &n) {
+        id(n.condition);
+        id(n.body);
+    }
+    void check(const Flat::Attribute &n) {
+        name(n.name);
+    }
+    void check(const Flat::Assembly &n) {
+        range(n.assembly, flat.string_ids.size());
+    }
+    void check(const Flat::Constant &n) {
+        switch (n.literal_kind) {
+            case Constant::LiteralKind::INTEGER:
+                flag(n.integer.is_unsigned);
+                return;
+            case Constant::LiteralKind::FLOAT:
+                flag(n.floating.is_float);
+                flag(n.floating.is_long);
+                return;
+            case Constant::LiteralKind::STRING:
+                if (flat.strings == nullptr ||
+                    n.string_id >= flat.strings->size()) {
+                    fail();
+                }
+                return;
+        }
+        fail();
+    }
+    void check(const Flat::Identifier &n) {
+        name(n.name);
+        id(n.type);
+        flag(n.owns_type);
+    }
+    void check(const Flat::NamedType &n) {
+        type(n);
+        name(n.name);
+    }
+    void check(const Flat::FunctionType &n) {
+        type(n);
+        flag(n.varargs);
+        id(n.return_type);
+        list(n.parameters);
+    }
+    void check(const Flat::PrimitiveType &n) {
+        type(n);
+        range(n.keywords, flat.keywords.size());
+    }
+    void check(const Flat::TypeDef &n) {
+        declaration(n);
+    }
+    void check(const Flat::VariableDeclaration &n) {
+        declaration(n);
+        id(n.value);
+        flag(n.global);
+    }
+    void check(const Flat::ArrayInitializationList &n) {
+        list(n.values);
+        if (n.packed != Flat::ArrayInitializationList::NOT_PACKED &&
+            n.packed >= flat.packed.size()) {
+            fail();
+        }
+    }
+    void check(const Flat::ArrayAccess &n) {
+        id(n.array);
+        list(n.indices);
+    }
+    void check(const Flat::StructAccess &n) {
+        id(n.struc);
+        id(n.member);
+        flag(n.through_pointer);
+    }
+    void check(const Flat::Assignment &n) {
+        id(n.left);
+        id(n.right);
+    }
+    void check(const Flat::OperationAssignment &n) {
+        id(n.left);
+        id(n.right);
+        enumerator(n.op, OperationAssignment::Operator::SHIFT_RIGHT);
+    }
+    void check(const Flat::ExpressionList &n) {
+        list(n.expressions);
+    }
+    void check(const Flat::FunctionCall &n) {
+        id(n.name);
+        list(n.arguments);
+    }
+    void check(const Flat::FunctionDefinition &n) {
+        declaration(n);
+        id(n.body);
+    }
+    void check(const Flat::FunctionDeclaration &n) {
+        declaration(n);
+    }
+    void check(const Flat::UnaryExpression &n) {
+        id(n.value);
+        enumerator(n.op, UnaryExpression::Operator::DEC_PREFIX);
+    }
+    void check(const Flat::BinaryExpression &n) {
+        id(n.left);
+        id(n.right);
+        enumerator(n.op, BinaryExpression::Operator::SHIFT_RIGHT);
+    }
+    void check(const Flat::TernaryExpression &n) {
+        id(n.condition);
+        id(n.then_expr);
+        id(n.else_expr);
+    }
+    void check(const Flat::Return &n) {
+        id(n.value);
+    }
+    void check(const Flat::StructType &n) {
+        type(n);
+        declaration(n);
+        flag(n.definition);
+        list(n.members);
+    }
+    void check(const Flat::UnionType &n) {
+        type(n);
+        declaration(n);
+        flag(n.definition);
+        list(n.members);
+    }
+    void check(const Flat::EnumValue &n) {
+        id(n.name);
+        id(n.value);
+    }
+    void check(const Flat::EnumType &n) {
+        type(n);
+        declaration(n);
+        flag(n.definition);
+        list(n.values);
+    }
+    void check(const Flat::TypeCast &n) {
+        id(n.type);
+        id(n.value);
+    }
+
+    // Walks the nodes below root, including the types identifiers borrow,
+    // and fails on a node that is its own descendant. Run after check.
+    void acyclic(NodeId root) {
+        if (!root) {
+            fail();
+        }
+        id(root);
+        std::vector<std::pair<NodeId, bool>> pending{{root, false}};
+        std::vector<NodeId> next;
+        while (!pending.empty()) {
+            auto [node, leaving] = pending.back();
+            pending.pop_back();
+            uint8_t &node_state = state(node);
+            if (leaving) {
+                node_state = DONE;
+                continue;
+            }
+            if (node_state != UNSEEN) {
+                continue;
+            }
+            node_state = ON_PATH;
+            pending.push_back({node, true});
+
+            next.clear();
+            flat.children_of(node, next);
+            if (node.kind() == Kind::IDENTIFIER) {
+                auto &n = flat.get<Flat::Identifier>(node);
+                if (!n.owns_type && n.type) {
+                    next.push_back(n.type);
+                }
+            }
+            for (NodeId child : next) {
+                if (state(child) == ON_PATH) {
+                    fail();
+                }
+                pending.push_back({child, false});
+            }
+        }
+    }
+
+   private:
+    enum : uint8_t { UNSEEN, ON_PATH, DONE };
+
+    static void fail() {
+        die("Corrupt flat AST in binary data");
+    }
+
+    void id(NodeId id) {
+        if (!id) {
+            return;
+        }
+        size_t kind = (size_t)id.kind();
+        if (kind >= KIND_COUNT) {
+            fail();
+        }
+        size_t end = kind + 1 < KIND_COUNT ? offsets[kind + 1] : states.size();
+        if (id.index() >= end - offsets[kind]) {
+            fail();
+        }
+    }
+    void range(Range range, size_t size) {
+        if (range.begin > size || range.size > size - range.begin) {
+            fail();
+        }
+    }
+    // The elements of children were checked on their own
+    void list(Range range) {
+        this->range(range, flat.children.size());
+    }
+    void name(uint32_t name) {
+        if (name >= flat.names.size()) {
+            fail();
+        }
+    }
+    // Loading a bool that is neither 0 nor 1 is undefined, so its byte is
+    // read instead
+    void flag(const bool &value) {
+        uint8_t byte;
+        std::memcpy(&byte, &value, 1);
+        if (byte > 1) {
+            fail();
+        }
+    }
+    // Any int loads into these enums, but the code switching on them or
+    // indexing with them only expects the values from the first to last
+    template <typename Enum>
+    void enumerator(Enum value, Enum last) {
+        if ((int)value < 0 || (int)value > (int)last) {
+            fail();
+        }
+    }
+    void type(const Flat::TypeInfo &info) {
+        list(info.array_sizes);
+        flag(info.is_const);
+        flag(info.is_restrict);
+    }
+    void declaration(const Flat::DeclarationInfo &info) {
+        id(info.name);
+        id(info.type);
+        flag(info.is_public);
+        list(info.attributes);
+        list(info.assembly);
+    }
+
+    uint8_t &state(NodeId id) {
+        return states[offsets[(size_t)id.kind()] + id.index()];
+    }
+
+    const FlatAST &flat;
+    // Where the nodes of each kind start in states
+    size_t offsets[KIND_COUNT];
+    std::vector<uint8_t> states;
+};
+
+}  // namespace
+
+FlatAST FlatAST::from_tree(const Program &program) {
+    trace("Flattening the AST");
+    FlatAST flat;
+    flat.strings = program.strings;
+    FlatBuilder builder(flat);
+    flat.root = builder.convert(&program);
+    return flat;
+}
+
+std::unique_ptr<Program> FlatAST::to_tree() const {
+    trace("Building the AST from the flat AST");
+    TreeBuilder builder(*this);
+    return builder.build_as<Program>(root);
+}
+
+FlatAST FlatAST::from_node(const AST &node, std::shared_ptr<StringPool> strings) {
+    FlatAST flat;
+    flat.strings = std::move(strings);
+    FlatBuilder builder(flat);
+    flat.root = builder.convert(&node);
+    return flat;
+}
+
+std::unique_ptr<AST> FlatAST::to_node() const {
+    TreeBuilder builder(*this);
+    return builder.build(root);
+}
+
+void FlatAST::serialize(std::string &out) const {
+    ByteWriter writer(out);
+    writer.put(root);
+#define WRITE(type, kind) writer.put_aligned_array(all<Flat::type>());
+    AST_KINDS(WRITE)
+#undef WRITE
+    writer.put_aligned_array(children);
+    writer.put_aligned_array(string_ids);
+    writer.put_aligned_array(keywords);
+    names.serialize(writer);
+    writer.put<uint32_t>(packed.size());
+    for (auto &list : packed) {
+        list->serialize(writer);
+    }
+}
+
+FlatAST FlatAST::deserialize(std::string_view data,
+                             std::shared_ptr<StringPool> strings,
+                             const std::shared_ptr<const void> &owner) {
+    FlatAST flat;
+    flat.strings = std::move(strings);
+    ByteReader reader(data);
+    flat.root = reader.get<NodeId>();
+#define READ(type, kind)                            \
+    std::get<SharedArray<Flat::type>>(flat.nodes) = \
+        reader.get_aligned_array<Flat::type>(owner);
+    AST_KINDS(READ)
+#undef READ
+    flat.children = reader.get_aligned_array<NodeId>(owner);
+    flat.string_ids = reader.get_aligned_array<uint32_t>(owner);
+    flat.keywords = reader.get_aligned_array<PrimitiveType::KeyWords>(owner);
+    flat.names.deserialize(reader);
+    uint32_t packed_count = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < packed_count; i++) {
+        flat.packed.push_back(std::make_shared<const PackedLiterals>(
+            PackedLiterals::deserialize(reader, owner)));
+    }
+    flat.validate();
+    return flat;
+}
+
+void FlatAST::validate() const {
+    Validator validator(*this);
+#define CHECK_NODES(type, kind)              \
+    for (auto &node : all<Flat::type>()) {   \
+        validator.check(node);               \
+    }
+    AST_KINDS(CHECK_NODES)
+#undef CHECK_NODES
+    validator.acyclic(root);
+}
+
+Range FlatAST::add_list(const std::vector<NodeId> &list) {
+    Range range{(uint32_t)children.size(), (uint32_t)list.size()};
+    auto &ids = children.mutate();
+    ids.insert(ids.end(), list.begin(), list.end());
+    return range;
+}
+
+size_t FlatAST::size() const {
+    size_t size = 0;
+#define COUNT(type, kind) size += all<Flat::type>().size();
+    AST_KINDS(COUNT)
+#undef COUNT
+    return size;
+}
+
+void FlatAST::children_of(NodeId id, std::vector<NodeId> &out) const {
+    auto add = [&](NodeId child) {
+        if (child) {
+            out.push_back(child);
+        }
+    };
+    auto add_list = [&](Range range) {
+        for (auto child : list(range)) {
+            add(child);
+        }
+    };
+    auto add_type = [&](const Flat::TypeInfo &info) {
+        add_list(info.array_sizes);
+    };
+    auto add_declaration = [&](const Flat::DeclarationInfo &info) {
+        add_list(info.assembly);
+        add_list(info.attributes);
+        add(info.type);
+        add(info.name);
+    };
+
+    switch (id.kind()) {
+        case Kind::PROGRAM:
+            add_list(get<Flat::Program>(id).declarations);
+            break;
+        case Kind::BLOCK:
+            add_list(get<Flat::Block>(id).statements);
+            break;
+        case Kind::SWITCH_BLOCK: {
+            auto &n = get<Flat::SwitchBlock>(id);
+            add(n.label);
+            add_list(n.statements);
+            break;
+        }
+        case Kind::SWITCH: {
+            auto &n = get<Flat::Switch>(id);
+            add(n.condition);
+            add_list(n.switch_blocks);
+            break;
+        }
+        case Kind::IF: {
+            auto &n = get<Flat::If>(id);
+            add(n.condition);
+            add(n.then_block);
+            add(n.else_block);
+            break;
+        }
+        case Kind::FOR: {
+            auto &n = get<Flat::For>(id);
+            add(n.init);
+            add(n.condition);
+            add(n.increment);
+            add(n.body);
+            break;
+        }
+        case Kind::WHILE: {
+            auto &n = get<Flat::While>(id);
+            add(n.condition);
+            add(n.body);
+            break;
+        }
+        case Kind::DO_WHILE: {
+            auto &n = get<Flat::DoWhile>(id);
+            add(n.body);
+            add(n.condition);
+            break;
+        }
+        case Kind::ATTRIBUTE:
+        case Kind::ASSEMBLY:
+        case Kind::CONSTANT:
+            break;
+        case Kind::IDENTIFIER: {
+            // A borrowed type is a child of its owner
+            auto &n = get<Flat::Identifier>(id);
+            if (n.owns_type) {
+                add(n.type);
+            }
+            break;
+        }
+        case Kind::NAMED_TYPE:
+            add_type(get<Flat::NamedType>(id));
+            break;
+        case Kind::FUNCTION_TYPE: {
+            auto &n = get<Flat::FunctionType>(id);
+            add_type(n);
+            add(n.return_type);
+            add_list(n.parameters);
+            break;
+        }
+        case Kind::PRIMITIVE_TYPE:
+            add_type(get<Flat::PrimitiveType>(id));
+            break;
+        case Kind::TYPE_DEF:
+            add_declaration(get<Flat::TypeDef>(id));
+            break;
+        case Kind::VARIABLE_DECLARATION: {
+            auto &n = get<Flat::VariableDeclaration>(id);
+            add_declaration(n);
+            add(n.value);
+            break;
+        }
+        case Kind::ARRAY_INITIALIZATION_LIST:
+            add_list(get<Flat::ArrayInitializationList>(id).values);
+            break;
+        case Kind::ARRAY_ACCESS: {
+            auto &n = get<Flat::ArrayAccess>(id);
+            add(n.array);
+            add_list(n.indices);
+            break;
+        }
+        case Kind::STRUCT_ACCESS: {
+            auto &n = get<Flat::StructAccess>(id);
+            add(n.struc);
+            add(n.member);
+            break;
+        }
+        case Kind::ASSIGNMENT: {
+            auto &n = get<Flat::Assignment>(id);
+            add(n.left);
+            add(n.right);
+            break;
+        }
+        case Kind::OPERATION_ASSIGNMENT: {
+            auto &n = get<Flat::OperationAssignment>(id);
+            add(n.left);
+            add(n.right);
+            break;
+        }
+        case Kind::EXPRESSION_LIST:
+            add_list(get<Flat::ExpressionList>(id).expressions);
+            break;
+        case Kind::FUNCTION_CALL: {
+            auto &n = get<Flat::FunctionCall>(id);
+            add(n.name);
+            add_list(n.arguments);
+            break;
+        }
+        case Kind::FUNCTION_DEFINITION: {
+            auto &n = get<Flat::FunctionDefinition>(id);
+            add_declaration(n);
+            add(n.body);
+            break;
+        }
+        case Kind::FUNCTION_DECLARATION:
+            add_declaration(get<Flat::FunctionDeclaration>(id));
+            break;
+        case Kind::UNARY_EXPRESSION:
+            add(get<Flat::UnaryExpression>(id).value);
+            break;
+        case Kind::BINARY_EXPRESSION: {
+            auto &n = get<Flat::BinaryExpression>(id);
+            add(n.left);
+            add(n.right);
+            break;
+        }
+        case Kind::TERNARY_EXPRESSION: {
+            auto &n = get<Flat::TernaryExpression>(id);
+            add(n.condition);
+            add(n.then_expr);
+            add(n.else_expr);
+            break;
+        }
+        case Kind::RETURN:
+            add(get<Flat::Return>(id).value);
+            break;
+        case Kind::STRUCT_TYPE: {
+            auto &n = get<Flat::StructType>(id);
+            add_type(n);
+            add_declaration(n);
+            add_list(n.members);
+            break;
+        }
+        case Kind::UNION_TYPE: {
+            auto &n = get<Flat::UnionType>(id);
+            add_type(n);
+            add_declaration(n);
+            add_list(n.members);
+            break;
+        }
+        case Kind::ENUM_VALUE: {
+            auto &n = get<Flat::EnumValue>(id);
+            add(n.name);
+            add(n.value);
+            break;
+        }
+        case Kind::ENUM_TYPE: {
+            auto &n = get<Flat::EnumType>(id);
+            add_type(n);
+            add_declaration(n);
+            add_list(n.values);
+            break;
+        }
+        case Kind::TYPE_CAST: {
+            auto &n = get<Flat::TypeCast>(id);
+            add(n.type);
+            add(n.value);
+            break;
+        }
+    }
+}
+
+}  // namespace CCOMP::AST
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "ast.hpp"
+#include "literals.hpp"
+#include "shared_array.hpp"
+
+namespace CCOMP::AST {
+
+// Kind in the upper bits and index into the nodes of that kind in the lower
+// bits. Default constructed it refers to no node.
+class NodeId {
+   public:
+    static constexpr uint32_t INDEX_BITS = 26;
+    static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+
+    NodeId() = default;
+    NodeId(Kind kind, uint32_t index)
+        : bits(((uint32_t)kind << INDEX_BITS) | index) {
+    }
+
+    [[nodiscard]] Kind kind() const {
+        return (Kind)(bits >> INDEX_BITS);
+    }
+    [[nodiscard]] uint32_t index() const {
+        return bits & INDEX_MASK;
+    }
+
+    explicit operator bool() const {
+        return bits != NONE;
+    }
+    bool operator==(NodeId other) const {
+        return bits == other.bits;
+    }
+    bool operator!=(NodeId other) const {
+        return bits != other.bits;
+    }
+
+   private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    uint32_t bits = NONE;
+};
+
+// Consecutive elements of one of the shared arrays of a FlatAST
+struct Range {
+    uint32_t begin = 0, size = 0;
+};
+
+// Node layouts of the flat representation. Children are NodeIds, lists of
+// children are Ranges into FlatAST::children and names are ids in
+// FlatAST::names.
+namespace Flat {
+
+struct Node {
+    SourceLocation location;
+};
+
+struct TypeInfo {
+    uint16_t pointer_count;
+    bool is_const, is_restrict;
+    // An unsized dimension has no node
+    Range array_sizes;
+};
+
+struct DeclarationInfo {
+    NodeId name, type;
+    bool is_public;
+    Range attributes, assembly;
+};
+
+struct Program : Node {
+    uint32_t file_location;
+    Range declarations;
+};
+struct Block : Node {
+    Range statements;
+};
+struct SwitchBlock : Node {
+    Range statements;
+    NodeId label;
+    bool is_default, break_after;
+};
+struct Switch : Node {
+    NodeId condition;
+    Range switch_blocks;
+};
+struct If : Node {
+    NodeId condition, then_block, else_block;
+};
+struct For : Node {
+    NodeId init, increment, condition, body;
+};
+struct While : Node {
+    NodeId condition, body;
+};
+struct DoWhile : Node {
+    NodeId condition, body;
+};
+struct Attribute : Node {
+    uint32_t name;
+};
+struct Assembly : Node {
+    // Ranges into FlatAST::string_ids
+    Range assembly;
+};
+struct Constant : Node {
+    CCOMP::AST::Constant::LiteralKind literal_kind;
+    union {
+        IntegerLiteral integer = {};
+        FloatLiteral floating;
+        // Id in FlatAST::strings
+        uint32_t string_id;
+    };
+};
+struct Identifier : Node {
+    uint32_t name;
+    NodeId type;
+    // false if type belongs to another node
+    bool owns_type;
+};
+struct NamedType : Node, TypeInfo {
+    uint32_t name;
+};
+struct FunctionType : Node, TypeInfo {
+    bool varargs;
+    NodeId return_type;
+    Range parameters;
+};
+struct PrimitiveType : Node, TypeInfo {
+    // Range into FlatAST::keywords
+    Range keywords;
+};
+struct TypeDef : Node, DeclarationInfo {};
+struct VariableDeclaration : Node, DeclarationInfo {
+    NodeId value;
+    bool global;
+};
+struct ArrayInitializationList : Node {
+    Range values;
+    // Index into FlatAST::packed, NOT_PACKED if values has the elements
+    uint32_t packed = NOT_PACKED;
+
+    static constexpr uint32_t NOT_PACKED = UINT32_MAX;
+};
+struct ArrayAccess : Node {
+    NodeId array;
+    Range indices;
+};
+struct StructAccess : Node {
+    bool through_pointer;
+    NodeId struc, member;
+};
+struct Assignment : Node {
+    NodeId left, right;
+};
+struct OperationAssignment : Node {
+    NodeId left, right;
+    CCOMP::AST::OperationAssignment::Operator op;
+};
+struct ExpressionList : Node {
+    Range expressions;
+};
+struct FunctionCall : Node {
+    NodeId name;
+    Range arguments;
+};
+struct FunctionDefinition : Node, DeclarationInfo {
+    NodeId body;
+};
+struct FunctionDeclaration : Node, DeclarationInfo {};
+struct UnaryExpression : Node {
+    NodeId value;
+    CCOMP::AST::UnaryExpression::Operator op;
+};
+struct BinaryExpression : Node {
+    NodeId left, right;
+    CCOMP::AST::BinaryExpression::Operator op;
+};
+struct TernaryExpression : Node {
+    NodeId condition, then_expr, else_expr;
+};
+struct Return : Node {
+    NodeId value;
+};
+struct StructType : Node, TypeInfo, DeclarationInfo {
+    bool definition;
+    Range members;
+};
+struct UnionType : Node, TypeInfo, DeclarationInfo {
+    bool definition;
+    Range members;
+};
+struct EnumValue : Node {
+    NodeId name, value;
+};
+struct EnumType : Node, TypeInfo, DeclarationInfo {
+    bool definition;
+    Range values;
+};
+struct TypeCast : Node {
+    NodeId type, value;
+};
+
+}  // namespace Flat
+
+// Read only view of a Range of one of the shared arrays
+template <typename T>
+class RangeView {
+   public:
+    RangeView(const SharedArray<T> &array, Range range)
+        : first(array.data() + range.begin), last(first + range.size) {
+    }
+
+    const T *begin() const {
+        return first;
+    }
+    const T *end() const {
+        return last;
+    }
+    [[nodiscard]] size_t size() const {
+        return last - first;
+    }
+    const T &operator[](size_t i) const {
+        return first[i];
+    }
+
+   private:
+    const T *first, *last;
+};
+
+// The AST with the nodes of every kind in one contiguous array and children
+// referenced by 32 bit ids instead of pointers. Walking it touches a few
+// dense arrays instead of a heap object per node.
+class FlatAST {
+   public:
+    // Lazy function bodies are parsed by the conversion
+    static FlatAST from_tree(const Program &program);
+    [[nodiscard]] std::unique_ptr<Program> to_tree() const;
+
+    // Same for a subtree of any kind, its string literals are ids in strings
+    static FlatAST from_node(const AST &node, std::shared_ptr<StringPool> strings);
+    [[nodiscard]] std::unique_ptr<AST> to_node() const;
+
+    // Appends the arrays to out. The nodes keep their in memory layout, so
+    // only a build with the same layout can deserialize them. The string
+    // literals are not written, they are passed back in.
+    void serialize(std::string &out) const;
+    // The arrays, and the packed initializers of the trees built from them,
+    // stay in data if owner keeps it alive, else they are copied. Every id,
+    // range and name is checked, corrupt data is fatal.
+    static FlatAST deserialize(std::string_view data,
+                               std::shared_ptr<StringPool> strings,
+                               const std::shared_ptr<const void> &owner = {});
+
+    template <typename T>
+    [[nodiscard]] const T &get(NodeId id) const {
+        return std::get<SharedArray<T>>(nodes)[id.index()];
+    }
+
+    // All nodes of one kind, in the order they were added
+    template <typename T>
+    [[nodiscard]] const SharedArray<T> &all() const {
+        return std::get<SharedArray<T>>(nodes);
+    }
+
+    template <typename T>
+    NodeId add(const T &node);
+
+    Range add_list(const std::vector<NodeId> &list);
+
+    [[nodiscard]] RangeView<NodeId> list(Range range) const {
+        return {children, range};
+    }
+
+    // Direct children of a node in source order, appended to out
+    void children_of(NodeId id, std::vector<NodeId> &out) const;
+
+    [[nodiscard]] size_t size() const;
+
+   public:
+    NodeId root;
+
+    SharedArray<NodeId> children;
+    SharedArray<uint32_t> string_ids;
+    SharedArray<PrimitiveType::KeyWords> keywords;
+
+    // Identifier, attribute and assembly text
+    StringPool names;
+    // String literals, shared with the tree
+    std::shared_ptr<StringPool> strings;
+    // Initializers made of number literals, shared with the tree
+    std::vector<std::shared_ptr<const PackedLiterals>> packed;
+
+   private:
+    // Dies unless every reference is in range and the nodes below root form
+    // no cycle
+    void validate() const;
+
+#define ARRAY(type, kind) SharedArray<Flat::type>,
+    std::tuple<AST_KINDS(ARRAY) std::nullptr_t> nodes;
+#undef ARRAY
+};
+
+template <typename T>
+struct KindOf;
+#define KIND_OF(type, kind)                       \
+    template <>                                   \
+    struct KindOf<Flat::type> {                   \
+        static constexpr Kind value = Kind::kind; \
+    };
+AST_KINDS(KIND_OF)
+#undef KIND_OF
+
+template <typename T>
+NodeId FlatAST::add(const T &node) {
+    auto &array = std::get<SharedArray<T>>(nodes);
+    if (array.size() > NodeId::INDEX_MASK) {
+        die("Too many nodes for the flat AST");
+    }
+    array.push_back(node);
+    return {KindOf<T>::value, (uint32_t)(array.size() - 1)};
+}
+
+}  // namespace CCOMP::AST
@@ -1,5 +1,10 @@
 #include "io.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <array>
 #include <fstream>
 #include <memory>
@@ -51,5 +56,33 @@ std::string write_file(const std::string &path, const std::string &content) {
     return path;
 }
 
+MappedFile::MappedFile(const std::string &path) {
+    trace("Mapping file %s", path.c_str());
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        die("Could not open file: %s", path.c_str());
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        die("Could not stat file: %s", path.c_str());
+    }
+    size = st.st_size;
+    if (size > 0) {
+        address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // The mapping stays valid without the descriptor
+    close(fd);
+    if (address == MAP_FAILED) {
+        die("Could not map file: %s", path.c_str());
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (address != nullptr) {
+        munmap(address, size);
+    }
+}
+
 }  // namespace IO
 }  // namespace CCOMP
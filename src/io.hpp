@@ -1,12 +1,31 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace CCOMP::IO {
 
 std::string read_file(const std::string &path);
 std::string write_file(const std::string &path, const std::string &content);
 
+// A file mapped read only into memory. Pages are only read when they are
+// first touched.
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    [[nodiscard]] std::string_view data() const {
+        return {static_cast<const char *>(address), size};
+    }
+
+   private:
+    void *address = nullptr;
+    size_t size = 0;
+};
+
 std::string exec(const std::string &command);
 
 }  // namespace CCOMP::IO
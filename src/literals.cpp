@@ -0,0 +1,364 @@
+#include "literals.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+#include "byte_stream.hpp"
+#include "common.hpp"
+
+namespace CCOMP::AST {
+
+uint32_t StringPool::intern(std::string_view s) {
+    auto it = ids.find(s);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    uint32_t id = strings.size();
+    strings.emplace_back(s);
+    ids.emplace(strings.back(), id);
+    return id;
+}
+
+void StringPool::serialize(ByteWriter &out) const {
+    out.put<uint32_t>(strings.size());
+    for (auto &s : strings) {
+        out.put_string(s);
+    }
+}
+
+void StringPool::deserialize(ByteReader &in) {
+    uint32_t count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < count; i++) {
+        std::string_view s = in.get_string();
+        strings.emplace_back(s);
+        ids.emplace(strings.back(), strings.size() - 1);
+    }
+}
+
+static int digit_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+IntegerLiteral decode_integer(std::string_view text, std::string &diagnostic) {
+    IntegerLiteral lit;
+
+    while (!text.empty()) {
+        char c = text.back();
+        if (c == 'u' || c == 'U') {
+            lit.is_unsigned = true;
+        } else if (c == 'l' || c == 'L') {
+            lit.long_count++;
+        } else {
+            break;
+        }
+        text.remove_suffix(1);
+    }
+
+    int base = 10;
+    if (text.size() > 2 && text[0] == '0' &&
+        (text[1] == 'x' || text[1] == 'X')) {
+        base = 16;
+        text.remove_prefix(2);
+    } else if (text.size() > 2 && text[0] == '0' &&
+               (text[1] == 'b' || text[1] == 'B')) {
+        base = 2;
+        text.remove_prefix(2);
+    } else if (text.size() > 1 && text[0] == '0') {
+        base = 8;
+        text.remove_prefix(1);
+    }
+
+    for (char c : text) {
+        int d = digit_value(c);
+        if (d < 0 || d >= base) {
+            const char *name = base == 16  ? "hexadecimal"
+                               : base == 8 ? "octal"
+                               : base == 2 ? "binary"
+                                           : "decimal";
+            diagnostic = std::string("invalid digit '") + c + "' in " + name +
+                         " constant";
+            break;
+        }
+        lit.value = lit.value * base + d;
+    }
+    return lit;
+}
+
+FloatLiteral decode_float(std::string_view text) {
+    FloatLiteral lit{};
+    while (!text.empty()) {
+        char c = text.back();
+        if (c == 'f' || c == 'F') {
+            lit.is_float = true;
+        } else if (c == 'l' || c == 'L') {
+            lit.is_long = true;
+        } else if (c != 'u' && c != 'U') {
+            break;
+        }
+        text.remove_suffix(1);
+    }
+    lit.value = std::strtod(std::string(text).c_str(), nullptr);
+    return lit;
+}
+
+std::string float_to_string(FloatLiteral literal) {
+    // max_digits10 always reads back, fewer digits usually do as well
+    char buffer[64];
+    for (int precision = 1;
+         precision <= std::numeric_limits<double>::max_digits10;
+         precision++) {
+        snprintf(buffer, sizeof(buffer), "%.*g", precision, literal.value);
+        if (std::strtod(buffer, nullptr) == literal.value) {
+            break;
+        }
+    }
+    std::string s = buffer;
+    if (s.find_first_of(".en") == std::string::npos) {
+        // Stays a floating literal
+        s += ".0";
+    }
+    if (literal.is_float) {
+        s += 'f';
+    }
+    if (literal.is_long) {
+        s += 'l';
+    }
+    return s;
+}
+
+std::string decode_string(std::string_view text) {
+    std::string erg;
+    erg.reserve(text.size());
+
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] != '\\' || i + 1 == text.size()) {
+            erg += text[i];
+            continue;
+        }
+        char c = text[++i];
+        switch (c) {
+            case 'n':
+                erg += '\n';
+                break;
+            case 't':
+                erg += '\t';
+                break;
+            case 'r':
+                erg += '\r';
+                break;
+            case 'a':
+                erg += '\a';
+                break;
+            case 'b':
+                erg += '\b';
+                break;
+            case 'f':
+                erg += '\f';
+                break;
+            case 'v':
+                erg += '\v';
+                break;
+            case 'e':
+                erg += '\x1b';
+                break;
+            case 'x': {
+                unsigned v = 0;
+                while (i + 1 < text.size() && digit_value(text[i + 1]) >= 0) {
+                    v = v * 16 + digit_value(text[++i]);
+                }
+                erg += static_cast<char>(v);
+                break;
+            }
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7': {
+                unsigned v = c - '0';
+                for (int n = 1; n < 3 && i + 1 < text.size() &&
+                                text[i + 1] >= '0' && text[i + 1] <= '7';
+                     n++) {
+                    v = v * 8 + (text[++i] - '0');
+                }
+                erg += static_cast<char>(v);
+                break;
+            }
+            default:
+                // \\ \" \' \?
+                erg += c;
+                break;
+        }
+    }
+    return erg;
+}
+
+std::string escape_string(std::string_view text) {
+    std::string erg;
+    erg.reserve(text.size());
+
+    for (char c : text) {
+        switch (c) {
+            case '\n':
+                erg += "\\n";
+                break;
+            case '\t':
+                erg += "\\t";
+                break;
+            case '\r':
+                erg += "\\r";
+                break;
+            case '\\':
+                erg += "\\\\";
+                break;
+            case '"':
+                erg += "\\\"";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    // Always three octal digits, so it can not merge with
+                    // a following digit
+                    erg += '\\';
+                    erg += static_cast<char>('0' + ((c >> 6) & 7));
+                    erg += static_cast<char>('0' + ((c >> 3) & 7));
+                    erg += static_cast<char>('0' + (c & 7));
+                } else {
+                    erg += c;
+                }
+                break;
+        }
+    }
+    return erg;
+}
+
+bool PackedLiterals::add(IntegerLiteral value, bool minus, uint32_t offset) {
+    if (m_storage == Storage::FLOATS || !fits(offset)) {
+        return false;
+    }
+    if (count == 0) {
+        suffix = {0, value.is_unsigned, value.long_count};
+    } else if (value.is_unsigned != suffix.is_unsigned ||
+               value.long_count != suffix.long_count) {
+        return false;
+    }
+
+    if (m_storage == Storage::BYTES && value.value > UINT8_MAX) {
+        integers.mutate().assign(bytes.begin(), bytes.end());
+        bytes = {};
+        m_storage = Storage::INTEGERS;
+    }
+    if (m_storage == Storage::BYTES) {
+        bytes.push_back(value.value);
+    } else {
+        integers.push_back(value.value);
+    }
+    add_position(minus, offset);
+    return true;
+}
+
+bool PackedLiterals::add(FloatLiteral value, bool minus, uint32_t offset) {
+    if (!fits(offset)) {
+        return false;
+    }
+    if (count == 0) {
+        float_suffix = {0, value.is_float, value.is_long};
+    } else if (m_storage != Storage::FLOATS ||
+               value.is_float != float_suffix.is_float ||
+               value.is_long != float_suffix.is_long) {
+        return false;
+    }
+    m_storage = Storage::FLOATS;
+    floats.push_back(value.value);
+    add_position(minus, offset);
+    return true;
+}
+
+bool PackedLiterals::fits(uint32_t offset) const {
+    return offset >= end && offset - end <= MAX_GAP;
+}
+
+void PackedLiterals::add_position(bool minus, uint32_t offset) {
+    gaps.push_back(offset - end);
+    end = offset;
+    if (minus) {
+        auto &bits = negative.mutate();
+        bits.resize(count / 8 + 1);
+        bits[count / 8] |= 1 << count % 8;
+    }
+    count++;
+}
+
+void PackedLiterals::shrink_to_fit() {
+    bytes.shrink_to_fit();
+    integers.shrink_to_fit();
+    floats.shrink_to_fit();
+    negative.shrink_to_fit();
+    gaps.shrink_to_fit();
+}
+
+void PackedLiterals::serialize(ByteWriter &out) const {
+    out.put(m_storage);
+    out.put(suffix.is_unsigned);
+    out.put(suffix.long_count);
+    out.put(float_suffix.is_float);
+    out.put(float_suffix.is_long);
+    out.put<uint64_t>(count);
+    out.put(end);
+    out.put_aligned_array(bytes);
+    out.put_aligned_array(integers);
+    out.put_aligned_array(floats);
+    out.put_aligned_array(negative);
+    out.put_aligned_array(gaps);
+}
+
+PackedLiterals PackedLiterals::deserialize(
+    ByteReader &in, const std::shared_ptr<const void> &owner) {
+    PackedLiterals packed;
+    packed.m_storage = in.get<Storage>();
+    packed.suffix.is_unsigned = in.get_flag();
+    packed.suffix.long_count = in.get<uint8_t>();
+    packed.float_suffix.is_float = in.get_flag();
+    packed.float_suffix.is_long = in.get_flag();
+    auto count = in.get<uint64_t>();
+    packed.end = in.get<uint32_t>();
+    packed.bytes = in.get_aligned_array<uint8_t>(owner);
+    packed.integers = in.get_aligned_array<uint64_t>(owner);
+    packed.floats = in.get_aligned_array<double>(owner);
+    packed.negative = in.get_aligned_array<uint8_t>(owner);
+    packed.gaps = in.get_aligned_array<uint8_t>(owner);
+
+    size_t elements = 0;
+    switch (packed.m_storage) {
+        case Storage::BYTES:
+            elements = packed.bytes.size();
+            break;
+        case Storage::INTEGERS:
+            elements = packed.integers.size();
+            break;
+        case Storage::FLOATS:
+            elements = packed.floats.size();
+            break;
+        default:
+            die("Invalid packed initializer in binary data");
+    }
+    if (elements != count || packed.gaps.size() != count ||
+        packed.negative.size() > (count + 7) / 8) {
+        die("Invalid packed initializer in binary data");
+    }
+    packed.count = count;
+    return packed;
+}
+
+}  // namespace CCOMP::AST
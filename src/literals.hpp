@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "shared_array.hpp"
+
+namespace CCOMP {
+class ByteWriter;
+class ByteReader;
+}  // namespace CCOMP
+
+namespace CCOMP::AST {
+
+// Owns every distinct string literal of a program exactly once
+class StringPool {
+   public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    StringPool() = default;
+    // The keys of ids are views into strings, a copy would share them
+    StringPool(const StringPool &) = delete;
+    StringPool &operator=(const StringPool &) = delete;
+    StringPool(StringPool &&) = default;
+    StringPool &operator=(StringPool &&) = default;
+
+    uint32_t intern(std::string_view s);
+    // The id of s, NONE if it was never interned
+    [[nodiscard]] uint32_t find(std::string_view s) const {
+        auto it = ids.find(s);
+        return it == ids.end() ? NONE : it->second;
+    }
+
+    // An empty pool reading it back gives every string its old id
+    void serialize(ByteWriter &out) const;
+    void deserialize(ByteReader &in);
+
+    [[nodiscard]] std::string_view get(uint32_t id) const {
+        return strings[id];
+    }
+
+    [[nodiscard]] size_t size() const {
+        return strings.size();
+    }
+
+   private:
+    // std::deque never moves its elements, so the views stay valid
+    std::deque<std::string> strings;
+    std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+struct IntegerLiteral {
+    uint64_t value = 0;
+    bool is_unsigned = false;
+    uint8_t long_count = 0;
+};
+
+// Trivial to be a member of the unions in the nodes, initialize it with {}
+struct FloatLiteral {
+    double value;
+    // f suffix, the literal is a float
+    bool is_float;
+    // l suffix, the literal is a long double
+    bool is_long;
+};
+
+// Decodes NUMBER, HEX_NUMBER, OCT_NUMBER and BIN_NUMBER tokens. An invalid
+// digit ends the value and is described in diagnostic, which stays empty
+// otherwise.
+IntegerLiteral decode_integer(std::string_view text, std::string &diagnostic);
+
+// Decodes a NUMBER token for which is_float_literal holds
+FloatLiteral decode_float(std::string_view text);
+
+// Shortest text reading back as the same value, with its suffix
+std::string float_to_string(FloatLiteral literal);
+
+// A NUMBER token with a '.' or an exponent, like 1.5f, .5 or 1e3
+[[nodiscard]] inline bool is_float_literal(std::string_view text) {
+    return text.find_first_of(".eE") != std::string_view::npos;
+}
+
+// Elements of an initializer list made only of number literals, stored
+// without a node per element. While every integer fits in a byte they take
+// one byte each, plus a byte for the distance to the element before.
+class PackedLiterals {
+   public:
+    enum class Storage : uint8_t {
+        BYTES,
+        INTEGERS,
+        FLOATS,
+    };
+
+    // offset is where the literal is behind the location of the list. False
+    // if the value does not fit the elements before it, because the kinds or
+    // the integer suffixes differ or it is more than MAX_GAP bytes behind
+    // the element before. The list then needs nodes.
+    bool add(IntegerLiteral value, bool minus, uint32_t offset);
+    bool add(FloatLiteral value, bool minus, uint32_t offset);
+
+    // Gives back the memory reserved for further elements
+    void shrink_to_fit();
+
+    // The arrays are written aligned, so reading them back can leave them in
+    // the data owner keeps alive instead of copying them
+    void serialize(ByteWriter &out) const;
+    static PackedLiterals deserialize(ByteReader &in,
+                                      const std::shared_ptr<const void> &owner);
+
+    [[nodiscard]] size_t size() const {
+        return count;
+    }
+    [[nodiscard]] Storage storage() const {
+        return m_storage;
+    }
+
+    // Only valid for BYTES and INTEGERS
+    [[nodiscard]] IntegerLiteral integer(size_t i) const {
+        IntegerLiteral lit = suffix;
+        lit.value = m_storage == Storage::BYTES ? bytes[i] : integers[i];
+        return lit;
+    }
+    // Only valid for FLOATS
+    [[nodiscard]] FloatLiteral floating(size_t i) const {
+        FloatLiteral lit = float_suffix;
+        lit.value = floats[i];
+        return lit;
+    }
+    // The literal was written with a unary minus in front of it
+    [[nodiscard]] bool is_negative(size_t i) const {
+        return i / 8 < negative.size() && (negative[i / 8] >> i % 8 & 1);
+    }
+    // Bytes from the literal before, or from the list for the first one, to
+    // the literal. Summed up they give the locations of the elements.
+    [[nodiscard]] uint8_t gap(size_t i) const {
+        return gaps[i];
+    }
+
+    static constexpr uint32_t MAX_GAP = UINT8_MAX;
+
+   private:
+    [[nodiscard]] bool fits(uint32_t offset) const;
+    void add_position(bool minus, uint32_t offset);
+
+    Storage m_storage = Storage::BYTES;
+    // is_unsigned and long_count shared by all integers
+    IntegerLiteral suffix;
+    // is_float and is_long shared by all floats
+    FloatLiteral float_suffix{};
+    size_t count = 0;
+
+    SharedArray<uint8_t> bytes;
+    SharedArray<uint64_t> integers;
+    SharedArray<double> floats;
+    // Bit i % 8 of byte i / 8 is set if element i is negative, it ends
+    // behind the last negative element
+    SharedArray<uint8_t> negative;
+    SharedArray<uint8_t> gaps;
+    // Offset of the last literal behind the list
+    uint32_t end = 0;
+};
+
+// Processes the escape sequences of a string literal without its quotes
+std::string decode_string(std::string_view text);
+
+// Inverse of decode_string
+std::string escape_string(std::string_view text);
+
+}  // namespace CCOMP::AST
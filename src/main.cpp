@@ -1,26 +1,200 @@
+#include <future>
+
 #include "args.hpp"
+#include "ast_file.hpp"
+#include "benchmark.hpp"
 #include "common.hpp"
 #include "io.hpp"
 #include "parser.hpp"
 #include "preprocessor.hpp"
+#include "query.hpp"
+#include "rewrite.hpp"
+#include "structural_hash.hpp"
+#include "symbol_index.hpp"
 #include "visitors/dotVisitor.hpp"
 
 using CCOMP::Arguments;
 using CCOMP::Parser::parse;
 
-void run(const Arguments &args) {
+// nullptr if it stops after preprocessing
+std::unique_ptr<CCOMP::AST::Program> parse_source(const Arguments &args) {
+    // Build the ATNs while the preprocessor is running, unless nothing is
+    // parsed
+    std::future<void> parser_ready;
+    if (!args.stop_after_preprocessing) {
+        parser_ready =
+            std::async(std::launch::async, CCOMP::Parser::initialize);
+    }
+
     std::string file_content = preprocessor(args);
 
     if (args.stop_after_preprocessing) {
         printf("%s", file_content.c_str());
-        return;
+        return nullptr;
     }
 
     CCOMP::IO::write_file("foo.pre.c", file_content);
     /*     std::string file_content = CCOMP::IO::read_file(args.source_path); */
 
-    auto ast = parse(file_content);
+    CCOMP::Parser::Options options;
+    options.profile = args.profile_parser;
+    options.lazy_bodies = args.lazy_bodies;
+    options.file_name = args.source_path;
+
+    parser_ready.wait();
+    std::unique_ptr<CCOMP::AST::Program> ast;
+    if (args.reparse_path.empty()) {
+        ast = parse(file_content, options);
+    } else {
+        // Parses the source, then only what the edit to it changed. The
+        // edited file is preprocessed under the name of the source, so the
+        // two only differ where the edit is.
+        auto result = CCOMP::Parser::parse_incremental(file_content, options);
+        std::string edited =
+            CCOMP::preprocessor(args.reparse_path, args.source_path);
+        size_t reparsed = CCOMP::Parser::reparse(
+            result, CCOMP::Parser::difference(file_content, edited), options);
+        info("Reparsed %zu of %zu bytes", reparsed, edited.size());
+        ast = std::move(result.program);
+    }
     ast->file_location = args.source_path;
+    return ast;
+}
+
+static bool ends_with(const std::string &s, std::string_view suffix) {
+    return s.size() >= suffix.size() &&
+           s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Reports the top level declarations that did not change since the hashes
+// at path were written and replaces them with the current ones
+static void update_hashes(CCOMP::AST::Program &program,
+                          const std::string &path) {
+    auto previous = CCOMP::AST::HashFile::load(path);
+    CCOMP::AST::HashFile current;
+    size_t unchanged = 0;
+    for (auto &declaration : program.declarations) {
+        uint64_t hash = CCOMP::AST::structural_hash(*declaration);
+        if (previous.contains(hash)) {
+            unchanged++;
+        }
+        current.add(hash);
+    }
+    info("%zu of %zu top level declarations are unchanged", unchanged,
+         program.declarations.size());
+    current.save(path);
+}
+
+static void print_occurrences(const CCOMP::AST::SymbolIndex &index,
+                              const std::vector<std::string> &names) {
+    using CCOMP::AST::SymbolIndex;
+    for (auto &name : names) {
+        for (auto &occurrence : index.find(name)) {
+            if (occurrence.file != SymbolIndex::NONE) {
+                printf("%s:%u:%u: ",
+                       std::string(index.name(occurrence.file)).c_str(),
+                       occurrence.line, occurrence.column);
+            } else {
+                printf("offset %u: ", occurrence.location.get_offset());
+            }
+            printf("%s %s %s", name.c_str(),
+                   SymbolIndex::role_name(occurrence.role),
+                   SymbolIndex::kind_name(occurrence.kind));
+            if (occurrence.scope != SymbolIndex::NONE) {
+                printf(" in %s",
+                       std::string(index.name(occurrence.scope)).c_str());
+            }
+            printf("\n");
+        }
+    }
+}
+
+// A tag of the name is preferred over a declaration with it
+static void print_layouts(const CCOMP::AST::Program &program,
+                          const std::vector<std::string> &names) {
+    CCOMP::AST::QueryEngine queries;
+    queries.update(program);
+    for (auto &name : names) {
+        CCOMP::AST::DeclarationId tag = queries.id(name, true);
+        CCOMP::AST::DeclarationId id = queries.id(name);
+        CCOMP::AST::Layout layout;
+        if (queries.declaration(tag) != nullptr) {
+            layout = queries.layout(tag);
+        } else if (queries.declaration(id) != nullptr) {
+            layout = queries.layout_of(queries.type(id));
+        } else {
+            warn("%s is not declared", name.c_str());
+            continue;
+        }
+        if (layout.size == CCOMP::AST::CanonicalType::UNSIZED) {
+            printf("%s: incomplete\n", name.c_str());
+        } else {
+            printf("%s: size %llu, align %llu\n", name.c_str(),
+                   (unsigned long long)layout.size,
+                   (unsigned long long)layout.align);
+        }
+    }
+}
+
+void run(const Arguments &args) {
+    if (ends_with(args.source_path, ".idx")) {
+        // Written by --index, the queries need no program
+        auto index = CCOMP::AST::SymbolIndex::load(args.source_path);
+        print_occurrences(index, args.find);
+        return;
+    }
+
+    std::unique_ptr<CCOMP::AST::Program> ast;
+    if (ends_with(args.source_path, ".ast")) {
+        // Written by --ast, there is nothing to preprocess or parse
+        ast = CCOMP::AST::ASTFile::open(args.source_path)->program();
+    } else {
+        ast = parse_source(args);
+    }
+    if (!ast) {
+        return;
+    }
+
+    if (args.bench_visitors) {
+        CCOMP::AST::benchmark_visitors(*ast);
+        CCOMP::ThreadPool pool(args.threads);
+        CCOMP::AST::benchmark_passes(*ast, pool);
+    }
+
+    if (!args.index_path.empty() || !args.find.empty()) {
+        auto index = CCOMP::AST::SymbolIndex::build(*ast, ast->sources.get());
+        if (!args.index_path.empty()) {
+            index.save(args.index_path);
+        }
+        print_occurrences(index, args.find);
+    }
+
+    if (!args.layouts.empty()) {
+        print_layouts(*ast, args.layouts);
+    }
+
+    if (args.fold_constants || args.shift_multiplications) {
+        CCOMP::AST::RewriteRules rules;
+        if (args.fold_constants) {
+            CCOMP::AST::add_folding_rules(rules);
+        }
+        if (args.shift_multiplications) {
+            CCOMP::AST::add_shift_rules(rules);
+        }
+        CCOMP::ThreadPool pool(args.threads);
+        CCOMP::AST::PassManager passes(&pool);
+        passes.add<CCOMP::AST::Rewriter>(rules);
+        passes.run(*ast);
+        trace("Rewrote %zu expressions", rules.applied());
+    }
+
+    if (!args.hashes_path.empty()) {
+        update_hashes(*ast, args.hashes_path);
+    }
+
+    if (!args.ast_path.empty()) {
+        CCOMP::AST::write_ast_file(*ast, args.ast_path);
+    }
 
     // Generate Visually
     if (!args.dot_path.empty()) {
@@ -1,22 +1,457 @@
 #include "parser.hpp"
 
+#include <algorithm>
+#include <cstdio>
+#include <tuple>
+#include <vector>
+
 #include "ANTLRInputStream.h"
 #include "antlr/CLexer.h"
 #include "antlr/CParser.h"
+#include "atn/ATN.h"
+#include "atn/DecisionInfo.h"
+#include "atn/DecisionState.h"
+#include "atn/ParseInfo.h"
 /* #include "antlr4-runtime.h" */
+#include "body_filter.hpp"
 #include "common.hpp"
+#include "error_strategy.hpp"
+#include "tokens.hpp"
+#include "typedefs.hpp"
+#include "visitors/locationShiftVisitor.hpp"
 
 using CCOMP::AST::AST;
+using CCOMP::AST::Block;
+using CCOMP::AST::CowPtr;
+using CCOMP::AST::LazyBody;
+using CCOMP::AST::LocationShiftVisitor;
+using CCOMP::AST::StringPool;
+using CCOMP::SourceLocation;
+using CCOMP::SourceManager;
 
-std::unique_ptr<Program> CCOMP::Parser::parse(const std::string &source) {
-    trace("Parsing source code");
+static CCOMP::Parser::PanicPoints panic_points() {
+    return {CParser::RuleProgram, CParser::RuleGlobalDeclaration,
+            CParser::SEMICOLON, CParser::LBRACE, CParser::RBRACE};
+}
+
+namespace {
+
+// Function body skipped by the LazyBodyFilter. It is lexed again from the
+// source and parsed with the typedefs declared in front of the function.
+class SourceBody : public LazyBody {
+   public:
+    // line and column of the '{' in the buffer are only used for
+    // diagnostics
+    SourceBody(std::shared_ptr<const SourceManager> sources, uint32_t offset,
+               uint32_t length, uint32_t line, uint32_t column,
+               std::shared_ptr<const CCOMP::Parser::TypedefTable> typedefs,
+               std::shared_ptr<StringPool> strings)
+        : SourceBody(SourceLocation(offset), std::move(sources), offset,
+                     length, line, column, typedefs->position(),
+                     std::move(typedefs), std::move(strings)) {
+    }
+
+    [[nodiscard]] std::unique_ptr<LazyBody> moved(
+        int64_t delta) const override {
+        return std::unique_ptr<LazyBody>(
+            new SourceBody(location.moved(delta), sources, offset, length, line,
+                           column, typedefs_position, typedefs, strings));
+    }
+
+   protected:
+    CowPtr<Block> parse() override {
+        using namespace CCOMP::Parser;
+        trace("Parsing function body at %u", location.get_offset());
+
+        std::string_view text =
+            std::string_view(sources->buffer()).substr(offset, length);
+        auto table = typedefs->at(typedefs_position);
+
+        antlr4::ANTLRInputStream input(text);
+        ArenaTokenFactory factory(text);
+        factory.set_typedefs(table.get(), CLexer::IDENTIFIER,
+                             CLexer::TYPEDEF_NAME);
+        CLexer lexer(&input);
+        lexer.setTokenFactory(&factory);
+        lexer.setLine(line);
+        lexer.setCharPositionInLine(column);
+        PresumedErrorListener listener(sources);
+        lexer.removeErrorListeners();
+        lexer.addErrorListener(&listener);
+        antlr4::CommonTokenStream tokens(&lexer);
+        CParser parser(&tokens);
+        parser.removeErrorListeners();
+        parser.addErrorListener(&listener);
+        // An earlier edit may have moved the body since it was skipped
+        parser.base_offset = location.get_offset();
+        parser.typedefs = table;
+        parser.strings = strings;
+        parser.setErrorHandler(
+            std::make_shared<PanicErrorStrategy>(panic_points(), nullptr));
+
+        try {
+            return std::move(parser.block()->ast);
+        } catch (antlr4::RecognitionException &e) {
+            // Already reported, the body stays empty like a skipped
+            // declaration
+            return std::make_unique<Block>(location);
+        }
+    }
+
+   private:
+    // location is where an edit moved the body, offset where it is in the
+    // buffer
+    SourceBody(SourceLocation location,
+               std::shared_ptr<const SourceManager> sources, uint32_t offset,
+               uint32_t length, uint32_t line, uint32_t column,
+               size_t typedefs_position,
+               std::shared_ptr<const CCOMP::Parser::TypedefTable> typedefs,
+               std::shared_ptr<StringPool> strings)
+        : LazyBody(location),
+          sources(std::move(sources)),
+          offset(offset),
+          length(length),
+          line(line),
+          column(column),
+          typedefs_position(typedefs_position),
+          typedefs(std::move(typedefs)),
+          strings(std::move(strings)) {
+    }
+
+    // The buffer the body was skipped in, offset is relative to it
+    std::shared_ptr<const SourceManager> sources;
+    uint32_t offset, length;
+    uint32_t line, column;
+
+    size_t typedefs_position;
+    std::shared_ptr<const CCOMP::Parser::TypedefTable> typedefs;
+    std::shared_ptr<StringPool> strings;
+};
+
+// Where a parsed text starts in the buffer of sources
+struct TextPosition {
+    std::shared_ptr<const SourceManager> sources;
+    uint32_t offset = 0;
+    uint32_t line = 1, column = 0;
+};
 
-    antlr4::ANTLRInputStream input(source);
+struct TextParse {
+    std::unique_ptr<Program> program;
+    std::vector<CCOMP::Parser::DeclarationSpan> spans;
+    size_t errors = 0;
+};
+
+}  // namespace
+
+void CCOMP::Parser::initialize() {
+    trace("Initializing lexer and parser");
+    CLexer::initialize();
+    CParser::initialize();
+}
+
+static void print_profile(CParser &parser) {
+    auto infos = parser.getParseInfo().getDecisionInfo();
+
+    // DecisionInfo is not assignable, sort pointers to it
+    std::vector<const antlr4::atn::DecisionInfo *> decisions;
+    for (const auto &info : infos) {
+        decisions.push_back(&info);
+    }
+    std::sort(decisions.begin(), decisions.end(),
+              [](const auto *a, const auto *b) {
+                  return a->timeInPrediction > b->timeInPrediction;
+              });
+
+    const auto &atn = parser.getATN();
+    const auto &rules = parser.getRuleNames();
+
+    fprintf(stderr, "%-4s %-32s %10s %10s %8s %8s %8s %8s\n", "dec", "rule",
+            "calls", "time ms", "SLL max", "LL fall", "LL max", "ambig");
+    for (const auto *d : decisions) {
+        if (d->invocations == 0) {
+            continue;
+        }
+        size_t rule = atn.decisionToState[d->decision]->ruleIndex;
+        fprintf(stderr, "%-4zu %-32s %10lld %10.3f %8lld %8lld %8lld %8zu\n",
+                d->decision, rules[rule].c_str(), d->invocations,
+                d->timeInPrediction / 1e6, d->SLL_MaxLook, d->LL_Fallback,
+                d->LL_MaxLook, d->ambiguities.size());
+    }
+}
+
+// Parses a sequence of top level declarations. A nullptr strings starts a new
+// pool. A speculative parse only counts its syntax errors, the caller tries
+// a larger text if there are any.
+static TextParse parse_text(std::string_view text, const TextPosition &position,
+                            std::shared_ptr<CCOMP::Parser::TypedefTable> typedefs,
+                            std::shared_ptr<StringPool> strings,
+                            const CCOMP::Parser::Options &options,
+                            bool speculative = false) {
+    using namespace CCOMP::Parser;
+
+    // The parser fetches the first token in its constructor, so the table has
+    // to be known to the factory before
+    antlr4::ANTLRInputStream input(text);
+    ArenaTokenFactory factory(text);
+    factory.set_typedefs(typedefs.get(), CLexer::IDENTIFIER,
+                         CLexer::TYPEDEF_NAME);
     CLexer lexer(&input);
-    antlr4::CommonTokenStream tokens(&lexer);
+    lexer.setTokenFactory(&factory);
+    lexer.setLine(position.line);
+    lexer.setCharPositionInLine(position.column);
+    PresumedErrorListener listener(position.sources);
+    lexer.removeErrorListeners();
+    if (!speculative) {
+        lexer.addErrorListener(&listener);
+    }
+    LazyBodyFilter filter(
+        lexer, {CLexer::LPAREN, CLexer::RPAREN, CLexer::LBRACE, CLexer::RBRACE,
+                CLexer::SEMICOLON, CLexer::EQUAL, CLexer::ATTRIBUTE,
+                CLexer::ASSEMBLY, CLexer::LAZY_BODY});
+    antlr4::CommonTokenStream tokens(
+        options.lazy_bodies ? static_cast<antlr4::TokenSource *>(&filter)
+                            : &lexer);
     CParser parser(&tokens);
+    parser.removeErrorListeners();
+    if (!speculative) {
+        parser.addErrorListener(&listener);
+    }
+    parser.base_offset = position.offset;
+    parser.typedefs = typedefs;
+    if (strings) {
+        parser.strings = strings;
+    }
+    if (options.lazy_bodies) {
+        // The bodies are parsed after this function returned
+        auto sources = position.sources;
+        uint32_t base = position.offset;
+        auto pool = parser.strings;
+        parser.make_lazy_body = [sources, base, typedefs,
+                                 pool](antlr4::Token *token) {
+            auto *body = static_cast<ArenaToken *>(token);
+            return std::make_unique<SourceBody>(
+                sources, base + body->get_offset(), body->view().size(),
+                token->getLine(), token->getCharPositionInLine(), typedefs,
+                pool);
+        };
+    }
+    parser.setErrorHandler(std::make_shared<PanicErrorStrategy>(
+        panic_points(), [&]() {
+            // The broken declaration may have left scopes open
+            typedefs->reset();
+            parser.retype_lookahead();
+        }));
+    if (options.profile) {
+        parser.setProfile(true);
+    }
+
+    TextParse erg;
+    erg.program = std::move(parser.program()->ast);
+    erg.program->sources = position.sources;
 
-    auto tree = parser.program();
+    if (options.profile) {
+        print_profile(parser);
+    }
+
+    erg.errors =
+        parser.getNumberOfSyntaxErrors() + lexer.getNumberOfSyntaxErrors();
+    if (erg.errors > 0) {
+        trace("%zu syntax errors", erg.errors);
+    }
+
+    erg.spans = std::move(parser.declaration_spans);
+    for (auto &span : erg.spans) {
+        span.begin += position.offset;
+        span.end += position.offset;
+    }
+    return erg;
+}
+
+std::unique_ptr<Program> CCOMP::Parser::parse(const std::string &source,
+                                              const Options &options) {
+    trace("Parsing source code");
+
+    TextPosition position;
+    position.sources = std::make_shared<const SourceManager>(
+        std::make_shared<const std::string>(source), options.file_name);
+    return parse_text(position.sources->buffer(), position,
+                      std::make_shared<TypedefTable>(), nullptr, options)
+        .program;
+}
+
+CCOMP::Parser::ParseResult CCOMP::Parser::parse_incremental(
+    std::string source, const Options &options) {
+    trace("Parsing source code incrementally");
+
+    ParseResult result;
+    result.source = std::make_shared<const std::string>(std::move(source));
+    result.typedefs = std::make_shared<TypedefTable>();
+
+    TextPosition position;
+    position.sources =
+        std::make_shared<const SourceManager>(result.source, options.file_name);
+    auto parsed = parse_text(*result.source, position, result.typedefs,
+                             nullptr, options);
+    result.program = std::move(parsed.program);
+    result.spans = std::move(parsed.spans);
+    return result;
+}
+
+// Line and column ANTLR reports for the byte at offset
+static std::pair<uint32_t, uint32_t> text_position(std::string_view text,
+                                                   uint32_t offset) {
+    uint32_t line = 1, column = 0;
+    for (uint32_t i = 0; i < offset && i < text.size(); i++) {
+        if (text[i] == '\n') {
+            line++;
+            column = 0;
+        } else if ((static_cast<unsigned char>(text[i]) & 0xc0) != 0x80) {
+            // Columns count code points
+            column++;
+        }
+    }
+    return {line, column};
+}
+
+// Replaces the declarations [first, last) and their spans by the reparsed ones
+// and moves everything behind them by delta bytes
+static void splice(CCOMP::Parser::ParseResult &result, size_t first,
+                   size_t last, TextParse parsed, int64_t delta) {
+    auto &spans = result.spans;
+    auto &declarations = result.program->declarations;
+
+    // Skipped declarations have a span but no node
+    auto index = std::count_if(spans.begin(), spans.begin() + first,
+                               [](const auto &span) { return span.in_program; });
+    auto removed =
+        std::count_if(spans.begin() + first, spans.begin() + last,
+                      [](const auto &span) { return span.in_program; });
+    auto &added = parsed.program->declarations;
+    declarations.erase(declarations.begin() + index,
+                       declarations.begin() + index + removed);
+    declarations.insert(declarations.begin() + index,
+                        std::make_move_iterator(added.begin()),
+                        std::make_move_iterator(added.end()));
+
+    spans.erase(spans.begin() + first, spans.begin() + last);
+    spans.insert(spans.begin() + first, parsed.spans.begin(),
+                 parsed.spans.end());
+    size_t behind = first + parsed.spans.size();
+    for (size_t i = behind; i < spans.size(); i++) {
+        spans[i].begin += delta;
+        spans[i].end += delta;
+    }
+
+    result.program->sources = parsed.program->sources;
+    if (delta == 0) {
+        return;
+    }
+    // Declarations shared with earlier versions of the Program are copied
+    LocationShiftVisitor shift(delta);
+    for (size_t i = index + added.size(); i < declarations.size(); i++) {
+        shift.shift(declarations[i]);
+    }
+}
+
+size_t CCOMP::Parser::reparse(ParseResult &result, const Edit &edit,
+                              const Options &options) {
+    const std::string &old_source = *result.source;
+    if (edit.offset + edit.length > old_source.size()) {
+        die("Edit at %u+%u is out of range", edit.offset, edit.length);
+    }
+
+    auto source = std::make_shared<std::string>();
+    source->reserve(old_source.size() + edit.text.size() - edit.length);
+    source->append(old_source, 0, edit.offset);
+    source->append(edit.text);
+    source->append(old_source, edit.offset + edit.length);
+    int64_t delta = (int64_t)edit.text.size() - edit.length;
+    auto sources = std::make_shared<const SourceManager>(source,
+                                                         options.file_name);
+
+    // Declarations [first, last) touch the edit. Touching counts, the edit
+    // may extend a token at their border.
+    auto &spans = result.spans;
+    size_t first = 0;
+    while (first < spans.size() && spans[first].end < edit.offset) {
+        first++;
+    }
+    size_t last = first;
+    while (last < spans.size() &&
+           spans[last].begin <= edit.offset + edit.length) {
+        last++;
+    }
+
+    for (size_t grow = 1;; grow *= 2) {
+        if (first == 0 && last == spans.size()) {
+            trace("Reparsing the whole file");
+            result = parse_incremental(*source, options);
+            return result.source->size();
+        }
+
+        // The region includes the whitespace and comments around the
+        // declarations, in old coordinates
+        uint32_t begin = first > 0 ? spans[first - 1].end : 0;
+        uint32_t end = last < spans.size() ? spans[last].begin
+                                           : old_source.size();
+        size_t typedefs_begin = first < spans.size()
+                                    ? spans[first].typedefs
+                                    : result.typedefs->position();
+        size_t typedefs_end = last < spans.size()
+                                  ? spans[last].typedefs
+                                  : result.typedefs->position();
+
+        TextPosition position;
+        position.sources = sources;
+        position.offset = begin;
+        std::tie(position.line, position.column) =
+            text_position(*source, begin);
+
+        std::string_view text =
+            std::string_view(*source).substr(begin, end + delta - begin);
+        trace("Reparsing declarations %zu to %zu, %zu bytes", first, last,
+              text.size());
+
+        auto table = result.typedefs->at(typedefs_begin);
+        auto parsed = parse_text(text, position, table,
+                                 result.program->strings, options, true);
+
+        // The declarations behind have to see the same typedefs as before
+        const auto &old_changes = result.typedefs->changes();
+        const auto &new_changes = table->changes();
+        bool same_typedefs =
+            new_changes.size() - typedefs_begin ==
+                typedefs_end - typedefs_begin &&
+            std::equal(new_changes.begin() + typedefs_begin, new_changes.end(),
+                       old_changes.begin() + typedefs_begin);
+
+        if (parsed.errors == 0 && same_typedefs) {
+            splice(result, first, last, std::move(parsed), delta);
+            result.source = std::move(source);
+            return text.size();
+        }
+
+        first = first > grow ? first - grow : 0;
+        last = std::min(spans.size(), last + grow);
+    }
+}
 
-    return std::move(tree->ast);
+CCOMP::Parser::Edit CCOMP::Parser::difference(std::string_view before,
+                                              std::string_view after) {
+    size_t prefix = 0;
+    size_t shorter = std::min(before.size(), after.size());
+    while (prefix < shorter && before[prefix] == after[prefix]) {
+        prefix++;
+    }
+    size_t suffix = 0;
+    while (suffix < shorter - prefix &&
+           before[before.size() - suffix - 1] ==
+               after[after.size() - suffix - 1]) {
+        suffix++;
+    }
+    Edit edit;
+    edit.offset = prefix;
+    edit.length = before.size() - prefix - suffix;
+    edit.text = after.substr(prefix, after.size() - prefix - suffix);
+    return edit;
 }
@@ -1,7 +1,67 @@
 #pragma once
 
+#include <string>
+#include <string_view>
+
 #include "ast.hpp"
+#include "typedefs.hpp"
 
 namespace CCOMP::Parser {
-std::unique_ptr<CCOMP::AST::Program> parse(const std::string &source);
+// Builds the ATNs of the lexer and the parser. The first parse does this
+// anyway, calling it early lets it overlap with other work.
+void initialize();
+
+struct Options {
+    // Print prediction statistics of every grammar decision to stderr
+    bool profile = false;
+
+    // Skip the bodies of function definitions and only parse them when
+    // FunctionDefinition::body is first called
+    bool lazy_bodies = false;
+
+    // Diagnostics use it for the lines in front of the first line marker
+    std::string file_name = "<input>";
+};
+
+std::unique_ptr<CCOMP::AST::Program> parse(const std::string &source,
+                                           const Options &options = {});
+
+// Byte range of a top level declaration in the source
+struct DeclarationSpan {
+    uint32_t begin, end;
+    // TypedefTable::position in front of the declaration
+    size_t typedefs;
+    // Broken declarations are skipped and have no node in the Program
+    bool in_program;
+};
+
+// Everything reparse needs to update a Program after an edit
+struct ParseResult {
+    std::shared_ptr<const std::string> source;
+    std::unique_ptr<CCOMP::AST::Program> program;
+    std::vector<DeclarationSpan> spans;
+    std::shared_ptr<TypedefTable> typedefs;
+};
+
+// Replaces length bytes at offset by text
+struct Edit {
+    uint32_t offset, length;
+    std::string text;
+};
+
+// The one edit turning before into after, it replaces what lies between
+// their common prefix and suffix
+Edit difference(std::string_view before, std::string_view after);
+
+ParseResult parse_incremental(std::string source, const Options &options = {});
+
+// Applies the edit to result.source and reparses only the top level
+// declarations touching it. The region grows if it does not parse on its
+// own or changes the typedefs seen by the declarations behind it, in the
+// worst case to the whole file. Only that last parse reports syntax errors.
+// Declarations behind the edit are moved by path copying, so trees sharing
+// them with result.program keep their locations. Returns the number of
+// reparsed bytes.
+size_t reparse(ParseResult &result, const Edit &edit,
+               const Options &options = {});
 }  // namespace CCOMP::Parser
@@ -0,0 +1,181 @@
+#include "pass_manager.hpp"
+
+#include "common.hpp"
+#include "traversal.hpp"
+
+namespace CCOMP::AST {
+
+// The lazy bodies share the typedef table of their file, so they are parsed
+// one after another before the declarations are spread over threads
+static void parse_bodies(const Program &program) {
+    for (auto &declaration : program.declarations) {
+        auto *definition = dyn_cast<FunctionDefinition>(declaration.get());
+        if (definition != nullptr) {
+            definition->body();
+        }
+    }
+}
+
+void PassManager::run(Program &program) {
+    m_walks = 0;
+    // The results of declarations that left the program would be kept, and
+    // the nodes with them, as long as the manager lives
+    std::unordered_set<const AST *> declarations;
+    for (auto &declaration : program.declarations) {
+        declarations.insert(declaration.get());
+    }
+    for (auto &analysis : analyses) {
+        analysis->retain(declarations);
+    }
+
+    Group group;
+    for (size_t i = 0; i <= steps.size(); i++) {
+        if (i < steps.size() && steps[i].analysis != nullptr) {
+            group.passes.push_back(steps[i].analysis);
+            continue;
+        }
+
+        // A transform or the end closes the group of analyses before it
+        if (!group.passes.empty()) {
+            run_group(program, group);
+            group = Group();
+        }
+        if (i < steps.size()) {
+            run_transform(program, *steps[i].transform);
+        }
+    }
+    trace("Passes walked %zu top level declarations", m_walks);
+}
+
+void PassManager::invalidate(const AST *declaration) {
+    for (auto &analysis : analyses) {
+        analysis->forget(declaration);
+    }
+}
+
+void PassManager::for_each_index(size_t count,
+                                 const std::function<void(size_t)> &f) {
+    if (pool != nullptr) {
+        pool->parallel_for(count, f);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        f(i);
+    }
+}
+
+void PassManager::run_group(Program &program, Group &group) {
+    size_t count = group.passes.size();
+    for (size_t kind = 0; kind < KIND_COUNT; kind++) {
+        for (uint32_t i = 0; i < count; i++) {
+            Pass *pass = group.passes[i];
+            if (!pass->kinds[kind]) {
+                continue;
+            }
+            if (pass->hooks & Pass::PRE) {
+                group.pre[kind].push_back(i);
+            }
+            if (pass->hooks & Pass::POST) {
+                group.post[kind].push_back(i);
+            }
+        }
+    }
+
+    // The results are created up front, the walks only fill them
+    auto &declarations = program.declarations;
+    std::vector<void *> results(declarations.size() * count, nullptr);
+    std::vector<size_t> stale;
+    for (size_t d = 0; d < declarations.size(); d++) {
+        const AST *declaration = declarations[d].get();
+        bool walk = false;
+        for (size_t i = 0; i < count; i++) {
+            if (!group.passes[i]->cached(declaration)) {
+                results[d * count + i] =
+                    group.passes[i]->prepare(declarations[d]);
+                walk = true;
+            }
+        }
+        if (walk) {
+            stale.push_back(d);
+        }
+    }
+    if (stale.empty()) {
+        return;
+    }
+    m_walks += stale.size();
+
+    parse_bodies(program);
+    for_each_index(stale.size(), [&](size_t i) {
+        size_t d = stale[i];
+        walk(*declarations[d], group, &results[d * count]);
+    });
+
+    for (size_t d : stale) {
+        for (size_t i = 0; i < count; i++) {
+            if (results[d * count + i] != nullptr) {
+                group.passes[i]->walk_merge(*declarations[d],
+                                            results[d * count + i]);
+            }
+        }
+    }
+}
+
+void PassManager::run_transform(Program &program, Transform &transform) {
+    trace("Running transform %s", transform.name);
+    auto &declarations = program.declarations;
+    std::vector<const AST *> old(declarations.size());
+    std::vector<char> changed(declarations.size());
+    for (size_t d = 0; d < declarations.size(); d++) {
+        old[d] = declarations[d].get();
+    }
+
+    parse_bodies(program);
+    for_each_index(declarations.size(), [&](size_t d) {
+        changed[d] = transform.run(declarations[d]);
+    });
+
+    for (size_t d = 0; d < declarations.size(); d++) {
+        if (changed[d]) {
+            invalidate(old[d]);
+        }
+    }
+}
+
+void PassManager::walk(const AST &declaration, const Group &group,
+                       void *const *results) {
+    size_t count = group.passes.size();
+    for (size_t i = 0; i < count; i++) {
+        if (results[i] != nullptr) {
+            group.passes[i]->walk_begin(declaration, results[i]);
+        }
+    }
+
+    Traversal traversal(declaration);
+    Traversal::Event event;
+    while (traversal.next(event)) {
+        size_t kind = (size_t)event.node->kind;
+        if (event.order == Traversal::Order::PRE) {
+            for (uint32_t i : group.pre[kind]) {
+                if (results[i] != nullptr) {
+                    group.passes[i]->walk_pre(*event.node, event.depth,
+                                              results[i]);
+                }
+            }
+        } else {
+            for (uint32_t i : group.post[kind]) {
+                if (results[i] != nullptr) {
+                    group.passes[i]->walk_post(*event.node, event.depth,
+                                               results[i]);
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (results[i] != nullptr) {
+            group.passes[i]->walk_end(declaration, results[i]);
+        }
+    }
+}
+
+}  // namespace CCOMP::AST
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "ast.hpp"
+#include "thread_pool.hpp"
+
+namespace CCOMP::AST {
+
+// An analysis run by a PassManager. It declares which hooks it has and which
+// kinds of nodes it looks at, so the manager can walk a top level declaration
+// once for all analyses and only call the ones a node concerns. Analyses
+// get const nodes, they must not change the tree. See Analysis for the
+// hooks.
+class Pass {
+   public:
+    enum Hooks : uint8_t {
+        // pre is called before the children of a node
+        PRE = 1,
+        // post after them
+        POST = 2,
+    };
+    using Kinds = std::bitset<KIND_COUNT>;
+
+    Pass(const char *name, uint8_t hooks, Kinds kinds = Kinds().set())
+        : name(name), hooks(hooks), kinds(kinds) {
+    }
+    virtual ~Pass() = default;
+
+    // The result for declaration is still valid, it is not walked again
+    [[nodiscard]] virtual bool cached(const AST *declaration) const = 0;
+    virtual void forget(const AST *declaration) = 0;
+    // Forgets the results of the declarations not in declarations
+    virtual void retain(
+        const std::unordered_set<const AST *> &declarations) = 0;
+
+   public:
+    const char *name;
+    uint8_t hooks;
+    Kinds kinds;
+
+   private:
+    friend class PassManager;
+
+    // Creates the empty result of a declaration before it is walked, the
+    // hooks get it back
+    virtual void *prepare(const CowPtr<AST> &declaration) = 0;
+    virtual void walk_begin(const AST &declaration, void *result) = 0;
+    virtual void walk_pre(const AST &node, size_t depth, void *result) = 0;
+    virtual void walk_post(const AST &node, size_t depth, void *result) = 0;
+    virtual void walk_end(const AST &declaration, void *result) = 0;
+    virtual void walk_merge(const AST &declaration, void *result) = 0;
+};
+
+// A pass with a Result for every top level declaration. The hooks get the
+// result of the declaration they are called for. With a ThreadPool several
+// declarations are walked at the same time, so they should change nothing
+// else but may use ThreadPool::scratch.
+template <typename Result>
+class Analysis : public Pass {
+   public:
+    using Pass::Pass;
+
+    // nullptr if the declaration was not walked or invalidated since
+    [[nodiscard]] const Result *result(const AST *declaration) const {
+        auto it = results.find(declaration);
+        return it == results.end() ? nullptr : &it->second.result;
+    }
+
+    [[nodiscard]] bool cached(const AST *declaration) const override {
+        return results.count(declaration) > 0;
+    }
+    void forget(const AST *declaration) override {
+        results.erase(declaration);
+    }
+    void retain(
+        const std::unordered_set<const AST *> &declarations) override {
+        for (auto it = results.begin(); it != results.end();) {
+            if (declarations.count(it->first) > 0) {
+                ++it;
+            } else {
+                it = results.erase(it);
+            }
+        }
+    }
+
+    // Number of declarations with a result
+    [[nodiscard]] size_t size() const {
+        return results.size();
+    }
+
+   protected:
+    // Called around the nodes of a top level declaration. The depth of the
+    // declaration itself is 0.
+    virtual void begin(const AST &, Result &) {
+    }
+    virtual void pre(const AST &, size_t, Result &) {
+    }
+    virtual void post(const AST &, size_t, Result &) {
+    }
+    virtual void end(const AST &, Result &) {
+    }
+    // Called on the thread running the manager for every walked declaration
+    // in source order, after all of them were walked
+    virtual void merge(const AST &, const Result &) {
+    }
+
+   private:
+    // The declaration is kept alive with its result, so its address is not
+    // reused by a new node while the result can be found under it
+    struct Entry {
+        CowPtr<AST> owner;
+        Result result;
+    };
+
+    void *prepare(const CowPtr<AST> &declaration) final {
+        Entry &entry = results[declaration.get()];
+        entry.owner = declaration;
+        entry.result = Result();
+        return &entry.result;
+    }
+    void walk_begin(const AST &declaration, void *result) final {
+        begin(declaration, *static_cast<Result *>(result));
+    }
+    void walk_pre(const AST &node, size_t depth, void *result) final {
+        pre(node, depth, *static_cast<Result *>(result));
+    }
+    void walk_post(const AST &node, size_t depth, void *result) final {
+        post(node, depth, *static_cast<Result *>(result));
+    }
+    void walk_end(const AST &declaration, void *result) final {
+        end(declaration, *static_cast<Result *>(result));
+    }
+    void walk_merge(const AST &declaration, void *result) final {
+        merge(declaration, *static_cast<Result *>(result));
+    }
+
+    std::unordered_map<const AST *, Entry> results;
+};
+
+// Changes the tree one top level declaration at a time
+class Transform {
+   public:
+    explicit Transform(const char *name) : name(name) {
+    }
+    virtual ~Transform() = default;
+
+    // True if it changed declaration, the results of the analyses for it
+    // are dropped then. It may replace the node as well. With a ThreadPool
+    // it is called for several declarations at the same time.
+    virtual bool run(CowPtr<AST> &declaration) = 0;
+
+   public:
+    const char *name;
+};
+
+// Runs passes in the order they were added. Consecutive analyses are fused,
+// every top level declaration is walked once for all of them, and only if
+// one of them has no result for it. Running the manager again therefore only
+// walks the declarations a transform changed or that were invalidated.
+// With a ThreadPool the declarations are spread over its threads.
+//
+//     PassManager passes;
+//     auto &calls = passes.add<CallCounter>();
+//     passes.add<Inliner>(calls);
+//     passes.run(program);
+class PassManager {
+   public:
+    explicit PassManager(ThreadPool *pool = nullptr) : pool(pool) {
+    }
+
+    template <typename P, typename... A>
+    P &add(A &&...args) {
+        auto pass = std::make_unique<P>(std::forward<A>(args)...);
+        P &ref = *pass;
+        if constexpr (std::is_base_of_v<Pass, P>) {
+            steps.push_back({pass.get(), nullptr});
+            analyses.push_back(std::move(pass));
+        } else {
+            static_assert(std::is_base_of_v<Transform, P>);
+            steps.push_back({nullptr, pass.get()});
+            transforms.push_back(std::move(pass));
+        }
+        return ref;
+    }
+
+    void run(Program &program);
+
+    // Drops the results of every analysis for a top level declaration that
+    // was changed outside of a Transform
+    void invalidate(const AST *declaration);
+
+    // Walks of top level declarations in the last run
+    [[nodiscard]] size_t walks() const {
+        return m_walks;
+    }
+
+   private:
+    struct Step {
+        Pass *analysis;
+        Transform *transform;
+    };
+
+    // Consecutive analyses, read by all threads walking them
+    struct Group {
+        std::vector<Pass *> passes;
+        // Indices into passes of the ones with a hook for each kind
+        std::vector<uint32_t> pre[KIND_COUNT];
+        std::vector<uint32_t> post[KIND_COUNT];
+    };
+
+    void run_group(Program &program, Group &group);
+    void run_transform(Program &program, Transform &transform);
+    // results holds one per pass of the group, nullptr for cached ones
+    static void walk(const AST &declaration, const Group &group,
+                     void *const *results);
+    void for_each_index(size_t count, const std::function<void(size_t)> &f);
+
+    ThreadPool *pool;
+    std::vector<std::unique_ptr<Pass>> analyses;
+    std::vector<std::unique_ptr<Transform>> transforms;
+    std::vector<Step> steps;
+    size_t m_walks = 0;
+};
+
+}  // namespace CCOMP::AST
@@ -1,14 +1,53 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 #include "args.hpp"
 #include "io.hpp"
 
 namespace CCOMP {
 
+// Replaces the file name from by to in the line markers of preprocessed text
+std::string static inline rename_line_markers(std::string_view text,
+                                              const std::string &from,
+                                              const std::string &to) {
+    std::string quoted_from = "\"" + from + "\"";
+    std::string quoted_to = "\"" + to + "\"";
+    std::string erg;
+    erg.reserve(text.size());
+    while (!text.empty()) {
+        size_t end = text.find('\n');
+        end = end == std::string_view::npos ? text.size() : end + 1;
+        std::string_view line = text.substr(0, end);
+        text.remove_prefix(end);
+
+        size_t at = line[0] == '#' ? line.find(quoted_from)
+                                   : std::string_view::npos;
+        if (at == std::string_view::npos) {
+            erg += line;
+            continue;
+        }
+        erg += line.substr(0, at);
+        erg += quoted_to;
+        erg += line.substr(at + quoted_from.size());
+    }
+    return erg;
+}
+
+// Preprocesses the file at path as if it was named name. An edited copy of a
+// file then preprocesses to the same text as the file around the edit.
+std::string static inline preprocessor(const std::string &path,
+                                       const std::string &name) {
+    std::string text = IO::exec("clang -E " + path);
+    if (path == name) {
+        return text;
+    }
+    return rename_line_markers(text, path, name);
+}
+
 std::string static inline preprocessor(const Arguments &args) {
-    return IO::exec("clang -E " + args.source_path);
+    return preprocessor(args.source_path, args.source_path);
 }
 
 }  // namespace CCOMP
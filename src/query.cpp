@@ -0,0 +1,441 @@
+#include "query.hpp"
+
+#include <algorithm>
+
+#include "common.hpp"
+
+namespace CCOMP::AST {
+
+using Builtin = CanonicalType::Builtin;
+
+DeclarationId QueryEngine::id(std::string_view name, bool tag) {
+    return names.intern(name) * 2 + (tag ? 1 : 0);
+}
+
+// Tags defined by a type and the constants of enums. Tags defined inside a
+// struct are declared at file scope as well.
+template <typename F>
+static void declared_tags(const Type *type, F &f) {
+    if (type == nullptr) {
+        return;
+    }
+    auto members = [&](auto *tag) {
+        if (!tag->definition) {
+            return;
+        }
+        if (!tag->name->name.empty()) {
+            f(tag->name->name, true, tag);
+        }
+        for (auto &member : tag->members) {
+            if (member->name && member->name->owns_type()) {
+                declared_tags(member->type(), f);
+            }
+        }
+    };
+    switch (type->kind) {
+        case Kind::STRUCT_TYPE:
+            members(cast<StructType>(type));
+            break;
+        case Kind::UNION_TYPE:
+            members(cast<UnionType>(type));
+            break;
+        case Kind::ENUM_TYPE: {
+            auto *tag = cast<EnumType>(type);
+            if (!tag->definition) {
+                break;
+            }
+            if (!tag->name->name.empty()) {
+                f(tag->name->name, true, tag);
+            }
+            for (auto &value : tag->values) {
+                f(value->name->name, false, value.get());
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Calls f(name, tag, node) for every name a top level declaration declares
+template <typename F>
+static void declared_names(const AST &node, F &&f) {
+    // A struct, union or enum on its own
+    if (auto *type = dyn_cast<Type>(&node)) {
+        declared_tags(type, f);
+        return;
+    }
+    auto *declaration = dyn_cast<Declaration>(&node);
+    if (declaration == nullptr) {
+        return;
+    }
+    bool named = declaration->name && !declaration->name->name.empty();
+    if (named) {
+        f(declaration->name->name, false, declaration);
+    }
+    // In int a, b; only the first declaration owns the type
+    if (declaration->owns_type() ||
+        (declaration->name && declaration->name->owns_type())) {
+        declared_tags(declaration->type(), f);
+    }
+}
+
+void QueryEngine::update(const Program &program) {
+    m_revision++;
+    types.set_sources(program.sources);
+    std::vector<Input> next(inputs.size());
+    for (auto &declaration : program.declarations) {
+        declared_names(*declaration, [&](std::string_view name, bool tag,
+                                         const AST *node) {
+            DeclarationId i = id(name, tag);
+            if (i >= next.size()) {
+                next.resize(i + 1);
+            }
+            Input &input = next[i];
+            if (input.node != nullptr &&
+                input.node->kind == Kind::FUNCTION_DEFINITION &&
+                node->kind != Kind::FUNCTION_DEFINITION) {
+                return;
+            }
+            input.owner = declaration;
+            input.node = node;
+        });
+    }
+
+    inputs.resize(std::max(inputs.size(), next.size()));
+    next.resize(inputs.size());
+    size_t changed = 0;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (next[i].node == inputs[i].node) {
+            next[i].changed = inputs[i].changed;
+        } else {
+            next[i].changed = m_revision;
+            changed++;
+        }
+    }
+    // The old nodes are released only now, after the comparison
+    inputs = std::move(next);
+    trace("Query revision %llu, %zu declarations changed",
+          (unsigned long long)m_revision, changed);
+}
+
+void QueryEngine::read(Query query, DeclarationId id) {
+    if (!frames.empty()) {
+        frames.back().push_back({query, id});
+    }
+}
+
+const AST *QueryEngine::declaration(DeclarationId id) {
+    read(Query::DECLARATION, id);
+    return id < inputs.size() ? inputs[id].node : nullptr;
+}
+
+template <typename V>
+V QueryEngine::fetch(std::vector<Memo<V>> &memos, Query query,
+                     DeclarationId id, Compute<V> compute) {
+    read(query, id);
+    refresh(memos, id, compute);
+    // Not the value of the last revision, it may be the one the running
+    // query is about to replace
+    if (memos[id].running) {
+        return V{};
+    }
+    return memos[id].value;
+}
+
+template <typename V>
+void QueryEngine::refresh(std::vector<Memo<V>> &memos, DeclarationId id,
+                          Compute<V> compute) {
+    if (id >= memos.size()) {
+        memos.resize(id + 1);
+    }
+    // Queries run below may grow memos, so it is indexed every time
+    if (memos[id].running) {
+        trace("Query of %.*s depends on itself", (int)name(id).size(),
+              name(id).data());
+        return;
+    }
+    if (memos[id].valid && memos[id].verified == m_revision) {
+        return;
+    }
+
+    // Running while its dependencies are checked as well, so one on itself
+    // ends the recursion
+    memos[id].running = true;
+    if (memos[id].valid) {
+        bool outdated = false;
+        for (size_t i = 0; i < memos[id].dependencies.size(); i++) {
+            Dependency dependency = memos[id].dependencies[i];
+            if (changed_at(dependency) > memos[id].verified) {
+                outdated = true;
+                break;
+            }
+        }
+        if (!outdated) {
+            memos[id].running = false;
+            memos[id].verified = m_revision;
+            return;
+        }
+    }
+
+    frames.emplace_back();
+    V value = (this->*compute)(id);
+    m_computations++;
+
+    Memo<V> &memo = memos[id];
+    memo.running = false;
+    memo.dependencies = std::move(frames.back());
+    frames.pop_back();
+    // An equal result keeps its revision, the queries reading it stay valid
+    if (!memo.valid || !(memo.value == value)) {
+        memo.changed = m_revision;
+    }
+    memo.value = value;
+    memo.valid = true;
+    memo.verified = m_revision;
+}
+
+uint64_t QueryEngine::changed_at(Dependency dependency) {
+    DeclarationId id = dependency.id;
+    switch (dependency.query) {
+        case Query::DECLARATION:
+            return id < inputs.size() ? inputs[id].changed : 0;
+        case Query::TYPE:
+            refresh(type_memos, id, &QueryEngine::compute_type);
+            return type_memos[id].changed;
+        case Query::RESOLVED_TYPE:
+            refresh(resolved_memos, id, &QueryEngine::compute_resolved_type);
+            return resolved_memos[id].changed;
+        case Query::TYPEDEF:
+            refresh(typedef_memos, id, &QueryEngine::compute_typedef_type);
+            return typedef_memos[id].changed;
+        case Query::LAYOUT:
+            refresh(layout_memos, id, &QueryEngine::compute_layout);
+            return layout_memos[id].changed;
+        case Query::BODY:
+            refresh(body_memos, id, &QueryEngine::compute_body);
+            return body_memos[id].changed;
+    }
+    die("Invalid query %d", (int)dependency.query);
+    return 0;
+}
+
+const CanonicalType *QueryEngine::type(DeclarationId id) {
+    return fetch(type_memos, Query::TYPE, id, &QueryEngine::compute_type);
+}
+
+const CanonicalType *QueryEngine::resolved_type(DeclarationId id) {
+    return fetch(resolved_memos, Query::RESOLVED_TYPE, id,
+                 &QueryEngine::compute_resolved_type);
+}
+
+const CanonicalType *QueryEngine::typedef_type(DeclarationId id) {
+    return fetch(typedef_memos, Query::TYPEDEF, id,
+                 &QueryEngine::compute_typedef_type);
+}
+
+Layout QueryEngine::layout(DeclarationId tag) {
+    return fetch(layout_memos, Query::LAYOUT, tag,
+                 &QueryEngine::compute_layout);
+}
+
+const Block *QueryEngine::body(DeclarationId id) {
+    return fetch(body_memos, Query::BODY, id, &QueryEngine::compute_body);
+}
+
+const CanonicalType *QueryEngine::compute_type(DeclarationId id) {
+    const AST *node = declaration(id);
+    if (node == nullptr) {
+        return nullptr;
+    }
+    switch (node->kind) {
+        case Kind::STRUCT_TYPE:
+            return types.tag(CanonicalType::Kind::STRUCT, name(id), node);
+        case Kind::UNION_TYPE:
+            return types.tag(CanonicalType::Kind::UNION, name(id), node);
+        case Kind::ENUM_TYPE:
+            return types.tag(CanonicalType::Kind::ENUM, name(id), node);
+        case Kind::ENUM_VALUE:
+            return types.builtin(Builtin::INT);
+        default:
+            return types.get(cast<Declaration>(node)->type());
+    }
+}
+
+const CanonicalType *QueryEngine::compute_resolved_type(DeclarationId id) {
+    return resolve(type(id));
+}
+
+const CanonicalType *QueryEngine::compute_typedef_type(DeclarationId id) {
+    const AST *node = declaration(id);
+    if (node == nullptr || node->kind != Kind::TYPE_DEF) {
+        return nullptr;
+    }
+    return resolved_type(id);
+}
+
+const CanonicalType *QueryEngine::with_const(const CanonicalType *type) {
+    if (type->is_const) {
+        return type;
+    }
+    switch (type->kind) {
+        case CanonicalType::Kind::BUILTIN:
+            return types.builtin(type->builtin, true);
+        case CanonicalType::Kind::POINTER:
+            return types.pointer(type->element, true, type->is_restrict);
+        case CanonicalType::Kind::NAMED:
+            return types.named(type->name, true);
+        case CanonicalType::Kind::STRUCT:
+        case CanonicalType::Kind::UNION:
+        case CanonicalType::Kind::ENUM:
+            return types.tag(type->kind, type->name, type->declaration, true);
+        default:
+            // The elements of arrays are const, functions cannot be
+            return type;
+    }
+}
+
+const CanonicalType *QueryEngine::resolve(const CanonicalType *type) {
+    if (type == nullptr) {
+        return nullptr;
+    }
+    switch (type->kind) {
+        case CanonicalType::Kind::NAMED: {
+            // Through the typedef query, so an edit of the typedef that
+            // keeps its type changes nothing for the ones using it
+            const CanonicalType *target = typedef_type(id(type->name));
+            if (target == nullptr) {
+                return type;
+            }
+            return type->is_const ? with_const(target) : target;
+        }
+        case CanonicalType::Kind::POINTER:
+            return types.pointer(resolve(type->element), type->is_const,
+                                 type->is_restrict);
+        case CanonicalType::Kind::ARRAY:
+            return types.array(resolve(type->element), type->size);
+        case CanonicalType::Kind::FUNCTION: {
+            std::vector<const CanonicalType *> parameters;
+            parameters.reserve(type->parameter_count);
+            for (uint32_t i = 0; i < type->parameter_count; i++) {
+                parameters.push_back(resolve(type->parameters[i]));
+            }
+            return types.function(resolve(type->element), parameters,
+                                  type->varargs);
+        }
+        default:
+            return type;
+    }
+}
+
+static Layout builtin_layout(Builtin builtin) {
+    switch (builtin) {
+        case Builtin::CHAR:
+        case Builtin::SIGNED_CHAR:
+        case Builtin::UNSIGNED_CHAR:
+            return {1, 1};
+        case Builtin::SHORT:
+        case Builtin::UNSIGNED_SHORT:
+            return {2, 2};
+        case Builtin::INT:
+        case Builtin::UNSIGNED_INT:
+        case Builtin::FLOAT:
+            return {4, 4};
+        case Builtin::LONG:
+        case Builtin::UNSIGNED_LONG:
+        case Builtin::LONG_LONG:
+        case Builtin::UNSIGNED_LONG_LONG:
+        case Builtin::DOUBLE:
+            return {8, 8};
+        case Builtin::LONG_DOUBLE:
+            return {16, 16};
+        case Builtin::VA_LIST:
+            return {24, 8};
+        default:
+            // void and invalid keyword combinations
+            return {};
+    }
+}
+
+Layout QueryEngine::layout_of(const CanonicalType *type) {
+    type = resolve(type);
+    if (type == nullptr) {
+        return {};
+    }
+    switch (type->kind) {
+        case CanonicalType::Kind::BUILTIN:
+            return builtin_layout(type->builtin);
+        case CanonicalType::Kind::POINTER:
+            return {8, 8};
+        case CanonicalType::Kind::ARRAY: {
+            Layout element = layout_of(type->element);
+            if (element.size == CanonicalType::UNSIZED ||
+                type->size == CanonicalType::UNSIZED) {
+                return {CanonicalType::UNSIZED, element.align};
+            }
+            return {element.size * type->size, element.align};
+        }
+        case CanonicalType::Kind::STRUCT:
+        case CanonicalType::Kind::UNION:
+            if (type->name.empty()) {
+                // Anonymous, declaration is the struct or union itself
+                return layout_of_members(*cast<Type>(type->declaration));
+            }
+            return layout(id(type->name, true));
+        case CanonicalType::Kind::ENUM:
+            return {4, 4};
+        default:
+            // Functions and typedef names that are not declared
+            return {};
+    }
+}
+
+static uint64_t align_up(uint64_t offset, uint64_t align) {
+    return (offset + align - 1) / align * align;
+}
+
+Layout QueryEngine::layout_of_members(const Type &tag) {
+    bool is_union = tag.kind == Kind::UNION_TYPE;
+    auto &members = is_union ? cast<UnionType>(&tag)->members
+                             : cast<StructType>(&tag)->members;
+
+    Layout result{0, 1};
+    for (auto &member : members) {
+        Layout layout = layout_of(types.get(member->type()));
+        if (layout.size == CanonicalType::UNSIZED) {
+            return {};
+        }
+
+        result.align = std::max(result.align, layout.align);
+        if (is_union) {
+            result.size = std::max(result.size, layout.size);
+        } else {
+            result.size = align_up(result.size, layout.align) + layout.size;
+        }
+    }
+    result.size = align_up(result.size, result.align);
+    return result;
+}
+
+Layout QueryEngine::compute_layout(DeclarationId id) {
+    const AST *node = declaration(id);
+    if (node == nullptr) {
+        return {};
+    }
+    switch (node->kind) {
+        case Kind::STRUCT_TYPE:
+        case Kind::UNION_TYPE:
+            return layout_of_members(*cast<Type>(node));
+        case Kind::ENUM_TYPE:
+            return {4, 4};
+        default:
+            return {};
+    }
+}
+
+const Block *QueryEngine::compute_body(DeclarationId id) {
+    auto *definition = dyn_cast<FunctionDefinition>(declaration(id));
+    return definition != nullptr ? definition->body() : nullptr;
+}
+
+}  // namespace CCOMP::AST
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "ast.hpp"
+#include "literals.hpp"
+#include "type_context.hpp"
+
+namespace CCOMP::AST {
+
+// Name of a top level declaration, it stays the same when the declaration is
+// reparsed. Tags of structs, unions and enums are a name space of their own.
+using DeclarationId = uint32_t;
+
+// Size and alignment in bytes on x86-64
+struct Layout {
+    uint64_t size = CanonicalType::UNSIZED;
+    uint64_t align = 1;
+
+    bool operator==(const Layout &other) const {
+        return size == other.size && align == other.align;
+    }
+};
+
+// Memoized analyses of the top level declarations. Every query remembers the
+// declarations and queries it read while it ran. After update only the
+// queries that read a changed declaration run again, and the ones reading
+// those only if their result changed as well.
+//
+// A declaration changed if it is another node than before. The engine keeps
+// the nodes it saw alive, so an address is not reused by a new node. Reparsed
+// declarations and ones changed through CowPtr::mut are new nodes.
+//
+// Queries run on the calling thread. One that ends up depending on itself
+// sees an empty result, a default constructed value, where it reads itself.
+class QueryEngine {
+   public:
+    // Reads the top level declarations, call it again after every change
+    void update(const Program &program);
+
+    DeclarationId id(std::string_view name, bool tag = false);
+    [[nodiscard]] std::string_view name(DeclarationId id) const {
+        return names.get(id / 2);
+    }
+
+    // The node declaring id, a function definition is preferred over its
+    // prototypes. The node of a tag is its struct, union or enum type and
+    // the one of an enum constant its EnumValue. nullptr if id is not
+    // declared.
+    const AST *declaration(DeclarationId id);
+    // As written, the tag type for tags and int for enum constants
+    const CanonicalType *type(DeclarationId id);
+    // The type with every typedef name replaced by its type
+    const CanonicalType *resolved_type(DeclarationId id);
+    // The resolved type a typedef name stands for, nullptr if id is no
+    // typedef
+    const CanonicalType *typedef_type(DeclarationId id);
+    // Of a struct, union or enum tag
+    Layout layout(DeclarationId tag);
+    // nullptr if id is no function definition. Lazy bodies are parsed.
+    const Block *body(DeclarationId id);
+
+    // Named structs and unions use the layout query
+    Layout layout_of(const CanonicalType *type);
+
+    [[nodiscard]] uint64_t revision() const {
+        return m_revision;
+    }
+    // Queries that ran instead of reusing their result, in total
+    [[nodiscard]] size_t computations() const {
+        return m_computations;
+    }
+
+   private:
+    enum class Query : uint8_t {
+        DECLARATION,
+        TYPE,
+        RESOLVED_TYPE,
+        TYPEDEF,
+        LAYOUT,
+        BODY,
+    };
+
+    struct Dependency {
+        Query query;
+        DeclarationId id;
+    };
+
+    struct Input {
+        // The top level declaration holding node
+        CowPtr<AST> owner;
+        const AST *node = nullptr;
+        uint64_t changed = 0;
+    };
+
+    template <typename V>
+    struct Memo {
+        V value{};
+        bool valid = false;
+        bool running = false;
+        // Revision it was last checked in and the one its value changed in
+        uint64_t verified = 0, changed = 0;
+        std::vector<Dependency> dependencies;
+    };
+
+    template <typename V>
+    using Compute = V (QueryEngine::*)(DeclarationId);
+
+    template <typename V>
+    V fetch(std::vector<Memo<V>> &memos, Query query, DeclarationId id,
+            Compute<V> compute);
+    template <typename V>
+    void refresh(std::vector<Memo<V>> &memos, DeclarationId id,
+                 Compute<V> compute);
+    // Brings a query up to date, the revision its result last changed in
+    uint64_t changed_at(Dependency dependency);
+    void read(Query query, DeclarationId id);
+
+    const CanonicalType *compute_type(DeclarationId id);
+    const CanonicalType *compute_resolved_type(DeclarationId id);
+    const CanonicalType *compute_typedef_type(DeclarationId id);
+    Layout compute_layout(DeclarationId id);
+    const Block *compute_body(DeclarationId id);
+
+    const CanonicalType *resolve(const CanonicalType *type);
+    const CanonicalType *with_const(const CanonicalType *type);
+    Layout layout_of_members(const Type &tag);
+
+    StringPool names;
+    // Owned by the engine, so the types of unchanged declarations stay the
+    // same pointers across reparses
+    TypeContext types;
+    uint64_t m_revision = 0;
+    size_t m_computations = 0;
+
+    std::vector<Input> inputs;
+    std::vector<Memo<const CanonicalType *>> type_memos;
+    std::vector<Memo<const CanonicalType *>> resolved_memos;
+    std::vector<Memo<const CanonicalType *>> typedef_memos;
+    std::vector<Memo<Layout>> layout_memos;
+    std::vector<Memo<const Block *>> body_memos;
+    // Dependencies of the queries that are running, the innermost last
+    std::vector<std::vector<Dependency>> frames;
+};
+
+}  // namespace CCOMP::AST
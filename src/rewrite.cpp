@@ -0,0 +1,597 @@
+#include "rewrite.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <type_traits>
+
+#include "common.hpp"
+#include "visitors/staticVisitor.hpp"
+
+namespace CCOMP::AST {
+
+// A symbol is the kind, operator and number of children of a node
+static constexpr uint64_t BOUND = 1ull << 24;
+// Packed initializers have no child nodes, only any() matches them
+static constexpr uint64_t PACKED = 0xff;
+
+static uint64_t make_symbol(Kind kind, uint64_t op, uint64_t arity) {
+    return (uint64_t)kind | op << 8 | arity << 32;
+}
+
+Pattern Pattern::any() {
+    return Pattern(0, true, {});
+}
+
+Pattern Pattern::constant(Constant::LiteralKind literal_kind) {
+    return Pattern(make_symbol(Kind::CONSTANT, (uint64_t)literal_kind, 0),
+                   true, {});
+}
+
+Pattern Pattern::node(Kind kind, std::vector<Pattern> children) {
+    switch (kind) {
+        case Kind::CONSTANT:
+        case Kind::UNARY_EXPRESSION:
+        case Kind::BINARY_EXPRESSION:
+        case Kind::OPERATION_ASSIGNMENT:
+            die("Pattern::node for a node with its own pattern");
+        default:
+            break;
+    }
+    uint64_t symbol = make_symbol(kind, 0, children.size());
+    return Pattern(symbol, false, std::move(children));
+}
+
+Pattern Pattern::unary(UnaryExpression::Operator op, Pattern value) {
+    std::vector<Pattern> children;
+    children.push_back(std::move(value));
+    return Pattern(make_symbol(Kind::UNARY_EXPRESSION, (uint64_t)op, 1),
+                   false, std::move(children));
+}
+
+Pattern Pattern::binary(BinaryExpression::Operator op, Pattern left,
+                        Pattern right) {
+    std::vector<Pattern> children;
+    children.push_back(std::move(left));
+    children.push_back(std::move(right));
+    return Pattern(make_symbol(Kind::BINARY_EXPRESSION, (uint64_t)op, 2),
+                   false, std::move(children));
+}
+
+Pattern Pattern::assignment(OperationAssignment::Operator op, Pattern left,
+                            Pattern right) {
+    std::vector<Pattern> children;
+    children.push_back(std::move(left));
+    children.push_back(std::move(right));
+    return Pattern(make_symbol(Kind::OPERATION_ASSIGNMENT, (uint64_t)op, 2),
+                   false, std::move(children));
+}
+
+namespace {
+
+// Appends the children of a node in the order of for_each_child
+class ChildList
+    : public StaticVisitor<ChildList, void, std::vector<const AST *> &> {
+   public:
+    template <typename T>
+    void visit(const T &node, std::vector<const AST *> &out) {
+        for_each_child(node, [&](auto &child) { out.push_back(&child); });
+    }
+};
+
+uint64_t symbol_of(const AST &node, size_t arity) {
+    uint64_t op = 0;
+    switch (node.kind) {
+        case Kind::CONSTANT:
+            op = (uint64_t)static_cast<const Constant &>(node).literal_kind;
+            break;
+        case Kind::UNARY_EXPRESSION:
+            op = (uint64_t)static_cast<const UnaryExpression &>(node).op;
+            break;
+        case Kind::BINARY_EXPRESSION:
+            op = (uint64_t)static_cast<const BinaryExpression &>(node).op;
+            break;
+        case Kind::OPERATION_ASSIGNMENT:
+            op = (uint64_t)static_cast<const OperationAssignment &>(node).op;
+            break;
+        case Kind::ARRAY_INITIALIZATION_LIST:
+            if (static_cast<const ArrayInitializationList &>(node)
+                    .packed()) {
+                op = PACKED;
+            }
+            break;
+        default:
+            break;
+    }
+    return make_symbol(node.kind, op, arity);
+}
+
+// The child pointers of statements and expressions the rules may look
+// into, of a node or of the copy of it that gets the rewritten children.
+// The flag tells whether the child may be replaced by any node.
+template <typename Node, typename F>
+void for_each_slot(Node &node, F &&f) {
+    using T = std::remove_const_t<Node>;
+    if constexpr (std::is_same_v<T, Program>) {
+        for (auto &declaration : node.declarations) {
+            f(declaration, true);
+        }
+    } else if constexpr (std::is_same_v<T, Block>) {
+        for (auto &statement : node.statements) {
+            f(statement, true);
+        }
+    } else if constexpr (std::is_same_v<T, SwitchBlock>) {
+        f(node.label, true);
+        for (auto &statement : node.statements) {
+            f(statement, true);
+        }
+    } else if constexpr (std::is_same_v<T, Switch>) {
+        f(node.condition, true);
+        for (auto &block : node.switch_blocks) {
+            f(block, false);
+        }
+    } else if constexpr (std::is_same_v<T, If>) {
+        f(node.condition, true);
+        f(node.then_block, true);
+        f(node.else_block, true);
+    } else if constexpr (std::is_same_v<T, For>) {
+        f(node.init, true);
+        f(node.condition, true);
+        f(node.increment, true);
+        f(node.body, true);
+    } else if constexpr (std::is_same_v<T, While>) {
+        f(node.condition, true);
+        f(node.body, true);
+    } else if constexpr (std::is_same_v<T, DoWhile>) {
+        f(node.body, true);
+        f(node.condition, true);
+    } else if constexpr (std::is_same_v<T, ArrayInitializationList>) {
+        if (node.packed()) {
+            return;
+        }
+        if constexpr (std::is_const_v<Node>) {
+            for (auto &value : node.values()) {
+                f(value, true);
+            }
+        } else {
+            for (auto &value : node.mutable_values()) {
+                f(value, true);
+            }
+        }
+    } else if constexpr (std::is_same_v<T, ArrayAccess>) {
+        f(node.array, true);
+        for (auto &index : node.indices) {
+            f(index, true);
+        }
+    } else if constexpr (std::is_same_v<T, StructAccess>) {
+        f(node.struc, true);
+    } else if constexpr (std::is_same_v<T, Assignment> ||
+                         std::is_same_v<T, OperationAssignment> ||
+                         std::is_same_v<T, BinaryExpression>) {
+        f(node.left, true);
+        f(node.right, true);
+    } else if constexpr (std::is_same_v<T, ExpressionList>) {
+        for (auto &expression : node.expressions) {
+            f(expression, true);
+        }
+    } else if constexpr (std::is_same_v<T, FunctionCall>) {
+        for (auto &argument : node.arguments) {
+            f(argument, true);
+        }
+    } else if constexpr (std::is_same_v<T, TernaryExpression>) {
+        f(node.condition, true);
+        f(node.then_expr, true);
+        f(node.else_expr, true);
+    } else if constexpr (std::is_same_v<T, UnaryExpression> ||
+                         std::is_same_v<T, Return> ||
+                         std::is_same_v<T, TypeCast> ||
+                         std::is_same_v<T, VariableDeclaration>) {
+        f(node.value, true);
+    } else if constexpr (std::is_same_v<T, FunctionDefinition>) {
+        f(node.body_ptr(), false);
+    }
+}
+
+// Node is an AST or a const AST
+template <typename Node, typename F>
+void for_each_slot_of(Node &node, F &&f) {
+    switch (node.kind) {
+#define SLOTS(type, kind)                                      \
+    case Kind::kind:                                           \
+        if constexpr (std::is_const_v<Node>) {                 \
+            for_each_slot(static_cast<const type &>(node), f); \
+        } else {                                               \
+            for_each_slot(static_cast<type &>(node), f);       \
+        }                                                      \
+        break;
+        AST_KINDS(SLOTS)
+#undef SLOTS
+    }
+}
+
+}  // namespace
+
+RewriteRules::RewriteRules() {
+    states.emplace_back();
+}
+
+void RewriteRules::add(const Pattern &pattern, Rewrite rewrite) {
+    uint32_t state = 0;
+    insert(pattern, state);
+    states[state].accepts.push_back(rules.size());
+    rules.push_back(std::move(rewrite));
+}
+
+// Follows the preorder of pattern from state, adding the missing states
+void RewriteRules::insert(const Pattern &pattern, uint32_t &state) {
+    uint32_t next;
+    if (pattern.symbol == 0) {
+        next = states[state].any;
+    } else {
+        uint64_t key = pattern.symbol | (pattern.bound ? BOUND : 0);
+        auto it = states[state].edges.find(key);
+        next = it == states[state].edges.end() ? NONE : it->second;
+    }
+
+    if (next == NONE) {
+        next = states.size();
+        // Invalidates the references into states
+        states.emplace_back();
+        if (pattern.symbol == 0) {
+            states[state].any = next;
+        } else {
+            uint64_t key = pattern.symbol | (pattern.bound ? BOUND : 0);
+            states[state].edges[key] = next;
+        }
+    }
+    state = next;
+
+    for (auto &child : pattern.children) {
+        insert(child, state);
+    }
+}
+
+void RewriteRules::match(uint32_t state,
+                         std::vector<const AST *> &pending,
+                         std::vector<const AST *> &bound,
+                         std::vector<Match> &out) const {
+    const State &s = states[state];
+    if (pending.empty()) {
+        // A pattern is only complete once every node it reached is matched
+        for (uint32_t rule : s.accepts) {
+            out.push_back({rule, bound});
+        }
+        return;
+    }
+
+    const AST *node = pending.back();
+    pending.pop_back();
+
+    if (s.any != NONE) {
+        bound.push_back(node);
+        match(s.any, pending, bound, out);
+        bound.pop_back();
+    }
+
+    if (!s.edges.empty()) {
+        // The children are matched next, the first one on top
+        size_t mark = pending.size();
+        ChildList().dispatch(*node, pending);
+        std::reverse(pending.begin() + mark, pending.end());
+        uint64_t symbol = symbol_of(*node, pending.size() - mark);
+
+        auto it = s.edges.find(symbol);
+        if (it != s.edges.end()) {
+            match(it->second, pending, bound, out);
+        }
+        it = s.edges.find(symbol | BOUND);
+        if (it != s.edges.end()) {
+            bound.push_back(node);
+            match(it->second, pending, bound, out);
+            bound.pop_back();
+        }
+        pending.resize(mark);
+    }
+
+    pending.push_back(node);
+}
+
+CowPtr<AST> RewriteRules::rewrite(const AST &root, bool replaceable) const {
+    // A node is left on the stack until its slots are rewritten. They are
+    // entered first one first, and each writes its result into the range of
+    // its parent in results.
+    struct Frame {
+        const AST *node;
+        bool replaceable;
+        // Where the result goes in results
+        size_t out;
+        // Range of the results of the slots, set once they were entered
+        size_t begin, end;
+        bool entered;
+    };
+    std::vector<Frame> stack;
+    std::vector<CowPtr<AST>> results(1);
+    std::vector<std::pair<const AST *, bool>> slots;
+    stack.push_back({&root, replaceable, 0, 0, 0, false});
+
+    while (!stack.empty()) {
+        Frame &top = stack.back();
+        if (!top.entered) {
+            top.entered = true;
+            slots.clear();
+            for_each_slot_of(*top.node, [&](auto &slot, bool replace) {
+                slots.emplace_back(slot.get(), replace);
+            });
+            top.begin = results.size();
+            top.end = top.begin + slots.size();
+            results.resize(top.end);
+            size_t begin = top.begin;
+            for (size_t i = slots.size(); i-- > 0;) {
+                if (slots[i].first != nullptr) {
+                    // Invalidates top
+                    stack.push_back({slots[i].first, slots[i].second,
+                                     begin + i, 0, 0, false});
+                }
+            }
+            continue;
+        }
+
+        Frame frame = top;
+        stack.pop_back();
+        CowPtr<AST> result = finish(*frame.node, frame.replaceable,
+                                    results.data() + frame.begin);
+        results.resize(frame.begin);
+        results[frame.out] = std::move(result);
+    }
+    return std::move(results[0]);
+}
+
+CowPtr<AST> RewriteRules::finish(const AST &node, bool replaceable,
+                                 const CowPtr<AST> *replaced) const {
+    // A changed slot needs a copy of node to go into
+    bool changed = false;
+    size_t count = 0;
+    for_each_slot_of(node, [&](auto &, bool) {
+        changed = changed || replaced[count] != nullptr;
+        count++;
+    });
+
+    CowPtr<AST> current;
+    if (changed) {
+        current = node.clone();
+        size_t i = 0;
+        for_each_slot_of(*current.mut(), [&](auto &slot, bool) {
+            if (replaced[i] != nullptr) {
+                using Slot = std::remove_reference_t<decltype(slot)>;
+                slot = Slot(replaced[i]);
+            }
+            i++;
+        });
+    }
+    if (!replaceable || (states[0].edges.empty() && states[0].any == NONE)) {
+        return current;
+    }
+
+    std::vector<const AST *> pending, bound;
+    std::vector<Match> matches;
+    for (size_t round = 0;; round++) {
+        if (round == MAX_ROUNDS) {
+            warn("Rewrite rules do not terminate at %u, stopped after %zu "
+                 "rounds",
+                 node.location.get_offset(), MAX_ROUNDS);
+            return current;
+        }
+        const AST &target = current != nullptr ? *current : node;
+        matches.clear();
+        pending.push_back(&target);
+        match(0, pending, bound, matches);
+        pending.clear();
+
+        std::sort(matches.begin(), matches.end(),
+                  [](const Match &a, const Match &b) {
+                      return a.rule < b.rule;
+                  });
+        std::unique_ptr<AST> result;
+        for (auto &m : matches) {
+            result = rules[m.rule](target, m.bound);
+            if (result != nullptr) {
+                break;
+            }
+        }
+        if (result == nullptr) {
+            return current;
+        }
+        m_applied.fetch_add(1, std::memory_order_relaxed);
+        current = std::move(result);
+    }
+}
+
+// An int literal, without a suffix and small enough to be no long
+static bool int_literal(const AST *node, int64_t &value) {
+    auto &literal = static_cast<const Constant *>(node)->integer;
+    if (literal.is_unsigned || literal.long_count > 0 ||
+        literal.value > INT_MAX) {
+        return false;
+    }
+    value = literal.value;
+    return true;
+}
+
+// The int result of op, false if it is undefined or no literal can hold it
+static bool fold(BinaryExpression::Operator op, int64_t a, int64_t b,
+                 int64_t &result) {
+    using Op = BinaryExpression::Operator;
+    switch (op) {
+        case Op::PLUS:
+            result = a + b;
+            break;
+        case Op::MINUS:
+            result = a - b;
+            break;
+        case Op::MUL:
+            result = a * b;
+            break;
+        case Op::DIV:
+            if (b == 0) {
+                return false;
+            }
+            result = a / b;
+            break;
+        case Op::REM:
+            if (b == 0) {
+                return false;
+            }
+            result = a % b;
+            break;
+        case Op::SHIFT_LEFT:
+            if (b >= 31) {
+                return false;
+            }
+            result = a << b;
+            break;
+        case Op::SHIFT_RIGHT:
+            if (b >= 32) {
+                return false;
+            }
+            result = a >> b;
+            break;
+        case Op::LESS:
+            result = a < b;
+            break;
+        case Op::GREATER:
+            result = a > b;
+            break;
+        case Op::LESS_EQUAL:
+            result = a <= b;
+            break;
+        case Op::GREATER_EQUAL:
+            result = a >= b;
+            break;
+        case Op::EQUAL:
+            result = a == b;
+            break;
+        case Op::NOT_EQUAL:
+            result = a != b;
+            break;
+        case Op::BITWISE_AND:
+            result = a & b;
+            break;
+        case Op::BITWISE_OR:
+            result = a | b;
+            break;
+        case Op::BITWISE_XOR:
+            result = a ^ b;
+            break;
+        case Op::LOGICAL_AND:
+            result = a && b;
+            break;
+        case Op::LOGICAL_OR:
+            result = a || b;
+            break;
+        default:
+            return false;
+    }
+    // Literals are not negative
+    return result >= 0 && result <= INT_MAX;
+}
+
+void add_folding_rules(RewriteRules &rules) {
+    using Op = BinaryExpression::Operator;
+    auto integer = Pattern::constant(Constant::LiteralKind::INTEGER);
+    for (Op op : {Op::PLUS, Op::MINUS, Op::MUL, Op::DIV, Op::REM,
+                  Op::SHIFT_LEFT, Op::SHIFT_RIGHT, Op::LESS, Op::GREATER,
+                  Op::LESS_EQUAL, Op::GREATER_EQUAL, Op::EQUAL,
+                  Op::NOT_EQUAL, Op::BITWISE_AND, Op::BITWISE_OR,
+                  Op::BITWISE_XOR, Op::LOGICAL_AND, Op::LOGICAL_OR}) {
+        rules.add(Pattern::binary(op, integer, integer),
+                  [op](const AST &node, const std::vector<const AST *> &bound)
+                      -> std::unique_ptr<AST> {
+                      int64_t a, b, result;
+                      if (!int_literal(bound[0], a) ||
+                          !int_literal(bound[1], b) ||
+                          !fold(op, a, b, result)) {
+                          return nullptr;
+                      }
+                      IntegerLiteral literal;
+                      literal.value = result;
+                      return std::make_unique<Constant>(node.location,
+                                                        literal);
+                  });
+    }
+}
+
+// The k of a power of two 2^k with k > 0
+static bool power_of_two(const AST *node, int64_t &k) {
+    int64_t value;
+    if (!int_literal(node, value) || value < 2 || (value & (value - 1)) != 0) {
+        return false;
+    }
+    k = 0;
+    while (value > 1) {
+        value >>= 1;
+        k++;
+    }
+    return true;
+}
+
+// The AST has no types, so only operands whose type shows in the node are
+// known to be unsigned: unsigned literals, casts to an unsigned integer and
+// left shifts of those
+static bool known_unsigned(const AST *node) {
+    while (auto *shift = dyn_cast<BinaryExpression>(node)) {
+        if (shift->op != BinaryExpression::Operator::SHIFT_LEFT) {
+            return false;
+        }
+        node = shift->left.get();
+    }
+    if (auto *constant = dyn_cast<Constant>(node)) {
+        return constant->literal_kind == Constant::LiteralKind::INTEGER &&
+               constant->integer.is_unsigned;
+    }
+    auto *conversion = dyn_cast<TypeCast>(node);
+    auto *type = conversion ? dyn_cast<PrimitiveType>(conversion->type.get())
+                            : nullptr;
+    if (type == nullptr || type->pointer_count > 0 ||
+        !type->array_sizes.empty()) {
+        return false;
+    }
+    auto &keywords = type->keywords;
+    return std::find(keywords.begin(), keywords.end(),
+                     PrimitiveType::KeyWords::UNSIGNED) != keywords.end();
+}
+
+static std::unique_ptr<AST> shift_left(const AST &node, const AST &value,
+                                       int64_t k) {
+    IntegerLiteral literal;
+    literal.value = k;
+    return std::make_unique<BinaryExpression>(
+        node.location, value.clone(),
+        std::make_unique<Constant>(node.location, literal),
+        BinaryExpression::Operator::SHIFT_LEFT);
+}
+
+void add_shift_rules(RewriteRules &rules) {
+    using Op = BinaryExpression::Operator;
+    auto integer = Pattern::constant(Constant::LiteralKind::INTEGER);
+    rules.add(Pattern::binary(Op::MUL, Pattern::any(), integer),
+              [](const AST &node, const std::vector<const AST *> &bound)
+                  -> std::unique_ptr<AST> {
+                  int64_t k;
+                  if (!power_of_two(bound[1], k) ||
+                      !known_unsigned(bound[0])) {
+                      return nullptr;
+                  }
+                  return shift_left(node, *bound[0], k);
+              });
+    rules.add(Pattern::binary(Op::MUL, integer, Pattern::any()),
+              [](const AST &node, const std::vector<const AST *> &bound)
+                  -> std::unique_ptr<AST> {
+                  int64_t k;
+                  if (!power_of_two(bound[0], k) ||
+                      !known_unsigned(bound[1])) {
+                      return nullptr;
+                  }
+                  return shift_left(node, *bound[1], k);
+              });
+}
+
+}  // namespace CCOMP::AST
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.hpp"
+#include "pass_manager.hpp"
+
+namespace CCOMP::AST {
+
+// Shape of the trees a rewrite rule applies to
+class Pattern {
+   public:
+    // Any node, it is bound
+    static Pattern any();
+    // A constant with a literal of literal_kind, it is bound
+    static Pattern constant(Constant::LiteralKind literal_kind);
+    // A node of kind with exactly these children, in the order of
+    // for_each_child. Constants and nodes with an operator have their own
+    // patterns.
+    static Pattern node(Kind kind, std::vector<Pattern> children = {});
+    static Pattern unary(UnaryExpression::Operator op, Pattern value);
+    static Pattern binary(BinaryExpression::Operator op, Pattern left,
+                          Pattern right);
+    static Pattern assignment(OperationAssignment::Operator op, Pattern left,
+                              Pattern right);
+
+   private:
+    friend class RewriteRules;
+
+    Pattern(uint64_t symbol, bool bound, std::vector<Pattern> children)
+        : symbol(symbol), bound(bound), children(std::move(children)) {
+    }
+
+    uint64_t symbol;
+    bool bound;
+    std::vector<Pattern> children;
+};
+
+// Rewrite rules compiled into a discrimination tree. Every pattern is a path
+// of node symbols in preorder, and the paths of all rules are merged into
+// one tree. Matching a node walks the tree along the node and its children,
+// so it only visits the rules that still fit instead of testing them one by
+// one, and adding rules does not slow down nodes they cannot match.
+//
+//     RewriteRules rules;
+//     rules.add(Pattern::binary(BinaryExpression::Operator::MUL,
+//                               Pattern::any(),
+//                               Pattern::constant(INTEGER)),
+//               [](const AST &node, const std::vector<const AST *> &bound) {
+//                   // bound[0] is the left side, bound[1] the constant
+//                   ...
+//               });
+//
+// The rules are only read while rewriting, so several threads may rewrite
+// with them at the same time.
+class RewriteRules {
+   public:
+    // Builds the replacement of node from the nodes its pattern bound, in
+    // the order of the pattern. A bound node is reused with clone, its
+    // children stay shared. nullptr if the rule does not apply after all.
+    using Rewrite = std::function<std::unique_ptr<AST>(
+        const AST &node, const std::vector<const AST *> &bound)>;
+
+    RewriteRules();
+
+    // Rules added first win when several match
+    void add(const Pattern &pattern, Rewrite rewrite);
+
+    // The tree with the rules applied bottom up, nullptr if nothing
+    // changed. After a rule replaced a node the rules are tried on the
+    // replacement again, up to MAX_ROUNDS times per node. Changed nodes
+    // are copies, so node and the trees sharing parts of it stay as they
+    // are. Types and packed initializers are not rewritten, function
+    // bodies are parsed.
+    CowPtr<AST> rewrite(const AST &node) const {
+        return rewrite(node, true);
+    }
+
+    [[nodiscard]] size_t size() const {
+        return rules.size();
+    }
+    // Replacements made by all rewrites, in total
+    [[nodiscard]] size_t applied() const {
+        return m_applied.load(std::memory_order_relaxed);
+    }
+
+    // Replacements of one node before the rules are taken to not
+    // terminate, a warning is printed and the last replacement kept
+    static constexpr size_t MAX_ROUNDS = 100;
+
+   private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct State {
+        // The next state for the symbol of a node, bound or not
+        std::unordered_map<uint64_t, uint32_t> edges;
+        uint32_t any = NONE;
+        // Rules whose pattern ends here
+        std::vector<uint32_t> accepts;
+    };
+
+    struct Match {
+        uint32_t rule;
+        std::vector<const AST *> bound;
+    };
+
+    void insert(const Pattern &pattern, uint32_t &state);
+    // Walks the tree with an explicit stack, deep expressions need no stack
+    // frame per level
+    CowPtr<AST> rewrite(const AST &root, bool replaceable) const;
+    // node with replaced as the results of its slots, and the rules applied
+    // to it if it is replaceable
+    CowPtr<AST> finish(const AST &node, bool replaceable,
+                       const CowPtr<AST> *replaced) const;
+    // Rules matching the trees in pending, in any order
+    void match(uint32_t state, std::vector<const AST *> &pending,
+               std::vector<const AST *> &bound,
+               std::vector<Match> &out) const;
+
+    std::vector<State> states;
+    std::vector<Rewrite> rules;
+    mutable std::atomic<size_t> m_applied = 0;
+};
+
+// Folds operators applied to int literals into one literal, where the
+// result is an int literal as well
+void add_folding_rules(RewriteRules &rules);
+
+// Turns multiplications by a power of two 2^k into left shifts by k. A left
+// shift of a negative value is undefined and one of a float does not
+// compile, so only operands known to be unsigned are rewritten.
+void add_shift_rules(RewriteRules &rules);
+
+// Applies rewrite rules to the top level declarations
+class Rewriter : public Transform {
+   public:
+    explicit Rewriter(const RewriteRules &rules)
+        : Transform("rewrite"), rules(rules) {
+    }
+
+    bool run(CowPtr<AST> &declaration) override {
+        CowPtr<AST> result = rules.rewrite(*declaration);
+        if (result == nullptr) {
+            return false;
+        }
+        declaration = std::move(result);
+        return true;
+    }
+
+   private:
+    const RewriteRules &rules;
+};
+
+}  // namespace CCOMP::AST
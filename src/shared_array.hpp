@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace CCOMP {
+
+// Array that owns its elements or borrows them from memory someone else
+// owns, like a mapped file. Changing a borrowed array copies it first.
+template <typename T>
+class SharedArray {
+   public:
+    SharedArray() = default;
+    // Borrows size elements at data, owner keeps them alive
+    SharedArray(const T *data, size_t size, std::shared_ptr<const void> owner)
+        : first(data), count(size), owner(std::move(owner)), borrowed(true) {
+    }
+
+    [[nodiscard]] const T *data() const {
+        return borrowed ? first : elements.data();
+    }
+    [[nodiscard]] size_t size() const {
+        return borrowed ? count : elements.size();
+    }
+    [[nodiscard]] bool empty() const {
+        return size() == 0;
+    }
+    [[nodiscard]] bool is_borrowed() const {
+        return borrowed;
+    }
+
+    const T *begin() const {
+        return data();
+    }
+    const T *end() const {
+        return data() + size();
+    }
+    const T &operator[](size_t i) const {
+        return data()[i];
+    }
+
+    // The elements to change
+    std::vector<T> &mutate() {
+        if (borrowed) {
+            elements.assign(first, first + count);
+            first = nullptr;
+            count = 0;
+            owner = nullptr;
+            borrowed = false;
+        }
+        return elements;
+    }
+    void push_back(const T &value) {
+        mutate().push_back(value);
+    }
+    void shrink_to_fit() {
+        elements.shrink_to_fit();
+    }
+
+   private:
+    std::vector<T> elements;
+    const T *first = nullptr;
+    size_t count = 0;
+    std::shared_ptr<const void> owner;
+    bool borrowed = false;
+};
+
+}  // namespace CCOMP
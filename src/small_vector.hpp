@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace CCOMP {
+
+// Vector keeping up to N elements inside the object. Only longer lists
+// allocate, which the lists of most AST nodes never get.
+template <typename T, size_t N>
+class SmallVector {
+    static_assert(N > 0, "Use std::vector without inline elements");
+
+   public:
+    SmallVector() = default;
+
+    SmallVector(const SmallVector &other) {
+        reserve(other.count);
+        for (const auto &element : other) {
+            push_back(element);
+        }
+    }
+
+    SmallVector(SmallVector &&other) noexcept {
+        take(other);
+    }
+
+    ~SmallVector() {
+        clear();
+        free_heap();
+    }
+
+    SmallVector &operator=(const SmallVector &other) {
+        if (this != &other) {
+            clear();
+            reserve(other.count);
+            for (const auto &element : other) {
+                push_back(element);
+            }
+        }
+        return *this;
+    }
+
+    SmallVector &operator=(SmallVector &&other) noexcept {
+        if (this != &other) {
+            clear();
+            free_heap();
+            take(other);
+        }
+        return *this;
+    }
+
+    T *data() {
+        return heap != nullptr ? heap : inline_data();
+    }
+    const T *data() const {
+        return heap != nullptr ? heap : inline_data();
+    }
+
+    T *begin() {
+        return data();
+    }
+    T *end() {
+        return data() + count;
+    }
+    const T *begin() const {
+        return data();
+    }
+    const T *end() const {
+        return data() + count;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return count;
+    }
+    [[nodiscard]] bool empty() const {
+        return count == 0;
+    }
+    [[nodiscard]] size_t capacity() const {
+        return cap;
+    }
+    // True while no element was moved to the heap
+    [[nodiscard]] bool is_inline() const {
+        return heap == nullptr;
+    }
+
+    T &operator[](size_t i) {
+        return data()[i];
+    }
+    const T &operator[](size_t i) const {
+        return data()[i];
+    }
+    T &back() {
+        return data()[count - 1];
+    }
+    const T &back() const {
+        return data()[count - 1];
+    }
+
+    void push_back(const T &value) {
+        emplace_back(value);
+    }
+    void push_back(T &&value) {
+        emplace_back(std::move(value));
+    }
+
+    template <typename... Args>
+    T &emplace_back(Args &&...args) {
+        if (count == cap) {
+            // The arguments may refer to an element that grow() moves
+            T value(std::forward<Args>(args)...);
+            grow(cap * 2);
+            return *new (data() + count++) T(std::move(value));
+        }
+        return *new (data() + count++) T(std::forward<Args>(args)...);
+    }
+
+    void pop_back() {
+        data()[--count].~T();
+    }
+
+    void reserve(size_t n) {
+        if (n > cap) {
+            grow(n);
+        }
+    }
+
+    void resize(size_t n) {
+        reserve(n);
+        while (count > n) {
+            pop_back();
+        }
+        while (count < n) {
+            new (data() + count++) T();
+        }
+    }
+
+    void clear() {
+        while (count > 0) {
+            pop_back();
+        }
+    }
+
+   private:
+    T *inline_data() {
+        return std::launder(reinterpret_cast<T *>(storage));
+    }
+    const T *inline_data() const {
+        return std::launder(reinterpret_cast<const T *>(storage));
+    }
+
+    void grow(size_t n) {
+        T *moved = std::allocator<T>().allocate(n);
+        std::uninitialized_move(begin(), end(), moved);
+        std::destroy(begin(), end());
+        free_heap();
+        heap = moved;
+        cap = n;
+    }
+
+    void free_heap() {
+        if (heap != nullptr) {
+            std::allocator<T>().deallocate(heap, cap);
+            heap = nullptr;
+            cap = N;
+        }
+    }
+
+    // Expects this to be empty and inline
+    void take(SmallVector &other) {
+        if (other.heap != nullptr) {
+            heap = std::exchange(other.heap, nullptr);
+            cap = std::exchange(other.cap, N);
+            count = std::exchange(other.count, 0);
+            return;
+        }
+        std::uninitialized_move(other.begin(), other.end(), inline_data());
+        count = other.count;
+        other.clear();
+    }
+
+    alignas(T) unsigned char storage[N * sizeof(T)];
+    T *heap = nullptr;
+    uint32_t count = 0, cap = N;
+};
+
+}  // namespace CCOMP
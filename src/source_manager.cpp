@@ -0,0 +1,200 @@
+#include "source_manager.hpp"
+
+#include <algorithm>
+
+#include "byte_stream.hpp"
+#include "common.hpp"
+
+namespace CCOMP {
+
+SourceManager::SourceManager(std::shared_ptr<const std::string> buffer,
+                             std::string main_file)
+    : m_buffer(std::move(buffer)), buffer_size(m_buffer->size()) {
+    files.push_back(std::move(main_file));
+}
+
+void SourceManager::build_tables() const {
+    std::call_once(built, [this]() {
+        trace("Building the line table");
+        std::string_view text = *m_buffer;
+
+        line_starts.push_back(0);
+        for (uint32_t i = 0; i < text.size(); i++) {
+            if (text[i] != '\n') {
+                continue;
+            }
+            uint32_t start = line_starts.back();
+            if (text[start] == '#') {
+                read_marker(text.substr(start, i - start), line_starts.size());
+            }
+            line_starts.push_back(i + 1);
+        }
+        uint32_t start = line_starts.back();
+        if (start < text.size() && text[start] == '#') {
+            read_marker(text.substr(start), line_starts.size());
+        }
+    });
+}
+
+// '# 12 "file.h" flags' or '#line 12 "file.h"', marker_line is the line of the
+// marker itself
+void SourceManager::read_marker(std::string_view text,
+                                uint32_t marker_line) const {
+    size_t i = 1;
+    auto skip_spaces = [&]() {
+        while (i < text.size() && (text[i] == ' ' || text[i] == '\t')) {
+            i++;
+        }
+    };
+
+    skip_spaces();
+    if (text.substr(i, 4) == "line") {
+        i += 4;
+        skip_spaces();
+    }
+    if (i >= text.size() || text[i] < '0' || text[i] > '9') {
+        return;
+    }
+    uint32_t line = 0;
+    while (i < text.size() && text[i] >= '0' && text[i] <= '9') {
+        line = line * 10 + (text[i] - '0');
+        i++;
+    }
+
+    // Without a file name the marker stays in the current file
+    uint32_t file = markers.empty() ? 0 : markers.back().file;
+    skip_spaces();
+    if (i < text.size() && text[i] == '"') {
+        std::string name;
+        for (i++; i < text.size() && text[i] != '"'; i++) {
+            if (text[i] == '\\' && i + 1 < text.size()) {
+                i++;
+            }
+            name += text[i];
+        }
+        auto found = std::find(files.begin(), files.end(), name);
+        file = found - files.begin();
+        if (found == files.end()) {
+            files.push_back(std::move(name));
+        }
+    }
+
+    markers.push_back({marker_line + 1, line, file});
+}
+
+PresumedLocation SourceManager::presumed(SourceLocation location) const {
+    if (!location.valid()) {
+        return {files[0], 0, 0};
+    }
+    build_tables();
+
+    uint32_t offset = std::min(location.get_offset(), buffer_size);
+    auto next = std::upper_bound(line_starts.begin(), line_starts.end(),
+                                 offset);
+    uint32_t index = next - line_starts.begin() - 1;
+
+    PresumedLocation presumed = presumed_line(index + 1);
+    presumed.column = 1 + characters(line_starts[index], offset);
+    return presumed;
+}
+
+static bool is_continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xc0) == 0x80;
+}
+
+uint32_t SourceManager::characters(uint32_t begin, uint32_t end) const {
+    if (m_buffer == nullptr || m_buffer->empty()) {
+        auto first = std::lower_bound(continuations.begin(),
+                                      continuations.end(), begin);
+        auto last = std::lower_bound(first, continuations.end(), end);
+        return end - begin - (last - first);
+    }
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i++) {
+        if (!is_continuation((*m_buffer)[i])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+PresumedLocation SourceManager::presumed_line(uint32_t buffer_line) const {
+    build_tables();
+
+    auto marker = std::upper_bound(
+        markers.begin(), markers.end(), buffer_line,
+        [](uint32_t line, const LineMarker &marker) {
+            return line < marker.buffer_line;
+        });
+    if (marker == markers.begin()) {
+        return {files[0], buffer_line, 0};
+    }
+    marker--;
+    return {files[marker->file],
+            marker->line + (buffer_line - marker->buffer_line), 0};
+}
+
+std::string SourceManager::describe(SourceLocation location) const {
+    auto presumed = this->presumed(location);
+    return std::string(presumed.file) + ":" + std::to_string(presumed.line) +
+           ":" + std::to_string(presumed.column);
+}
+
+void SourceManager::serialize(ByteWriter &out) const {
+    build_tables();
+    std::vector<uint32_t> offsets = continuations;
+    for (uint32_t i = 0; i < m_buffer->size(); i++) {
+        if (is_continuation((*m_buffer)[i])) {
+            offsets.push_back(i);
+        }
+    }
+
+    out.put(buffer_size);
+    out.put_array(line_starts);
+    out.put_array(markers);
+    out.put_array(offsets);
+    out.put<uint32_t>(files.size());
+    for (auto &file : files) {
+        out.put_string(file);
+    }
+}
+
+std::shared_ptr<const SourceManager> SourceManager::deserialize(
+    ByteReader &in) {
+    std::shared_ptr<SourceManager> sources(new SourceManager());
+    sources->m_buffer = std::make_shared<const std::string>();
+    sources->buffer_size = in.get<uint32_t>();
+    in.get_array(sources->line_starts);
+    in.get_array(sources->markers);
+    in.get_array(sources->continuations);
+    uint32_t file_count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < file_count; i++) {
+        sources->files.emplace_back(in.get_string());
+    }
+    std::call_once(sources->built, []() {});
+
+    // presumed looks lines, markers and continuation bytes up by binary
+    // search and indexes files with the markers
+    auto &lines = sources->line_starts;
+    auto &markers = sources->markers;
+    bool valid =
+        !lines.empty() && lines[0] == 0 &&
+        std::is_sorted(lines.begin(), lines.end()) &&
+        lines.back() <= sources->buffer_size &&
+        std::is_sorted(markers.begin(), markers.end(),
+                       [](const LineMarker &a, const LineMarker &b) {
+                           return a.buffer_line < b.buffer_line;
+                       }) &&
+        std::is_sorted(sources->continuations.begin(),
+                       sources->continuations.end()) &&
+        !sources->files.empty();
+    for (auto &marker : markers) {
+        valid = valid && marker.file < sources->files.size();
+    }
+    if (!valid) {
+        die("Invalid line table in binary data");
+    }
+    return sources;
+}
+
+}  // namespace CCOMP
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CCOMP {
+class ByteWriter;
+class ByteReader;
+
+// Byte offset into the preprocessed buffer. The SourceManager turns it into a
+// file, line and column.
+class SourceLocation {
+   public:
+    SourceLocation() = default;
+    explicit SourceLocation(uint32_t offset) : offset(offset) {
+    }
+
+    [[nodiscard]] bool valid() const {
+        return offset != INVALID;
+    }
+    [[nodiscard]] uint32_t get_offset() const {
+        return offset;
+    }
+
+    [[nodiscard]] SourceLocation moved(int64_t delta) const {
+        if (!valid()) {
+            return *this;
+        }
+        return SourceLocation(offset + delta);
+    }
+
+    bool operator==(SourceLocation other) const {
+        return offset == other.offset;
+    }
+    bool operator!=(SourceLocation other) const {
+        return offset != other.offset;
+    }
+    bool operator<(SourceLocation other) const {
+        return offset < other.offset;
+    }
+
+   private:
+    static constexpr uint32_t INVALID = UINT32_MAX;
+    uint32_t offset = INVALID;
+};
+
+// Position in the file the preprocessor read. Lines and columns start at 1,
+// columns count code points.
+struct PresumedLocation {
+    std::string_view file;
+    uint32_t line = 0, column = 0;
+};
+
+// Maps locations in the preprocessed buffer back to the original files using
+// the line markers ('# 12 "file.h" 2') the preprocessor leaves in it. The line
+// table and the markers are only collected on the first lookup.
+class SourceManager {
+   public:
+    // main_file is used for lines in front of the first marker
+    explicit SourceManager(std::shared_ptr<const std::string> buffer,
+                           std::string main_file = "<input>");
+
+    // Empty for a manager read back with deserialize
+    [[nodiscard]] const std::string &buffer() const {
+        return *m_buffer;
+    }
+
+    [[nodiscard]] PresumedLocation presumed(SourceLocation location) const;
+
+    // For diagnostics which only know the line of the buffer, starting at 1
+    [[nodiscard]] PresumedLocation presumed_line(uint32_t buffer_line) const;
+
+    // "file:line:column"
+    [[nodiscard]] std::string describe(SourceLocation location) const;
+
+    // Writes the tables instead of the buffer. The manager read back maps
+    // locations like this one, but has no buffer.
+    void serialize(ByteWriter &out) const;
+    static std::shared_ptr<const SourceManager> deserialize(ByteReader &in);
+
+   private:
+    SourceManager() = default;
+
+    // Line buffer_line of the buffer is line of file
+    struct LineMarker {
+        uint32_t buffer_line;
+        uint32_t line;
+        uint32_t file;
+    };
+
+    void build_tables() const;
+    void read_marker(std::string_view text, uint32_t buffer_line) const;
+    // Code points in the bytes [begin, end) of the buffer
+    [[nodiscard]] uint32_t characters(uint32_t begin, uint32_t end) const;
+
+    std::shared_ptr<const std::string> m_buffer;
+    uint32_t buffer_size = 0;
+
+    mutable std::once_flag built;
+    // Offset of the first byte of every line
+    mutable std::vector<uint32_t> line_starts;
+    mutable std::vector<LineMarker> markers;
+    mutable std::vector<std::string> files;
+    // Offsets of the UTF-8 continuation bytes, only kept without the buffer
+    std::vector<uint32_t> continuations;
+};
+
+}  // namespace CCOMP
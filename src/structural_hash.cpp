@@ -0,0 +1,334 @@
+#include "structural_hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <type_traits>
+
+#include "byte_stream.hpp"
+#include "common.hpp"
+#include "io.hpp"
+#include "traversal.hpp"
+#include "visitors/staticVisitor.hpp"
+
+namespace CCOMP::AST {
+
+namespace {
+
+// Mixes the fields of one node into a hash. Only fixed constants are used,
+// unlike std::hash, so the hashes can be written to a file.
+class Hash {
+   public:
+    explicit Hash(Kind kind) {
+        add((uint64_t)kind);
+    }
+
+    void add(uint64_t word) {
+        state = mix(state + 0x9e3779b97f4a7c15 + word);
+    }
+
+    // FNV-1a of the bytes
+    void add(std::string_view s) {
+        uint64_t h = 0xcbf29ce484222325;
+        for (char c : s) {
+            h = (h ^ (uint8_t)c) * 0x100000001b3;
+        }
+        add(s.size());
+        add(h);
+    }
+
+    [[nodiscard]] uint64_t value() const {
+        return state;
+    }
+
+   private:
+    // Finalizer of splitmix64
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t state = 0;
+};
+
+// Fields of a node besides its children and location
+template <typename T>
+void add_fields(const T &, Hash &) {
+}
+void add_fields(const Identifier &node, Hash &hash) {
+    hash.add(node.name);
+}
+void add_fields(const Attribute &node, Hash &hash) {
+    hash.add(node.name);
+}
+void add_fields(const Assembly &node, Hash &hash) {
+    hash.add(node.assembly.size());
+    for (auto &line : node.assembly) {
+        hash.add(line);
+    }
+}
+void add_fields(const SwitchBlock &node, Hash &hash) {
+    hash.add(node.is_default);
+    hash.add(node.break_after);
+}
+void add_fields(const StructAccess &node, Hash &hash) {
+    hash.add(node.through_pointer);
+}
+void add_fields(const OperationAssignment &node, Hash &hash) {
+    hash.add((uint64_t)node.op);
+}
+void add_fields(const UnaryExpression &node, Hash &hash) {
+    hash.add((uint64_t)node.op);
+}
+void add_fields(const BinaryExpression &node, Hash &hash) {
+    hash.add((uint64_t)node.op);
+}
+void add_fields(const VariableDeclaration &node, Hash &hash) {
+    hash.add(node.global);
+}
+void add_fields(const NamedType &node, Hash &hash) {
+    hash.add(node.name);
+}
+void add_fields(const FunctionType &node, Hash &hash) {
+    hash.add(node.varargs);
+}
+void add_fields(const PrimitiveType &node, Hash &hash) {
+    hash.add(node.keywords.size());
+    for (auto keyword : node.keywords) {
+        hash.add((uint64_t)keyword);
+    }
+}
+void add_fields(const StructType &node, Hash &hash) {
+    hash.add(node.definition);
+}
+void add_fields(const UnionType &node, Hash &hash) {
+    hash.add(node.definition);
+}
+void add_fields(const EnumType &node, Hash &hash) {
+    hash.add(node.definition);
+}
+
+void add_type_fields(const Type &node, Hash &hash) {
+    hash.add(node.pointer_count);
+    hash.add(node.is_const);
+    hash.add(node.is_restrict);
+    // Dimensions without a size are no child
+    hash.add(node.array_sizes.size());
+    for (auto &size : node.array_sizes) {
+        hash.add(size != nullptr);
+    }
+}
+
+// Hashes of the children of a node, in the order of for_each_child
+struct ChildHashes {
+    const uint64_t *first;
+    size_t size;
+};
+
+// Hashes a node from the hashes of its children. The tree is walked with a
+// Traversal, so deep expressions need no stack frame per level.
+class Hasher : public StaticVisitor<Hasher, uint64_t, ChildHashes> {
+   public:
+    explicit Hasher(std::unordered_map<const AST *, uint64_t> *nodes)
+        : nodes(nodes) {
+    }
+
+    uint64_t hash(const AST &root) {
+        // The hashes of the finished children of the nodes on the stack
+        std::vector<uint64_t> hashes;
+        // Where the children of each node on the stack begin in hashes
+        std::vector<size_t> starts;
+        Traversal walk(root);
+        Traversal::Event event;
+        while (walk.next(event)) {
+            if (event.order == Traversal::Order::PRE) {
+                starts.push_back(hashes.size());
+                continue;
+            }
+            size_t start = starts.back();
+            starts.pop_back();
+            uint64_t hash =
+                dispatch(*event.node, {hashes.data() + start,
+                                       hashes.size() - start});
+            hashes.resize(start);
+            hashes.push_back(hash);
+        }
+        return hashes.back();
+    }
+
+    template <typename T>
+    uint64_t visit(const T &node, ChildHashes children) {
+        Hash hash(T::KIND);
+        add_fields(node, hash);
+        if constexpr (std::is_base_of_v<Type, T>) {
+            add_type_fields(node, hash);
+        }
+        if constexpr (std::is_base_of_v<DeclarationData, T>) {
+            hash.add(node.is_public);
+        }
+        for (size_t i = 0; i < children.size; i++) {
+            hash.add(children.first[i]);
+        }
+        hash.add(children.size);
+        return record(node, hash.value());
+    }
+
+    uint64_t visit(const Constant &node, ChildHashes) {
+        switch (node.literal_kind) {
+            case Constant::LiteralKind::INTEGER:
+                return record(node, integer(node.integer));
+            case Constant::LiteralKind::FLOAT:
+                return record(node, floating(node.floating));
+            case Constant::LiteralKind::STRING:
+                return record(node, string(node.string));
+        }
+        die("Invalid literal kind %d", (int)node.literal_kind);
+        return 0;
+    }
+
+    // Hashes the elements of a packed list like the nodes unpack would make
+    uint64_t visit(const ArrayInitializationList &node,
+                   ChildHashes children) {
+        if (!node.packed()) {
+            return visit<ArrayInitializationList>(node, children);
+        }
+        const PackedLiterals &packed = *node.packed();
+        Hash hash(Kind::ARRAY_INITIALIZATION_LIST);
+        for (size_t i = 0; i < packed.size(); i++) {
+            uint64_t value;
+            if (packed.storage() == PackedLiterals::Storage::FLOATS) {
+                value = floating(packed.floating(i));
+            } else {
+                value = integer(packed.integer(i));
+            }
+            if (packed.is_negative(i)) {
+                value = unary(UnaryExpression::Operator::MINUS, value);
+            }
+            hash.add(value);
+        }
+        hash.add(packed.size());
+        return record(node, hash.value());
+    }
+
+   private:
+    static uint64_t integer(IntegerLiteral literal) {
+        Hash hash(Kind::CONSTANT);
+        hash.add((uint64_t)Constant::LiteralKind::INTEGER);
+        hash.add(literal.value);
+        hash.add(literal.is_unsigned);
+        hash.add(literal.long_count);
+        hash.add(0);
+        return hash.value();
+    }
+    static uint64_t floating(FloatLiteral literal) {
+        uint64_t bits;
+        std::memcpy(&bits, &literal.value, sizeof(bits));
+        Hash hash(Kind::CONSTANT);
+        hash.add((uint64_t)Constant::LiteralKind::FLOAT);
+        hash.add(bits);
+        hash.add(literal.is_float);
+        hash.add(literal.is_long);
+        hash.add(0);
+        return hash.value();
+    }
+    static uint64_t string(std::string_view literal) {
+        Hash hash(Kind::CONSTANT);
+        hash.add((uint64_t)Constant::LiteralKind::STRING);
+        hash.add(literal);
+        hash.add(0);
+        return hash.value();
+    }
+    static uint64_t unary(UnaryExpression::Operator op, uint64_t value) {
+        Hash hash(Kind::UNARY_EXPRESSION);
+        hash.add((uint64_t)op);
+        hash.add(value);
+        hash.add(1);
+        return hash.value();
+    }
+
+    uint64_t record(const AST &node, uint64_t hash) {
+        if (nodes != nullptr) {
+            (*nodes)[&node] = hash;
+        }
+        return hash;
+    }
+
+    std::unordered_map<const AST *, uint64_t> *nodes;
+};
+
+}  // namespace
+
+uint64_t structural_hash(const AST &node,
+                         std::unordered_map<const AST *, uint64_t> *nodes) {
+    return Hasher(nodes).hash(node);
+}
+
+HashFile HashFile::load(const std::string &path) {
+    HashFile file;
+    if (!std::ifstream(path)) {
+        trace("No structural hashes at %s", path.c_str());
+        return file;
+    }
+    // The file only saves work, so a damaged one is ignored like an old
+    // one. The sizes are checked first, ByteReader dies on truncated data.
+    std::string data = IO::read_file(path);
+    // The header, the element size and the count
+    const size_t start = sizeof(Header) + 2 * sizeof(uint32_t);
+    if (data.size() < start) {
+        warn("%s is truncated, it is ignored", path.c_str());
+        return file;
+    }
+    ByteReader reader(data);
+    auto header = reader.get<Header>();
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        warn("%s is no structural hash file, it is ignored", path.c_str());
+        return file;
+    }
+    if (header.version != VERSION) {
+        trace("%s has version %u instead of %u, it is ignored", path.c_str(),
+              header.version, VERSION);
+        return file;
+    }
+    ByteReader array = reader;
+    auto element_size = array.get<uint32_t>();
+    auto count = array.get<uint32_t>();
+    if (element_size != sizeof(uint64_t) ||
+        data.size() - start != (uint64_t)count * sizeof(uint64_t)) {
+        warn("%s is damaged, it is ignored", path.c_str());
+        return file;
+    }
+    reader.get_array(file.hashes);
+    file.sorted = false;
+    return file;
+}
+
+void HashFile::save(const std::string &path) {
+    sort();
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+
+    std::string out;
+    ByteWriter writer(out);
+    writer.put(header);
+    writer.put_array(hashes);
+    IO::write_file(path, out);
+}
+
+bool HashFile::contains(uint64_t hash) {
+    sort();
+    return std::binary_search(hashes.begin(), hashes.end(), hash);
+}
+
+void HashFile::sort() {
+    if (sorted) {
+        return;
+    }
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    sorted = true;
+}
+
+}  // namespace CCOMP::AST
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.hpp"
+#include "pass_manager.hpp"
+
+namespace CCOMP::AST {
+
+// Hash of the structure of a tree, computed bottom up from the hashes of the
+// children. Locations are left out, so a declaration keeps its hash when the
+// lines above it change, and so is the file name of a Program. Identifiers
+// and string literals are hashed by their text, not by any id. The hash is
+// the same in every run and build, a packed initializer hashes like its
+// unpacked nodes and is not unpacked. Lazy bodies are parsed.
+//
+// With nodes the hash of every node in the tree is stored in it as well.
+uint64_t structural_hash(const AST &node,
+                         std::unordered_map<const AST *, uint64_t> *nodes =
+                             nullptr);
+
+// The structural hash of every top level declaration. It hashes in begin,
+// so it adds no work to the nodes of the walk it is fused into.
+class StructuralHashes : public Analysis<uint64_t> {
+   public:
+    StructuralHashes() : Analysis("structural hashes", 0, Kinds()) {
+    }
+
+   protected:
+    void begin(const AST &declaration, uint64_t &result) override {
+        result = structural_hash(declaration);
+    }
+};
+
+// The structural hashes of the top level declarations of an earlier compile.
+// A declaration whose hash is in it did not change since, wherever it moved.
+class HashFile {
+   public:
+    // Changes whenever structural_hash hashes differently
+    static constexpr uint32_t VERSION = 2;
+
+    // Empty if there is no file at path, it was written by another version
+    // or it is damaged
+    static HashFile load(const std::string &path);
+    void save(const std::string &path);
+
+    void add(uint64_t hash) {
+        hashes.push_back(hash);
+        sorted = false;
+    }
+    [[nodiscard]] bool contains(uint64_t hash);
+    [[nodiscard]] size_t size() const {
+        return hashes.size();
+    }
+
+   private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+    };
+
+    static constexpr char MAGIC[8] = {'C', 'C', 'O', 'M', 'P', 'H', 'S', 'H'};
+
+    void sort();
+
+    std::vector<uint64_t> hashes;
+    bool sorted = true;
+};
+
+}  // namespace CCOMP::AST
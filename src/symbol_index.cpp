@@ -0,0 +1,354 @@
+#include "symbol_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+#include "byte_stream.hpp"
+#include "common.hpp"
+#include "io.hpp"
+#include "visitors/staticVisitor.hpp"
+
+namespace CCOMP::AST {
+
+namespace {
+
+struct Entry {
+    uint32_t name;
+    SymbolIndex::Occurrence occurrence;
+};
+
+// Records the names a top level declaration mentions. Names of declarations
+// are recorded by their declaration, every other Identifier is a reference.
+// The visits only queue the nodes and names of a node, index works through
+// them with an explicit stack, so deep trees need no stack frame per level.
+class Indexer : public StaticVisitor<Indexer> {
+   public:
+    using Role = SymbolIndex::Role;
+
+    Indexer(StringPool &names, const SourceManager *sources,
+            std::vector<Entry> &entries)
+        : names(names), sources(sources), entries(entries) {
+    }
+
+    void index(const AST &root) {
+        pending.push_back({&root, {}, {}, {}, {}});
+        while (!pending.empty()) {
+            Item item = pending.back();
+            pending.pop_back();
+            if (item.node == nullptr) {
+                add(item.name, item.location, item.kind, item.role);
+                continue;
+            }
+            dispatch(*item.node);
+            // The first queued item is taken next
+            pending.insert(pending.end(), queued.rbegin(), queued.rend());
+            queued.clear();
+        }
+    }
+
+    template <typename T>
+    void visit_children(const T &node) {
+        for_each_child(node, [&](const AST &child) { enter(child); });
+    }
+
+    void visit(const Identifier &node) {
+        record(node.name, node.location, Kind::IDENTIFIER, Role::REFERENCE);
+        visit_type(node);
+    }
+
+    void visit(const NamedType &node) {
+        record(node.name, node.location, node.kind, Role::TYPE_NAME);
+        visit_children(node);
+    }
+
+    void visit(const FunctionType &node) {
+        enter(*node.return_type);
+        for (auto &param : node.parameters) {
+            record(param->name, param->location, Kind::IDENTIFIER,
+                   Role::DECLARATION);
+            visit_type(*param);
+        }
+        for_each_array_size(node, [&](const AST &size) { enter(size); });
+    }
+
+    void visit(const FunctionCall &node) {
+        record(node.name->name, node.name->location, node.kind, Role::CALL);
+        for (auto &argument : node.arguments) {
+            enter(*argument);
+        }
+    }
+
+    void visit(const StructAccess &node) {
+        enter(*node.struc);
+        record(node.member->name, node.member->location, node.kind,
+               Role::MEMBER);
+    }
+
+    void visit(const TypeDef &node) {
+        declaration(node, Role::DECLARATION);
+    }
+    void visit(const VariableDeclaration &node) {
+        declaration(node, Role::DECLARATION);
+    }
+    void visit(const FunctionDeclaration &node) {
+        declaration(node, Role::DECLARATION);
+    }
+    void visit(const FunctionDefinition &node) {
+        declaration(node, Role::DEFINITION);
+    }
+    void visit(const EnumValue &node) {
+        declaration(node, Role::DECLARATION);
+    }
+    void visit(const StructType &node) {
+        declaration(node, node.definition ? Role::DEFINITION : Role::TAG);
+    }
+    void visit(const UnionType &node) {
+        declaration(node, node.definition ? Role::DEFINITION : Role::TAG);
+    }
+    void visit(const EnumType &node) {
+        declaration(node, node.definition ? Role::DEFINITION : Role::TAG);
+    }
+
+   public:
+    uint32_t scope = SymbolIndex::NONE;
+
+   private:
+    // A node to visit, or a name to record if node is nullptr
+    struct Item {
+        const AST *node;
+        std::string_view name;
+        SourceLocation location;
+        Kind kind;
+        Role role;
+    };
+
+    void enter(const AST &node) {
+        queued.push_back({&node, {}, {}, {}, {}});
+    }
+    void record(std::string_view name, SourceLocation location, Kind kind,
+                Role role) {
+        queued.push_back({nullptr, name, location, kind, role});
+    }
+
+    // The children but the name, then the name
+    template <typename T>
+    void declaration(const T &node, Role role) {
+        const Identifier &name = *node.name;
+        for_each_child(node, [&](const AST &child) {
+            if (&child != &name) {
+                enter(child);
+            }
+        });
+        record(name.name, name.location, node.kind, role);
+        visit_type(name);
+    }
+
+    // A type the identifier only refers to belongs to a declaration and is
+    // visited there
+    void visit_type(const Identifier &node) {
+        if (node.owns_type()) {
+            enter(*node.type());
+        }
+    }
+
+    void add(std::string_view name, SourceLocation location, Kind kind,
+             Role role) {
+        if (name.empty()) {
+            return;
+        }
+        SymbolIndex::Occurrence occurrence{};
+        occurrence.location = location;
+        occurrence.file = SymbolIndex::NONE;
+        occurrence.scope = scope;
+        occurrence.kind = kind;
+        occurrence.role = role;
+        if (sources != nullptr && location.valid()) {
+            PresumedLocation presumed = sources->presumed(location);
+            occurrence.file = names.intern(presumed.file);
+            occurrence.line = presumed.line;
+            occurrence.column = presumed.column;
+        }
+        entries.push_back({names.intern(name), occurrence});
+    }
+
+    StringPool &names;
+    const SourceManager *sources;
+    std::vector<Entry> &entries;
+    // Items left to do, the next one last
+    std::vector<Item> pending;
+    // Items of the node visited last, in order
+    std::vector<Item> queued;
+};
+
+}  // namespace
+
+SymbolIndex SymbolIndex::build(const Program &program,
+                               const SourceManager *sources) {
+    SymbolIndex index;
+    std::vector<Entry> entries;
+    Indexer indexer(index.names, sources, entries);
+    for (auto &declaration : program.declarations) {
+        const DeclarationData *data = declaration_data(declaration.get());
+        indexer.scope = NONE;
+        if (data != nullptr && !data->name->name.empty()) {
+            indexer.scope = index.names.intern(data->name->name);
+        }
+        indexer.index(*declaration);
+    }
+
+    // Counting sort by name
+    auto &offsets = index.offsets;
+    offsets.assign(index.names.size() + 1, 0);
+    for (auto &entry : entries) {
+        offsets[entry.name + 1]++;
+    }
+    for (size_t i = 1; i < offsets.size(); i++) {
+        offsets[i] += offsets[i - 1];
+    }
+    std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+    index.occurrences.resize(entries.size());
+    for (auto &entry : entries) {
+        index.occurrences[next[entry.name]++] = entry.occurrence;
+    }
+
+    // A declaration records its name after its children
+    auto by_location = [](const Occurrence &a, const Occurrence &b) {
+        return a.location < b.location;
+    };
+    for (size_t i = 0; i + 1 < offsets.size(); i++) {
+        std::stable_sort(index.occurrences.begin() + offsets[i],
+                         index.occurrences.begin() + offsets[i + 1],
+                         by_location);
+    }
+
+    trace("Indexed %zu occurrences of %zu names", index.occurrences.size(),
+          index.names.size());
+    return index;
+}
+
+void SymbolIndex::save(const std::string &path) const {
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+
+    std::string out;
+    ByteWriter writer(out);
+    writer.put(header);
+    names.serialize(writer);
+    writer.put_array(offsets);
+    // Field by field, the padding of Occurrence is not written
+    writer.put<uint32_t>(occurrences.size());
+    for (auto &occurrence : occurrences) {
+        writer.put(occurrence.location.get_offset());
+        writer.put(occurrence.file);
+        writer.put(occurrence.line);
+        writer.put(occurrence.column);
+        writer.put(occurrence.scope);
+        writer.put(occurrence.kind);
+        writer.put(occurrence.role);
+    }
+    IO::write_file(path, out);
+}
+
+SymbolIndex SymbolIndex::load(const std::string &path) {
+    std::string data = IO::read_file(path);
+    ByteReader reader(data);
+    auto header = reader.get<Header>();
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        die("%s is no symbol index", path.c_str());
+    }
+    if (header.version != VERSION) {
+        die("%s has version %u instead of %u", path.c_str(), header.version,
+            VERSION);
+    }
+
+    SymbolIndex index;
+    index.names.deserialize(reader);
+    reader.get_array(index.offsets);
+    // file and scope are ids of names, callers and name hand them out
+    auto is_name = [&](uint32_t id) {
+        return id == NONE || id < index.names.size();
+    };
+    index.occurrences.resize(reader.get<uint32_t>());
+    for (auto &occurrence : index.occurrences) {
+        occurrence.location = SourceLocation(reader.get<uint32_t>());
+        occurrence.file = reader.get<uint32_t>();
+        occurrence.line = reader.get<uint32_t>();
+        occurrence.column = reader.get<uint32_t>();
+        occurrence.scope = reader.get<uint32_t>();
+        occurrence.kind = reader.get<Kind>();
+        occurrence.role = reader.get<Role>();
+        if ((size_t)occurrence.kind >= KIND_COUNT ||
+            occurrence.role > Role::TAG || !is_name(occurrence.file) ||
+            !is_name(occurrence.scope)) {
+            die("%s is corrupt", path.c_str());
+        }
+    }
+    // find turns each pair of offsets into a range of occurrences
+    auto &offsets = index.offsets;
+    if (offsets.size() != index.names.size() + 1 || offsets[0] != 0 ||
+        offsets.back() != index.occurrences.size()) {
+        die("%s is corrupt", path.c_str());
+    }
+    for (size_t i = 1; i < offsets.size(); i++) {
+        if (offsets[i] < offsets[i - 1]) {
+            die("%s is corrupt", path.c_str());
+        }
+    }
+    return index;
+}
+
+SymbolIndex::Occurrences SymbolIndex::find(std::string_view name) const {
+    uint32_t id = names.find(name);
+    if (id == StringPool::NONE) {
+        return {nullptr, nullptr};
+    }
+    const Occurrence *first = occurrences.data();
+    return {first + offsets[id], first + offsets[id + 1]};
+}
+
+std::vector<uint32_t> SymbolIndex::callers(std::string_view function) const {
+    std::vector<uint32_t> result;
+    std::unordered_set<uint32_t> seen;
+    for (auto &occurrence : find(function)) {
+        if (occurrence.role == Role::CALL && occurrence.scope != NONE &&
+            seen.insert(occurrence.scope).second) {
+            result.push_back(occurrence.scope);
+        }
+    }
+    return result;
+}
+
+const char *SymbolIndex::role_name(Role role) {
+    switch (role) {
+        case Role::DECLARATION:
+            return "declaration";
+        case Role::DEFINITION:
+            return "definition";
+        case Role::REFERENCE:
+            return "reference";
+        case Role::CALL:
+            return "call";
+        case Role::MEMBER:
+            return "member";
+        case Role::TYPE_NAME:
+            return "type name";
+        case Role::TAG:
+            return "tag";
+    }
+    return "";
+}
+
+const char *SymbolIndex::kind_name(Kind kind) {
+    switch (kind) {
+#define KIND_NAME(type, kind) \
+    case Kind::kind:          \
+        return #type;
+        AST_KINDS(KIND_NAME)
+#undef KIND_NAME
+    }
+    return "";
+}
+
+}  // namespace CCOMP::AST
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ast.hpp"
+#include "literals.hpp"
+#include "source_manager.hpp"
+
+namespace CCOMP::AST {
+
+// Every place a name is mentioned in a program, grouped by name. Building it
+// walks the program once, afterwards looking up a name only touches its
+// occurrences. It can be saved next to the source and loaded by tools
+// without parsing again.
+//
+//     auto index = SymbolIndex::build(program, &sources);
+//     for (auto &occurrence : index.find("malloc")) {
+//         if (occurrence.role == SymbolIndex::Role::CALL) ...
+//     }
+class SymbolIndex {
+   public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    enum class Role : uint8_t {
+        // Name of a declaration, parameter, struct member or enum constant
+        DECLARATION,
+        // Name of a function definition or a struct, union or enum with
+        // members
+        DEFINITION,
+        // Identifier in an expression
+        REFERENCE,
+        // Name of a called function
+        CALL,
+        // Member behind . or ->
+        MEMBER,
+        // Typedef name used as a type
+        TYPE_NAME,
+        // Tag of a struct, union or enum without members
+        TAG,
+    };
+
+    struct Occurrence {
+        SourceLocation location;
+        // Where the preprocessor read it, NONE and 0 without a SourceManager
+        uint32_t file, line, column;
+        // Name of the top level declaration it is in, NONE for unnamed ones
+        uint32_t scope;
+        // Of the node mentioning the name, for declarations the declaration
+        Kind kind;
+        Role role;
+    };
+
+    // Occurrences of one name in source order
+    class Occurrences {
+       public:
+        Occurrences(const Occurrence *first, const Occurrence *last)
+            : first(first), last(last) {
+        }
+
+        [[nodiscard]] const Occurrence *begin() const {
+            return first;
+        }
+        [[nodiscard]] const Occurrence *end() const {
+            return last;
+        }
+        [[nodiscard]] size_t size() const {
+            return last - first;
+        }
+        [[nodiscard]] bool empty() const {
+            return first == last;
+        }
+
+       private:
+        const Occurrence *first, *last;
+    };
+
+    // With sources the occurrences get their file, line and column. Lazy
+    // bodies are parsed.
+    static SymbolIndex build(const Program &program,
+                             const SourceManager *sources = nullptr);
+
+    void save(const std::string &path) const;
+    static SymbolIndex load(const std::string &path);
+
+    [[nodiscard]] Occurrences find(std::string_view name) const;
+    // Top level declarations calling function, each once, in source order
+    [[nodiscard]] std::vector<uint32_t> callers(
+        std::string_view function) const;
+
+    // Of the ids in occurrences
+    [[nodiscard]] std::string_view name(uint32_t id) const {
+        return names.get(id);
+    }
+    [[nodiscard]] size_t size() const {
+        return occurrences.size();
+    }
+
+    static const char *role_name(Role role);
+    static const char *kind_name(Kind kind);
+
+   private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+    };
+
+    static constexpr char MAGIC[8] = {'C', 'C', 'O', 'M', 'P', 'I', 'D', 'X'};
+
+    // Names, file names and scopes
+    StringPool names;
+    // The occurrences of name id are [offsets[id], offsets[id + 1])
+    std::vector<uint32_t> offsets;
+    std::vector<Occurrence> occurrences;
+};
+
+}  // namespace CCOMP::AST
@@ -0,0 +1,230 @@
+#include "thread_pool.hpp"
+
+#include "common.hpp"
+
+namespace CCOMP {
+
+WorkDeque::WorkDeque(size_t capacity) {
+    arrays.push_back(std::make_unique<Array>(capacity));
+    array.store(arrays.back().get(), std::memory_order_relaxed);
+}
+
+WorkDeque::Array *WorkDeque::grow(Array *old, int64_t top, int64_t bottom) {
+    arrays.push_back(std::make_unique<Array>((old->mask + 1) * 2));
+    Array *bigger = arrays.back().get();
+    for (int64_t i = top; i < bottom; i++) {
+        bigger->put(i, old->get(i));
+    }
+    array.store(bigger, std::memory_order_release);
+    return bigger;
+}
+
+void WorkDeque::push(uint64_t item) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    Array *a = array.load(std::memory_order_relaxed);
+    if (b - t > (int64_t)a->mask) {
+        a = grow(a, t, b);
+    }
+    a->put(b, item);
+    // Publishes the item and everything written before it to the thieves
+    bottom.store(b + 1, std::memory_order_release);
+}
+
+bool WorkDeque::pop(uint64_t &item) {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Array *a = array.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // Empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+    item = a->get(b);
+    if (t == b) {
+        // The last item, a thief may be taking it at the same time
+        bool won = top.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool WorkDeque::steal(uint64_t &item) {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return false;
+    }
+    Array *a = array.load(std::memory_order_acquire);
+    item = a->get(t);
+    return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed);
+}
+
+bool WorkDeque::empty() const {
+    int64_t t = top.load(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_seq_cst);
+    return t >= b;
+}
+
+// A range of iterations is one deque item
+static uint64_t make_range(uint32_t begin, uint32_t end) {
+    return (uint64_t)begin << 32 | end;
+}
+
+ThreadPool::ThreadPool(size_t count) {
+    if (count == 0) {
+        count = std::thread::hardware_concurrency();
+    }
+    if (count == 0) {
+        count = 1;
+    }
+    trace("Starting a thread pool with %zu threads", count);
+
+    for (size_t i = 0; i < count; i++) {
+        deques.push_back(std::make_unique<WorkDeque>());
+    }
+    // Deque 0 belongs to the caller of parallel_for
+    for (size_t i = 1; i < count; i++) {
+        threads.emplace_back([this, i]() { work(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+Arena &ThreadPool::scratch() {
+    thread_local Arena arena;
+    return arena;
+}
+
+void ThreadPool::parallel_for(size_t count,
+                              const std::function<void(size_t)> &body) {
+    if (count == 0) {
+        return;
+    }
+    if (count > UINT32_MAX) {
+        die("parallel_for over %zu iterations", count);
+    }
+    if (threads.empty()) {
+        for (size_t i = 0; i < count; i++) {
+            body(i);
+            scratch().reset();
+        }
+        return;
+    }
+
+    this->body = &body;
+    remaining.store(count, std::memory_order_relaxed);
+    deques[0]->push(make_range(0, count));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+    }
+    wake.notify_all();
+
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (!run_one(0)) {
+            idle();
+        }
+    }
+}
+
+void ThreadPool::work(size_t self) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock,
+                      [&]() { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            if (!run_one(self)) {
+                idle();
+            }
+        }
+    }
+}
+
+bool ThreadPool::run_one(size_t self) {
+    uint64_t range;
+    if (deques[self]->pop(range)) {
+        execute(self, range);
+        return true;
+    }
+    // Start at different victims so the thieves do not all fight for one
+    thread_local uint32_t random = self * 2654435761u + 1;
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    for (size_t i = 0; i < deques.size(); i++) {
+        size_t victim = (random + i) % deques.size();
+        if (victim != self && deques[victim]->steal(range)) {
+            execute(self, range);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::idle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    // Either the check below sees a range pushed in the meantime or the
+    // thread pushing it sees this sleeper, see execute
+    sleepers.fetch_add(1, std::memory_order_seq_cst);
+    bool has_work = false;
+    for (auto &deque : deques) {
+        has_work = has_work || !deque->empty();
+    }
+    if (!has_work && remaining.load(std::memory_order_seq_cst) > 0) {
+        work_available.wait(lock);
+    }
+    sleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::execute(size_t self, uint64_t range) {
+    uint32_t begin = range >> 32;
+    uint32_t end = range & UINT32_MAX;
+    bool pushed = end - begin > 1;
+    while (end - begin > 1) {
+        uint32_t middle = begin + (end - begin) / 2;
+        deques[self]->push(make_range(middle, end));
+        end = middle;
+    }
+    if (pushed) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0) {
+            // Taking the lock waits for a sleeper between its check and
+            // its wait
+            std::lock_guard<std::mutex> lock(mutex);
+            work_available.notify_all();
+        }
+    }
+    (*body)(begin);
+    scratch().reset();
+    if (remaining.fetch_sub(1, std::memory_order_seq_cst) == 1) {
+        // The caller of parallel_for and the idle workers wait for this
+        std::lock_guard<std::mutex> lock(mutex);
+        work_available.notify_all();
+    }
+}
+
+}  // namespace CCOMP
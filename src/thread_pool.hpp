@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "arena.hpp"
+
+namespace CCOMP {
+
+// Chase-Lev deque. The thread owning it pushes and pops at the bottom, the
+// other threads steal from the top. The items are ranges of work, see
+// ThreadPool.
+class WorkDeque {
+   public:
+    explicit WorkDeque(size_t capacity = 64);
+
+    WorkDeque(const WorkDeque &) = delete;
+    WorkDeque &operator=(const WorkDeque &) = delete;
+
+    // Only the owner
+    void push(uint64_t item);
+    bool pop(uint64_t &item);
+    // Any thread
+    bool steal(uint64_t &item);
+    [[nodiscard]] bool empty() const;
+
+   private:
+    struct Array {
+        explicit Array(size_t capacity)
+            : mask(capacity - 1),
+              items(std::make_unique<std::atomic<uint64_t>[]>(capacity)) {
+        }
+
+        [[nodiscard]] uint64_t get(int64_t i) const {
+            return items[i & mask].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, uint64_t item) {
+            items[i & mask].store(item, std::memory_order_relaxed);
+        }
+
+        size_t mask;
+        std::unique_ptr<std::atomic<uint64_t>[]> items;
+    };
+
+    Array *grow(Array *old, int64_t top, int64_t bottom);
+
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::atomic<Array *> array;
+    // Thieves may still read from replaced arrays, they are kept until the
+    // deque is destroyed
+    std::vector<std::unique_ptr<Array>> arrays;
+};
+
+// Fixed set of threads running the iterations of parallel_for. A range of
+// iterations is split in halves until single ones are left, the upper halves
+// go to the deque of the thread and idle threads steal them, so large ranges
+// are taken first.
+class ThreadPool {
+   public:
+    // 0 starts one thread per core. The thread calling parallel_for works as
+    // well and counts as one of them.
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    [[nodiscard]] size_t size() const {
+        return deques.size();
+    }
+
+    // Calls body(i) for every i below count and returns when all calls
+    // returned. The calls happen in no particular order. Only one thread may
+    // call it at a time and body may not call it.
+    void parallel_for(size_t count, const std::function<void(size_t)> &body);
+
+    // Memory of the calling thread for the current iteration, it is reset
+    // after every one
+    static Arena &scratch();
+
+   private:
+    void work(size_t self);
+    // Runs a range of its own or a stolen one, false if there was none
+    bool run_one(size_t self);
+    void execute(size_t self, uint64_t range);
+    // Blocks until a deque may have a range or the iterations are done
+    void idle();
+
+    std::vector<std::unique_ptr<WorkDeque>> deques;
+    std::vector<std::thread> threads;
+
+    const std::function<void(size_t)> *body = nullptr;
+    // Iterations of the current parallel_for that did not return yet
+    std::atomic<size_t> remaining{0};
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    // Counts the calls of parallel_for, the workers sleep until it changes
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    // Threads in idle, the ones pushing ranges only wake them if there are
+    // any
+    std::condition_variable work_available;
+    std::atomic<size_t> sleepers{0};
+};
+
+}  // namespace CCOMP
@@ -0,0 +1,71 @@
+#include "tokens.hpp"
+
+#include "common.hpp"
+
+namespace CCOMP::Parser {
+
+ArenaTokenFactory::ArenaTokenFactory(std::string_view source)
+    : arena(), source(source) {
+    trace("Token factory for %zu bytes", source.size());
+
+    bool ascii = true;
+    for (unsigned char c : source) {
+        if (c >= 0x80) {
+            ascii = false;
+            break;
+        }
+    }
+    if (ascii) {
+        return;
+    }
+
+    code_point_offsets.reserve(source.size() + 1);
+    for (uint32_t i = 0; i < source.size(); i++) {
+        // Skip UTF-8 continuation bytes
+        if ((static_cast<unsigned char>(source[i]) & 0xc0) != 0x80) {
+            code_point_offsets.push_back(i);
+        }
+    }
+    code_point_offsets.push_back(source.size());
+}
+
+uint32_t ArenaTokenFactory::byte_offset(size_t code_point) const {
+    if (code_point_offsets.empty()) {
+        return code_point;
+    }
+    if (code_point >= code_point_offsets.size()) {
+        return source.size();
+    }
+    return code_point_offsets[code_point];
+}
+
+std::unique_ptr<antlr4::CommonToken> ArenaTokenFactory::create(
+    std::pair<antlr4::TokenSource *, antlr4::CharStream *> source_pair,
+    size_t type, const std::string &text, size_t channel, size_t start,
+    size_t stop, size_t line, size_t char_position_in_line) {
+    uint32_t begin = byte_offset(start);
+    uint32_t end = stop + 1 > start ? byte_offset(stop + 1) : begin;
+
+    if (typedefs != nullptr && type == identifier_type &&
+        typedefs->is_typedef(source.substr(begin, end - begin))) {
+        type = typedef_name_type;
+    }
+
+    auto *token = new (arena) ArenaToken(source_pair, type, channel, start,
+                                         stop, source.data(), begin,
+                                         end - begin);
+    token->setLine(line);
+    token->setCharPositionInLine(char_position_in_line);
+    if (!text.empty()) {
+        token->setText(text);
+    }
+    return std::unique_ptr<antlr4::CommonToken>(token);
+}
+
+std::unique_ptr<antlr4::CommonToken> ArenaTokenFactory::create(
+    size_t type, const std::string &text) {
+    return std::unique_ptr<antlr4::CommonToken>(new (arena)
+                                                    ArenaToken(type, text));
+}
+
+}  // namespace CCOMP::Parser
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CommonToken.h"
+#include "TokenFactory.h"
+#include "arena.hpp"
+#include "typedefs.hpp"
+
+namespace CCOMP::Parser {
+
+// Token living in an Arena. It does not copy its text, it only remembers
+// where in the source buffer the token starts and how long it is.
+class ArenaToken : public antlr4::CommonToken {
+   public:
+    ArenaToken(std::pair<antlr4::TokenSource *, antlr4::CharStream *> source,
+               size_t type, size_t channel, size_t start, size_t stop,
+               const char *base, uint32_t offset, uint32_t length)
+        : CommonToken(source, type, channel, start, stop),
+          base(base),
+          offset(offset),
+          length(length) {
+    }
+
+    ArenaToken(size_t type, const std::string &text)
+        : CommonToken(type, text), base(nullptr), offset(0), length(0) {
+    }
+
+    [[nodiscard]] std::string_view view() const {
+        if (!_text.empty()) {
+            return _text;
+        }
+        return {base + offset, length};
+    }
+
+    // Byte offset of the token in the source buffer
+    [[nodiscard]] uint32_t get_offset() const {
+        return offset;
+    }
+
+    std::string getText() const override {
+        return std::string(view());
+    }
+
+    // Tokens are owned by the std::unique_ptrs of the token stream, but their
+    // memory belongs to the arena of the factory.
+    static void *operator new(size_t size, Arena &arena) {
+        return arena.allocate(size, alignof(ArenaToken));
+    }
+    static void operator delete(void *, Arena &) {
+    }
+    static void operator delete(void *) {
+    }
+
+   private:
+    const char *base;
+    uint32_t offset, length;
+};
+
+class ArenaTokenFactory : public antlr4::TokenFactory<antlr4::CommonToken> {
+   public:
+    // The source has to outlive the factory and all tokens created by it
+    explicit ArenaTokenFactory(std::string_view source);
+
+    std::unique_ptr<antlr4::CommonToken> create(
+        std::pair<antlr4::TokenSource *, antlr4::CharStream *> source,
+        size_t type, const std::string &text, size_t channel, size_t start,
+        size_t stop, size_t line, size_t char_position_in_line) override;
+
+    std::unique_ptr<antlr4::CommonToken> create(
+        size_t type, const std::string &text) override;
+
+    // Identifiers naming a typedef of the table become typedef_name tokens
+    void set_typedefs(const TypedefTable *table, size_t identifier,
+                      size_t typedef_name) {
+        typedefs = table;
+        identifier_type = identifier;
+        typedef_name_type = typedef_name;
+    }
+
+   private:
+    uint32_t byte_offset(size_t code_point) const;
+
+    Arena arena;
+    std::string_view source;
+
+    // ANTLR counts in code points, only filled if the source is not ASCII
+    std::vector<uint32_t> code_point_offsets;
+
+    const TypedefTable *typedefs = nullptr;
+    size_t identifier_type = 0, typedef_name_type = 0;
+};
+
+}  // namespace CCOMP::Parser
@@ -0,0 +1,84 @@
+#include "traversal.hpp"
+
+#include "visitors/ASTBaseVisitor.hpp"
+
+namespace CCOMP::AST {
+
+// Lets the base visitor walk one node, but records the children it would
+// recurse into instead of visiting them
+class ChildCollector : public ASTBaseVisitor {
+   public:
+    ChildCollector(const AST &parent, std::vector<const AST *> &out)
+        : parent(&parent), out(&out) {
+    }
+
+#define COLLECT(type, kind)                                \
+    void *visit(const type &node, void *args) override {   \
+        if (&node != parent) {                             \
+            out->push_back(&node);                         \
+            return nullptr;                                \
+        }                                                  \
+        return ASTBaseVisitor::visit(node, args);          \
+    }
+    AST_KINDS(COLLECT)
+#undef COLLECT
+
+   private:
+    const AST *parent;
+    std::vector<const AST *> *out;
+};
+
+void children_of(const AST &node, std::vector<const AST *> &out) {
+    ChildCollector collector(node, out);
+    node.accept(collector, nullptr);
+}
+
+Traversal::Traversal(const AST &root) : root(&root) {
+}
+
+void Traversal::enter(const AST &node, Event &event) {
+    uint32_t end = children.size();
+    stack.push_back({&node, end, end, end});
+    entered = true;
+    event = {&node, Order::PRE, stack.size() - 1};
+}
+
+bool Traversal::next(Event &event) {
+    if (entered) {
+        entered = false;
+        Frame &top = stack.back();
+        if (!skip) {
+            children_of(*top.node, children);
+            top.end = children.size();
+        }
+        skip = false;
+    }
+
+    if (stack.empty()) {
+        if (root == nullptr) {
+            return false;
+        }
+        enter(*root, event);
+        root = nullptr;
+        return true;
+    }
+
+    Frame &top = stack.back();
+    if (top.next < top.end) {
+        const AST *child = children[top.next++];
+        enter(*child, event);
+        return true;
+    }
+
+    // The children of top are the last ones in children
+    event = {top.node, Order::POST, stack.size() - 1};
+    children.resize(top.begin);
+    stack.pop_back();
+    return true;
+}
+
+void Traversal::skip_children() {
+    skip = entered;
+}
+
+}  // namespace CCOMP::AST
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ast.hpp"
+
+namespace CCOMP::AST {
+
+// Direct children of a node in the order ASTBaseVisitor visits them,
+// appended to out. Like the base visitor this parses lazy function bodies.
+void children_of(const AST &node, std::vector<const AST *> &out);
+
+// Walks a tree with an explicit stack instead of recursing through accept.
+// Every node is reported once before its children and once after them.
+//
+//     Traversal walk(program);
+//     Traversal::Event event;
+//     while (walk.next(event)) {
+//         ...
+//     }
+class Traversal {
+   public:
+    enum class Order : uint8_t {
+        PRE,
+        POST,
+    };
+
+    struct Event {
+        const AST *node;
+        Order order;
+        // 0 for the root
+        size_t depth;
+    };
+
+    explicit Traversal(const AST &root);
+
+    // False after the POST event of the root
+    bool next(Event &event);
+
+    // The node of the last PRE event gets its POST event next, without
+    // visiting its children
+    void skip_children();
+
+   private:
+    struct Frame {
+        const AST *node;
+        // Range of the children of node in children and the next one to
+        // enter
+        uint32_t begin, next, end;
+    };
+
+    void enter(const AST &node, Event &event);
+
+    const AST *root;
+    std::vector<Frame> stack;
+    // Children of the nodes on the stack, the ones of the top frame last
+    std::vector<const AST *> children;
+    // The top frame was entered and its children were not collected yet
+    bool entered = false, skip = false;
+};
+
+}  // namespace CCOMP::AST
@@ -0,0 +1,271 @@
+#include "type_context.hpp"
+
+#include <algorithm>
+#include <functional>
+
+#include "ast.hpp"
+#include "common.hpp"
+
+namespace CCOMP::AST {
+
+using Builtin = CanonicalType::Builtin;
+
+static void mix(size_t &hash, size_t value) {
+    hash ^= value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+}
+
+size_t TypeContext::Hash::operator()(const CanonicalType *type) const {
+    size_t hash = (size_t)type->kind;
+    mix(hash, (size_t)type->builtin);
+    mix(hash, type->is_const | type->is_restrict << 1 | type->varargs << 2);
+    mix(hash, std::hash<const void *>()(type->element));
+    mix(hash, type->size);
+    for (uint32_t i = 0; i < type->parameter_count; i++) {
+        mix(hash, std::hash<const void *>()(type->parameters[i]));
+    }
+    // Names are interned, the pointer identifies them
+    mix(hash, std::hash<const void *>()(type->name.data()));
+    mix(hash, std::hash<const void *>()(type->declaration));
+    return hash;
+}
+
+bool TypeContext::Equal::operator()(const CanonicalType *a,
+                                    const CanonicalType *b) const {
+    return a->kind == b->kind && a->builtin == b->builtin &&
+           a->is_const == b->is_const && a->is_restrict == b->is_restrict &&
+           a->varargs == b->varargs && a->element == b->element &&
+           a->size == b->size && a->parameter_count == b->parameter_count &&
+           std::equal(a->parameters, a->parameters + a->parameter_count,
+                      b->parameters) &&
+           a->name.data() == b->name.data() &&
+           a->name.size() == b->name.size() &&
+           a->declaration == b->declaration;
+}
+
+const CanonicalType *TypeContext::intern(const CanonicalType &key) {
+    auto found = types.find(&key);
+    if (found != types.end()) {
+        return *found;
+    }
+
+    auto *type = arena.make<CanonicalType>(key);
+    if (key.parameter_count > 0) {
+        auto **parameters = static_cast<const CanonicalType **>(
+            arena.allocate(sizeof(CanonicalType *) * key.parameter_count,
+                           alignof(CanonicalType *)));
+        std::copy(key.parameters, key.parameters + key.parameter_count,
+                  parameters);
+        type->parameters = parameters;
+    }
+    types.insert(type);
+    return type;
+}
+
+const CanonicalType *TypeContext::builtin(Builtin builtin, bool is_const) {
+    CanonicalType key{};
+    key.kind = CanonicalType::Kind::BUILTIN;
+    key.builtin = builtin;
+    key.is_const = is_const;
+    return intern(key);
+}
+
+const CanonicalType *TypeContext::pointer(const CanonicalType *pointee,
+                                          bool is_const, bool is_restrict) {
+    CanonicalType key{};
+    key.kind = CanonicalType::Kind::POINTER;
+    key.element = pointee;
+    key.is_const = is_const;
+    key.is_restrict = is_restrict;
+    return intern(key);
+}
+
+const CanonicalType *TypeContext::array(const CanonicalType *element,
+                                        uint64_t size) {
+    CanonicalType key{};
+    key.kind = CanonicalType::Kind::ARRAY;
+    key.element = element;
+    key.size = size;
+    return intern(key);
+}
+
+const CanonicalType *TypeContext::function(
+    const CanonicalType *return_type,
+    const std::vector<const CanonicalType *> &parameters, bool varargs) {
+    CanonicalType key{};
+    key.kind = CanonicalType::Kind::FUNCTION;
+    key.element = return_type;
+    key.parameters = parameters.data();
+    key.parameter_count = parameters.size();
+    key.varargs = varargs;
+    return intern(key);
+}
+
+const CanonicalType *TypeContext::named(std::string_view name,
+                                        bool is_const) {
+    CanonicalType key{};
+    key.kind = CanonicalType::Kind::NAMED;
+    key.name = names.get(names.intern(name));
+    key.is_const = is_const;
+    return intern(key);
+}
+
+const CanonicalType *TypeContext::tag(CanonicalType::Kind kind,
+                                      std::string_view name,
+                                      const AST *declaration, bool is_const) {
+    CanonicalType key{};
+    key.kind = kind;
+    key.name = names.get(names.intern(name));
+    if (name.empty()) {
+        key.declaration = declaration;
+    }
+    key.is_const = is_const;
+    return intern(key);
+}
+
+// The keywords may be written in any order and int may be left out. NONE for
+// an invalid combination.
+static Builtin builtin_of(const PrimitiveType &type) {
+    using KeyWords = PrimitiveType::KeyWords;
+    int count[(int)KeyWords::DOUBLE + 1] = {};
+    for (auto keyword : type.keywords) {
+        count[(int)keyword]++;
+    }
+    auto has = [&](KeyWords keyword) { return count[(int)keyword] > 0; };
+
+    int longs = count[(int)KeyWords::LONG];
+    bool is_signed = has(KeyWords::SIGNED);
+    bool is_unsigned = has(KeyWords::UNSIGNED);
+    int bases = has(KeyWords::VOID) + has(KeyWords::CHAR) +
+                has(KeyWords::INT) + has(KeyWords::FLOAT) +
+                has(KeyWords::DOUBLE) + has(KeyWords::VA_LIST);
+    bool sign = is_signed || is_unsigned;
+    bool only_base = !sign && longs == 0 && !has(KeyWords::SHORT);
+
+    if (bases > 1 || (is_signed && is_unsigned) || longs > 2 ||
+        (longs > 0 && has(KeyWords::SHORT))) {
+        return Builtin::NONE;
+    }
+
+    if (has(KeyWords::VOID) && only_base) {
+        return Builtin::VOID;
+    }
+    if (has(KeyWords::VA_LIST) && only_base) {
+        return Builtin::VA_LIST;
+    }
+    if (has(KeyWords::FLOAT) && only_base) {
+        return Builtin::FLOAT;
+    }
+    if (has(KeyWords::DOUBLE) && !sign && !has(KeyWords::SHORT) &&
+        longs < 2) {
+        return longs == 1 ? Builtin::LONG_DOUBLE : Builtin::DOUBLE;
+    }
+    if (has(KeyWords::CHAR) && longs == 0 && !has(KeyWords::SHORT)) {
+        if (is_signed) {
+            return Builtin::SIGNED_CHAR;
+        }
+        return is_unsigned ? Builtin::UNSIGNED_CHAR : Builtin::CHAR;
+    }
+    if (bases == 0 || has(KeyWords::INT)) {
+        if (has(KeyWords::SHORT)) {
+            return is_unsigned ? Builtin::UNSIGNED_SHORT : Builtin::SHORT;
+        }
+        if (longs == 2) {
+            return is_unsigned ? Builtin::UNSIGNED_LONG_LONG
+                               : Builtin::LONG_LONG;
+        }
+        if (longs == 1) {
+            return is_unsigned ? Builtin::UNSIGNED_LONG : Builtin::LONG;
+        }
+        if (bases == 1 || sign) {
+            return is_unsigned ? Builtin::UNSIGNED_INT : Builtin::INT;
+        }
+    }
+    return Builtin::NONE;
+}
+
+void TypeContext::report(const AST &node, const std::string &message) {
+    m_errors++;
+    if (sources != nullptr && node.location.valid()) {
+        PresumedLocation presumed = sources->presumed(node.location);
+        error("%.*s:%u:%u: %s", (int)presumed.file.size(),
+              presumed.file.data(), presumed.line, presumed.column,
+              message.c_str());
+    } else {
+        error("%s", message.c_str());
+    }
+}
+
+// Only integer constants give an array a known size
+static uint64_t array_size(const AST *size) {
+    auto *constant = dyn_cast<Constant>(size);
+    if (constant == nullptr ||
+        constant->literal_kind != Constant::LiteralKind::INTEGER) {
+        return CanonicalType::UNSIZED;
+    }
+    return constant->integer.value;
+}
+
+const CanonicalType *TypeContext::get(const Type *type) {
+    if (type == nullptr) {
+        return nullptr;
+    }
+
+    // const of a Type applies to the base, restrict to the outermost pointer
+    const CanonicalType *canonical = nullptr;
+    switch (type->kind) {
+        case Kind::PRIMITIVE_TYPE: {
+            auto *primitive = cast<PrimitiveType>(type);
+            Builtin which = builtin_of(*primitive);
+            if (which == Builtin::NONE) {
+                report(*type, "invalid type specifiers '" +
+                                  primitive->to_string() + "'");
+            }
+            canonical = builtin(which, type->is_const);
+            break;
+        }
+        case Kind::NAMED_TYPE:
+            canonical = named(cast<NamedType>(type)->name, type->is_const);
+            break;
+        case Kind::FUNCTION_TYPE: {
+            auto *fn = cast<FunctionType>(type);
+            std::vector<const CanonicalType *> parameters;
+            parameters.reserve(fn->parameters.size());
+            for (auto &parameter : fn->parameters) {
+                parameters.push_back(get(parameter->type()));
+            }
+            canonical =
+                function(get(fn->return_type.get()), parameters, fn->varargs);
+            break;
+        }
+        case Kind::STRUCT_TYPE:
+            canonical = tag(CanonicalType::Kind::STRUCT,
+                            cast<StructType>(type)->name->name, type,
+                            type->is_const);
+            break;
+        case Kind::UNION_TYPE:
+            canonical = tag(CanonicalType::Kind::UNION,
+                            cast<UnionType>(type)->name->name, type,
+                            type->is_const);
+            break;
+        case Kind::ENUM_TYPE:
+            canonical = tag(CanonicalType::Kind::ENUM,
+                            cast<EnumType>(type)->name->name, type,
+                            type->is_const);
+            break;
+        default:
+            die("Invalid type kind %d", (int)type->kind);
+    }
+
+    for (int i = 0; i < type->pointer_count; i++) {
+        bool outermost = i + 1 == type->pointer_count;
+        canonical = pointer(canonical, false, outermost && type->is_restrict);
+    }
+    // int a[2][3] is an array of 2 arrays of 3 ints
+    for (size_t i = type->array_sizes.size(); i > 0; i--) {
+        uint64_t size = array_size(type->array_sizes[i - 1].get());
+        canonical = array(canonical, size);
+    }
+    return canonical;
+}
+
+}  // namespace CCOMP::AST
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "arena.hpp"
+#include "literals.hpp"
+#include "source_manager.hpp"
+
+namespace CCOMP::AST {
+
+class AST;
+class Type;
+
+// Type after removing its spelling. Every distinct type exists once per
+// TypeContext, so two types are equal exactly if their pointers are.
+struct CanonicalType {
+    enum class Kind : uint8_t {
+        BUILTIN,
+        POINTER,
+        ARRAY,
+        FUNCTION,
+        // A typedef name, typedefs are not resolved yet
+        NAMED,
+        STRUCT,
+        UNION,
+        ENUM,
+    };
+
+    // Every valid combination of the primitive type keywords
+    enum class Builtin : uint8_t {
+        NONE,
+        VOID,
+        CHAR,
+        SIGNED_CHAR,
+        UNSIGNED_CHAR,
+        SHORT,
+        UNSIGNED_SHORT,
+        INT,
+        UNSIGNED_INT,
+        LONG,
+        UNSIGNED_LONG,
+        LONG_LONG,
+        UNSIGNED_LONG_LONG,
+        FLOAT,
+        DOUBLE,
+        LONG_DOUBLE,
+        VA_LIST,
+    };
+
+    static constexpr uint64_t UNSIZED = UINT64_MAX;
+
+    Kind kind;
+    Builtin builtin = Builtin::NONE;
+    bool is_const = false, is_restrict = false;
+    bool varargs = false;
+
+    // Pointee, array element or return type
+    const CanonicalType *element = nullptr;
+    // Number of array elements, UNSIZED if unknown
+    uint64_t size = UNSIZED;
+
+    // Parameter types of a function, allocated in the arena of the context
+    const CanonicalType *const *parameters = nullptr;
+    uint32_t parameter_count = 0;
+
+    // Typedef or tag name, owned by the context
+    std::string_view name;
+    // Anonymous tags are distinct types, told apart by their declaration
+    const AST *declaration = nullptr;
+};
+
+// Hash-consing table of CanonicalTypes. The types live as long as the
+// context and are never changed after they were created.
+class TypeContext {
+   public:
+    TypeContext() = default;
+    TypeContext(const TypeContext &) = delete;
+    TypeContext &operator=(const TypeContext &) = delete;
+
+    const CanonicalType *builtin(CanonicalType::Builtin builtin,
+                                 bool is_const = false);
+    const CanonicalType *pointer(const CanonicalType *pointee,
+                                 bool is_const = false,
+                                 bool is_restrict = false);
+    const CanonicalType *array(const CanonicalType *element,
+                               uint64_t size = CanonicalType::UNSIZED);
+    const CanonicalType *function(
+        const CanonicalType *return_type,
+        const std::vector<const CanonicalType *> &parameters, bool varargs);
+    const CanonicalType *named(std::string_view name, bool is_const = false);
+    // kind is STRUCT, UNION or ENUM. An empty name needs the declaration.
+    const CanonicalType *tag(CanonicalType::Kind kind, std::string_view name,
+                             const AST *declaration, bool is_const = false);
+
+    // The canonical type of a type written in the source. nullptr stays
+    // nullptr. Invalid primitive types are reported and become the builtin
+    // NONE.
+    const CanonicalType *get(const Type *type);
+
+    // Diagnostics give the file and line of a node through it
+    void set_sources(std::shared_ptr<const SourceManager> sources) {
+        this->sources = std::move(sources);
+    }
+    // Number of diagnostics reported by get
+    [[nodiscard]] size_t errors() const {
+        return m_errors;
+    }
+
+    // Number of distinct types
+    [[nodiscard]] size_t size() const {
+        return types.size();
+    }
+
+   private:
+    struct Hash {
+        size_t operator()(const CanonicalType *type) const;
+    };
+    struct Equal {
+        bool operator()(const CanonicalType *a, const CanonicalType *b) const;
+    };
+
+    // The existing type equal to key, or a copy of key
+    const CanonicalType *intern(const CanonicalType &key);
+    void report(const AST &node, const std::string &message);
+
+    Arena arena;
+    StringPool names;
+    std::unordered_set<const CanonicalType *, Hash, Equal> types;
+    std::shared_ptr<const SourceManager> sources;
+    size_t m_errors = 0;
+};
+
+}  // namespace CCOMP::AST
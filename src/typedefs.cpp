@@ -0,0 +1,82 @@
+#include "typedefs.hpp"
+
+#include "common.hpp"
+
+namespace CCOMP::Parser {
+
+// Builtin types the grammar has no keyword for
+static const char *builtin_types[] = {
+    "_Bool", "__int128_t", "__uint128_t", "__float128", "__bf16", "_Float16",
+};
+
+TypedefTable::TypedefTable() {
+    scopes.emplace_back();
+    for (auto name : builtin_types) {
+        declare_typedef(name);
+    }
+}
+
+void TypedefTable::push_scope() {
+    scopes.emplace_back();
+}
+
+void TypedefTable::pop_scope() {
+    if (scopes.size() == 1) {
+        die("Can not leave the file scope");
+    }
+    scopes.pop_back();
+}
+
+void TypedefTable::reset() {
+    scopes.resize(1);
+}
+
+std::string_view TypedefTable::intern(std::string_view name) {
+    return *names.emplace(name).first;
+}
+
+void TypedefTable::declare(std::string_view name, bool is_typedef) {
+    name = intern(name);
+    scopes.back()[name] = is_typedef;
+    if (scopes.size() == 1) {
+        file_scope_log.emplace_back(name, is_typedef);
+    }
+}
+
+void TypedefTable::declare_typedef(std::string_view name) {
+    trace("Typedef %.*s", (int)name.size(), name.data());
+    declare(name, true);
+}
+
+void TypedefTable::declare_ordinary(std::string_view name) {
+    if (!is_typedef(name)) {
+        return;
+    }
+    declare(name, false);
+}
+
+std::shared_ptr<TypedefTable> TypedefTable::at(size_t position) const {
+    auto table = std::make_shared<TypedefTable>();
+    // The builtins are part of the log
+    table->scopes.assign(1, {});
+    table->file_scope_log.clear();
+    for (size_t i = 0; i < position && i < file_scope_log.size(); i++) {
+        table->declare(file_scope_log[i].first, file_scope_log[i].second);
+    }
+    return table;
+}
+
+bool TypedefTable::is_typedef(std::string_view name) const {
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+        if (it->empty()) {
+            continue;
+        }
+        auto found = it->find(name);
+        if (found != it->end()) {
+            return found->second;
+        }
+    }
+    return false;
+}
+
+}  // namespace CCOMP::Parser
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace CCOMP::Parser {
+
+// Scoped set of the names declared with typedef. The lexer asks it whether an
+// identifier has to become a TYPEDEF_NAME token, the parser updates it while
+// reducing declarations.
+class TypedefTable {
+   public:
+    TypedefTable();
+
+    void push_scope();
+    void pop_scope();
+
+    // Back to file scope, used after skipping broken input
+    void reset();
+
+    void declare_typedef(std::string_view name);
+
+    // An ordinary declaration hides a typedef of an outer scope
+    void declare_ordinary(std::string_view name);
+
+    [[nodiscard]] bool is_typedef(std::string_view name) const;
+
+    [[nodiscard]] size_t depth() const {
+        return scopes.size();
+    }
+
+    // Number of changes to the file scope so far
+    [[nodiscard]] size_t position() const {
+        return file_scope_log.size();
+    }
+
+    // New table with the file scope as it was at position, for parsing a
+    // skipped function body after the rest of the file
+    [[nodiscard]] std::shared_ptr<TypedefTable> at(size_t position) const;
+
+    // Every change to the file scope in order, true for a typedef
+    [[nodiscard]] const std::vector<std::pair<std::string_view, bool>> &
+    changes() const {
+        return file_scope_log;
+    }
+
+   private:
+    std::string_view intern(std::string_view name);
+    void declare(std::string_view name, bool is_typedef);
+
+    // Owns the names, the scopes only hold views into it
+    std::unordered_set<std::string> names;
+
+    // true for a typedef, false for an ordinary identifier hiding one
+    std::vector<std::unordered_map<std::string_view, bool>> scopes;
+
+    // Replayed by at
+    std::vector<std::pair<std::string_view, bool>> file_scope_log;
+};
+
+}  // namespace CCOMP::Parser
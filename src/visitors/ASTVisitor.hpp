@@ -42,41 +42,41 @@ typedef class SwitchBlock SwitchBlock;
 
 class ASTVisitor {
    public:
-    virtual void *visit(Program &node, void *args) = 0;
-    virtual void *visit(Block &node, void *args) = 0;
-    virtual void *visit(Constant &node, void *args) = 0;
-    virtual void *visit(Identifier &node, void *args) = 0;
-    virtual void *visit(PrimitiveType &node, void *args) = 0;
-    virtual void *visit(VariableDeclaration &node, void *args) = 0;
-    virtual void *visit(FunctionDefinition &node, void *args) = 0;
-    virtual void *visit(FunctionDeclaration &node, void *args) = 0;
-    virtual void *visit(FunctionCall &node, void *args) = 0;
-    virtual void *visit(UnaryExpression &node, void *args) = 0;
-    virtual void *visit(BinaryExpression &node, void *args) = 0;
-    virtual void *visit(Return &node, void *args) = 0;
-    virtual void *visit(TypeDef &node, void *args) = 0;
-    virtual void *visit(NamedType &node, void *args) = 0;
-    virtual void *visit(ArrayInitializationList &node, void *args) = 0;
-    virtual void *visit(FunctionType &node, void *args) = 0;
-    virtual void *visit(StructType &node, void *args) = 0;
-    virtual void *visit(UnionType &node, void *args) = 0;
-    virtual void *visit(Attribute &node, void *args) = 0;
-    virtual void *visit(Assembly &node, void *args) = 0;
-    virtual void *visit(If &node, void *args) = 0;
-    virtual void *visit(ArrayAccess &node, void *args) = 0;
-    virtual void *visit(StructAccess &node, void *args) = 0;
-    virtual void *visit(Assignment &node, void *args) = 0;
-    virtual void *visit(OperationAssignment &node, void *args) = 0;
-    virtual void *visit(For &node, void *args) = 0;
-    virtual void *visit(While &node, void *args) = 0;
-    virtual void *visit(DoWhile &node, void *args) = 0;
-    virtual void *visit(TypeCast &node, void *args) = 0;
-    virtual void *visit(TernaryExpression &node, void *args) = 0;
-    virtual void *visit(ExpressionList &node, void *args) = 0;
-    virtual void *visit(EnumType &node, void *args) = 0;
-    virtual void *visit(EnumValue &node, void *args) = 0;
-    virtual void *visit(Switch &node, void *args) = 0;
-    virtual void *visit(SwitchBlock &node, void *args) = 0;
+    virtual void *visit(const Program &node, void *args) = 0;
+    virtual void *visit(const Block &node, void *args) = 0;
+    virtual void *visit(const Constant &node, void *args) = 0;
+    virtual void *visit(const Identifier &node, void *args) = 0;
+    virtual void *visit(const PrimitiveType &node, void *args) = 0;
+    virtual void *visit(const VariableDeclaration &node, void *args) = 0;
+    virtual void *visit(const FunctionDefinition &node, void *args) = 0;
+    virtual void *visit(const FunctionDeclaration &node, void *args) = 0;
+    virtual void *visit(const FunctionCall &node, void *args) = 0;
+    virtual void *visit(const UnaryExpression &node, void *args) = 0;
+    virtual void *visit(const BinaryExpression &node, void *args) = 0;
+    virtual void *visit(const Return &node, void *args) = 0;
+    virtual void *visit(const TypeDef &node, void *args) = 0;
+    virtual void *visit(const NamedType &node, void *args) = 0;
+    virtual void *visit(const ArrayInitializationList &node, void *args) = 0;
+    virtual void *visit(const FunctionType &node, void *args) = 0;
+    virtual void *visit(const StructType &node, void *args) = 0;
+    virtual void *visit(const UnionType &node, void *args) = 0;
+    virtual void *visit(const Attribute &node, void *args) = 0;
+    virtual void *visit(const Assembly &node, void *args) = 0;
+    virtual void *visit(const If &node, void *args) = 0;
+    virtual void *visit(const ArrayAccess &node, void *args) = 0;
+    virtual void *visit(const StructAccess &node, void *args) = 0;
+    virtual void *visit(const Assignment &node, void *args) = 0;
+    virtual void *visit(const OperationAssignment &node, void *args) = 0;
+    virtual void *visit(const For &node, void *args) = 0;
+    virtual void *visit(const While &node, void *args) = 0;
+    virtual void *visit(const DoWhile &node, void *args) = 0;
+    virtual void *visit(const TypeCast &node, void *args) = 0;
+    virtual void *visit(const TernaryExpression &node, void *args) = 0;
+    virtual void *visit(const ExpressionList &node, void *args) = 0;
+    virtual void *visit(const EnumType &node, void *args) = 0;
+    virtual void *visit(const EnumValue &node, void *args) = 0;
+    virtual void *visit(const Switch &node, void *args) = 0;
+    virtual void *visit(const SwitchBlock &node, void *args) = 0;
 };
 
 }  // namespace CCOMP::AST
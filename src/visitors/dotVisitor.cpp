@@ -3,13 +3,12 @@
 #include <fstream>
 #include <stack>
 
+#include "traversal.hpp"
+
 namespace CCOMP::AST {
 
 static std::ofstream file;
 
-static std::stack<int> node_stack;
-static int node_counter = 0;
-
 static void declare_node(int id, const std::string &name) {
     file << "  node_" << id << " [label=\"" << name << "\"];\n";
     file.flush();
@@ -20,7 +19,9 @@ static void connect_nodes(int a, int b) {
     file.flush();
 }
 
-void DotVisitor::generate(Program &node, const std::string &output_file) {
+// Walks the tree with a Traversal, a node gets its id and label on its PRE
+// event and is connected to the node below it on the stack
+void DotVisitor::generate(const Program &node, const std::string &output_file) {
     std::ofstream l_file(output_file);
     file = std::move(l_file);
 
@@ -28,176 +29,177 @@ void DotVisitor::generate(Program &node, const std::string &output_file) {
     file << "  graph [ordering=\"out\"];\n";
 
     DotVisitor visitor;
-
-    node.accept(visitor, nullptr);
+    std::stack<int> node_stack;
+    int node_counter = 0;
+
+    Traversal walk(node);
+    Traversal::Event event;
+    while (walk.next(event)) {
+        if (event.order == Traversal::Order::POST) {
+            node_stack.pop();
+            continue;
+        }
+        int id = node_counter++;
+        declare_node(id, visitor.dispatch(*event.node));
+        if (!node_stack.empty()) {
+            connect_nodes(node_stack.top(), id);
+        }
+        node_stack.push(id);
+    }
 
     file << "}";
     file.close();
 }
 
-void *DotVisitor::visit(Program &node, void *args) {
-    int id = node_counter++;
-    declare_node(id, node.file_location);
-
-    node_stack.push(id);
-    return ASTBaseVisitor::visit(node, args);
+std::string DotVisitor::visit(const Program &node) {
+    return node.file_location;
 }
 
-#define GENERATE(name)                 \
-    int id = node_counter++;           \
-    declare_node(id, name);            \
-    int parent = node_stack.top();     \
-    connect_nodes(parent, id);         \
-    node_stack.push(id);               \
-    ASTBaseVisitor::visit(node, args); \
-    node_stack.pop();                  \
-    return nullptr;
-
-#define GENERATE_TYPE(name)                                \
-    std::string arr = "";                                  \
-    for (int i = 0; i < node.array_dimensions; i++) {      \
-        arr += "[]";                                       \
-    }                                                      \
-    int id = node_counter++;                               \
-    std::string r = (node.is_restrict ? "restrict " : ""); \
-    std::string c = (node.is_const ? "const " : "");       \
-    std::string p = "";                                    \
-    for (int i = 0; i < node.pointer_count; i++) {         \
-        p += "*";                                          \
-    }                                                      \
-    declare_node(id, c + r + std::string(name) + p + arr); \
-    int parent = node_stack.top();                         \
-    connect_nodes(parent, id);                             \
-    node_stack.push(id);                                   \
-    ASTBaseVisitor::visit(node, args);                     \
-    node_stack.pop();                                      \
-    return nullptr;
+// Qualifiers, pointers and array dimensions around the name of a type
+static std::string type_label(const Type &node, const std::string &name) {
+    std::string arr = "";
+    for (int i = 0; i < node.array_dimensions; i++) {
+        arr += "[]";
+    }
+    std::string r = (node.is_restrict ? "restrict " : "");
+    std::string c = (node.is_const ? "const " : "");
+    std::string p = "";
+    for (int i = 0; i < node.pointer_count; i++) {
+        p += "*";
+    }
+    return c + r + name + p + arr;
+}
 
-void *DotVisitor::visit(FunctionDeclaration &node, void *args) {
-    GENERATE("Function Decl");
+std::string DotVisitor::visit(const FunctionDeclaration &) {
+    return "Function Decl";
 }
 
-void *DotVisitor::visit(FunctionDefinition &node, void *args) {
-    GENERATE("Function Def");
+std::string DotVisitor::visit(const FunctionDefinition &) {
+    return "Function Def";
 }
 
-void *DotVisitor::visit(Block &node, void *args) {
-    GENERATE("Block");
+std::string DotVisitor::visit(const Block &) {
+    return "Block";
 }
 
-void *DotVisitor::visit(Constant &node, void *args) {
-    GENERATE(node.value);
+std::string DotVisitor::visit(const Constant &node) {
+    return node.to_string();
 }
 
-void *DotVisitor::visit(Identifier &node, void *args) {
+std::string DotVisitor::visit(const Identifier &node) {
     if (node.name == "") {
-        GENERATE("Anonymous");
+        return "Anonymous";
     }
-    GENERATE(node.name);
+    return node.name;
 }
 
-void *DotVisitor::visit(PrimitiveType &node, void *args) {
-    GENERATE_TYPE(node.to_string());
+std::string DotVisitor::visit(const PrimitiveType &node) {
+    return type_label(node, node.to_string());
 }
 
-void *DotVisitor::visit(NamedType &node, void *args) {
-    GENERATE_TYPE(node.name);
+std::string DotVisitor::visit(const NamedType &node) {
+    return type_label(node, node.name);
 }
 
-void *DotVisitor::visit(VariableDeclaration &node, void *args) {
-    GENERATE("Variable");
+std::string DotVisitor::visit(const VariableDeclaration &) {
+    return "Variable";
 }
 
-void *DotVisitor::visit(FunctionCall &node, void *args) {
-    GENERATE("FunctionCall");
+std::string DotVisitor::visit(const FunctionCall &) {
+    return "FunctionCall";
 }
 
-void *DotVisitor::visit(UnaryExpression &node, void *args) {
-    GENERATE(node.op_to_str());
+std::string DotVisitor::visit(const UnaryExpression &node) {
+    return node.op_to_str();
 }
 
-void *DotVisitor::visit(BinaryExpression &node, void *args) {
-    GENERATE(node.op_to_str());
+std::string DotVisitor::visit(const BinaryExpression &node) {
+    return node.op_to_str();
 }
 
-void *DotVisitor::visit(Return &node, void *args) {
-    GENERATE("Return");
+std::string DotVisitor::visit(const Return &) {
+    return "Return";
 }
 
-void *DotVisitor::visit(TypeDef &node, void *args) {
-    GENERATE("TypeDef");
+std::string DotVisitor::visit(const TypeDef &) {
+    return "TypeDef";
 }
 
-void *DotVisitor::visit(ArrayInitializationList &node, void *args) {
-    GENERATE("Array Init");
+// Packed elements have no nodes, the label counts them
+std::string DotVisitor::visit(const ArrayInitializationList &node) {
+    if (node.packed()) {
+        return "Array Init: " + std::to_string(node.size()) + " packed";
+    }
+    return "Array Init";
 };
 
-void *DotVisitor::visit(FunctionType &node, void *args) {
-    GENERATE_TYPE(std::string("FunctionType") + (node.varargs ? "..." : ""));
+std::string DotVisitor::visit(const FunctionType &node) {
+    return type_label(node, std::string("FunctionType") +
+                                (node.varargs ? "..." : ""));
 };
 
-void *DotVisitor::visit(StructType &node, void *args) {
-    GENERATE_TYPE("StructType");
+std::string DotVisitor::visit(const StructType &node) {
+    return type_label(node, "StructType");
 };
 
-void *DotVisitor::visit(UnionType &node, void *args) {
-    GENERATE_TYPE("UnionType");
+std::string DotVisitor::visit(const UnionType &node) {
+    return type_label(node, "UnionType");
 };
-void *DotVisitor::visit(Attribute &node, void *args) {
-    GENERATE("Attribute: " + node.name);
+std::string DotVisitor::visit(const Attribute &node) {
+    return "Attribute: " + node.name;
 };
-void *DotVisitor::visit(Assembly &node, void *args) {
+std::string DotVisitor::visit(const Assembly &node) {
     std::stringstream s;
     for (auto &i : node.assembly) {
         s << "\\\"" << i << "\\\""
           << "\n";
     }
-    GENERATE("Asm: " + s.str());
+    return "Asm: " + s.str();
 };
-void *DotVisitor::visit(If &node, void *args) {
-    GENERATE("If");
+std::string DotVisitor::visit(const If &) {
+    return "If";
 };
-void *DotVisitor::visit(ArrayAccess &node, void *args) {
-    GENERATE("ArrayAccess");
+std::string DotVisitor::visit(const ArrayAccess &) {
+    return "ArrayAccess";
 };
-void *DotVisitor::visit(StructAccess &node, void *args) {
-    GENERATE(std::string("StructAccess") + (node.through_pointer ? " (ptr)" : ""));
+std::string DotVisitor::visit(const StructAccess &node) {
+    return std::string("StructAccess") + (node.through_pointer ? " (ptr)" : "");
 };
-void *DotVisitor::visit(Assignment &node, void *args) {
-    GENERATE("=");
+std::string DotVisitor::visit(const Assignment &) {
+    return "=";
 };
-void *DotVisitor::visit(For &node, void *args) {
-    GENERATE("For");
+std::string DotVisitor::visit(const For &) {
+    return "For";
 };
-void *DotVisitor::visit(TypeCast &node, void *args) {
-    GENERATE("TypeCast");
+std::string DotVisitor::visit(const TypeCast &) {
+    return "TypeCast";
 };
-void *DotVisitor::visit(TernaryExpression &node, void *args) {
-    GENERATE("Ternary");
+std::string DotVisitor::visit(const TernaryExpression &) {
+    return "Ternary";
 };
-void *DotVisitor::visit(OperationAssignment &node, void *args) {
-    GENERATE(node.op_to_str());
+std::string DotVisitor::visit(const OperationAssignment &node) {
+    return node.op_to_str();
 };
-void *DotVisitor::visit(ExpressionList &node, void *args) {
-    GENERATE(",");
+std::string DotVisitor::visit(const ExpressionList &) {
+    return ",";
 };
-void *DotVisitor::visit(EnumType &node, void *args) {
-    GENERATE_TYPE("enum");
+std::string DotVisitor::visit(const EnumType &node) {
+    return type_label(node, "enum");
 };
-void *DotVisitor::visit(EnumValue &node, void *args) {
-    GENERATE("EnumValue");
+std::string DotVisitor::visit(const EnumValue &) {
+    return "EnumValue";
 };
-void *DotVisitor::visit(While &node, void *args) {
-    GENERATE("While");
+std::string DotVisitor::visit(const While &) {
+    return "While";
 };
-void *DotVisitor::visit(DoWhile &node, void *args) {
-    GENERATE("DoWhile");
+std::string DotVisitor::visit(const DoWhile &) {
+    return "DoWhile";
 };
-void *DotVisitor::visit(Switch &node, void *args) {
-    GENERATE("Switch");
+std::string DotVisitor::visit(const Switch &) {
+    return "Switch";
 };
-void *DotVisitor::visit(SwitchBlock &node, void *args) {
-    GENERATE(std::string(node.is_default ? "default" : "case") + std::string(node.break_after ? " (break)" : ""));
+std::string DotVisitor::visit(const SwitchBlock &node) {
+    return std::string(node.is_default ? "default" : "case") + std::string(node.break_after ? " (break)" : "");
 };
 
 }  // namespace CCOMP::AST
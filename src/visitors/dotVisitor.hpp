@@ -1,47 +1,50 @@
 #pragma once
 
-#include "visitors/ASTBaseVisitor.hpp"
+#include <string>
+
+#include "visitors/staticVisitor.hpp"
 
 namespace CCOMP::AST {
 
-class DotVisitor : public ASTBaseVisitor {
+// The label of a node, generate writes the labels of a whole tree
+class DotVisitor : public StaticVisitor<DotVisitor, std::string> {
    public:
-    static void generate(Program &node, const std::string &output_file);
+    static void generate(const Program &node, const std::string &output_file);
 
-    void *visit(Program &node, void *args) override;
-    void *visit(Block &node, void *args) override;
-    void *visit(Constant &node, void *args) override;
-    void *visit(Identifier &node, void *args) override;
-    void *visit(PrimitiveType &node, void *args) override;
-    void *visit(VariableDeclaration &node, void *args) override;
-    void *visit(FunctionDefinition &node, void *args) override;
-    void *visit(FunctionDeclaration &node, void *args) override;
-    void *visit(FunctionCall &node, void *args) override;
-    void *visit(UnaryExpression &node, void *args) override;
-    void *visit(BinaryExpression &node, void *args) override;
-    void *visit(Return &node, void *args) override;
-    void *visit(TypeDef &node, void *args) override;
-    void *visit(NamedType &node, void *args) override;
-    void *visit(ArrayInitializationList &node, void *args) override;
-    void *visit(FunctionType &node, void *args) override;
-    void *visit(StructType &node, void *args) override;
-    void *visit(UnionType &node, void *args) override;
-    void *visit(Attribute &node, void *args) override;
-    void *visit(Assembly &node, void *args) override;
-    void *visit(If &node, void *args) override;
-    void *visit(ArrayAccess &node, void *args) override;
-    void *visit(StructAccess &node, void *args) override;
-    void *visit(Assignment &node, void *args) override;
-    void *visit(For &node, void *args) override;
-    void *visit(TypeCast &node, void *args) override;
-    void *visit(TernaryExpression &node, void *args) override;
-    void *visit(OperationAssignment &node, void *args) override;
-    void *visit(ExpressionList &node, void *args) override;
-    void *visit(EnumType &node, void *args) override;
-    void *visit(EnumValue &node, void *args) override;
-    void *visit(While &node, void *args) override;
-    void *visit(DoWhile &node, void *args) override;
-    void *visit(Switch &node, void *args) override;
-    void *visit(SwitchBlock &node, void *args) override;
+    std::string visit(const Program &node);
+    std::string visit(const Block &node);
+    std::string visit(const Constant &node);
+    std::string visit(const Identifier &node);
+    std::string visit(const PrimitiveType &node);
+    std::string visit(const VariableDeclaration &node);
+    std::string visit(const FunctionDefinition &node);
+    std::string visit(const FunctionDeclaration &node);
+    std::string visit(const FunctionCall &node);
+    std::string visit(const UnaryExpression &node);
+    std::string visit(const BinaryExpression &node);
+    std::string visit(const Return &node);
+    std::string visit(const TypeDef &node);
+    std::string visit(const NamedType &node);
+    std::string visit(const ArrayInitializationList &node);
+    std::string visit(const FunctionType &node);
+    std::string visit(const StructType &node);
+    std::string visit(const UnionType &node);
+    std::string visit(const Attribute &node);
+    std::string visit(const Assembly &node);
+    std::string visit(const If &node);
+    std::string visit(const ArrayAccess &node);
+    std::string visit(const StructAccess &node);
+    std::string visit(const Assignment &node);
+    std::string visit(const For &node);
+    std::string visit(const TypeCast &node);
+    std::string visit(const TernaryExpression &node);
+    std::string visit(const OperationAssignment &node);
+    std::string visit(const ExpressionList &node);
+    std::string visit(const EnumType &node);
+    std::string visit(const EnumValue &node);
+    std::string visit(const While &node);
+    std::string visit(const DoWhile &node);
+    std::string visit(const Switch &node);
+    std::string visit(const SwitchBlock &node);
 };
 }  // namespace CCOMP::AST
@@ -0,0 +1,258 @@
+#include "visitors/locationShiftVisitor.hpp"
+
+namespace CCOMP::AST {
+
+namespace {
+
+// Calls f with the pointers to the children of a node, in the order of
+// for_each_child. Function bodies are left to the caller, so lazy ones stay
+// unparsed, and packed initializers have no child nodes.
+template <typename F>
+void for_each_child_ptr(Program &node, F &&f) {
+    for (auto &decl : node.declarations) {
+        f(decl);
+    }
+}
+template <typename F>
+void for_each_child_ptr(Block &node, F &&f) {
+    for (auto &stmt : node.statements) {
+        f(stmt);
+    }
+}
+template <typename F>
+void for_each_child_ptr(Constant &, F &&) {
+}
+template <typename F>
+void for_each_child_ptr(Identifier &node, F &&f) {
+    f(node.type_ptr());
+}
+template <typename F>
+void for_each_array_size_ptr(Type &node, F &&f) {
+    for (auto &arr : node.array_sizes) {
+        f(arr);
+    }
+}
+template <typename F>
+void for_each_child_ptr(PrimitiveType &node, F &&f) {
+    for_each_array_size_ptr(node, f);
+}
+template <typename F>
+void for_each_child_ptr(NamedType &node, F &&f) {
+    for_each_array_size_ptr(node, f);
+}
+template <typename F>
+void for_each_declaration_child_ptr(Declaration &node, F &&f) {
+    for (auto &ass : node.assembly) {
+        f(ass);
+    }
+    for (auto &attr : node.attributes) {
+        f(attr);
+    }
+    f(node.m_type);
+    f(node.name);
+}
+template <typename F>
+void for_each_child_ptr(TypeDef &node, F &&f) {
+    f(node.name);
+}
+template <typename F>
+void for_each_child_ptr(VariableDeclaration &node, F &&f) {
+    for_each_declaration_child_ptr(node, f);
+    f(node.value);
+}
+template <typename F>
+void for_each_child_ptr(FunctionDefinition &node, F &&f) {
+    for_each_declaration_child_ptr(node, f);
+}
+template <typename F>
+void for_each_child_ptr(FunctionDeclaration &node, F &&f) {
+    for_each_declaration_child_ptr(node, f);
+}
+template <typename F>
+void for_each_child_ptr(FunctionCall &node, F &&f) {
+    f(node.name);
+    for (auto &arg : node.arguments) {
+        f(arg);
+    }
+}
+template <typename F>
+void for_each_child_ptr(UnaryExpression &node, F &&f) {
+    f(node.value);
+}
+template <typename F>
+void for_each_child_ptr(BinaryExpression &node, F &&f) {
+    f(node.left);
+    f(node.right);
+}
+template <typename F>
+void for_each_child_ptr(Return &node, F &&f) {
+    f(node.value);
+}
+template <typename F>
+void for_each_child_ptr(ArrayInitializationList &node, F &&f) {
+    if (node.packed()) {
+        return;
+    }
+    for (auto &val : node.mutable_values()) {
+        f(val);
+    }
+}
+template <typename F>
+void for_each_child_ptr(FunctionType &node, F &&f) {
+    f(node.return_type);
+    for (auto &param : node.parameters) {
+        f(param);
+    }
+    for_each_array_size_ptr(node, f);
+}
+// Struct, union and enum types
+template <typename F, typename Tag, typename Members>
+void for_each_tag_child_ptr(Tag &node, Members &members, F &&f) {
+    for (auto &ass : node.assembly) {
+        f(ass);
+    }
+    for (auto &attr : node.attributes) {
+        f(attr);
+    }
+    f(node.name);
+    for (auto &member : members) {
+        f(member);
+    }
+    for_each_array_size_ptr(node, f);
+}
+template <typename F>
+void for_each_child_ptr(StructType &node, F &&f) {
+    for_each_tag_child_ptr(node, node.members, f);
+}
+template <typename F>
+void for_each_child_ptr(UnionType &node, F &&f) {
+    for_each_tag_child_ptr(node, node.members, f);
+}
+template <typename F>
+void for_each_child_ptr(EnumType &node, F &&f) {
+    for_each_tag_child_ptr(node, node.values, f);
+}
+template <typename F>
+void for_each_child_ptr(EnumValue &node, F &&f) {
+    f(node.name);
+    f(node.value);
+}
+template <typename F>
+void for_each_child_ptr(Attribute &, F &&) {
+}
+template <typename F>
+void for_each_child_ptr(Assembly &, F &&) {
+}
+template <typename F>
+void for_each_child_ptr(If &node, F &&f) {
+    f(node.condition);
+    f(node.then_block);
+    f(node.else_block);
+}
+template <typename F>
+void for_each_child_ptr(ArrayAccess &node, F &&f) {
+    f(node.array);
+    for (auto &idx : node.indices) {
+        f(idx);
+    }
+}
+template <typename F>
+void for_each_child_ptr(StructAccess &node, F &&f) {
+    f(node.struc);
+    f(node.member);
+}
+template <typename F>
+void for_each_child_ptr(Assignment &node, F &&f) {
+    f(node.left);
+    f(node.right);
+}
+template <typename F>
+void for_each_child_ptr(For &node, F &&f) {
+    f(node.init);
+    f(node.condition);
+    f(node.increment);
+    f(node.body);
+}
+template <typename F>
+void for_each_child_ptr(TypeCast &node, F &&f) {
+    f(node.type);
+    f(node.value);
+}
+template <typename F>
+void for_each_child_ptr(TernaryExpression &node, F &&f) {
+    f(node.condition);
+    f(node.then_expr);
+    f(node.else_expr);
+}
+template <typename F>
+void for_each_child_ptr(OperationAssignment &node, F &&f) {
+    f(node.left);
+    f(node.right);
+}
+template <typename F>
+void for_each_child_ptr(ExpressionList &node, F &&f) {
+    for (auto &expr : node.expressions) {
+        f(expr);
+    }
+}
+template <typename F>
+void for_each_child_ptr(While &node, F &&f) {
+    f(node.condition);
+    f(node.body);
+}
+template <typename F>
+void for_each_child_ptr(DoWhile &node, F &&f) {
+    f(node.body);
+    f(node.condition);
+}
+template <typename F>
+void for_each_child_ptr(Switch &node, F &&f) {
+    f(node.condition);
+    for (auto &block : node.switch_blocks) {
+        f(block);
+    }
+}
+template <typename F>
+void for_each_child_ptr(SwitchBlock &node, F &&f) {
+    f(node.label);
+    for (auto &s : node.statements) {
+        f(s);
+    }
+}
+
+}  // namespace
+
+void LocationShiftVisitor::walk(AST *root) {
+    // A child is copied by mut before its parent is left, so every node on
+    // the stack belongs to this tree only
+    auto enter = [&](auto &child) {
+        if (child) {
+            pending.push_back(child.mut());
+        }
+    };
+
+    pending.push_back(root);
+    while (!pending.empty()) {
+        AST *node = pending.back();
+        pending.pop_back();
+        node->location = node->location.moved(delta);
+
+        if (auto *definition = dyn_cast<FunctionDefinition>(node)) {
+            if (const LazyBody *lazy = definition->lazy()) {
+                definition->set_lazy_body(lazy->moved(delta));
+            } else {
+                enter(definition->body_ptr());
+            }
+        }
+        switch (node->kind) {
+#define CHILDREN(type, kind)                                       \
+    case Kind::kind:                                               \
+        for_each_child_ptr(static_cast<type &>(*node), enter);     \
+        break;
+            AST_KINDS(CHILDREN)
+#undef CHILDREN
+        }
+    }
+}
+
+}  // namespace CCOMP::AST
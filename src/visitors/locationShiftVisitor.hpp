@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ast.hpp"
+
+namespace CCOMP::AST {
+
+// Moves the nodes behind an edit by the number of bytes it inserted or
+// removed. The nodes are changed through CowPtr::mut, so shared ones are
+// copied first and the trees sharing them keep their locations. Unparsed
+// function bodies are moved without parsing them.
+//
+//     LocationShiftVisitor(delta).shift(program.declarations[i]);
+class LocationShiftVisitor {
+   public:
+    explicit LocationShiftVisitor(int64_t delta) : delta(delta) {
+    }
+
+    template <typename T>
+    void shift(CowPtr<T> &root) {
+        if (root) {
+            walk(root.mut());
+        }
+    }
+
+   private:
+    // Moves node, which no other tree refers to, and everything below it
+    void walk(AST *node);
+
+    int64_t delta;
+    // Nodes left to move, with an explicit stack deep trees need no stack
+    // frame per level
+    std::vector<AST *> pending;
+};
+}  // namespace CCOMP::AST
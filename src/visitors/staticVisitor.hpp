@@ -0,0 +1,321 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include "ast.hpp"
+#include "common.hpp"
+
+namespace CCOMP::AST {
+
+// Calls f with every child of a node, in the order all visitors walk them.
+// Lazy function bodies are parsed. The elements of a packed initializer have
+// no nodes and are left out, see ArrayInitializationList::packed.
+template <typename F>
+void for_each_child(const Program &node, F &&f) {
+    for (auto &decl : node.declarations) {
+        f(*decl);
+    }
+}
+template <typename F>
+void for_each_child(const Block &node, F &&f) {
+    for (auto &stmt : node.statements) {
+        f(*stmt);
+    }
+}
+template <typename F>
+void for_each_child(const Constant &, F &&) {
+}
+template <typename F>
+void for_each_child(const Identifier &node, F &&f) {
+    if (node.type()) {
+        f(*node.type());
+    }
+}
+template <typename F>
+void for_each_array_size(const Type &node, F &&f) {
+    for (auto &arr : node.array_sizes) {
+        if (arr) {
+            f(*arr);
+        }
+    }
+}
+template <typename F>
+void for_each_child(const PrimitiveType &node, F &&f) {
+    for_each_array_size(node, f);
+}
+template <typename F>
+void for_each_declaration_child(const Declaration &node, F &&f) {
+    for (auto &ass : node.assembly) {
+        f(*ass);
+    }
+    for (auto &attr : node.attributes) {
+        f(*attr);
+    }
+    if (node.owns_type()) {
+        f(*node.type());
+    }
+    f(*node.name);
+}
+template <typename F>
+void for_each_child(const VariableDeclaration &node, F &&f) {
+    for_each_declaration_child(node, f);
+    if (node.value) {
+        f(*node.value);
+    }
+}
+template <typename F>
+void for_each_child(const FunctionDefinition &node, F &&f) {
+    for_each_declaration_child(node, f);
+    f(*node.body());
+}
+template <typename F>
+void for_each_child(const FunctionDeclaration &node, F &&f) {
+    for_each_declaration_child(node, f);
+}
+template <typename F>
+void for_each_child(const FunctionCall &node, F &&f) {
+    f(*node.name);
+    for (auto &arg : node.arguments) {
+        f(*arg);
+    }
+}
+template <typename F>
+void for_each_child(const UnaryExpression &node, F &&f) {
+    f(*node.value);
+}
+template <typename F>
+void for_each_child(const BinaryExpression &node, F &&f) {
+    f(*node.left);
+    f(*node.right);
+}
+template <typename F>
+void for_each_child(const Return &node, F &&f) {
+    if (node.value) {
+        f(*node.value);
+    }
+}
+template <typename F>
+void for_each_child(const TypeDef &node, F &&f) {
+    f(*node.name);
+}
+template <typename F>
+void for_each_child(const NamedType &node, F &&f) {
+    for_each_array_size(node, f);
+}
+template <typename F>
+void for_each_child(const ArrayInitializationList &node, F &&f) {
+    for (auto &val : node.values()) {
+        f(*val);
+    }
+}
+template <typename F>
+void for_each_child(const FunctionType &node, F &&f) {
+    f(*node.return_type);
+    for (auto &param : node.parameters) {
+        f(*param);
+    }
+    for_each_array_size(node, f);
+}
+// Struct, union and enum types
+template <typename F, typename Tag, typename Members>
+void for_each_tag_child(const Tag &node, const Members &members, F &&f) {
+    for (auto &ass : node.assembly) {
+        f(*ass);
+    }
+    for (auto &attr : node.attributes) {
+        f(*attr);
+    }
+    f(*node.name);
+    for (auto &member : members) {
+        f(*member);
+    }
+    for_each_array_size(node, f);
+}
+template <typename F>
+void for_each_child(const StructType &node, F &&f) {
+    for_each_tag_child(node, node.members, f);
+}
+template <typename F>
+void for_each_child(const UnionType &node, F &&f) {
+    for_each_tag_child(node, node.members, f);
+}
+template <typename F>
+void for_each_child(const EnumType &node, F &&f) {
+    for_each_tag_child(node, node.values, f);
+}
+template <typename F>
+void for_each_child(const EnumValue &node, F &&f) {
+    f(*node.name);
+    if (node.value) {
+        f(*node.value);
+    }
+}
+template <typename F>
+void for_each_child(const Attribute &, F &&) {
+}
+template <typename F>
+void for_each_child(const Assembly &, F &&) {
+}
+template <typename F>
+void for_each_child(const If &node, F &&f) {
+    f(*node.condition);
+    f(*node.then_block);
+    if (node.else_block) {
+        f(*node.else_block);
+    }
+}
+template <typename F>
+void for_each_child(const ArrayAccess &node, F &&f) {
+    f(*node.array);
+    for (auto &idx : node.indices) {
+        f(*idx);
+    }
+}
+template <typename F>
+void for_each_child(const StructAccess &node, F &&f) {
+    f(*node.struc);
+    f(*node.member);
+}
+template <typename F>
+void for_each_child(const Assignment &node, F &&f) {
+    f(*node.left);
+    f(*node.right);
+}
+template <typename F>
+void for_each_child(const For &node, F &&f) {
+    if (node.init) {
+        f(*node.init);
+    }
+    if (node.condition) {
+        f(*node.condition);
+    }
+    if (node.increment) {
+        f(*node.increment);
+    }
+    f(*node.body);
+}
+template <typename F>
+void for_each_child(const TypeCast &node, F &&f) {
+    f(*node.type);
+    f(*node.value);
+}
+template <typename F>
+void for_each_child(const TernaryExpression &node, F &&f) {
+    f(*node.condition);
+    f(*node.then_expr);
+    f(*node.else_expr);
+}
+template <typename F>
+void for_each_child(const OperationAssignment &node, F &&f) {
+    f(*node.left);
+    f(*node.right);
+}
+template <typename F>
+void for_each_child(const ExpressionList &node, F &&f) {
+    for (auto &expr : node.expressions) {
+        f(*expr);
+    }
+}
+template <typename F>
+void for_each_child(const While &node, F &&f) {
+    f(*node.condition);
+    f(*node.body);
+}
+template <typename F>
+void for_each_child(const DoWhile &node, F &&f) {
+    f(*node.body);
+    f(*node.condition);
+}
+template <typename F>
+void for_each_child(const Switch &node, F &&f) {
+    f(*node.condition);
+    for (auto &block : node.switch_blocks) {
+        f(*block);
+    }
+}
+template <typename F>
+void for_each_child(const SwitchBlock &node, F &&f) {
+    if (!node.is_default) {
+        f(*node.label);
+    }
+    for (auto &s : node.statements) {
+        f(*s);
+    }
+}
+
+// Visitor without virtual calls. dispatch switches on the Kind of a node and
+// calls Derived::visit for its class directly, so the calls can be inlined
+// and results and arguments keep their types:
+//
+//     class Counter : public StaticVisitor<Counter, size_t, int> {
+//        public:
+//         size_t visit(const Constant &node, int depth) { ... }
+//     };
+//
+// Classes without a visit in Derived get visit_children, which dispatches
+// every child and returns a default constructed Result. Children whose class
+// is known from their member, like the name of a declaration, are visited
+// without the switch.
+template <typename Derived, typename Result = void, typename... Args>
+class StaticVisitor {
+   public:
+    Result dispatch(const AST &node, Args... args) {
+        switch (node.kind) {
+#define DISPATCH(type, kind) \
+    case Kind::kind:         \
+        return call(static_cast<const type &>(node), args...);
+            AST_KINDS(DISPATCH)
+#undef DISPATCH
+        }
+        die("Invalid AST node kind %d", (int)node.kind);
+        return Result();
+    }
+
+    // Node classes have a KIND, base classes like Type need the switch
+    template <typename T>
+    Result dispatch(const T &node, Args... args) {
+        if constexpr (IsNodeClass<T>::value) {
+            return call(node, args...);
+        } else {
+            return dispatch(static_cast<const AST &>(node), args...);
+        }
+    }
+
+    template <typename T>
+    Result visit_children(const T &node, Args... args) {
+        for_each_child(node, [&](auto &child) {
+            derived().dispatch(child, args...);
+        });
+        return Result();
+    }
+
+   private:
+    Derived &derived() {
+        return static_cast<Derived &>(*this);
+    }
+
+    template <typename T, typename = void>
+    struct IsNodeClass : std::false_type {};
+    template <typename T>
+    struct IsNodeClass<T, std::void_t<decltype(T::KIND)>> : std::true_type {};
+
+    template <typename T, typename = void>
+    struct HasVisit : std::false_type {};
+    template <typename T>
+    struct HasVisit<T, std::void_t<decltype(std::declval<Derived &>().visit(
+                           std::declval<const T &>(),
+                           std::declval<Args>()...))>>
+        : std::true_type {};
+
+    template <typename T>
+    Result call(const T &node, Args... args) {
+        if constexpr (HasVisit<T>::value) {
+            return derived().visit(node, args...);
+        } else {
+            return derived().visit_children(node, args...);
+        }
+    }
+};
+
+}  // namespace CCOMP::AST
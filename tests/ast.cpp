@@ -0,0 +1,332 @@
+#include "ast.hpp"
+
+#include <atomic>
+
+#include "byte_stream.hpp"
+#include "check.hpp"
+#include "flat_ast.hpp"
+#include "type_context.hpp"
+#include "visitors/locationShiftVisitor.hpp"
+
+using namespace CCOMP::AST;
+using CCOMP::ByteReader;
+using CCOMP::ByteWriter;
+
+// Counts its parses, moved copies share the counter
+class CountingBody : public LazyBody {
+   public:
+    CountingBody(SourceLocation location, std::atomic<int> &parses)
+        : LazyBody(location), parses(parses) {
+    }
+
+    [[nodiscard]] std::unique_ptr<LazyBody> moved(
+        int64_t delta) const override {
+        return std::make_unique<CountingBody>(location.moved(delta), parses);
+    }
+
+   protected:
+    CowPtr<Block> parse() override {
+        parses++;
+        return std::make_unique<Block>(location);
+    }
+
+   private:
+    std::atomic<int> &parses;
+};
+
+static std::unique_ptr<Identifier> identifier(uint32_t offset,
+                                              const char *name) {
+    return std::make_unique<Identifier>(SourceLocation(offset), name);
+}
+
+// Shifting a declaration copies the nodes another tree shares
+static void test_shift_shared() {
+    auto name = identifier(10, "x");
+    name->add_type(std::make_unique<NamedType>(identifier(8, "int")));
+    CowPtr<AST> declaration(std::make_unique<VariableDeclaration>(
+        SourceLocation(8), std::move(name), identifier(14, "y")));
+    CowPtr<AST> before = declaration;
+
+    LocationShiftVisitor(5).shift(declaration);
+
+    auto *moved = cast<VariableDeclaration>(declaration.get());
+    auto *old = cast<VariableDeclaration>(before.get());
+    CHECK(moved != old);
+    CHECK(moved->location.get_offset() == 13);
+    CHECK(moved->name->location.get_offset() == 15);
+    CHECK(moved->value->location.get_offset() == 19);
+    CHECK(moved->type()->location.get_offset() == 13);
+    CHECK(old->location.get_offset() == 8);
+    CHECK(old->name->location.get_offset() == 10);
+    CHECK(old->value->location.get_offset() == 14);
+    CHECK(old->type()->location.get_offset() == 8);
+}
+
+// Copies of a definition parse their lazy body once, shifting an unparsed
+// one does not parse it
+static void test_lazy_body() {
+    std::atomic<int> parses = 0;
+    CowPtr<FunctionDefinition> definition(std::make_unique<FunctionDefinition>(
+        SourceLocation(0), identifier(4, "f"),
+        std::make_unique<CountingBody>(SourceLocation(8), parses)));
+    CowPtr<AST> copy(definition->clone());
+
+    CowPtr<FunctionDefinition> shifted = definition;
+    LocationShiftVisitor(3).shift(shifted);
+    CHECK(parses == 0);
+    CHECK(shifted->lazy()->get_location().get_offset() == 11);
+
+    CHECK(definition->body() == cast<FunctionDefinition>(copy.get())->body());
+    CHECK(parses == 1);
+    CHECK(definition->body()->location.get_offset() == 8);
+    CHECK(shifted->body()->location.get_offset() == 11);
+    CHECK(parses == 2);
+}
+
+// A type shared by a copy of an identifier outlives the original
+static void test_shared_type() {
+    auto owner = identifier(0, "x");
+    owner->add_type(std::make_unique<NamedType>(identifier(0, "int")));
+    auto user = identifier(4, "x");
+    user->share_type(owner->type_ptr());
+    owner.reset();
+    CHECK(user->type() != nullptr && isa<NamedType>(user->type()));
+    CHECK(!user->owns_type());
+}
+
+// The flat AST gives an identifier sharing a type a copy of its own
+static void test_flat_shared_type() {
+    CowPtr<Type> type(std::make_unique<NamedType>(identifier(0, "int")));
+    auto name = identifier(4, "x");
+    name->share_type(type);
+    Program program(SourceLocation(0));
+    program.strings = std::make_shared<StringPool>();
+    auto declaration = std::make_unique<VariableDeclaration>(
+        SourceLocation(0), std::move(name), nullptr);
+    declaration->m_type = std::move(type);
+    program.add_declaration(std::move(declaration));
+
+    auto tree = FlatAST::from_tree(program).to_tree();
+    auto *variable = cast<VariableDeclaration>(tree->declarations[0].get());
+    CowPtr<Identifier> copy = variable->name;
+    CHECK(!copy->owns_type() && copy->type() != variable->type());
+    tree.reset();
+    CHECK(copy->type() != nullptr && isa<NamedType>(copy->type()));
+}
+
+// Reading a packed list leaves it packed, unpacking gives every element
+// the location it was parsed at
+static void test_packed_locations() {
+    // {1, -2,   300} with the '{' at offset 20
+    PackedLiterals packed;
+    CHECK(packed.add(IntegerLiteral{1, false, 0}, false, 1));
+    CHECK(packed.add(IntegerLiteral{2, false, 0}, true, 5));
+    CHECK(packed.add(IntegerLiteral{300, false, 0}, false, 10));
+    CHECK(!packed.add(IntegerLiteral{4, false, 0}, false,
+                      10 + PackedLiterals::MAX_GAP + 1));
+    ArrayInitializationList list(SourceLocation(20));
+    list.set_packed(std::make_shared<const PackedLiterals>(packed));
+
+    CHECK(list.values().empty() && list.packed() != nullptr);
+    // The gaps are saved with the list
+    auto strings = std::make_shared<StringPool>();
+    std::string data;
+    FlatAST::from_node(list, strings).serialize(data);
+    auto copy = unique_cast<ArrayInitializationList>(
+        FlatAST::deserialize(data, strings).to_node());
+    auto &values = copy->mutable_values();
+    CHECK(values.size() == 3 && copy->packed() == nullptr);
+    CHECK(values[0]->location.get_offset() == 21);
+    auto *minus = cast<UnaryExpression>(values[1].get());
+    CHECK(minus->value->location.get_offset() == 25);
+    CHECK(values[2]->location.get_offset() == 30);
+}
+
+// Deserializing with an owner leaves the arrays in the data
+static void test_flat_in_place() {
+    PackedLiterals packed;
+    for (uint32_t i = 0; i < 100; i++) {
+        CHECK(packed.add(IntegerLiteral{i * 1000, false, 0}, i % 3 == 0,
+                         i * 6 + 1));
+    }
+    auto list = std::make_unique<ArrayInitializationList>(SourceLocation(40));
+    list->set_packed(std::make_shared<const PackedLiterals>(packed));
+    Block block(SourceLocation(0));
+    block.add_statement(std::make_unique<Return>(SourceLocation(2),
+                                                 identifier(9, "x")));
+    block.add_statement(std::move(list));
+
+    auto strings = std::make_shared<StringPool>();
+    auto data = std::make_shared<std::string>();
+    FlatAST::from_node(block, strings).serialize(*data);
+    auto flat = FlatAST::deserialize(*data, strings, data);
+    CHECK(flat.children.is_borrowed());
+    CHECK(flat.all<Flat::Block>().is_borrowed());
+    CHECK(flat.all<Flat::Return>().size() == 1);
+
+    auto copy = unique_cast<Block>(flat.to_node());
+    data.reset();
+    auto *copied = cast<ArrayInitializationList>(copy->statements[1].get());
+    CHECK(copied->packed()->size() == 100);
+    CHECK(copied->packed()->integer(99).value == 99000);
+    CHECK(copied->packed()->is_negative(99) &&
+          !copied->packed()->is_negative(98));
+    CHECK(cast<Return>(copy->statements[0].get())->value->location ==
+          SourceLocation(9));
+}
+
+// A line table read back maps locations like the buffer it was built from
+static void test_source_tables() {
+    auto buffer = std::make_shared<const std::string>(
+        "int a;\n# 7 \"b.h\" 1\nchar *s = \"\xc3\xa4\xc3\xb6\"; int b;\n"
+        "# 3 \"a.c\" 2\nint c;\n");
+    SourceManager sources(buffer, "a.c");
+    std::string data;
+    ByteWriter writer(data);
+    sources.serialize(writer);
+    ByteReader reader(data);
+    auto copy = SourceManager::deserialize(reader);
+    CHECK(copy->buffer().empty());
+    for (uint32_t offset = 0; offset <= buffer->size(); offset++) {
+        CHECK(copy->describe(SourceLocation(offset)) ==
+              sources.describe(SourceLocation(offset)));
+    }
+    CHECK(copy->describe(SourceLocation(buffer->find("int b"))) ==
+          "b.h:7:17");
+}
+
+// Every form of number the lexer accepts decodes with its suffix
+static void test_number_literals() {
+    CHECK(is_float_literal("1.5f") && is_float_literal(".5") &&
+          is_float_literal("1e3") && !is_float_literal("10U"));
+    FloatLiteral f = decode_float("1.5f");
+    CHECK(f.value == 1.5 && f.is_float && !f.is_long);
+    f = decode_float("1e3");
+    CHECK(f.value == 1000 && !f.is_float && !f.is_long);
+    f = decode_float("1.0L");
+    CHECK(f.value == 1 && f.is_long);
+    CHECK(decode_float(".5").value == 0.5);
+    CHECK(float_to_string(decode_float("2.5E-1F")) == "0.25f");
+
+    std::string diagnostic;
+    IntegerLiteral i = decode_integer("10U", diagnostic);
+    CHECK(i.value == 10 && i.is_unsigned && i.long_count == 0);
+    i = decode_integer("0X1Ful", diagnostic);
+    CHECK(i.value == 31 && i.is_unsigned && i.long_count == 1);
+    CHECK(diagnostic.empty());
+    decode_integer("10f", diagnostic);
+    CHECK(diagnostic == "invalid digit 'f' in decimal constant");
+}
+
+// A moved pool keeps the views its ids are keyed by, copying is not allowed
+static void test_string_pool_move() {
+    static_assert(!std::is_copy_constructible_v<StringPool>);
+    StringPool pool;
+    uint32_t id = pool.intern("a string longer than the small buffer");
+    uint32_t small = pool.intern("s");
+    StringPool moved = std::move(pool);
+    CHECK(moved.find("a string longer than the small buffer") == id);
+    CHECK(moved.find("s") == small && moved.get(small) == "s");
+    CHECK(moved.intern("s") == small && moved.size() == 2);
+}
+
+// x = x + 1 + 1 + ... nested deeper than the stack would allow frames for,
+// the innermost x borrows the type of the declared one
+static void test_flat_deep_chain() {
+    const size_t depth = 200000;
+    auto name = identifier(4, "x");
+    name->add_type(std::make_unique<NamedType>(identifier(0, "int")));
+    auto innermost = identifier(8, "x");
+    innermost->share_type(name->type_ptr());
+    std::unique_ptr<AST> value = std::move(innermost);
+    for (size_t i = 0; i < depth; i++) {
+        auto one = std::make_unique<Constant>(SourceLocation(12),
+                                              IntegerLiteral{1, false, 0});
+        value = std::make_unique<BinaryExpression>(
+            SourceLocation(10), std::move(value), std::move(one),
+            BinaryExpression::Operator::PLUS);
+    }
+    Program program(SourceLocation(0));
+    program.strings = std::make_shared<StringPool>();
+    program.add_declaration(std::make_unique<VariableDeclaration>(
+        SourceLocation(0), std::move(name), std::move(value)));
+
+    std::string data;
+    FlatAST::from_tree(program).serialize(data);
+    CHECK(FlatAST::deserialize(data, program.strings).size() ==
+          FlatAST::from_tree(program).size());
+    auto tree = FlatAST::deserialize(data, program.strings).to_tree();
+    auto *variable = cast<VariableDeclaration>(tree->declarations[0].get());
+    const AST *node = variable->value.get();
+    size_t levels = 0;
+    while (auto *sum = dyn_cast<BinaryExpression>(node)) {
+        CHECK(cast<Constant>(sum->right.get())->integer.value == 1);
+        node = sum->left.get();
+        levels++;
+    }
+    CHECK(levels == depth);
+    auto *x = cast<Identifier>(node);
+    CHECK(x->name == "x" && !x->owns_type());
+    CHECK(cast<NamedType>(x->type())->name == "int");
+}
+
+static std::unique_ptr<PrimitiveType> primitive(
+    std::initializer_list<PrimitiveType::KeyWords> keywords,
+    int pointer_count = 0) {
+    auto type = std::make_unique<PrimitiveType>(SourceLocation(0));
+    for (auto keyword : keywords) {
+        type->add_keyword(keyword);
+    }
+    type->pointer_count = pointer_count;
+    return type;
+}
+
+// Spellings of one type intern to one CanonicalType, invalid keyword sets are
+// reported and become NONE
+static void test_type_context() {
+    using KeyWords = PrimitiveType::KeyWords;
+    TypeContext context;
+    auto *unsigned_long = context.get(
+        primitive({KeyWords::UNSIGNED, KeyWords::LONG, KeyWords::INT}).get());
+    CHECK(unsigned_long->builtin == CanonicalType::Builtin::UNSIGNED_LONG);
+    CHECK(context.get(primitive({KeyWords::LONG, KeyWords::UNSIGNED,
+                                 KeyWords::INT})
+                          .get()) == unsigned_long);
+    CHECK(context.get(primitive({KeyWords::LONG, KeyWords::UNSIGNED}).get()) ==
+          unsigned_long);
+
+    auto *char_pointer = context.get(primitive({KeyWords::CHAR}, 1).get());
+    CHECK(char_pointer->kind == CanonicalType::Kind::POINTER);
+    CHECK(char_pointer->element ==
+          context.builtin(CanonicalType::Builtin::CHAR));
+    CHECK(context.get(primitive({KeyWords::CHAR}, 1).get()) == char_pointer);
+    size_t types = context.size();
+    CHECK(context.errors() == 0);
+
+    for (const auto &keywords :
+         {primitive({KeyWords::SIGNED, KeyWords::UNSIGNED, KeyWords::INT}),
+          primitive({KeyWords::LONG, KeyWords::SHORT}),
+          primitive({KeyWords::LONG, KeyWords::LONG, KeyWords::LONG}),
+          primitive({KeyWords::INT, KeyWords::DOUBLE}),
+          primitive({KeyWords::UNSIGNED, KeyWords::FLOAT})}) {
+        CHECK(context.get(keywords.get())->builtin ==
+              CanonicalType::Builtin::NONE);
+    }
+    CHECK(context.errors() == 5);
+    CHECK(context.size() == types + 1);
+}
+
+int main() {
+    test_shift_shared();
+    test_lazy_body();
+    test_shared_type();
+    test_flat_shared_type();
+    test_packed_locations();
+    test_flat_in_place();
+    test_source_tables();
+    test_number_literals();
+    test_string_pool_move();
+    test_type_context();
+    test_flat_deep_chain();
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "error_strategy.hpp"
+
+#include "ANTLRInputStream.h"
+#include "CommonTokenStream.h"
+#include "antlr/CLexer.h"
+#include "antlr/CParser.h"
+#include "atn/DecisionInfo.h"
+#include "atn/ParseInfo.h"
+#include "check.hpp"
+#include "tokens.hpp"
+
+using namespace CCOMP::AST;
+using CCOMP::Parser::ArenaTokenFactory;
+using CCOMP::Parser::PanicErrorStrategy;
+using CCOMP::Parser::PanicPoints;
+using CCOMP::Parser::TypedefTable;
+
+// Remembers the line of every syntax error instead of printing it
+class LineListener : public antlr4::BaseErrorListener {
+   public:
+    void syntaxError(antlr4::Recognizer * /*recognizer*/,
+                     antlr4::Token * /*offending_symbol*/, size_t line,
+                     size_t /*column*/, const std::string & /*message*/,
+                     std::exception_ptr /*e*/) override {
+        lines.push_back(line);
+    }
+
+    std::vector<size_t> lines;
+};
+
+struct Recovery {
+    // Of the declarations in the Program
+    std::vector<std::string> names;
+    std::vector<size_t> error_lines;
+    // Tokens looked at by all predictions
+    long long lookahead = 0;
+};
+
+// Parses like Parser::parse with the profiler on
+static Recovery parse_broken(const std::string &source) {
+    antlr4::ANTLRInputStream input(source);
+    ArenaTokenFactory factory(source);
+    auto typedefs = std::make_shared<TypedefTable>();
+    factory.set_typedefs(typedefs.get(), CLexer::IDENTIFIER,
+                         CLexer::TYPEDEF_NAME);
+    CLexer lexer(&input);
+    lexer.setTokenFactory(&factory);
+    antlr4::CommonTokenStream tokens(&lexer);
+    CParser parser(&tokens);
+    LineListener listener;
+    parser.removeErrorListeners();
+    parser.addErrorListener(&listener);
+    parser.typedefs = typedefs;
+    parser.setErrorHandler(std::make_shared<PanicErrorStrategy>(
+        PanicPoints{CParser::RuleProgram, CParser::RuleGlobalDeclaration,
+                    CParser::SEMICOLON, CParser::LBRACE, CParser::RBRACE},
+        [&]() {
+            typedefs->reset();
+            parser.retype_lookahead();
+        }));
+    parser.setProfile(true);
+
+    Recovery result;
+    auto program = std::move(parser.program()->ast);
+    for (auto &declaration : program->declarations) {
+        auto *data = declaration_data(declaration.get());
+        result.names.push_back(data->name->name);
+    }
+    result.error_lines = std::move(listener.lines);
+    for (auto &decision : parser.getParseInfo().getDecisionInfo()) {
+        result.lookahead += decision.SLL_TotalLook + decision.LL_TotalLook;
+    }
+    return result;
+}
+
+// Groups of five lines: a variable, a broken initializer ending at its ';',
+// a broken body ending at its '}', stray tokens at the top level and a
+// function
+static std::string broken_source(size_t groups) {
+    std::string source;
+    for (size_t i = 0; i < groups; i++) {
+        std::string n = std::to_string(i);
+        source += "int a" + n + ";\n";
+        source += "int b" + n + " = ;\n";
+        source += "int c" + n + "(void) { if (1) { return 1 + ; } }\n";
+        source += ") x" + n + " ;\n";
+        source += "int d" + n + "(void) { return " + n + "; }\n";
+    }
+    return source;
+}
+
+// One diagnostic per broken declaration, and the parse goes on behind it
+static void test_recovery() {
+    const size_t groups = 100;
+    Recovery recovery = parse_broken(broken_source(groups));
+
+    CHECK(recovery.names.size() == 2 * groups);
+    CHECK(recovery.error_lines.size() == 3 * groups);
+    for (size_t i = 0; i < groups; i++) {
+        std::string n = std::to_string(i);
+        CHECK(recovery.names[2 * i] == "a" + n);
+        CHECK(recovery.names[2 * i + 1] == "d" + n);
+        for (size_t k = 0; k < 3; k++) {
+            CHECK(recovery.error_lines[3 * i + k] == 5 * i + 2 + k);
+        }
+    }
+}
+
+// Four times the input costs four times the lookahead, not sixteen
+static void test_linear() {
+    Recovery small = parse_broken(broken_source(250));
+    Recovery large = parse_broken(broken_source(1000));
+    CHECK(small.lookahead > 0);
+    CHECK(large.lookahead <= 5 * small.lookahead);
+}
+
+// Unbalanced parentheses are skipped in one go as well
+static void test_unbalanced() {
+    std::string source = "int p = " + std::string(200, '(') + "1;\n";
+    source += "int q;\n";
+    Recovery recovery = parse_broken(source);
+    CHECK(recovery.error_lines.size() == 1);
+    CHECK(recovery.names.size() == 1 && recovery.names[0] == "q");
+}
+
+int main() {
+    test_recovery();
+    test_linear();
+    test_unbalanced();
+    return 0;
+}
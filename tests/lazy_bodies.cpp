@@ -0,0 +1,55 @@
+#include <filesystem>
+
+#include "check.hpp"
+#include "parser.hpp"
+#include "preprocessor.hpp"
+#include "structural_hash.hpp"
+
+using namespace CCOMP::AST;
+using CCOMP::Parser::Options;
+
+// Number of function definitions whose body was skipped
+static size_t lazy_count(const Program &program) {
+    size_t count = 0;
+    for (auto &declaration : program.declarations) {
+        auto *function = dyn_cast<FunctionDefinition>(declaration.get());
+        count += function && function->lazy() ? 1 : 0;
+    }
+    return count;
+}
+
+// Skipping the bodies gives the same tree once every body is parsed. The
+// structural hash parses the lazy bodies it reaches.
+static size_t test_example(const std::string &path) {
+    std::string source = CCOMP::preprocessor(path, path);
+    Options eager_options;
+    eager_options.file_name = path;
+    Options lazy_options = eager_options;
+    lazy_options.lazy_bodies = true;
+    auto eager = CCOMP::Parser::parse(source, eager_options);
+    auto lazy = CCOMP::Parser::parse(source, lazy_options);
+
+    CHECK(lazy_count(*eager) == 0);
+    size_t skipped = lazy_count(*lazy);
+    CHECK(eager->declarations.size() == lazy->declarations.size());
+    for (size_t i = 0; i < eager->declarations.size(); i++) {
+        CHECK(structural_hash(*eager->declarations[i]) ==
+              structural_hash(*lazy->declarations[i]));
+    }
+    CHECK(lazy_count(*lazy) == 0);
+    CHECK(structural_hash(*eager) == structural_hash(*lazy));
+    return skipped;
+}
+
+int main() {
+    CCOMP::Parser::initialize();
+    size_t skipped = 0;
+    for (auto &entry : std::filesystem::directory_iterator(EXAMPLES_DIR)) {
+        if (entry.path().extension() == ".c") {
+            skipped += test_example(entry.path().string());
+        }
+    }
+    // Else the lazy parse was not tested at all
+    CHECK(skipped > 0);
+    return 0;
+}
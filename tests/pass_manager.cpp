@@ -0,0 +1,87 @@
+#include "pass_manager.hpp"
+
+#include "check.hpp"
+
+using namespace CCOMP::AST;
+
+static const SourceLocation LOCATION(0);
+
+// int name = value;
+static std::unique_ptr<AST> variable(const char *name, uint64_t value) {
+    IntegerLiteral literal;
+    literal.value = value;
+    return std::make_unique<VariableDeclaration>(
+        LOCATION, std::make_unique<Identifier>(LOCATION, name),
+        std::make_unique<Constant>(LOCATION, literal));
+}
+
+// Sum of the integer constants of a declaration
+class ConstantSum : public Analysis<uint64_t> {
+   public:
+    ConstantSum()
+        : Analysis("constant sum", POST, Kinds().set((size_t)Kind::CONSTANT)) {
+    }
+
+   protected:
+    void post(const AST &node, size_t, uint64_t &result) override {
+        result += cast<Constant>(&node)->integer.value;
+    }
+};
+
+// Turns the value 1 into 2
+class Increment : public Transform {
+   public:
+    Increment() : Transform("increment") {
+    }
+
+    bool run(CowPtr<AST> &declaration) override {
+        auto *variable = cast<VariableDeclaration>(declaration.get());
+        auto *value = cast<Constant>(variable->value.get());
+        if (value->integer.value != 1) {
+            return false;
+        }
+        IntegerLiteral two;
+        two.value = 2;
+        cast<VariableDeclaration>(declaration.mut())->value =
+            std::make_unique<Constant>(LOCATION, two);
+        return true;
+    }
+};
+
+// Only the declarations without a result are walked again, and the results
+// of removed ones are dropped
+static void test_walks() {
+    Program program(LOCATION);
+    program.add_declaration(variable("a", 1));
+    program.add_declaration(variable("b", 5));
+    program.add_declaration(variable("c", 7));
+
+    PassManager passes;
+    auto &sums = passes.add<ConstantSum>();
+    passes.add<Increment>();
+    passes.run(program);
+    CHECK(passes.walks() == 3);
+    CHECK(sums.size() == 2);
+    CHECK(*sums.result(program.declarations[1].get()) == 5);
+
+    // Only a changed, the transform leaves it alone now
+    passes.run(program);
+    CHECK(passes.walks() == 1);
+    CHECK(*sums.result(program.declarations[0].get()) == 2);
+    passes.run(program);
+    CHECK(passes.walks() == 0);
+
+    // b was changed elsewhere, c removed and d added
+    passes.invalidate(program.declarations[1].get());
+    program.declarations.pop_back();
+    program.add_declaration(variable("d", 4));
+    passes.run(program);
+    CHECK(passes.walks() == 2);
+    CHECK(sums.size() == 3);
+    CHECK(*sums.result(program.declarations[2].get()) == 4);
+}
+
+int main() {
+    test_walks();
+    return 0;
+}
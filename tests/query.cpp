@@ -0,0 +1,84 @@
+#include "query.hpp"
+
+#include "check.hpp"
+
+using namespace CCOMP::AST;
+using KeyWords = PrimitiveType::KeyWords;
+
+static std::unique_ptr<Identifier> identifier(const char *name) {
+    return std::make_unique<Identifier>(SourceLocation(0), name);
+}
+
+static std::unique_ptr<Type> primitive(KeyWords keyword) {
+    auto type = std::make_unique<PrimitiveType>(SourceLocation(0));
+    type->add_keyword(keyword);
+    return type;
+}
+
+// struct name as a type, without its members
+static std::unique_ptr<Type> tag(const char *name) {
+    return std::make_unique<StructType>(SourceLocation(0), identifier(name),
+                                        false);
+}
+
+static std::unique_ptr<VariableDeclaration> variable(
+    const char *name, std::unique_ptr<Type> type) {
+    auto declaration = std::make_unique<VariableDeclaration>(
+        SourceLocation(0), identifier(name), nullptr);
+    declaration->m_type = std::move(type);
+    return declaration;
+}
+
+// struct name { type member; }
+static std::unique_ptr<StructType> structure(const char *name,
+                                             std::unique_ptr<Type> type) {
+    auto node =
+        std::make_unique<StructType>(SourceLocation(0), identifier(name), true);
+    node->add_member(variable("member", std::move(type)));
+    return node;
+}
+
+// Only the queries reading a changed declaration run again
+static void test_reuse() {
+    Program program(SourceLocation(0));
+    program.add_declaration(structure("A", primitive(KeyWords::INT)));
+    program.add_declaration(structure("B", primitive(KeyWords::CHAR)));
+    program.add_declaration(variable("b", tag("B")));
+
+    QueryEngine queries;
+    queries.update(program);
+    CHECK(queries.layout(queries.id("A", true)) == (Layout{4, 4}));
+    CHECK(queries.layout_of(queries.type(queries.id("b"))) == (Layout{1, 1}));
+    size_t computed = queries.computations();
+
+    program.declarations[0] = structure("A", primitive(KeyWords::DOUBLE));
+    queries.update(program);
+    CHECK(queries.layout_of(queries.type(queries.id("b"))) == (Layout{1, 1}));
+    CHECK(queries.computations() == computed);
+    CHECK(queries.layout(queries.id("A", true)) == (Layout{8, 8}));
+    CHECK(queries.computations() > computed);
+}
+
+// A struct containing itself has no size, also when it had one in the
+// revision before
+static void test_cycle() {
+    Program program(SourceLocation(0));
+    program.add_declaration(structure("S", primitive(KeyWords::INT)));
+    QueryEngine queries;
+    queries.update(program);
+    DeclarationId s = queries.id("S", true);
+    CHECK(queries.layout(s) == (Layout{4, 4}));
+
+    program.declarations[0] = structure("S", tag("S"));
+    queries.update(program);
+    CHECK(queries.layout(s).size == CanonicalType::UNSIZED);
+    // Checking the query against its own dependency ends as well
+    queries.update(program);
+    CHECK(queries.layout(s).size == CanonicalType::UNSIZED);
+}
+
+int main() {
+    test_reuse();
+    test_cycle();
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "check.hpp"
+#include "parser.hpp"
+#include "preprocessor.hpp"
+
+using namespace CCOMP;
+using AST::CowPtr;
+
+static const std::string SOURCE =
+    "int f(int a) { return a; }\n"
+    "int g(int b) { return b + 1; }\n"
+    "int h() { return 2; }\n";
+
+static std::string replaced(std::string text, const std::string &from,
+                            const std::string &to) {
+    return text.replace(text.find(from), from.size(), to);
+}
+
+static void test_difference() {
+    Parser::Edit edit = Parser::difference("abcdef", "abXYZef");
+    CHECK(edit.offset == 2 && edit.length == 2 && edit.text == "XYZ");
+    edit = Parser::difference("aaa", "aaaa");
+    CHECK(edit.offset == 3 && edit.length == 0 && edit.text == "a");
+    edit = Parser::difference("same", "same");
+    CHECK(edit.length == 0 && edit.text.empty());
+}
+
+// Editing one body reparses its declaration only. The ones behind it move,
+// a tree still sharing them keeps the old locations.
+static void test_body_edit() {
+    auto result = Parser::parse_incremental(SOURCE);
+    CHECK(result.program->declarations.size() == 3);
+    CowPtr<AST::AST> old_h = result.program->declarations[2];
+    uint32_t h_offset = old_h->location.get_offset();
+
+    std::string edited = replaced(SOURCE, "b + 1", "b * 10");
+    size_t reparsed =
+        Parser::reparse(result, Parser::difference(SOURCE, edited));
+    CHECK(reparsed < edited.size());
+    CHECK(*result.source == edited);
+    CHECK(result.program->declarations.size() == 3);
+    CHECK(result.program->declarations[2]->location.get_offset() ==
+          h_offset + 1);
+    CHECK(old_h->location.get_offset() == h_offset);
+}
+
+// An edit that breaks the syntax grows the region to the whole file
+static void test_broken_edit() {
+    auto result = Parser::parse_incremental(SOURCE);
+    std::string edited = replaced(SOURCE, "return a;", "return a");
+    size_t reparsed =
+        Parser::reparse(result, Parser::difference(SOURCE, edited));
+    CHECK(reparsed == edited.size());
+    CHECK(*result.source == edited);
+}
+
+// Output of clang -E for the file at path, with a declaration from a header
+static std::string preprocessed(const std::string &path,
+                                const std::string &body) {
+    return "# 1 \"" + path + "\"\n"
+           "# 1 \"<built-in>\" 1\n"
+           "# 1 \"" + path + "\" 2\n"
+           "# 1 \"a.h\" 1\n"
+           "int printf(const char *format, ...);\n"
+           "# 2 \"" + path + "\" 2\n"
+           "int f(int a) { return a; }\n"
+           "int g(int b) { return " + body + "; }\n"
+           "# 9 \"" + path + "\"\n"
+           "int h() { return 2; }\n";
+}
+
+// An edited copy preprocessed under the name of the source only differs in
+// the edit, so only its declaration is reparsed
+static void test_preprocessed_edit() {
+    std::string source = preprocessed("a.c", "b + 1");
+    std::string edited = CCOMP::rename_line_markers(
+        preprocessed("/tmp/edited.c", "b * 10"), "/tmp/edited.c", "a.c");
+    CHECK(edited == preprocessed("a.c", "b * 10"));
+
+    Parser::Edit edit = Parser::difference(source, edited);
+    CHECK(edit.offset == source.find("b + 1") + 2);
+    auto result = Parser::parse_incremental(source);
+    size_t reparsed = Parser::reparse(result, edit);
+    CHECK(reparsed < edited.size() / 2);
+    CHECK(*result.source == edited);
+    CHECK(result.program->declarations.size() == 4);
+}
+
+int main() {
+    Parser::initialize();
+    test_difference();
+    test_body_edit();
+    test_broken_edit();
+    test_preprocessed_edit();
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include "rewrite.hpp"
+
+#include "check.hpp"
+#include "structural_hash.hpp"
+
+using namespace CCOMP::AST;
+using Op = BinaryExpression::Operator;
+
+static const SourceLocation LOCATION(0);
+
+static std::unique_ptr<AST> integer(uint64_t value) {
+    IntegerLiteral literal;
+    literal.value = value;
+    return std::make_unique<Constant>(LOCATION, literal);
+}
+
+static std::unique_ptr<AST> binary(Op op, std::unique_ptr<AST> left,
+                                   std::unique_ptr<AST> right) {
+    return std::make_unique<BinaryExpression>(LOCATION, std::move(left),
+                                              std::move(right), op);
+}
+
+static std::unique_ptr<Identifier> identifier(const char *name) {
+    return std::make_unique<Identifier>(LOCATION, name);
+}
+
+static bool is_integer(const AST *node, uint64_t value) {
+    auto *constant = dyn_cast<Constant>(node);
+    return constant != nullptr &&
+           constant->literal_kind == Constant::LiteralKind::INTEGER &&
+           constant->integer.value == value;
+}
+
+static void test_folding() {
+    RewriteRules rules;
+    add_folding_rules(rules);
+
+    // (2 + 3) * (5 - 4) is 5, 1 - 2 and 1 / 0 stay
+    CowPtr<AST> product(
+        binary(Op::MUL, binary(Op::PLUS, integer(2), integer(3)),
+               binary(Op::MINUS, integer(5), integer(4))));
+    CHECK(is_integer(rules.rewrite(*product).get(), 5));
+    CowPtr<AST> negative(binary(Op::MINUS, integer(1), integer(2)));
+    CHECK(rules.rewrite(*negative) == nullptr);
+    CowPtr<AST> division(binary(Op::DIV, integer(1), integer(0)));
+    CHECK(rules.rewrite(*division) == nullptr);
+}
+
+// (unsigned)name
+static std::unique_ptr<AST> as_unsigned(const char *name) {
+    auto type = std::make_unique<PrimitiveType>(LOCATION);
+    type->add_keyword(PrimitiveType::KeyWords::UNSIGNED);
+    return std::make_unique<TypeCast>(LOCATION, std::move(type),
+                                      identifier(name));
+}
+
+static void test_shifts() {
+    RewriteRules rules;
+    add_folding_rules(rules);
+    add_shift_rules(rules);
+
+    // (unsigned)x * 8 is (unsigned)x << 3
+    CowPtr<AST> right(binary(Op::MUL, as_unsigned("x"), integer(8)));
+    auto result = rules.rewrite(*right);
+    auto *shift = dyn_cast<BinaryExpression>(result.get());
+    CHECK(shift != nullptr && shift->op == Op::SHIFT_LEFT);
+    CHECK(isa<TypeCast>(shift->left.get()));
+    CHECK(is_integer(shift->right.get(), 3));
+
+    // 2 * (unsigned)x * 4 is (unsigned)x << 1 << 2
+    CowPtr<AST> left(
+        binary(Op::MUL, binary(Op::MUL, integer(2), as_unsigned("x")),
+               integer(4)));
+    result = rules.rewrite(*left);
+    shift = dyn_cast<BinaryExpression>(result.get());
+    CHECK(shift != nullptr && shift->op == Op::SHIFT_LEFT);
+    CHECK(is_integer(shift->right.get(), 2));
+    auto *inner = dyn_cast<BinaryExpression>(shift->left.get());
+    CHECK(inner != nullptr && inner->op == Op::SHIFT_LEFT);
+    CHECK(is_integer(inner->right.get(), 1));
+
+    // x may be negative or a float, (unsigned)x * 6 and * 1 stay, 4 * 8 is
+    // folded first
+    CowPtr<AST> unknown(binary(Op::MUL, identifier("x"), integer(8)));
+    CHECK(rules.rewrite(*unknown) == nullptr);
+    CowPtr<AST> six(binary(Op::MUL, as_unsigned("x"), integer(6)));
+    CHECK(rules.rewrite(*six) == nullptr);
+    CowPtr<AST> one(binary(Op::MUL, as_unsigned("x"), integer(1)));
+    CHECK(rules.rewrite(*one) == nullptr);
+    CowPtr<AST> constants(binary(Op::MUL, integer(4), integer(8)));
+    CHECK(is_integer(rules.rewrite(*constants).get(), 32));
+}
+
+// Rewriting copies the changed path and leaves the original tree alone
+static void test_sharing() {
+    RewriteRules rules;
+    add_folding_rules(rules);
+
+    auto body = std::make_unique<Block>(LOCATION);
+    body->add_statement(std::make_unique<Return>(
+        LOCATION, binary(Op::SHIFT_LEFT, integer(1), integer(4))));
+    body->add_statement(std::make_unique<Return>(LOCATION, identifier("y")));
+    auto name = std::make_unique<Identifier>(LOCATION, "f");
+    name->add_type(std::make_unique<FunctionType>(
+        LOCATION, std::make_unique<NamedType>(identifier("int"))));
+    Program program(LOCATION);
+    program.add_declaration(std::make_unique<FunctionDefinition>(
+        LOCATION, std::move(name), std::move(body)));
+
+    CowPtr<AST> before = program.declarations[0];
+    uint64_t hash = structural_hash(*before);
+    PassManager passes;
+    passes.add<Rewriter>(rules);
+    passes.run(program);
+
+    CHECK(program.declarations[0].get() != before.get());
+    CHECK(structural_hash(*before) == hash);
+    auto *after = cast<FunctionDefinition>(program.declarations[0].get());
+    auto *old = cast<FunctionDefinition>(before.get());
+    auto *first = cast<Return>(after->body()->statements[0].get());
+    CHECK(is_integer(first->value.get(), 16));
+    // The unchanged statement is shared
+    CHECK(after->body()->statements[1].get() ==
+          old->body()->statements[1].get());
+}
+
+// A rule set that never stops gives up with a warning
+static void test_no_fixpoint() {
+    RewriteRules rules;
+    rules.add(Pattern::unary(UnaryExpression::Operator::MINUS, Pattern::any()),
+              [](const AST &node, const std::vector<const AST *> &bound)
+                  -> std::unique_ptr<AST> {
+                  return std::make_unique<UnaryExpression>(
+                      node.location, bound[0]->clone(),
+                      UnaryExpression::Operator::MINUS);
+              });
+    CowPtr<AST> negation(std::make_unique<UnaryExpression>(
+        LOCATION, identifier("x"), UnaryExpression::Operator::MINUS));
+    auto result = rules.rewrite(*negation);
+    CHECK(result != nullptr && isa<UnaryExpression>(result.get()));
+    CHECK(rules.applied() == RewriteRules::MAX_ROUNDS);
+}
+
+int main() {
+    test_folding();
+    test_shifts();
+    test_sharing();
+    test_no_fixpoint();
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "structural_hash.hpp"
+
+#include <filesystem>
+
+#include "check.hpp"
+#include "io.hpp"
+#include "visitors/locationShiftVisitor.hpp"
+
+using namespace CCOMP::AST;
+
+static std::unique_ptr<Identifier> identifier(uint32_t offset,
+                                              const char *name) {
+    return std::make_unique<Identifier>(SourceLocation(offset), name);
+}
+
+static std::unique_ptr<AST> integer(uint32_t offset, uint64_t value) {
+    return std::make_unique<Constant>(SourceLocation(offset),
+                                      IntegerLiteral{value, false, 0});
+}
+
+// int x = y;
+static CowPtr<AST> declaration(const char *value) {
+    auto name = identifier(10, "x");
+    name->add_type(std::make_unique<NamedType>(identifier(6, "int")));
+    return CowPtr<AST>(std::make_unique<VariableDeclaration>(
+        SourceLocation(6), std::move(name), identifier(14, value)));
+}
+
+// Lines added above a declaration leave its hash alone
+static void test_locations() {
+    CowPtr<AST> node = declaration("y");
+    uint64_t hash = structural_hash(*node);
+    LocationShiftVisitor(100).shift(node);
+    CHECK(node->location.get_offset() == 106);
+    CHECK(structural_hash(*node) == hash);
+    CHECK(structural_hash(*declaration("z")) != hash);
+}
+
+// {1, -2, 300} packed, unpacked by the list and made of nodes
+static void test_packed() {
+    PackedLiterals packed;
+    CHECK(packed.add(IntegerLiteral{1, false, 0}, false, 1));
+    CHECK(packed.add(IntegerLiteral{2, false, 0}, true, 4));
+    CHECK(packed.add(IntegerLiteral{300, false, 0}, false, 8));
+    ArrayInitializationList list(SourceLocation(20));
+    list.set_packed(std::make_shared<const PackedLiterals>(packed));
+    uint64_t hash = structural_hash(list);
+    CHECK(list.packed() != nullptr);
+
+    ArrayInitializationList unpacked(list);
+    CHECK(unpacked.mutable_values().size() == 3);
+    CHECK(unpacked.packed() == nullptr);
+    CHECK(structural_hash(unpacked) == hash);
+
+    ArrayInitializationList nodes(SourceLocation(0));
+    nodes.add_value(integer(1, 1));
+    nodes.add_value(std::make_unique<UnaryExpression>(
+        SourceLocation(4), integer(5, 2), UnaryExpression::Operator::MINUS));
+    nodes.add_value(integer(8, 300));
+    CHECK(structural_hash(nodes) == hash);
+}
+
+// A damaged file is ignored like one of another version
+static void test_damaged_file() {
+    std::string path =
+        (std::filesystem::temp_directory_path() / "ccomp_test_hashes").string();
+    HashFile file;
+    file.add(1);
+    file.add(2);
+    file.save(path);
+    HashFile loaded = HashFile::load(path);
+    CHECK(loaded.size() == 2 && loaded.contains(2));
+
+    std::string data = CCOMP::IO::read_file(path);
+    std::string magic = data;
+    magic[0] = 'X';
+    std::string count = data;
+    count[20]++;
+    std::string version = data;
+    version[8]++;
+    for (const std::string &damaged :
+         {data.substr(0, data.size() - 3), data.substr(0, 4), magic, count,
+          version, std::string()}) {
+        CCOMP::IO::write_file(path, damaged);
+        CHECK(HashFile::load(path).size() == 0);
+    }
+    std::filesystem::remove(path);
+    CHECK(HashFile::load(path).size() == 0);
+}
+
+int main() {
+    test_locations();
+    test_packed();
+    test_damaged_file();
+    return 0;
+}
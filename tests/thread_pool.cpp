@@ -0,0 +1,95 @@
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+
+using CCOMP::ThreadPool;
+using CCOMP::WorkDeque;
+
+// Every iteration runs exactly once
+static void test_parallel_for(ThreadPool &pool, size_t count) {
+    std::vector<std::atomic<int>> calls(count);
+    pool.parallel_for(count, [&](size_t i) {
+        calls[i].fetch_add(1, std::memory_order_relaxed);
+        // Exercises the per thread arena
+        void *memory = ThreadPool::scratch().allocate(64, 8);
+        static_cast<char *>(memory)[0] = 1;
+    });
+    for (auto &call : calls) {
+        CHECK(call.load() == 1);
+    }
+}
+
+// The owner pops while thieves steal, no item is lost or taken twice
+static void test_deque() {
+    constexpr uint64_t ITEMS = 100000;
+    WorkDeque deque(4);
+    std::vector<std::atomic<int>> taken(ITEMS);
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; i++) {
+        thieves.emplace_back([&]() {
+            uint64_t item;
+            while (!done.load()) {
+                if (deque.steal(item)) {
+                    taken[item].fetch_add(1);
+                }
+            }
+        });
+    }
+    uint64_t item;
+    for (uint64_t i = 0; i < ITEMS; i++) {
+        deque.push(i);
+        if (i % 3 == 0 && deque.pop(item)) {
+            taken[item].fetch_add(1);
+        }
+    }
+    while (deque.pop(item)) {
+        taken[item].fetch_add(1);
+    }
+    // Thieves may still hold an item they read but did not take
+    while (!deque.empty()) {
+        std::this_thread::yield();
+    }
+    done.store(true);
+    for (auto &thief : thieves) {
+        thief.join();
+    }
+    for (auto &count : taken) {
+        CHECK(count.load() == 1);
+    }
+}
+
+int main() {
+    test_deque();
+
+    ThreadPool single(1);
+    test_parallel_for(single, 1000);
+
+    ThreadPool pool(4);
+    CHECK(pool.size() == 4);
+    test_parallel_for(pool, 0);
+    test_parallel_for(pool, 1);
+    test_parallel_for(pool, 100000);
+    // Many short calls, the workers go to sleep and wake up in between
+    for (int i = 0; i < 1000; i++) {
+        test_parallel_for(pool, 7);
+    }
+
+    // Iterations of different length, idle workers block until the slow
+    // ones are done
+    std::atomic<size_t> sum{0};
+    pool.parallel_for(64, [&](size_t i) {
+        if (i % 16 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        sum.fetch_add(i);
+    });
+    CHECK(sum.load() == 64 * 63 / 2);
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "tokens.hpp"
+
+#include "ANTLRInputStream.h"
+#include "CommonTokenStream.h"
+#include "antlr/CLexer.h"
+#include "check.hpp"
+#include "parser.hpp"
+
+using namespace CCOMP::AST;
+using CCOMP::Parser::ArenaToken;
+using CCOMP::Parser::ArenaTokenFactory;
+
+// The comment in front of the tokens and the string are not ASCII, "\xc3\xa4"
+// is one code point in two bytes
+static const std::string SOURCE =
+    "/* \xc3\xa4\xc3\xb6 */ char *s = \"\xc3\xbc\";\n"
+    "int n = 42;\n";
+
+// Every token is a view into the source at its byte offset, ANTLR's own
+// indexes count code points
+static void test_views() {
+    antlr4::ANTLRInputStream input(SOURCE);
+    ArenaTokenFactory factory(SOURCE);
+    CLexer lexer(&input);
+    lexer.setTokenFactory(&factory);
+    antlr4::CommonTokenStream stream(&lexer);
+    stream.fill();
+
+    const std::vector<std::string_view> expected = {
+        "char", "*", "s", "=", "\"\xc3\xbc\"", ";", "int", "n", "=", "42", ";"};
+    auto tokens = stream.getTokens();
+    CHECK(tokens.size() == expected.size() + 1);
+    CHECK(tokens.back()->getType() == antlr4::Token::EOF);
+
+    size_t from = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        auto *token = static_cast<ArenaToken *>(tokens[i]);
+        uint32_t offset = SOURCE.find(expected[i], from);
+        from = offset + expected[i].size();
+        CHECK(token->get_offset() == offset);
+        CHECK(token->view() == expected[i]);
+        CHECK(token->view().data() == SOURCE.data() + offset);
+        CHECK(token->getText() == expected[i]);
+    }
+    // Two code points of the comment take two bytes each, the one of the
+    // string as well
+    CHECK(tokens[2]->getStartIndex() == SOURCE.find("s =") - 2);
+    CHECK(tokens[9]->getStartIndex() == SOURCE.find("42") - 3);
+    CHECK(tokens[2]->getType() == CLexer::IDENTIFIER);
+    CHECK(tokens[4]->getType() == CLexer::STRING);
+    CHECK(tokens[9]->getType() == CLexer::NUMBER);
+}
+
+// Floating constants with exponents and suffixes are one token
+static void test_numbers() {
+    const std::string source = "1.5f 1e3 1.0L 10U .5 2.5E-1F 0X1Fu";
+    antlr4::ANTLRInputStream input(source);
+    ArenaTokenFactory factory(source);
+    CLexer lexer(&input);
+    lexer.setTokenFactory(&factory);
+    antlr4::CommonTokenStream stream(&lexer);
+    stream.fill();
+
+    auto tokens = stream.getTokens();
+    CHECK(tokens.size() == 8);
+    for (size_t i = 0; i < 6; i++) {
+        CHECK(tokens[i]->getType() == CLexer::NUMBER);
+    }
+    CHECK(tokens[6]->getType() == CLexer::HEX_NUMBER);
+    CHECK(static_cast<ArenaToken *>(tokens[5])->view() == "2.5E-1F");
+}
+
+// The nodes get the text and the byte offsets of their tokens
+static void test_parse() {
+    CCOMP::Parser::initialize();
+    auto program = CCOMP::Parser::parse(SOURCE);
+    CHECK(program->declarations.size() == 2);
+
+    auto *s = cast<VariableDeclaration>(program->declarations[0].get());
+    CHECK(s->name->name == "s");
+    CHECK(s->name->location.get_offset() == SOURCE.find("s ="));
+    auto *string = cast<Constant>(s->value.get());
+    CHECK(string->literal_kind == Constant::LiteralKind::STRING);
+    CHECK(string->string == "\xc3\xbc");
+    CHECK(string->location.get_offset() == SOURCE.find('"'));
+
+    auto *n = cast<VariableDeclaration>(program->declarations[1].get());
+    CHECK(n->name->name == "n");
+    CHECK(n->name->location.get_offset() == SOURCE.find("n ="));
+    auto *number = cast<Constant>(n->value.get());
+    CHECK(number->literal_kind == Constant::LiteralKind::INTEGER);
+    CHECK(number->integer.value == 42);
+    CHECK(number->location.get_offset() == SOURCE.find("42"));
+}
+
+int main() {
+    test_views();
+    test_numbers();
+    test_parse();
+    return 0;
+}
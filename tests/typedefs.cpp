@@ -0,0 +1,100 @@
+#include "typedefs.hpp"
+
+#include "check.hpp"
+#include "parser.hpp"
+
+using namespace CCOMP::AST;
+using CCOMP::Parser::TypedefTable;
+
+// An ordinary declaration hides a typedef until its scope ends
+static void test_table() {
+    TypedefTable table;
+    CHECK(table.is_typedef("_Bool"));
+    table.declare_typedef("foo");
+    size_t position = table.position();
+
+    table.push_scope();
+    table.declare_ordinary("foo");
+    CHECK(!table.is_typedef("foo"));
+    table.push_scope();
+    table.declare_typedef("foo");
+    CHECK(table.is_typedef("foo"));
+    table.pop_scope();
+    CHECK(!table.is_typedef("foo"));
+    table.pop_scope();
+    CHECK(table.is_typedef("foo"));
+    // Only the file scope is logged
+    CHECK(table.position() == position);
+
+    table.declare_typedef("bar");
+    auto before = table.at(position);
+    CHECK(before->is_typedef("foo") && !before->is_typedef("bar"));
+    CHECK(before->is_typedef("_Bool"));
+}
+
+static const Block *body(const Program &program, size_t index) {
+    return cast<FunctionDefinition>(program.declarations[index].get())->body();
+}
+
+// foo * bar with foo a typedef and bar the declared pointer
+static void check_declaration(const AST *node) {
+    auto *bar = cast<VariableDeclaration>(node);
+    CHECK(bar->name->name == "bar");
+    auto *type = cast<NamedType>(bar->type());
+    CHECK(type->name == "foo" && type->pointer_count == 1);
+}
+
+// foo * bar with foo and bar variables
+static void check_expression(const AST *node) {
+    auto *product = cast<BinaryExpression>(node);
+    CHECK(product->op == BinaryExpression::Operator::MUL);
+    CHECK(cast<Identifier>(product->left.get())->name == "foo");
+    CHECK(cast<Identifier>(product->right.get())->name == "bar");
+}
+
+// The typedef is known to the tokens right behind it, which may have been
+// lexed before it was reduced
+static void test_declaration() {
+    auto program = CCOMP::Parser::parse("typedef int foo; foo * bar;");
+    CHECK(program->declarations.size() == 2);
+    CHECK(isa<TypeDef>(program->declarations[0].get()));
+    check_declaration(program->declarations[1].get());
+}
+
+// The grammar takes one declarator per declaration, so foo and bar are
+// declared one by one
+static void test_expression() {
+    auto program = CCOMP::Parser::parse(
+        "int foo; int bar;\n"
+        "void f(void) { foo * bar; }\n");
+    CHECK(program->declarations.size() == 3);
+    check_expression(body(*program, 2)->statements[0].get());
+}
+
+// A variable hides the typedef in its block and the blocks inside it, behind
+// the block it is a type again
+static void test_shadowed() {
+    auto program = CCOMP::Parser::parse(
+        "typedef int foo;\n"
+        "void f(void) { int foo; foo * bar; { foo * bar; } }\n"
+        "void g(void) { foo * bar; }\n");
+    CHECK(program->declarations.size() == 3);
+
+    const Block *f = body(*program, 1);
+    CHECK(f->statements.size() == 3);
+    CHECK(cast<VariableDeclaration>(f->statements[0].get())->name->name ==
+          "foo");
+    check_expression(f->statements[1].get());
+    check_expression(cast<Block>(f->statements[2].get())->statements[0].get());
+
+    check_declaration(body(*program, 2)->statements[0].get());
+}
+
+int main() {
+    test_table();
+    CCOMP::Parser::initialize();
+    test_declaration();
+    test_expression();
+    test_shadowed();
+    return 0;
+}